@@ -300,6 +300,30 @@ bool search_address_dictionaries_tokens_with_phrases(char *str, token_array *tok
 }
 
 
+// Sets up a search of the dictionaries for use with trie_search_tokens_multi
+bool search_address_dictionaries_tokens_multi_source(char *str, token_array *tokens, char *lang, phrase_array *phrases, trie_token_search_t *search) {
+    if (str == NULL || search == NULL) return false;
+    if (address_dict == NULL) {
+        log_error(ADDRESS_DICTIONARY_SETUP_ERROR);
+        return false;
+    }
+
+    trie_prefix_result_t prefix = get_language_prefix(lang);
+
+    if (prefix.node_id == NULL_NODE_ID) {
+        return false;
+    }
+
+    *search = (trie_token_search_t){
+        .trie = address_dict->trie,
+        .start_node_id = prefix.node_id,
+        .str = str,
+        .tokens = tokens,
+        .phrases = phrases
+    };
+    return true;
+}
+
 phrase_array *search_address_dictionaries_tokens(char *str, token_array *tokens, char *lang) {
     phrase_array *phrases = NULL;
 
@@ -62,6 +62,7 @@ phrase_array *search_address_dictionaries(char *str, char *lang);
 bool search_address_dictionaries_with_phrases(char *str, char *lang, phrase_array **phrases);
 phrase_array *search_address_dictionaries_tokens(char *str, token_array *tokens, char *lang);
 bool search_address_dictionaries_tokens_with_phrases(char *str, token_array *tokens, char *lang, phrase_array **phrases);
+bool search_address_dictionaries_tokens_multi_source(char *str, token_array *tokens, char *lang, phrase_array *phrases, trie_token_search_t *search);
 
 phrase_t search_address_dictionaries_substring(char *str, size_t len, char *lang);
 phrase_t search_address_dictionaries_prefix(char *str, size_t len, char *lang);
@@ -1,3 +1,6 @@
+#include <ctype.h>
+#include <pthread.h>
+
 #include "address_parser.h"
 #include "address_dictionary.h"
 #include "features.h"
@@ -15,6 +18,9 @@
 #define ADDRESS_PARSER_PHRASE_FILENAME "address_parser_phrases.dat"
 #define ADDRESS_PARSER_POSTAL_CODES_FILENAME "address_parser_postal_codes.dat"
 
+#define ADDRESS_PARSER_COUNTRY_SUBDIR "countries"
+#define ADDRESS_PARSER_LANGUAGE_SUBDIR "languages"
+
 #define UNKNOWN_WORD "UNKNOWN"
 #define UNKNOWN_NUMERIC "UNKNOWN_NUMERIC"
 
@@ -22,6 +28,15 @@
 
 static address_parser_t *parser = NULL;
 
+// Specialized (per-country/per-language) models, keyed by e.g. "countries/us".
+// A NULL value records that no model exists so the directory is only probed once.
+KHASH_MAP_INIT_STR(str_address_parser, address_parser_t *)
+
+static char *parser_dir = NULL;
+static khash_t(str_address_parser) *specialized_parsers = NULL;
+// Specialized models are loaded on first use, possibly from several parsing threads
+static pthread_mutex_t specialized_parsers_lock = PTHREAD_MUTEX_INITIALIZER;
+
 typedef enum {
     ADDRESS_PARSER_NULL_PHRASE,
     ADDRESS_PARSER_DICTIONARY_PHRASE,
@@ -53,6 +68,15 @@ bool address_parser_print_features(bool print_features) {
     if (parser == NULL) return false;
 
     parser->options.print_features = print_features;
+
+    if (specialized_parsers != NULL) {
+        address_parser_t *model;
+        kh_foreach_value(specialized_parsers, model, {
+            if (model != NULL) {
+                model->options.print_features = print_features;
+            }
+        })
+    }
     return true;
 }
 
@@ -163,11 +187,10 @@ static bool postal_code_context_exists(address_parser_t *self, uint32_t postal_c
     return graph_has_edge(g, postal_code_id, admin_id);
 }
 
-bool address_parser_load(char *dir) {
-    if (parser != NULL) return false;
-    if (dir == NULL) {
-        dir = LIBPOSTAL_ADDRESS_PARSER_DIR;
-    }
+address_parser_t *address_parser_load_dir(char *dir) {
+    if (dir == NULL) return NULL;
+
+    address_parser_t *parser = NULL;
 
     char_array *path = char_array_new_size(strlen(dir));
 
@@ -183,7 +206,7 @@ bool address_parser_load(char *dir) {
         } else {
             char_array_destroy(path);
             log_error("Averaged perceptron model could not be loaded\n");
-            return false;
+            return NULL;
         }
     } else {
         model_path = NULL;
@@ -203,7 +226,7 @@ bool address_parser_load(char *dir) {
             } else {
                 char_array_destroy(path);
                 log_error("Averaged perceptron model could not be loaded\n");
-                return false;
+                return NULL;
             }
         } else {
             model_path = NULL;
@@ -213,7 +236,7 @@ bool address_parser_load(char *dir) {
     if (parser == NULL) {
         char_array_destroy(path);
         log_error("Could not find parser model file of known type\n");
-        return false;
+        return NULL;
     }
 
     char_array_clear(path);
@@ -300,12 +323,126 @@ bool address_parser_load(char *dir) {
     }
 
     char_array_destroy(path);
-    return true;
+    return parser;
 
 exit_address_parser_created:
     address_parser_destroy(parser);
     char_array_destroy(path);
-    return false;
+    return NULL;
+}
+
+bool address_parser_load(char *dir) {
+    if (parser != NULL) return false;
+    if (dir == NULL) {
+        dir = LIBPOSTAL_ADDRESS_PARSER_DIR;
+    }
+
+    parser = address_parser_load_dir(dir);
+    if (parser == NULL) {
+        return false;
+    }
+
+    parser_dir = strdup(dir);
+    return true;
+}
+
+static address_parser_t *get_specialized_address_parser(char *subdir, char *name) {
+    if (parser_dir == NULL || name == NULL) return NULL;
+
+    size_t len = strlen(name);
+    if (len == 0) return NULL;
+
+    // Only plain codes (e.g. "us", "pt_br") map to model directories
+    for (size_t i = 0; i < len; i++) {
+        if (!isalnum((unsigned char)name[i]) && name[i] != '_' && name[i] != '-') return NULL;
+    }
+
+    char_array *key = char_array_new_size(strlen(subdir) + len + 2);
+    char_array_add_joined(key, PATH_SEPARATOR, true, 2, subdir, name);
+    char *key_str = char_array_get_string(key);
+
+    // Model directories are lowercase, option values may not be
+    for (char *c = key_str; *c; c++) {
+        *c = tolower((unsigned char)*c);
+    }
+
+    address_parser_t *model = NULL;
+
+    pthread_mutex_lock(&specialized_parsers_lock);
+
+    if (specialized_parsers == NULL) {
+        specialized_parsers = kh_init(str_address_parser);
+        if (specialized_parsers == NULL) {
+            char_array_destroy(key);
+            goto exit_specialized_parser;
+        }
+    }
+
+    khiter_t k = kh_get(str_address_parser, specialized_parsers, key_str);
+    if (k != kh_end(specialized_parsers)) {
+        char_array_destroy(key);
+        model = kh_value(specialized_parsers, k);
+        goto exit_specialized_parser;
+    }
+
+    char *dir = path_join(2, parser_dir, key_str);
+
+    char *model_path = path_join(2, dir, ADDRESS_PARSER_MODEL_FILENAME_CRF);
+    bool exists = file_exists(model_path);
+    free(model_path);
+    if (!exists) {
+        model_path = path_join(2, dir, ADDRESS_PARSER_MODEL_FILENAME);
+        exists = file_exists(model_path);
+        free(model_path);
+    }
+
+    if (exists) {
+        model = address_parser_load_dir(dir);
+        if (model == NULL) {
+            log_error("Error loading specialized parser model, dir=%s\n", dir);
+        } else {
+            model->options = parser->options;
+        }
+    }
+    free(dir);
+
+    int ret;
+    k = kh_put(str_address_parser, specialized_parsers, char_array_to_string(key), &ret);
+    if (ret < 0) {
+        free((char *)kh_key(specialized_parsers, k));
+        address_parser_destroy(model);
+        model = NULL;
+        goto exit_specialized_parser;
+    }
+    kh_value(specialized_parsers, k) = model;
+
+exit_specialized_parser:
+    pthread_mutex_unlock(&specialized_parsers_lock);
+    return model;
+}
+
+address_parser_t *get_address_parser_country(char *country) {
+    return get_specialized_address_parser(ADDRESS_PARSER_COUNTRY_SUBDIR, country);
+}
+
+address_parser_t *get_address_parser_language(char *language) {
+    return get_specialized_address_parser(ADDRESS_PARSER_LANGUAGE_SUBDIR, language);
+}
+
+/*
+Picks the most specific model available for the given options: country first,
+then language, falling back to the global parser. Specialized models are loaded
+lazily on first use from {parser_dir}/countries/{cc} or {parser_dir}/languages/{lang}.
+*/
+address_parser_t *get_address_parser_options(char *language, char *country) {
+    if (parser == NULL) return NULL;
+
+    address_parser_t *model = get_address_parser_country(country);
+    if (model == NULL) {
+        model = get_address_parser_language(language);
+    }
+
+    return model != NULL ? model : parser;
 }
 
 void address_parser_destroy(address_parser_t *self) {
@@ -370,26 +507,6 @@ void address_parser_context_destroy(address_parser_context_t *self) {
         char_array_destroy(self->phrase);
     }
 
-    if (self->context_phrase != NULL) {
-        char_array_destroy(self->context_phrase);
-    }
-
-    if (self->long_context_phrase != NULL) {
-        char_array_destroy(self->long_context_phrase);
-    }
-
-    if (self->component_phrase != NULL) {
-        char_array_destroy(self->component_phrase);
-    }
-
-    if (self->context_component_phrase != NULL) {
-        char_array_destroy(self->context_component_phrase);
-    }
-
-    if (self->long_context_component_phrase != NULL) {
-        char_array_destroy(self->long_context_component_phrase);
-    }
-
     if (self->prefix_phrase != NULL) {
         char_array_destroy(self->prefix_phrase);
     }
@@ -494,6 +611,34 @@ void address_parser_context_destroy(address_parser_context_t *self) {
         phrase_array_destroy(self->suffix_phrases);
     }
 
+    if (self->phrase_search != NULL) {
+        trie_multi_search_destroy(self->phrase_search);
+    }
+
+    if (self->vocab_freqs != NULL) {
+        uint32_array_destroy(self->vocab_freqs);
+    }
+
+    if (self->address_phrase_strings != NULL) {
+        cstring_array_destroy(self->address_phrase_strings);
+    }
+
+    if (self->component_phrase_strings != NULL) {
+        cstring_array_destroy(self->component_phrase_strings);
+    }
+
+    if (self->crf_context != NULL) {
+        crf_context_destroy(self->crf_context);
+    }
+
+    if (self->viterbi != NULL) {
+        uint32_array_destroy(self->viterbi);
+    }
+
+    if (self->scores != NULL) {
+        double_array_destroy(self->scores);
+    }
+
     free(self);
 }
 
@@ -504,37 +649,13 @@ address_parser_context_t *address_parser_context_new(void) {
 
     context->language = NULL;
     context->country = NULL;
+    context->crf_context = NULL;
 
     context->phrase = char_array_new();
     if (context->phrase == NULL) {
         goto exit_address_parser_context_allocated;
     }
 
-    context->context_phrase = char_array_new();
-    if (context->context_phrase == NULL) {
-        goto exit_address_parser_context_allocated;
-    }
-
-    context->long_context_phrase = char_array_new();
-    if (context->long_context_phrase == NULL) {
-        goto exit_address_parser_context_allocated;
-    }
-
-    context->component_phrase = char_array_new();
-    if (context->component_phrase == NULL) {
-        goto exit_address_parser_context_allocated;
-    }
-
-    context->context_component_phrase = char_array_new();
-    if (context->context_component_phrase == NULL) {
-        goto exit_address_parser_context_allocated;
-    }
-
-    context->long_context_component_phrase = char_array_new();
-    if (context->long_context_component_phrase == NULL) {
-        goto exit_address_parser_context_allocated;
-    }
-
     context->prefix_phrase = char_array_new();
     if (context->prefix_phrase == NULL) {
         goto exit_address_parser_context_allocated;
@@ -665,6 +786,36 @@ address_parser_context_t *address_parser_context_new(void) {
         goto exit_address_parser_context_allocated;
     }
 
+    context->phrase_search = trie_multi_search_new();
+    if (context->phrase_search == NULL) {
+        goto exit_address_parser_context_allocated;
+    }
+
+    context->vocab_freqs = uint32_array_new();
+    if (context->vocab_freqs == NULL) {
+        goto exit_address_parser_context_allocated;
+    }
+
+    context->address_phrase_strings = cstring_array_new();
+    if (context->address_phrase_strings == NULL) {
+        goto exit_address_parser_context_allocated;
+    }
+
+    context->component_phrase_strings = cstring_array_new();
+    if (context->component_phrase_strings == NULL) {
+        goto exit_address_parser_context_allocated;
+    }
+
+    context->viterbi = uint32_array_new();
+    if (context->viterbi == NULL) {
+        goto exit_address_parser_context_allocated;
+    }
+
+    context->scores = double_array_new();
+    if (context->scores == NULL) {
+        goto exit_address_parser_context_allocated;
+    }
+
     return context;
 
 exit_address_parser_context_allocated:
@@ -684,6 +835,24 @@ bool is_valid_component_phrase(cstring_array *strings, phrase_t phrase) {
     return valid;
 }
 
+static void address_parser_phrase_strings(cstring_array *phrase_strings, cstring_array *str, phrase_array *phrases) {
+    cstring_array_clear(phrase_strings);
+
+    for (size_t i = 0; i < phrases->n; i++) {
+        phrase_t phrase = phrases->a[i];
+        size_t phrase_end = phrase.start + phrase.len;
+
+        cstring_array_start_token(phrase_strings);
+        for (size_t k = phrase.start; k < phrase_end; k++) {
+            cstring_array_append_string(phrase_strings, cstring_array_get_string(str, k));
+            if (k < phrase_end - 1) {
+                cstring_array_append_string(phrase_strings, " ");
+            }
+        }
+        cstring_array_terminate(phrase_strings);
+    }
+}
+
 void address_parser_context_fill(address_parser_context_t *context, address_parser_t *parser, tokenized_string_t *tokenized_str, char *language, char *country) {
     uint32_t token_index;
     char *word;
@@ -705,9 +874,18 @@ void address_parser_context_fill(address_parser_context_t *context, address_pars
     char *str = tokenized_str->str;
     token_array *tokens = tokenized_str->tokens;
 
+    phrase_array_clear(context->prefix_phrases);
+    phrase_array_clear(context->suffix_phrases);
+
     cstring_array_foreach(tokenized_str->strings, token_index, word, {
         token_t token = tokens->a[token_index];
 
+        phrase_t prefix_phrase = search_address_dictionaries_prefix(word, token.len, NULL);
+        phrase_array_push(context->prefix_phrases, prefix_phrase);
+
+        phrase_t suffix_phrase = search_address_dictionaries_suffix(word, token.len, NULL);
+        phrase_array_push(context->suffix_phrases, suffix_phrase);
+
         size_t token_offset = normalized->str->n;
         address_parser_normalize_token(normalized, str, token);
         size_t token_len;
@@ -740,6 +918,11 @@ void address_parser_context_fill(address_parser_context_t *context, address_pars
     char *normalized_str = normalized->str->a;
     char *normalized_str_admin = normalized_admin->str->a;
 
+    uint32_array_clear(context->vocab_freqs);
+    cstring_array_foreach(normalized, token_index, word, {
+        uint32_array_push(context->vocab_freqs, word_vocab_frequency(parser, word));
+    })
+
     /*
     Address dictionary phrases
     --------------------------
@@ -759,23 +942,6 @@ void address_parser_context_fill(address_parser_context_t *context, address_pars
 
     size_t num_tokens = tokens->n;
 
-    bool have_address_phrases = search_address_dictionaries_tokens_with_phrases(normalized_str, normalized_tokens, NULL, &address_dictionary_phrases);
-    token_phrase_memberships(address_dictionary_phrases, address_phrase_memberships, num_tokens);
-
-    phrase_array_clear(context->prefix_phrases);
-    phrase_array_clear(context->suffix_phrases);
-
-    for (size_t i = 0; i < num_tokens; i++) {
-        token_t token = tokens->a[i];
-        char *word_pre_norm = tokenized_string_get_token(tokenized_str, i);
-
-        phrase_t prefix_phrase = search_address_dictionaries_prefix(word_pre_norm, token.len, NULL);
-        phrase_array_push(context->prefix_phrases, prefix_phrase);
-
-        phrase_t suffix_phrase = search_address_dictionaries_suffix(word_pre_norm, token.len, NULL);
-        phrase_array_push(context->suffix_phrases, suffix_phrase);
-    }
-
     /*
     Component phrases
     -----------------
@@ -795,7 +961,42 @@ void address_parser_context_fill(address_parser_context_t *context, address_pars
     phrase_array *component_phrases = context->component_phrases;
     int64_array *component_phrase_memberships = context->component_phrase_memberships;
 
-    bool have_component_phrases = trie_search_tokens_with_phrases(parser->phrases, normalized_str_admin, normalized_admin_tokens, &component_phrases);
+    phrase_array_clear(context->postal_code_phrases);
+    int64_array_clear(context->postal_code_phrase_memberships);
+
+    phrase_array *postal_code_phrases = context->postal_code_phrases;
+    int64_array *postal_code_phrase_memberships = context->postal_code_phrase_memberships;
+
+    // Dictionary phrases are matched on the normalized tokens, component phrases and postal codes
+    // on the admin-normalized tokens. The token indices are the same, so search all three in one pass.
+    trie_token_search_t searches[3];
+    size_t num_searches = 0;
+
+    if (search_address_dictionaries_tokens_multi_source(normalized_str, normalized_tokens, NULL, address_dictionary_phrases, &searches[num_searches])) {
+        num_searches++;
+    }
+
+    searches[num_searches++] = (trie_token_search_t){
+        .trie = parser->phrases,
+        .start_node_id = ROOT_NODE_ID,
+        .str = normalized_str_admin,
+        .tokens = normalized_admin_tokens,
+        .phrases = component_phrases
+    };
+
+    searches[num_searches++] = (trie_token_search_t){
+        .trie = parser->postal_codes,
+        .start_node_id = ROOT_NODE_ID,
+        .str = normalized_str_admin,
+        .tokens = normalized_admin_tokens,
+        .phrases = postal_code_phrases
+    };
+
+    if (num_tokens > 0) {
+        trie_search_tokens_multi(context->phrase_search, searches, num_searches);
+    }
+
+    token_phrase_memberships(address_dictionary_phrases, address_phrase_memberships, num_tokens);
     token_phrase_memberships(component_phrases, component_phrase_memberships, num_tokens);
 
     for (size_t i = 0; i < component_phrases->n; i++) {
@@ -807,29 +1008,11 @@ void address_parser_context_fill(address_parser_context_t *context, address_pars
         }
     }
 
-    phrase_array_clear(context->postal_code_phrases);
-    int64_array_clear(context->postal_code_phrase_memberships);
-
-    phrase_array *postal_code_phrases = context->postal_code_phrases;
-    int64_array *postal_code_phrase_memberships = context->postal_code_phrase_memberships;
-
-    bool have_postal_code_phrases = trie_search_tokens_with_phrases(parser->postal_codes, normalized_str_admin, normalized_admin_tokens, &postal_code_phrases);
     token_phrase_memberships(postal_code_phrases, postal_code_phrase_memberships, num_tokens);
 
-}
-
-static inline phrase_t phrase_at_index(phrase_array *phrases, int64_array *phrase_memberships, uint32_t i) {
-    if (phrases == NULL || phrase_memberships == NULL || i > phrase_memberships->n - 1) {
-        return NULL_PHRASE;
-    }
+    address_parser_phrase_strings(context->address_phrase_strings, normalized, address_dictionary_phrases);
+    address_parser_phrase_strings(context->component_phrase_strings, normalized_admin, component_phrases);
 
-    int64_t phrase_index = phrase_memberships->a[i];
-    if (phrase_index != NULL_PHRASE_MEMBERSHIP) {
-        phrase_t phrase = phrases->a[phrase_index];
-        return phrase;
-    }
-
-    return NULL_PHRASE;
 }
 
 char *phrase_prefix(char *word, size_t len, phrase_t prefix_phrase, char_array *prefix_phrase_array) {
@@ -880,20 +1063,25 @@ static inline bool is_plain_word_phrase_type(address_parser_phrase_type_t type)
     return type == ADDRESS_PARSER_NULL_PHRASE || type == ADDRESS_PARSER_SUFFIX_PHRASE || type == ADDRESS_PARSER_PREFIX_PHRASE;
 }
 
-static address_parser_phrase_t word_or_phrase_at_index(address_parser_t *parser, tokenized_string_t *tokenized, address_parser_context_t *context, uint32_t i, bool long_context) {
-    phrase_t phrase;
+static address_parser_phrase_t word_or_phrase_at_index(address_parser_t *parser, tokenized_string_t *tokenized, address_parser_context_t *context, uint32_t i) {
+    phrase_t phrase = NULL_PHRASE;
     address_parser_phrase_t response;
-    char *phrase_string = NULL;
 
-    phrase = phrase_at_index(context->address_dictionary_phrases, context->address_phrase_memberships, i);
-    
-    phrase_t component_phrase = phrase_at_index(context->component_phrases, context->component_phrase_memberships, i);
+    int64_t address_phrase_index = context->address_phrase_memberships->a[i];
+    int64_t component_phrase_index = context->component_phrase_memberships->a[i];
 
-    if (phrase.len > 0 && is_valid_dictionary_phrase(phrase) && component_phrase.len <= phrase.len) {
-        phrase_string = cstring_array_get_phrase(context->normalized, long_context ? context->long_context_phrase : context->context_phrase, phrase),
+    if (address_phrase_index != NULL_PHRASE_MEMBERSHIP) {
+        phrase = context->address_dictionary_phrases->a[address_phrase_index];
+    }
+
+    phrase_t component_phrase = NULL_PHRASE;
+    if (component_phrase_index != NULL_PHRASE_MEMBERSHIP) {
+        component_phrase = context->component_phrases->a[component_phrase_index];
+    }
 
+    if (phrase.len > 0 && is_valid_dictionary_phrase(phrase) && component_phrase.len <= phrase.len) {
         response = (address_parser_phrase_t){
-            phrase_string,
+            cstring_array_get_string(context->address_phrase_strings, address_phrase_index),
             ADDRESS_PARSER_DICTIONARY_PHRASE,
             phrase
         };
@@ -903,10 +1091,8 @@ static address_parser_phrase_t word_or_phrase_at_index(address_parser_t *parser,
     phrase = component_phrase;
 
     if (phrase.len > 0) {
-        phrase_string = cstring_array_get_phrase(context->normalized_admin, long_context ? context->long_context_component_phrase : context->context_component_phrase, phrase);
-
         response = (address_parser_phrase_t){
-            phrase_string,
+            cstring_array_get_string(context->component_phrase_strings, component_phrase_index),
             ADDRESS_PARSER_COMPONENT_PHRASE,
             phrase
         };
@@ -1149,7 +1335,6 @@ bool address_parser_features(void *self, void *ctx, tokenized_string_t *tokenize
     }
 
     char_array *phrase_tokens = context->phrase;
-    char_array *component_phrase_tokens = context->component_phrase;
 
     uint32_t expansion_index;
     address_expansion_value_t *expansion_value;
@@ -1175,7 +1360,7 @@ bool address_parser_features(void *self, void *ctx, tokenized_string_t *tokenize
             }
             uint32_t address_phrase_types = expansion_value->components;
 
-            phrase_string = cstring_array_get_phrase(context->normalized, phrase_tokens, phrase);
+            phrase_string = cstring_array_get_string(context->address_phrase_strings, address_phrase_index);
 
             add_word_feature = false;
             log_debug("phrase_string=%s\n", phrase_string);
@@ -1200,7 +1385,7 @@ bool address_parser_features(void *self, void *ctx, tokenized_string_t *tokenize
     if (component_phrase.len > 0 && component_phrase.len >= phrase.len) {
         component_phrase = component_phrases->a[component_phrase_index];
 
-        component_phrase_string = cstring_array_get_phrase(context->normalized_admin, component_phrase_tokens, component_phrase);
+        component_phrase_string = cstring_array_get_string(context->component_phrase_strings, component_phrase_index);
         
         uint32_t component_phrase_index = component_phrase.data;
         if (component_phrase_index > parser->phrase_types->n) {
@@ -1318,7 +1503,7 @@ bool address_parser_features(void *self, void *ctx, tokenized_string_t *tokenize
         }
     }
 
-    uint32_t word_freq = word_vocab_frequency(parser, word);
+    uint32_t word_freq = context->vocab_freqs->a[idx];
 
     bool is_word = is_word_token(token.type);
 
@@ -1480,11 +1665,11 @@ bool address_parser_features(void *self, void *ctx, tokenized_string_t *tokenize
     }
 
     if (last_index >= 0) {
-        address_parser_phrase_t prev_word_or_phrase = word_or_phrase_at_index(parser, tokenized, context, last_index, false);
+        address_parser_phrase_t prev_word_or_phrase = word_or_phrase_at_index(parser, tokenized, context, last_index);
         char *prev_word = prev_word_or_phrase.str;
 
         if (is_plain_word_phrase_type(prev_word_or_phrase.type)) {
-            uint32_t prev_word_freq = word_vocab_frequency(parser, prev_word);
+            uint32_t prev_word_freq = context->vocab_freqs->a[last_index];
             token_t prev_token = tokenized->tokens->a[last_index];
             bool prev_token_numeric = is_numeric_token(prev_token.type);
             if (prev_word_freq == 0) {
@@ -1505,12 +1690,12 @@ bool address_parser_features(void *self, void *ctx, tokenized_string_t *tokenize
     }
 
     if (next_index < num_tokens) {
-        address_parser_phrase_t next_word_or_phrase = word_or_phrase_at_index(parser, tokenized, context, next_index, false);
+        address_parser_phrase_t next_word_or_phrase = word_or_phrase_at_index(parser, tokenized, context, next_index);
         char *next_word = next_word_or_phrase.str;
         size_t next_word_len = 1;
 
         if (is_plain_word_phrase_type(next_word_or_phrase.type)) {
-            uint32_t next_word_freq = word_vocab_frequency(parser, next_word);
+            uint32_t next_word_freq = context->vocab_freqs->a[next_index];
             token_t next_token = tokenized->tokens->a[next_index];
             bool next_token_numeric = is_numeric_token(next_token.type);
             if (next_word_freq == 0) {
@@ -1554,7 +1739,7 @@ bool address_parser_features(void *self, void *ctx, tokenized_string_t *tokenize
                 token_t right_token = tokens->a[right_idx];
 
                 /* Check */
-                address_parser_phrase_t right_context_word_or_phrase = word_or_phrase_at_index(parser, tokenized, context, right_idx, true);
+                address_parser_phrase_t right_context_word_or_phrase = word_or_phrase_at_index(parser, tokenized, context, right_idx);
                 address_parser_phrase_type_t right_context_phrase_type = right_context_word_or_phrase.type;
                 if (right_context_phrase_type != ADDRESS_PARSER_NULL_PHRASE &&
                     right_context_phrase_type != ADDRESS_PARSER_DICTIONARY_PHRASE &&
@@ -1644,9 +1829,19 @@ bool address_parser_features(void *self, void *ctx, tokenized_string_t *tokenize
 
 bool address_parser_predict(address_parser_t *self, address_parser_context_t *context, cstring_array *token_labels, tagger_feature_function feature_function, tokenized_string_t *tokenized_str) {
     if (self->model_type == ADDRESS_PARSER_TYPE_GREEDY_AVERAGED_PERCEPTRON) {
-        return averaged_perceptron_tagger_predict(self->model.ap, self, context, context->features, context->prev_tag_features, context->prev2_tag_features, token_labels, feature_function, tokenized_str, self->options.print_features);
+        return averaged_perceptron_tagger_predict_context(self->model.ap, context->scores, self, context, context->features, context->prev_tag_features, context->prev2_tag_features, token_labels, feature_function, tokenized_str, self->options.print_features);
     } else if (self->model_type == ADDRESS_PARSER_TYPE_CRF) {
-        return crf_tagger_predict(self->model.crf, self, context, context->features, context->prev_tag_features, token_labels, feature_function, tokenized_str, self->options.print_features);
+        crf_t *crf = self->model.crf;
+        // The context may have been used with a model that has a different label set
+        if (context->crf_context != NULL && context->crf_context->num_labels != crf->num_classes) {
+            crf_context_destroy(context->crf_context);
+            context->crf_context = NULL;
+        }
+        if (context->crf_context == NULL) {
+            context->crf_context = crf_context_new(CRF_CONTEXT_VITERBI, crf->num_classes, CRF_CONTEXT_DEFAULT_NUM_ITEMS);
+            if (context->crf_context == NULL) return false;
+        }
+        return crf_tagger_predict_context(crf, context->crf_context, context->viterbi, self, context, context->features, context->prev_tag_features, token_labels, feature_function, tokenized_str, self->options.print_features);
     } else {
         log_error("Parser has unknown model type\n");
     }
@@ -1659,15 +1854,21 @@ libpostal_address_parser_response_t *address_parser_response_new(void) {
 }
 
 libpostal_address_parser_response_t *address_parser_parse(char *address, char *language, char *country) {
+    return address_parser_parse_context(address, language, country, NULL);
+}
+
+libpostal_address_parser_response_t *address_parser_parse_context(char *address, char *language, char *country, address_parser_context_t *context) {
     if (address == NULL) return NULL;
 
-    address_parser_t *parser = get_address_parser();
+    address_parser_t *parser = get_address_parser_options(language, country);
     if (parser == NULL || parser->context == NULL) {
         log_error("parser is not setup, call libpostal_setup_address_parser()\n");
         return NULL;
     }
 
-    address_parser_context_t *context = parser->context;
+    if (context == NULL) {
+        context = parser->context;
+    }
 
     char *normalized = address_parser_normalize_string(address);
     bool is_normalized = normalized != NULL;
@@ -1695,9 +1896,9 @@ libpostal_address_parser_response_t *address_parser_parse(char *address, char *l
         uint32_array_push(context->separators, ADDRESS_SEPARATOR_NONE);
     }
 
-    // This parser was trained without knowing language/country.
-    // If at some point we build country-specific/language-specific
-    // parsers, these parameters could be used to select a model.
+    // The parsers are trained without knowing language/country.
+    // These parameters are only used to select a model above
+    // (see get_address_parser_options).
     // The language parameter does technically control which dictionaries
     // are searched at the street level. It's possible with e.g. a phrase
     // like "de", which can be either the German country code or a stopword
@@ -1706,8 +1907,7 @@ libpostal_address_parser_response_t *address_parser_parse(char *address, char *l
     // may be working together as a kind of intercept. Depriving the model
     // of the street-level phrase features by passing in a known language
     // may change the decision threshold so explicitly ignore these
-    // options until there's a use for them (country-specific or language-specific
-    // parser models).
+    // options for feature extraction.
 
     language = NULL;
     country = NULL;
@@ -1854,4 +2054,20 @@ void address_parser_module_teardown(void) {
         address_parser_destroy(parser);
     }
     parser = NULL;
+
+    if (specialized_parsers != NULL) {
+        const char *key;
+        address_parser_t *model;
+        kh_foreach(specialized_parsers, key, model, {
+            free((char *)key);
+            address_parser_destroy(model);
+        })
+        kh_destroy(str_address_parser, specialized_parsers);
+    }
+    specialized_parsers = NULL;
+
+    if (parser_dir != NULL) {
+        free(parser_dir);
+    }
+    parser_dir = NULL;
 }
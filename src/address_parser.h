@@ -145,17 +145,12 @@ typedef struct address_parser_context {
     cstring_array *prev2_tag_features;
     // Temporary strings used at each token during feature extraction
     char_array *phrase;
-    char_array *context_phrase;
-    char_array *long_context_phrase;
     char_array *prefix_phrase;
     char_array *context_prefix_phrase;
     char_array *long_context_prefix_phrase;
     char_array *suffix_phrase;
     char_array *context_suffix_phrase;
     char_array *long_context_suffix_phrase;
-    char_array *component_phrase;
-    char_array *context_component_phrase;
-    char_array *long_context_component_phrase;
     // ngrams and prefix/suffix features
     cstring_array *ngrams;
     // For hyphenated words
@@ -176,8 +171,20 @@ typedef struct address_parser_context {
     int64_array *postal_code_phrase_memberships; // Index in postal_code_phrases or -1
     phrase_array *prefix_phrases;
     phrase_array *suffix_phrases;
+    // Scratch space for searching all of the phrase tries in one pass
+    trie_multi_search_t *phrase_search;
+    // Per-sentence lookups computed once in address_parser_context_fill since
+    // the feature function visits each token again as a neighbor
+    uint32_array *vocab_freqs; // Vocab frequency of each normalized token
+    cstring_array *address_phrase_strings; // Normalized string for each of address_dictionary_phrases
+    cstring_array *component_phrase_strings; // Admin-normalized string for each of component_phrases
     // The tokenized string used to conveniently access both words as C strings and tokens by index
     tokenized_string_t *tokenized_str;
+    // Tagger scratch space, kept here rather than in the model so that
+    // several contexts can predict with the same model concurrently
+    crf_context_t *crf_context;
+    uint32_array *viterbi;
+    double_array *scores;
 } address_parser_context_t;
 
 typedef union postal_code_context_value {
@@ -222,10 +229,15 @@ typedef struct address_parser {
 address_parser_t *address_parser_new(void);
 address_parser_t *address_parser_new_options(parser_options_t options);
 address_parser_t *get_address_parser(void);
+address_parser_t *get_address_parser_country(char *country);
+address_parser_t *get_address_parser_language(char *language);
+address_parser_t *get_address_parser_options(char *language, char *country);
 bool address_parser_load(char *dir);
 
 bool address_parser_print_features(bool print_features);
 libpostal_address_parser_response_t *address_parser_parse(char *address, char *language, char *country);
+// Parses using the caller's context instead of the model's, so threads with separate contexts can parse concurrently
+libpostal_address_parser_response_t *address_parser_parse_context(char *address, char *language, char *country, address_parser_context_t *context);
 void address_parser_destroy(address_parser_t *self);
 
 char *address_parser_normalize_string(char *str);
@@ -244,6 +256,7 @@ bool address_parser_features(void *self, void *ctx, tokenized_string_t *str, uin
 // I/O methods
 
 bool address_parser_load(char *dir);
+address_parser_t *address_parser_load_dir(char *dir);
 bool address_parser_save(address_parser_t *self, char *output_dir);
 
 // Module setup/teardown
@@ -1,13 +1,10 @@
 #include "address_parser_io.h"
 
-address_parser_data_set_t *address_parser_data_set_init(char *filename) {
+address_parser_data_set_t *address_parser_data_set_new(void) {
     address_parser_data_set_t *data_set = malloc(sizeof(address_parser_data_set_t));
-    data_set->f = fopen(filename, "r");
-    if (data_set->f == NULL) {
-        free(data_set);
-        return NULL;
-    }
+    if (data_set == NULL) return NULL;
 
+    data_set->f = NULL;
     data_set->tokens = token_array_new();
     data_set->tokenized_str = NULL;
     data_set->normalizations = cstring_array_new();
@@ -20,6 +17,22 @@ address_parser_data_set_t *address_parser_data_set_init(char *filename) {
     return data_set;
 }
 
+address_parser_data_set_t *address_parser_data_set_init(char *filename) {
+    FILE *f = fopen(filename, "r");
+    if (f == NULL) {
+        return NULL;
+    }
+
+    address_parser_data_set_t *data_set = address_parser_data_set_new();
+    if (data_set == NULL) {
+        fclose(f);
+        return NULL;
+    }
+    data_set->f = f;
+
+    return data_set;
+}
+
 bool address_parser_data_set_rewind(address_parser_data_set_t *self) {
     if (self == NULL || self->f == NULL) return false;
 
@@ -191,48 +204,52 @@ bool address_parser_data_set_tokenize_line(address_parser_data_set_t *self, char
 
 
 
-bool address_parser_data_set_next(address_parser_data_set_t *self) {
-    if (self == NULL) return false;
+bool address_parser_data_set_set_line(address_parser_data_set_t *self, char *line) {
+    if (self == NULL || line == NULL) return false;
 
-    cstring_array *fields = NULL;
+    size_t token_count;
 
-    if (self->norm == 0 || self->norm >= cstring_array_num_strings(self->normalizations)) {
-        char *line = file_getline(self->f);
-        if (line == NULL) {
-            return false;
-        }
+    cstring_array *fields = cstring_array_split(line, TAB_SEPARATOR, TAB_SEPARATOR_LEN, &token_count);
+    if (fields == NULL) {
+        return false;
+    }
 
-        size_t token_count;
+    bool ret = false;
 
-        fields = cstring_array_split(line, TAB_SEPARATOR, TAB_SEPARATOR_LEN, &token_count);
+    if (token_count != ADDRESS_PARSER_FILE_NUM_TOKENS) {
+        log_error("Token count did not match, expected %d, got %zu\n", ADDRESS_PARSER_FILE_NUM_TOKENS, token_count);
+        goto exit_destroy_fields;
+    }
 
-        free(line);
+    char *language = cstring_array_get_string(fields, ADDRESS_PARSER_FIELD_LANGUAGE);
+    char *country = cstring_array_get_string(fields, ADDRESS_PARSER_FIELD_COUNTRY);
+    char *address = cstring_array_get_string(fields, ADDRESS_PARSER_FIELD_ADDRESS);
 
-        if (token_count != ADDRESS_PARSER_FILE_NUM_TOKENS) {
-            log_error("Token count did not match, expected %d, got %zu\n", ADDRESS_PARSER_FILE_NUM_TOKENS, token_count);
-            return false;
-        }
+    char_array_clear(self->country);
+    char_array_add(self->country, country);
 
-        char *language = cstring_array_get_string(fields, ADDRESS_PARSER_FIELD_LANGUAGE);
-        char *country = cstring_array_get_string(fields, ADDRESS_PARSER_FIELD_COUNTRY);
-        char *address = cstring_array_get_string(fields, ADDRESS_PARSER_FIELD_ADDRESS);
+    char_array_clear(self->language);
+    char_array_add(self->language, language);
 
-        char_array_clear(self->country);
-        char_array_add(self->country, country);
+    log_debug("Doing: %s\n", address);
 
-        char_array_clear(self->language);
-        char_array_add(self->language, language);
+    cstring_array_clear(self->normalizations);
+    self->norm = 0;
 
-        log_debug("Doing: %s\n", address);
+    if (!address_parser_all_normalizations(self->normalizations, address, language) || cstring_array_num_strings(self->normalizations) == 0) {
+        log_error("Error during string normalization\n");
+        goto exit_destroy_fields;
+    }
 
-        cstring_array_clear(self->normalizations);
+    ret = true;
 
-        if (!address_parser_all_normalizations(self->normalizations, address, language) || cstring_array_num_strings(self->normalizations) == 0) {
-            log_error("Error during string normalization\n");
-            return false;
-        }
-        self->norm = 0;
-    }
+exit_destroy_fields:
+    cstring_array_destroy(fields);
+    return ret;
+}
+
+bool address_parser_data_set_next_normalization(address_parser_data_set_t *self) {
+    if (self == NULL || self->norm >= cstring_array_num_strings(self->normalizations)) return false;
 
     char *normalized = cstring_array_get_string(self->normalizations, self->norm);
 
@@ -243,25 +260,40 @@ bool address_parser_data_set_next(address_parser_data_set_t *self) {
     token_array_clear(tokens);
     cstring_array_clear(labels);
     uint32_array_clear(separators);
-    size_t len = strlen(normalized);
 
     tokenized_string_t *tokenized_str = NULL;
 
     if (address_parser_data_set_tokenize_line(self, normalized)) {
         // Add tokens as discrete strings for easier use in feature functions
         bool copy_tokens = true;
-        tokenized_str = tokenized_string_from_tokens(normalized, self->tokens, copy_tokens);        
+        tokenized_str = tokenized_string_from_tokens(normalized, self->tokens, copy_tokens);
     }
 
     self->tokenized_str = tokenized_str;
 
     self->norm++;
 
-    if (fields != NULL) {
-        cstring_array_destroy(fields);
+    return tokenized_str != NULL;
+}
+
+bool address_parser_data_set_next(address_parser_data_set_t *self) {
+    if (self == NULL) return false;
+
+    if (self->norm == 0 || self->norm >= cstring_array_num_strings(self->normalizations)) {
+        char *line = file_getline(self->f);
+        if (line == NULL) {
+            return false;
+        }
+
+        bool line_ok = address_parser_data_set_set_line(self, line);
+        free(line);
+
+        if (!line_ok) {
+            return false;
+        }
     }
 
-    return tokenized_str != NULL;
+    return address_parser_data_set_next_normalization(self);
 }
 
 
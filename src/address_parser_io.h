@@ -34,9 +34,15 @@ typedef struct address_parser_data_set {
 } address_parser_data_set_t;
 
 
+// Data set with no file, fed one line at a time with address_parser_data_set_set_line
+address_parser_data_set_t *address_parser_data_set_new(void);
 address_parser_data_set_t *address_parser_data_set_init(char *filename);
 bool address_parser_data_set_rewind(address_parser_data_set_t *self);
 bool address_parser_data_set_tokenize_line(address_parser_data_set_t *self, char *input);
+// Parses a training line (language, country, labeled address) and computes its normalizations
+bool address_parser_data_set_set_line(address_parser_data_set_t *self, char *line);
+// Tokenizes the next normalization of the current line, false when there are none left
+bool address_parser_data_set_next_normalization(address_parser_data_set_t *self);
 bool address_parser_data_set_next(address_parser_data_set_t *self);
 void address_parser_data_set_destroy(address_parser_data_set_t *self);
 
@@ -1,3 +1,7 @@
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
 #include "address_parser.h"
 #include "address_parser_io.h"
 #include "address_dictionary.h"
@@ -9,14 +13,45 @@
 
 #include "log/log.h"
 
+#define ADDRESS_PARSER_TEST_BATCH_SIZE 256
+#define ADDRESS_PARSER_TEST_LOG_LINES 100000
+
 typedef struct address_parser_test_results {
     size_t num_errors;
     size_t num_predictions;
     size_t num_address_errors;
     size_t num_address_predictions;
     uint32_t *confusion;
+    double_array *latencies;        // Seconds spent featurizing + predicting each address
 } address_parser_test_results_t;
 
+/*
+Evaluation is parallelized by handing out batches of raw lines from a shared
+file handle. Each worker normalizes, tokenizes and predicts with its own data
+set and parser context and keeps its own counts/confusion matrix, which are
+summed once all the workers are done.
+*/
+typedef struct address_parser_test_reader {
+    pthread_mutex_t lock;
+    FILE *f;
+    size_t num_lines;
+    bool done;
+} address_parser_test_reader_t;
+
+typedef struct address_parser_test_worker {
+    pthread_t thread;
+    address_parser_t *parser;
+    address_parser_test_reader_t *reader;
+    address_parser_test_results_t results;
+    bool print_errors;
+    bool success;
+} address_parser_test_worker_t;
+
+static double address_parser_test_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
 
 static uint32_t address_parser_num_classes(address_parser_t *parser) {
     if (parser->model_type == ADDRESS_PARSER_TYPE_GREEDY_AVERAGED_PERCEPTRON) {
@@ -56,109 +91,292 @@ static uint32_t address_parser_get_class_index(address_parser_t *parser, char *n
 }
 
 
-#define EMPTY_ADDRESS_PARSER_TEST_RESULT (address_parser_test_results_t){0, 0, 0, 0, NULL}
+#define EMPTY_ADDRESS_PARSER_TEST_RESULT (address_parser_test_results_t){0, 0, 0, 0, NULL, NULL}
 
-bool address_parser_test(address_parser_t *parser, char *filename, address_parser_test_results_t *result, bool print_errors) {
-    if (filename == NULL) {
-        log_error("Filename was NULL\n");
-        return NULL;
+static size_t address_parser_test_reader_read(address_parser_test_reader_t *reader, cstring_array *lines, size_t max_lines) {
+    cstring_array_clear(lines);
+
+    size_t num_lines = 0;
+
+    pthread_mutex_lock(&reader->lock);
+    while (!reader->done && num_lines < max_lines) {
+        char *line = file_getline(reader->f);
+        if (line == NULL) {
+            reader->done = true;
+            break;
+        }
+        cstring_array_add_string(lines, line);
+        free(line);
+        num_lines++;
     }
 
-    uint32_t num_classes = address_parser_num_classes(parser);
+    size_t prev_lines = reader->num_lines;
+    reader->num_lines += num_lines;
+    if (reader->num_lines / ADDRESS_PARSER_TEST_LOG_LINES > prev_lines / ADDRESS_PARSER_TEST_LOG_LINES) {
+        log_info("Read %zu lines\n", reader->num_lines);
+    }
+    pthread_mutex_unlock(&reader->lock);
+
+    return num_lines;
+}
+
+static void address_parser_test_reader_stop(address_parser_test_reader_t *reader) {
+    pthread_mutex_lock(&reader->lock);
+    reader->done = true;
+    pthread_mutex_unlock(&reader->lock);
+}
 
+static bool address_parser_test_results_init(address_parser_test_results_t *result, uint32_t num_classes) {
+    *result = EMPTY_ADDRESS_PARSER_TEST_RESULT;
     result->confusion = calloc(num_classes * num_classes, sizeof(uint32_t));
+    result->latencies = double_array_new();
+    return result->confusion != NULL && result->latencies != NULL;
+}
+
+static void address_parser_test_results_clear(address_parser_test_results_t *result) {
+    if (result->confusion != NULL) {
+        free(result->confusion);
+    }
+    if (result->latencies != NULL) {
+        double_array_destroy(result->latencies);
+    }
+    *result = EMPTY_ADDRESS_PARSER_TEST_RESULT;
+}
 
-    address_parser_data_set_t *data_set = address_parser_data_set_init(filename);
+static void address_parser_test_results_merge(address_parser_test_results_t *result, address_parser_test_results_t *other, uint32_t num_classes) {
+    result->num_errors += other->num_errors;
+    result->num_predictions += other->num_predictions;
+    result->num_address_errors += other->num_address_errors;
+    result->num_address_predictions += other->num_address_predictions;
 
-    if (data_set == NULL) {
-        log_error("Error initializing data set\n");
-        return NULL;
+    for (size_t i = 0; i < num_classes * num_classes; i++) {
+        result->confusion[i] += other->confusion[i];
     }
 
-    address_parser_context_t *context = address_parser_context_new();
+    double_array_extend(result->latencies, other->latencies);
+}
+
+static bool address_parser_test_example(address_parser_test_worker_t *worker, address_parser_context_t *context, address_parser_data_set_t *data_set, cstring_array *token_labels) {
+    address_parser_t *parser = worker->parser;
+    address_parser_test_results_t *result = &worker->results;
+    uint32_t num_classes = address_parser_num_classes(parser);
 
-    bool success = false;
+    char *language = char_array_get_string(data_set->language);
+    if (string_equals(language, UNKNOWN_LANGUAGE) || string_equals(language, AMBIGUOUS_LANGUAGE)) {
+        language = NULL;
+    }
+    char *country = char_array_get_string(data_set->country);
 
-    size_t examples = 0;
+    cstring_array_clear(token_labels);
 
-    bool logged = false;
+    size_t starting_errors = result->num_errors;
 
-    cstring_array *token_labels = cstring_array_new();
+    double start_time = address_parser_test_time();
 
-    while (address_parser_data_set_next(data_set)) {
-        char *language = char_array_get_string(data_set->language);
-        if (string_equals(language, UNKNOWN_LANGUAGE) || string_equals(language, AMBIGUOUS_LANGUAGE)) {
-            language = NULL;
-        }
-        char *country = char_array_get_string(data_set->country);
+    address_parser_context_fill(context, parser, data_set->tokenized_str, language, country);
+    bool prediction_success = address_parser_predict(parser, context, token_labels, &address_parser_features, data_set->tokenized_str);
+
+    double_array_push(result->latencies, address_parser_test_time() - start_time);
+
+    if (!prediction_success) {
+        log_error("Error in prediction\n");
+        return false;
+    }
 
-        address_parser_context_fill(context, parser, data_set->tokenized_str, language, country);
+    uint32_t i;
+    char *predicted;
+    cstring_array_foreach(token_labels, i, predicted, {
+        char *truth = cstring_array_get_string(data_set->labels, i);
+
+        if (strcmp(predicted, truth) != 0) {
+            result->num_errors++;
+
+            uint32_t predicted_index = address_parser_get_class_index(parser, predicted);
+            uint32_t truth_index = address_parser_get_class_index(parser, truth);
+
+            result->confusion[predicted_index * num_classes + truth_index]++;
+
+            if (worker->print_errors) {
+                printf("%s\t%s\t%d\t%s\n", predicted, truth, i, data_set->tokenized_str->str);
+            }
+        }
+        result->num_predictions++;
+    })
 
-        cstring_array_clear(token_labels);
+    if (result->num_errors > starting_errors) {
+        result->num_address_errors++;
+    }
 
-        char *prev_label = NULL;
+    result->num_address_predictions++;
 
-        size_t starting_errors = result->num_errors;
+    return true;
+}
 
-        bool prediction_success = address_parser_predict(parser, context, token_labels, &address_parser_features, data_set->tokenized_str);
+static void *address_parser_test_worker_run(void *arg) {
+    address_parser_test_worker_t *worker = (address_parser_test_worker_t *)arg;
+    address_parser_test_reader_t *reader = worker->reader;
 
-        if (prediction_success) {
-            uint32_t i;
-            char *predicted;
-            cstring_array_foreach(token_labels, i, predicted, {
-                char *truth = cstring_array_get_string(data_set->labels, i);
+    address_parser_data_set_t *data_set = address_parser_data_set_new();
+    address_parser_context_t *context = address_parser_context_new();
+    cstring_array *token_labels = cstring_array_new();
+    cstring_array *lines = cstring_array_new();
 
-                if (strcmp(predicted, truth) != 0) {
-                    result->num_errors++;
+    if (data_set == NULL || context == NULL || token_labels == NULL || lines == NULL) {
+        log_error("Error allocating test worker\n");
+        address_parser_test_reader_stop(reader);
+        goto exit_worker;
+    }
 
-                    uint32_t predicted_index = address_parser_get_class_index(parser, predicted);
-                    uint32_t truth_index = address_parser_get_class_index(parser, truth);
+    bool ok = true;
 
-                    result->confusion[predicted_index * num_classes + truth_index]++;
+    while (ok && address_parser_test_reader_read(reader, lines, ADDRESS_PARSER_TEST_BATCH_SIZE) > 0) {
+        size_t num_lines = cstring_array_num_strings(lines);
+        for (size_t i = 0; i < num_lines; i++) {
+            char *line = cstring_array_get_string(lines, i);
+            if (!address_parser_data_set_set_line(data_set, line)) {
+                ok = false;
+                break;
+            }
 
-                    if (print_errors) {
-                        printf("%s\t%s\t%d\t%s\n", predicted, truth, i, data_set->tokenized_str->str);
-                    }
+            while (data_set->norm < cstring_array_num_strings(data_set->normalizations)) {
+                if (!address_parser_data_set_next_normalization(data_set)) {
+                    ok = false;
+                    break;
                 }
-                result->num_predictions++;
 
-            })
+                ok = address_parser_test_example(worker, context, data_set, token_labels);
 
-        } else {
-            log_error("Error in prediction\n");
-            tokenized_string_destroy(data_set->tokenized_str);
-            break;
+                tokenized_string_destroy(data_set->tokenized_str);
+                data_set->tokenized_str = NULL;
+
+                if (!ok) break;
+            }
+
+            if (!ok) break;
         }
+    }
+
+    // Like the single-threaded loop, a bad line ends the evaluation
+    if (!ok) {
+        address_parser_test_reader_stop(reader);
+    }
+
+    worker->success = true;
 
-        if (result->num_errors > starting_errors) {
-            result->num_address_errors++;
+exit_worker:
+    if (data_set != NULL) {
+        if (data_set->tokenized_str != NULL) {
+            tokenized_string_destroy(data_set->tokenized_str);
+            data_set->tokenized_str = NULL;
         }
+        address_parser_data_set_destroy(data_set);
+    }
+    if (context != NULL) {
+        address_parser_context_destroy(context);
+    }
+    if (token_labels != NULL) {
+        cstring_array_destroy(token_labels);
+    }
+    if (lines != NULL) {
+        cstring_array_destroy(lines);
+    }
+    return NULL;
+}
 
-        result->num_address_predictions++;
+bool address_parser_test(address_parser_t *parser, char *filename, address_parser_test_results_t *result, bool print_errors, size_t num_threads) {
+    if (filename == NULL) {
+        log_error("Filename was NULL\n");
+        return false;
+    }
+
+    if (num_threads == 0) num_threads = 1;
+
+    uint32_t num_classes = address_parser_num_classes(parser);
 
-        if (result->num_address_predictions % 1000 == 0 && result->num_address_predictions > 0) {
-            log_info("Did %zu examples\n", result->num_address_predictions);
+    if (!address_parser_test_results_init(result, num_classes)) {
+        log_error("Error allocating results\n");
+        return false;
+    }
+
+    address_parser_test_reader_t reader = (address_parser_test_reader_t){
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .f = fopen(filename, "r"),
+        .num_lines = 0,
+        .done = false
+    };
+
+    if (reader.f == NULL) {
+        log_error("Error opening %s\n", filename);
+        return false;
+    }
+
+    address_parser_test_worker_t *workers = calloc(num_threads, sizeof(address_parser_test_worker_t));
+    if (workers == NULL) {
+        fclose(reader.f);
+        return false;
+    }
+
+    bool success = true;
+    size_t num_started = 0;
+
+    for (size_t i = 0; i < num_threads; i++) {
+        address_parser_test_worker_t *worker = &workers[i];
+        worker->parser = parser;
+        worker->reader = &reader;
+        worker->print_errors = print_errors;
+        worker->success = false;
+
+        if (!address_parser_test_results_init(&worker->results, num_classes)) {
+            log_error("Error allocating results\n");
+            success = false;
+            break;
+        }
+
+        if (pthread_create(&worker->thread, NULL, address_parser_test_worker_run, worker) != 0) {
+            log_error("Error starting test thread\n");
+            success = false;
+            break;
         }
+        num_started++;
+    }
 
-        tokenized_string_destroy(data_set->tokenized_str);
-        data_set->tokenized_str = NULL;
+    if (!success) {
+        address_parser_test_reader_stop(&reader);
+    }
 
+    for (size_t i = 0; i < num_started; i++) {
+        pthread_join(workers[i].thread, NULL);
+        success = success && workers[i].success;
+        address_parser_test_results_merge(result, &workers[i].results, num_classes);
     }
 
-    cstring_array_destroy(token_labels);
+    for (size_t i = 0; i < num_threads; i++) {
+        address_parser_test_results_clear(&workers[i].results);
+    }
 
-    address_parser_data_set_destroy(data_set);
-    address_parser_context_destroy(context);
+    free(workers);
+    fclose(reader.f);
+    pthread_mutex_destroy(&reader.lock);
 
+    return success;
+}
 
-    return true;
+static double address_parser_test_percentile(double_array *sorted, double p) {
+    if (sorted->n == 0) return 0.0;
+    size_t idx = (size_t)(p * (double)(sorted->n - 1) + 0.5);
+    return sorted->a[idx];
+}
+
+static size_t address_parser_test_default_num_threads(void) {
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return num_cpus > 0 ? (size_t)num_cpus : 1;
 }
 
 int main(int argc, char **argv) {
     char *address_parser_dir = LIBPOSTAL_ADDRESS_PARSER_DIR;
 
     if (argc < 2) {
-        log_error("Usage: ./address_parser_test filename [parser_dir]\n");
+        log_error("Usage: ./address_parser_test filename [parser_dir] [--print-errors] [--threads number]\n");
         exit(EXIT_FAILURE);
     }
 
@@ -167,6 +385,9 @@ int main(int argc, char **argv) {
     bool print_errors = false;
 
     ssize_t arg_iterations;
+    ssize_t arg_threads;
+
+    size_t num_threads = address_parser_test_default_num_threads();
 
     char *filename = NULL;
     char *addres_parser_dir = NULL;
@@ -177,6 +398,14 @@ int main(int argc, char **argv) {
         if (string_equals(arg, "--print-errors")) {
             print_errors = true;
             continue;
+        } else if (string_equals(arg, "--threads")) {
+            if (i + 1 >= argc || sscanf(argv[i + 1], "%zd", &arg_threads) != 1 || arg_threads < 1) {
+                log_error("Bad arg for --threads\n");
+                exit(EXIT_FAILURE);
+            }
+            num_threads = (size_t)arg_threads;
+            i++;
+            continue;
         } else if (position == 0) {
             filename = arg;
             position++;
@@ -216,16 +445,36 @@ int main(int argc, char **argv) {
         printf("crf parser\n");
     }
 
+    log_info("Testing with %zu threads\n", num_threads);
+
     address_parser_test_results_t results = EMPTY_ADDRESS_PARSER_TEST_RESULT;
 
-    if (!address_parser_test(parser, filename, &results, print_errors)) {
-        log_error("Error in training\n");
+    double start_time = address_parser_test_time();
+
+    if (!address_parser_test(parser, filename, &results, print_errors, num_threads)) {
+        log_error("Error in testing\n");
         exit(EXIT_FAILURE);
     }
 
+    double elapsed = address_parser_test_time() - start_time;
+
     printf("Errors: %zu / %zu (%f%%)\n", results.num_errors, results.num_predictions, (double)results.num_errors / results.num_predictions);
     printf("Addresses: %zu / %zu (%f%%)\n\n", results.num_address_errors, results.num_address_predictions, (double)results.num_address_errors / results.num_address_predictions);
 
+    // Wall-clock throughput includes reading and normalization, latencies only featurization + prediction
+    printf("Threads: %zu, time: %.2fs\n", num_threads, elapsed);
+    if (elapsed > 0.0) {
+        printf("Throughput: %.1f addresses/s, %.1f tokens/s\n", (double)results.num_address_predictions / elapsed, (double)results.num_predictions / elapsed);
+    }
+
+    double_array_sort(results.latencies->a, results.latencies->n);
+    printf("Latency per address (us): p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f max=%.1f\n\n",
+           address_parser_test_percentile(results.latencies, 0.5) * 1e6,
+           address_parser_test_percentile(results.latencies, 0.9) * 1e6,
+           address_parser_test_percentile(results.latencies, 0.99) * 1e6,
+           address_parser_test_percentile(results.latencies, 0.999) * 1e6,
+           address_parser_test_percentile(results.latencies, 1.0) * 1e6);
+
 
     printf("Confusion matrix:\n\n");
     uint32_t num_classes = address_parser_num_classes(parser);
@@ -252,7 +501,7 @@ int main(int argc, char **argv) {
 
     }
 
-    free(results.confusion);
+    address_parser_test_results_clear(&results);
     free(confusion_sorted);
 
     address_parser_module_teardown();
@@ -1101,14 +1101,28 @@ exit_epoch_training_started:
 }
 
 
-bool address_parser_train(address_parser_t *self, char *filename, address_parser_model_type_t model_type, uint32_t num_iterations, size_t min_updates) {
+bool address_parser_train(address_parser_t *self, char *filename, address_parser_model_type_t model_type, uint32_t num_iterations, size_t min_updates, uint32_t hash_bits) {
     self->model_type = model_type;
     void *trainer;
     if (model_type == ADDRESS_PARSER_TYPE_GREEDY_AVERAGED_PERCEPTRON) {
+        if (hash_bits > 0) {
+            log_error("Feature hashing is only supported for the CRF model\n");
+            return false;
+        }
         averaged_perceptron_trainer_t *ap_trainer = averaged_perceptron_trainer_new(min_updates);
         trainer = (void *)ap_trainer;
     } else if (model_type == ADDRESS_PARSER_TYPE_CRF) {
-        crf_averaged_perceptron_trainer_t *crf_trainer = crf_averaged_perceptron_trainer_new(self->num_classes, min_updates);
+        crf_averaged_perceptron_trainer_t *crf_trainer;
+        if (hash_bits > 0) {
+            log_info("Hashing features into 2^%u ids\n", hash_bits);
+            crf_trainer = crf_averaged_perceptron_trainer_new_hashed(self->num_classes, min_updates, hash_bits, FEATURE_HASH_DEFAULT_SEED);
+        } else {
+            crf_trainer = crf_averaged_perceptron_trainer_new(self->num_classes, min_updates);
+        }
+        if (crf_trainer == NULL) {
+            log_error("Error creating CRF trainer\n");
+            return false;
+        }
         trainer = (void *)crf_trainer;
     }
 
@@ -1150,10 +1164,11 @@ typedef enum {
     ADDRESS_PARSER_TRAIN_POSITIONAL_ARG,
     ADDRESS_PARSER_TRAIN_ARG_ITERATIONS,
     ADDRESS_PARSER_TRAIN_ARG_MIN_UPDATES,
-    ADDRESS_PARSER_TRAIN_ARG_MODEL_TYPE
+    ADDRESS_PARSER_TRAIN_ARG_MODEL_TYPE,
+    ADDRESS_PARSER_TRAIN_ARG_HASH_BITS
 } address_parser_train_keyword_arg_t;
 
-#define USAGE "Usage: ./address_parser_train filename output_dir [--iterations number --min-updates number --model (crf|greedyap)]\n"
+#define USAGE "Usage: ./address_parser_train filename output_dir [--iterations number --min-updates number --model (crf|greedyap) --hash-bits number]\n"
 
 int main(int argc, char **argv) {
     if (argc < 3) {
@@ -1171,10 +1186,12 @@ int main(int argc, char **argv) {
 
     size_t num_iterations = DEFAULT_ITERATIONS;
     uint64_t min_updates = DEFAULT_MIN_UPDATES;
+    uint32_t hash_bits = 0;
     size_t position = 0;
 
     ssize_t arg_iterations;
     uint64_t arg_min_updates;
+    uint32_t arg_hash_bits;
 
     char *filename = NULL;
     char *output_dir = NULL;
@@ -1199,6 +1216,11 @@ int main(int argc, char **argv) {
             continue;
         }
 
+        if (string_equals(arg, "--hash-bits")) {
+            kwarg = ADDRESS_PARSER_TRAIN_ARG_HASH_BITS;
+            continue;
+        }
+
         if (kwarg == ADDRESS_PARSER_TRAIN_ARG_ITERATIONS) {
             if (sscanf(arg, "%zd", &arg_iterations) != 1 || arg_iterations < 0) {
                 log_error("Bad arg for --iterations: %s\n", arg);
@@ -1221,6 +1243,12 @@ int main(int argc, char **argv) {
                 log_error("Bad arg for --model, valid values are [crf, greedyap]\n");
                 exit(EXIT_FAILURE);
             }
+        } else if (kwarg == ADDRESS_PARSER_TRAIN_ARG_HASH_BITS) {
+            if (sscanf(arg, "%u", &arg_hash_bits) != 1 || !feature_hash_valid_bits(arg_hash_bits)) {
+                log_error("Bad arg for --hash-bits: %s, must be between %d and %d\n", arg, FEATURE_HASH_MIN_BITS, FEATURE_HASH_MAX_BITS);
+                exit(EXIT_FAILURE);
+            }
+            hash_bits = arg_hash_bits;
         } else if (position == 0) {
             filename = arg;
             position++;
@@ -1261,7 +1289,7 @@ int main(int argc, char **argv) {
 
     log_info("Finished initialization\n");
 
-    if (!address_parser_train(parser, filename, model_type, num_iterations, min_updates)) {
+    if (!address_parser_train(parser, filename, model_type, num_iterations, min_updates, hash_bits)) {
         log_error("Error in training\n");
         exit(EXIT_FAILURE);
     }
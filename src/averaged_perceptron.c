@@ -2,16 +2,20 @@
 
 #define PERCEPTRON_SIGNATURE 0xCBCBCBCB
 
+#define PERCEPTRON_FEATURE_FILTER_ERROR_RATE 0.01
+
 static inline bool averaged_perceptron_get_feature_id(averaged_perceptron_t *self, char *feature, uint32_t *feature_id) {
+    if (self->feature_filter != NULL &&
+        !blocked_bloom_filter_check(self->feature_filter, feature, strlen(feature))) {
+        return false;
+    }
     return trie_get_data(self->features, feature, feature_id);
 }
 
-inline double_array *averaged_perceptron_predict_scores(averaged_perceptron_t *self, cstring_array *features) {
-    if (self->scores == NULL || self->scores->n == 0) self->scores = double_array_new_zeros((size_t)self->num_classes);
-
-    double_array_zero(self->scores->a, self->scores->n);
+static inline void averaged_perceptron_score_features(averaged_perceptron_t *self, cstring_array *features, double_array *scores_array) {
+    double_array_zero(scores_array->a, scores_array->n);
 
-    double *scores = self->scores->a;
+    double *scores = scores_array->a;
 
     uint32_t i = 0;
     char *feature;
@@ -31,8 +35,14 @@ inline double_array *averaged_perceptron_predict_scores(averaged_perceptron_t *s
             scores[class_id] += data[col];
         }
     })
+}
+
+inline double_array *averaged_perceptron_predict_scores(averaged_perceptron_t *self, cstring_array *features) {
+    if (self->scores == NULL || self->scores->n == 0) self->scores = double_array_new_zeros((size_t)self->num_classes);
+
+    averaged_perceptron_score_features(self, features, self->scores);
 
-    return self->scores;   
+    return self->scores;
 }
 
 inline double_array *averaged_perceptron_predict_scores_counts(averaged_perceptron_t *self, khash_t(str_uint32) *feature_counts) {
@@ -75,6 +85,16 @@ inline uint32_t averaged_perceptron_predict(averaged_perceptron_t *self, cstring
 
 }
 
+uint32_t averaged_perceptron_predict_with_scores(averaged_perceptron_t *self, cstring_array *features, double_array *scores) {
+    if (scores->n != self->num_classes) {
+        double_array_resize_fixed(scores, (size_t)self->num_classes);
+    }
+
+    averaged_perceptron_score_features(self, features, scores);
+
+    return (uint32_t)double_array_argmax(scores->a, scores->n);
+}
+
 inline uint32_t averaged_perceptron_predict_counts(averaged_perceptron_t *self, khash_t(str_uint32) *feature_counts) {
     double_array *scores = averaged_perceptron_predict_scores_counts(self, feature_counts);
 
@@ -83,6 +103,44 @@ inline uint32_t averaged_perceptron_predict_counts(averaged_perceptron_t *self,
     return (uint32_t)max_score;
 }
 
+bool averaged_perceptron_build_feature_filter(averaged_perceptron_t *self) {
+    if (self == NULL || self->features == NULL) return false;
+
+    bool ret = false;
+
+    cstring_array *keys = cstring_array_new();
+    uint32_array *values = uint32_array_new();
+    blocked_bloom_filter_t *filter = NULL;
+
+    if (keys == NULL || values == NULL || !trie_get_keys(self->features, keys, values)) {
+        goto exit_perceptron_build_feature_filter;
+    }
+
+    size_t num_keys = cstring_array_num_strings(keys);
+    filter = blocked_bloom_filter_new(num_keys > 0 ? num_keys : 1, PERCEPTRON_FEATURE_FILTER_ERROR_RATE);
+    if (filter == NULL) {
+        goto exit_perceptron_build_feature_filter;
+    }
+
+    for (size_t i = 0; i < num_keys; i++) {
+        char *key = cstring_array_get_string(keys, i);
+        blocked_bloom_filter_add(filter, key, strlen(key));
+    }
+
+    if (self->feature_filter != NULL) {
+        blocked_bloom_filter_destroy(self->feature_filter);
+    }
+    self->feature_filter = filter;
+    filter = NULL;
+    ret = true;
+
+exit_perceptron_build_feature_filter:
+    if (keys != NULL) cstring_array_destroy(keys);
+    if (values != NULL) uint32_array_destroy(values);
+    if (filter != NULL) blocked_bloom_filter_destroy(filter);
+    return ret;
+}
+
 averaged_perceptron_t *averaged_perceptron_read(FILE *f) {
     if (f == NULL) return NULL;
 
@@ -141,6 +199,14 @@ averaged_perceptron_t *averaged_perceptron_read(FILE *f) {
         goto exit_perceptron_created;
     }
 
+    // Models written before the feature filter existed end here
+    if (!file_at_eof(f)) {
+        perceptron->feature_filter = blocked_bloom_filter_read(f);
+        if (perceptron->feature_filter == NULL) {
+            goto exit_perceptron_created;
+        }
+    }
+
     return perceptron;
 
 exit_perceptron_created:
@@ -186,6 +252,10 @@ bool averaged_perceptron_write(averaged_perceptron_t *self, FILE *f) {
         return false;
     }
 
+    if (self->feature_filter != NULL && !blocked_bloom_filter_write(self->feature_filter, f)) {
+        return false;
+    }
+
     return true;
 }
 
@@ -206,6 +276,10 @@ void averaged_perceptron_destroy(averaged_perceptron_t *self) {
         trie_destroy(self->features);
     }
 
+    if (self->feature_filter != NULL) {
+        blocked_bloom_filter_destroy(self->feature_filter);
+    }
+
     if (self->classes != NULL) {
         cstring_array_destroy(self->classes);
     }
@@ -23,6 +23,7 @@ The weights are stored as a sparse matrix in compressed sparse row format
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "bloom.h"
 #include "collections.h"
 #include "sparse_matrix.h"
 #include "trie.h"
@@ -31,6 +32,7 @@ typedef struct averaged_perceptron {
     uint32_t num_features;
     uint32_t num_classes;
     trie_t *features;
+    blocked_bloom_filter_t *feature_filter;  // Optional, rejects most unknown features before the trie lookup
     cstring_array *classes;
     sparse_matrix_t *weights;
     double_array *scores;
@@ -40,11 +42,15 @@ averaged_perceptron_t *averaged_perceptron_read(FILE *f);
 averaged_perceptron_t *averaged_perceptron_load(char *filename);
 
 uint32_t averaged_perceptron_predict(averaged_perceptron_t *self, cstring_array *features);
+// Same as averaged_perceptron_predict but scores into a caller-owned array, safe to call from several threads
+uint32_t averaged_perceptron_predict_with_scores(averaged_perceptron_t *self, cstring_array *features, double_array *scores);
 uint32_t averaged_perceptron_predict_counts(averaged_perceptron_t *self, khash_t(str_uint32) *feature_counts);
 
 double_array *averaged_perceptron_predict_scores(averaged_perceptron_t *self, cstring_array *features);
 double_array *averaged_perceptron_predict_scores_counts(averaged_perceptron_t *self, khash_t(str_uint32) *feature_counts);
 
+bool averaged_perceptron_build_feature_filter(averaged_perceptron_t *self);
+
 bool averaged_perceptron_write(averaged_perceptron_t *self, FILE *f);
 bool averaged_perceptron_save(averaged_perceptron_t *self, char *filename);
 
@@ -1,7 +1,7 @@
 #include "averaged_perceptron_tagger.h"
 #include "log/log.h"
 
-bool averaged_perceptron_tagger_predict(averaged_perceptron_t *model, void *tagger, void *context, cstring_array *features, cstring_array *prev_tag_features, cstring_array *prev2_tag_features, cstring_array *labels, tagger_feature_function feature_function, tokenized_string_t *tokenized, bool print_features) {
+bool averaged_perceptron_tagger_predict_context(averaged_perceptron_t *model, double_array *scores, void *tagger, void *context, cstring_array *features, cstring_array *prev_tag_features, cstring_array *prev2_tag_features, cstring_array *labels, tagger_feature_function feature_function, tokenized_string_t *tokenized, bool print_features) {
 
     // Keep two tags of history in training
     char *prev = NULL;
@@ -58,7 +58,7 @@ bool averaged_perceptron_tagger_predict(averaged_perceptron_t *model, void *tagg
         }
 
 
-        uint32_t guess = averaged_perceptron_predict(model, features);
+        uint32_t guess = scores != NULL ? averaged_perceptron_predict_with_scores(model, features, scores) : averaged_perceptron_predict(model, features);
         char *predicted = cstring_array_get_string(model->classes, guess);
 
         cstring_array_add_string(labels, predicted);
@@ -71,3 +71,7 @@ bool averaged_perceptron_tagger_predict(averaged_perceptron_t *model, void *tagg
     return true;
 
 }
+
+bool averaged_perceptron_tagger_predict(averaged_perceptron_t *model, void *tagger, void *context, cstring_array *features, cstring_array *prev_tag_features, cstring_array *prev2_tag_features, cstring_array *labels, tagger_feature_function feature_function, tokenized_string_t *tokenized, bool print_features) {
+    return averaged_perceptron_tagger_predict_context(model, NULL, tagger, context, features, prev_tag_features, prev2_tag_features, labels, feature_function, tokenized, print_features);
+}
@@ -26,5 +26,7 @@ the current value.
 #define START2 "START2"
 
 bool averaged_perceptron_tagger_predict(averaged_perceptron_t *model, void *tagger, void *context, cstring_array *features, cstring_array *prev_tag_features, cstring_array *prev2_tag_features, cstring_array *labels, tagger_feature_function feature_function, tokenized_string_t *tokenized, bool print_features);
+// Scores into the caller's scores array instead of the model's, NULL uses the model's
+bool averaged_perceptron_tagger_predict_context(averaged_perceptron_t *model, double_array *scores, void *tagger, void *context, cstring_array *features, cstring_array *prev_tag_features, cstring_array *prev2_tag_features, cstring_array *labels, tagger_feature_function feature_function, tokenized_string_t *tokenized, bool print_features);
 
 #endif
\ No newline at end of file
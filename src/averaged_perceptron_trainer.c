@@ -213,6 +213,11 @@ averaged_perceptron_t *averaged_perceptron_trainer_finalize(averaged_perceptron_
 
     perceptron->features = features;
 
+    perceptron->feature_filter = NULL;
+    if (!averaged_perceptron_build_feature_filter(perceptron)) {
+        log_warn("Could not build feature filter, continuing without one\n");
+    }
+
     perceptron->num_features = self->num_features;
     perceptron->num_classes = self->num_classes;
 
@@ -2,8 +2,10 @@
 
 #include "bloom.h"
 #include "murmur/murmur.h"
+#include "vector.h"
 
 #define BLOOM_FILTER_SIGNATURE 0xBABABABA
+#define BLOCKED_BLOOM_FILTER_SIGNATURE 0xBBBBBBBB
 
 #define LOG2_SQUARED 0.4804530139182014
 #define LOG2 0.6931471805599453
@@ -221,3 +223,192 @@ void bloom_filter_destroy(bloom_filter_t *self) {
 
     free(self);
 }
+
+
+/*
+Blocked Bloom filter
+*/
+
+// Odd multipliers, one per word, spreading the low 32 bits of the hash (as in split block Bloom filters)
+static const uint32_t blocked_bloom_filter_salts[BLOCKED_BLOOM_FILTER_NUM_HASHES] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+static inline uint64_t blocked_bloom_filter_hash(const char *key, size_t len) {
+    uint64_t checksum[2];
+    MurmurHash3_x64_128(key, len, SALT_CONSTANT, checksum);
+    return checksum[0];
+}
+
+static inline uint64_t *blocked_bloom_filter_block(blocked_bloom_filter_t *self, uint64_t hash) {
+    // Maps the high 32 bits onto [0, num_blocks) without a division
+    uint64_t block_index = ((hash >> 32) * self->num_blocks) >> 32;
+    return self->blocks + block_index * BLOCKED_BLOOM_FILTER_BLOCK_WORDS;
+}
+
+static inline void blocked_bloom_filter_mask(uint64_t hash, uint64_t *mask) {
+    uint32_t key = (uint32_t)hash;
+    for (int i = 0; i < BLOCKED_BLOOM_FILTER_BLOCK_WORDS; i++) {
+        uint64_t bit = (uint64_t)1 << ((key * blocked_bloom_filter_salts[i]) >> 26);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        bit = __builtin_bswap64(bit);
+#endif
+        mask[i] = bit;
+    }
+}
+
+blocked_bloom_filter_t *blocked_bloom_filter_new(uint64_t capacity, double error) {
+    if (capacity < 1 || error <= 0.0 || error >= 1.0) {
+        return NULL;
+    }
+
+    blocked_bloom_filter_t *bloom = calloc(1, sizeof(blocked_bloom_filter_t));
+    if (bloom == NULL) {
+        return NULL;
+    }
+
+    bloom->capacity = capacity;
+    bloom->error = error;
+
+    double bits_per_entry = -(log(error) / LOG2_SQUARED);
+    uint64_t num_bits = (uint64_t)ceil((double)capacity * bits_per_entry);
+    uint64_t block_bits = BLOCKED_BLOOM_FILTER_BLOCK_SIZE * 8;
+    bloom->num_blocks = (num_bits + block_bits - 1) / block_bits;
+    if (bloom->num_blocks == 0) {
+        bloom->num_blocks = 1;
+    }
+
+    size_t num_bytes = bloom->num_blocks * BLOCKED_BLOOM_FILTER_BLOCK_SIZE;
+    bloom->blocks = aligned_malloc(num_bytes, BLOCKED_BLOOM_FILTER_BLOCK_SIZE);
+    if (bloom->blocks == NULL) {
+        free(bloom);
+        return NULL;
+    }
+    memset(bloom->blocks, 0, num_bytes);
+
+    return bloom;
+}
+
+bool blocked_bloom_filter_check(blocked_bloom_filter_t *self, const char *key, size_t len) {
+    uint64_t hash = blocked_bloom_filter_hash(key, len);
+    uint64_t *block = blocked_bloom_filter_block(self, hash);
+
+    uint64_t mask[BLOCKED_BLOOM_FILTER_BLOCK_WORDS];
+    blocked_bloom_filter_mask(hash, mask);
+
+    uint64_t missing = 0;
+    for (int i = 0; i < BLOCKED_BLOOM_FILTER_BLOCK_WORDS; i++) {
+        missing |= ~block[i] & mask[i];
+    }
+
+    return missing == 0;
+}
+
+void blocked_bloom_filter_add(blocked_bloom_filter_t *self, const char *key, size_t len) {
+    uint64_t hash = blocked_bloom_filter_hash(key, len);
+    uint64_t *block = blocked_bloom_filter_block(self, hash);
+
+    uint64_t mask[BLOCKED_BLOOM_FILTER_BLOCK_WORDS];
+    blocked_bloom_filter_mask(hash, mask);
+
+    for (int i = 0; i < BLOCKED_BLOOM_FILTER_BLOCK_WORDS; i++) {
+        block[i] |= mask[i];
+    }
+}
+
+size_t blocked_bloom_filter_memory_size(blocked_bloom_filter_t *self) {
+    if (self == NULL) return 0;
+    return sizeof(blocked_bloom_filter_t) + self->num_blocks * BLOCKED_BLOOM_FILTER_BLOCK_SIZE;
+}
+
+void blocked_bloom_filter_destroy(blocked_bloom_filter_t *self) {
+    if (self == NULL) return;
+
+    if (self->blocks != NULL) {
+        aligned_free(self->blocks);
+    }
+
+    free(self);
+}
+
+/*
+Layout: signature, capacity, error, num_blocks, padding length, then zero
+padding so the blocks (raw little-endian words) start at a 64-byte aligned
+offset in the file, wherever the filter is embedded. Streams without a file
+position (pipes) are padded relative to the signature instead.
+*/
+#define BLOCKED_BLOOM_FILTER_HEADER_SIZE (sizeof(uint32_t) + sizeof(uint64_t) + sizeof(double) + sizeof(uint64_t) + sizeof(uint32_t))
+
+bool blocked_bloom_filter_write(blocked_bloom_filter_t *self, FILE *f) {
+    if (self == NULL || f == NULL) {
+        return false;
+    }
+
+    long offset = ftell(f);
+    if (offset < 0) {
+        offset = 0;
+    }
+    size_t blocks_offset = (size_t)offset + BLOCKED_BLOOM_FILTER_HEADER_SIZE;
+    uint32_t padding_len = (uint32_t)((BLOCKED_BLOOM_FILTER_BLOCK_SIZE - blocks_offset % BLOCKED_BLOOM_FILTER_BLOCK_SIZE) % BLOCKED_BLOOM_FILTER_BLOCK_SIZE);
+
+    if (!file_write_uint32(f, BLOCKED_BLOOM_FILTER_SIGNATURE) ||
+        !file_write_uint64(f, self->capacity) ||
+        !file_write_double(f, self->error) ||
+        !file_write_uint64(f, self->num_blocks) ||
+        !file_write_uint32(f, padding_len)) {
+        return false;
+    }
+
+    char padding[BLOCKED_BLOOM_FILTER_BLOCK_SIZE] = {0};
+    if (padding_len > 0 && !file_write_chars(f, padding, padding_len)) {
+        return false;
+    }
+
+    return file_write_chars(f, (char *)self->blocks, self->num_blocks * BLOCKED_BLOOM_FILTER_BLOCK_SIZE);
+}
+
+blocked_bloom_filter_t *blocked_bloom_filter_read(FILE *f) {
+    uint32_t signature;
+
+    if (f == NULL || !file_read_uint32(f, &signature) || signature != BLOCKED_BLOOM_FILTER_SIGNATURE) {
+        return NULL;
+    }
+
+    blocked_bloom_filter_t *bloom = calloc(1, sizeof(blocked_bloom_filter_t));
+    if (bloom == NULL) {
+        return NULL;
+    }
+
+    uint32_t padding_len;
+
+    if (!file_read_uint64(f, &bloom->capacity) ||
+        !file_read_double(f, &bloom->error) ||
+        !file_read_uint64(f, &bloom->num_blocks) ||
+        !file_read_uint32(f, &padding_len) ||
+        bloom->num_blocks == 0 ||
+        padding_len >= BLOCKED_BLOOM_FILTER_BLOCK_SIZE) {
+        goto exit_blocked_bloom_filter_created;
+    }
+
+    char padding[BLOCKED_BLOOM_FILTER_BLOCK_SIZE];
+    if (padding_len > 0 && !file_read_chars(f, padding, padding_len)) {
+        goto exit_blocked_bloom_filter_created;
+    }
+
+    size_t num_bytes = bloom->num_blocks * BLOCKED_BLOOM_FILTER_BLOCK_SIZE;
+    bloom->blocks = aligned_malloc(num_bytes, BLOCKED_BLOOM_FILTER_BLOCK_SIZE);
+    if (bloom->blocks == NULL) {
+        goto exit_blocked_bloom_filter_created;
+    }
+
+    if (!file_read_chars(f, (char *)bloom->blocks, num_bytes)) {
+        goto exit_blocked_bloom_filter_created;
+    }
+
+    return bloom;
+
+exit_blocked_bloom_filter_created:
+    blocked_bloom_filter_destroy(bloom);
+    return NULL;
+}
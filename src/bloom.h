@@ -37,5 +37,40 @@ bool bloom_filter_save(bloom_filter_t *self, char *path);
 bloom_filter_t *bloom_filter_read(FILE *f);
 bloom_filter_t *bloom_filter_load(char *path);
 
+/*
+Blocked Bloom filter: every key sets BLOCKED_BLOOM_FILTER_NUM_HASHES bits
+inside a single 64-byte block, one bit in each of the block's 8 words, so a
+lookup touches exactly one cache line. The block and the bit positions all
+come from one 64-bit hash, and the 8-word probe mask is computed with a
+fixed-length loop the compiler can vectorize.
+
+Words are kept little-endian in memory and on disk, and the serialized blocks
+start on a 64-byte boundary relative to the start of the filter, so a file
+produced by blocked_bloom_filter_write can be used in place (e.g. mmap'd).
+*/
+
+#define BLOCKED_BLOOM_FILTER_BLOCK_WORDS 8
+#define BLOCKED_BLOOM_FILTER_BLOCK_SIZE (BLOCKED_BLOOM_FILTER_BLOCK_WORDS * sizeof(uint64_t))
+#define BLOCKED_BLOOM_FILTER_NUM_HASHES BLOCKED_BLOOM_FILTER_BLOCK_WORDS
+
+typedef struct blocked_bloom_filter {
+    uint64_t capacity;
+    double error;
+    uint64_t num_blocks;
+    uint64_t *blocks;
+} blocked_bloom_filter_t;
+
+blocked_bloom_filter_t *blocked_bloom_filter_new(uint64_t capacity, double error);
+
+bool blocked_bloom_filter_check(blocked_bloom_filter_t *self, const char *key, size_t len);
+void blocked_bloom_filter_add(blocked_bloom_filter_t *self, const char *key, size_t len);
+
+size_t blocked_bloom_filter_memory_size(blocked_bloom_filter_t *self);
+
+void blocked_bloom_filter_destroy(blocked_bloom_filter_t *self);
+
+bool blocked_bloom_filter_write(blocked_bloom_filter_t *self, FILE *f);
+blocked_bloom_filter_t *blocked_bloom_filter_read(FILE *f);
+
 
 #endif
\ No newline at end of file
@@ -2,23 +2,37 @@
 #include "log/log.h"
 
 #define CRF_SIGNATURE 0xCFCFCFCF
+#define CRF_HASHED_SIGNATURE 0xCFCFCFC1
 
+#define CRF_FEATURE_FILTER_ERROR_RATE 0.01
 
 static inline bool crf_get_feature_id(crf_t *self, char *feature, uint32_t *feature_id) {
+    if (self->hash_bits > 0) {
+        *feature_id = feature_hash_id(feature, self->hash_seed, self->hash_bits);
+        return true;
+    }
+    // Most generated features are not in the model, the filter rejects them with one cache line probe
+    if (self->state_features_filter != NULL &&
+        !blocked_bloom_filter_check(self->state_features_filter, feature, strlen(feature))) {
+        return false;
+    }
     return trie_get_data(self->state_features, feature, feature_id);
 }
 
 static inline bool crf_get_state_trans_feature_id(crf_t *self, char *feature, uint32_t *feature_id) {
+    if (self->hash_bits > 0) {
+        *feature_id = feature_hash_id(feature, self->hash_seed, self->hash_bits);
+        return true;
+    }
     return trie_get_data(self->state_trans_features, feature, feature_id);
 }
 
-bool crf_tagger_score(crf_t *self, void *tagger, void *tagger_context, cstring_array *features, cstring_array *prev_tag_features, tagger_feature_function feature_function, tokenized_string_t *tokenized, bool print_features) {
-    if (self == NULL || feature_function == NULL || tokenized == NULL ) {
+bool crf_tagger_score_context(crf_t *self, crf_context_t *crf_context, void *tagger, void *tagger_context, cstring_array *features, cstring_array *prev_tag_features, tagger_feature_function feature_function, tokenized_string_t *tokenized, bool print_features) {
+    if (self == NULL || crf_context == NULL || feature_function == NULL || tokenized == NULL ) {
         return false;
     }
     size_t num_tokens = tokenized->tokens->n;
 
-    crf_context_t *crf_context = self->context;
     crf_context_set_num_items(crf_context, num_tokens);
     crf_context_reset(crf_context, CRF_CONTEXT_RESET_ALL);
 
@@ -97,49 +111,100 @@ bool crf_tagger_score(crf_t *self, void *tagger, void *tagger_context, cstring_a
     return true;
 }
 
-bool crf_tagger_score_viterbi(crf_t *self, void *tagger, void *tagger_context, cstring_array *features, cstring_array *prev_tag_features, tagger_feature_function feature_function, tokenized_string_t *tokenized, double *score, bool print_features) {
-    if (!crf_tagger_score(self, tagger, tagger_context, features, prev_tag_features, feature_function, tokenized, print_features)) {
+bool crf_tagger_score(crf_t *self, void *tagger, void *tagger_context, cstring_array *features, cstring_array *prev_tag_features, tagger_feature_function feature_function, tokenized_string_t *tokenized, bool print_features) {
+    if (self == NULL) return false;
+    return crf_tagger_score_context(self, self->context, tagger, tagger_context, features, prev_tag_features, feature_function, tokenized, print_features);
+}
+
+static bool crf_tagger_score_viterbi_context(crf_t *self, crf_context_t *crf_context, uint32_array *viterbi, void *tagger, void *tagger_context, cstring_array *features, cstring_array *prev_tag_features, tagger_feature_function feature_function, tokenized_string_t *tokenized, double *score, bool print_features) {
+    if (!crf_tagger_score_context(self, crf_context, tagger, tagger_context, features, prev_tag_features, feature_function, tokenized, print_features)) {
         return false;
     }
 
     size_t num_tokens = tokenized->tokens->n;
 
-    uint32_array_resize_fixed(self->viterbi, num_tokens);
-    double viterbi_score = crf_context_viterbi(self->context, self->viterbi->a);
+    uint32_array_resize_fixed(viterbi, num_tokens);
+    double viterbi_score = crf_context_viterbi(crf_context, viterbi->a);
 
     *score = viterbi_score;
 
     return true;
 }
 
+bool crf_tagger_score_viterbi(crf_t *self, void *tagger, void *tagger_context, cstring_array *features, cstring_array *prev_tag_features, tagger_feature_function feature_function, tokenized_string_t *tokenized, double *score, bool print_features) {
+    if (self == NULL) return false;
+    return crf_tagger_score_viterbi_context(self, self->context, self->viterbi, tagger, tagger_context, features, prev_tag_features, feature_function, tokenized, score, print_features);
+}
 
-bool crf_tagger_predict(crf_t *self, void *tagger, void *context, cstring_array *features, cstring_array *prev_tag_features, cstring_array *labels, tagger_feature_function feature_function, tokenized_string_t *tokenized, bool print_features) {
+bool crf_tagger_predict_context(crf_t *self, crf_context_t *crf_context, uint32_array *viterbi, void *tagger, void *context, cstring_array *features, cstring_array *prev_tag_features, cstring_array *labels, tagger_feature_function feature_function, tokenized_string_t *tokenized, bool print_features) {
     double score;
 
-    if (labels == NULL) return false;
-    if (!crf_tagger_score_viterbi(self, tagger, context, features, prev_tag_features, feature_function, tokenized, &score, print_features)) {
+    if (labels == NULL || viterbi == NULL) return false;
+    if (!crf_tagger_score_viterbi_context(self, crf_context, viterbi, tagger, context, features, prev_tag_features, feature_function, tokenized, &score, print_features)) {
         return false;
     }
 
-    uint32_t *viterbi = self->viterbi->a;
-
-    for (size_t i = 0; i < self->viterbi->n; i++) {
-        char *predicted = cstring_array_get_string(self->classes, viterbi[i]);
+    for (size_t i = 0; i < viterbi->n; i++) {
+        char *predicted = cstring_array_get_string(self->classes, viterbi->a[i]);
         cstring_array_add_string(labels, predicted);
     }
 
     return true;
 }
 
+bool crf_tagger_predict(crf_t *self, void *tagger, void *context, cstring_array *features, cstring_array *prev_tag_features, cstring_array *labels, tagger_feature_function feature_function, tokenized_string_t *tokenized, bool print_features) {
+    if (self == NULL) return false;
+    return crf_tagger_predict_context(self, self->context, self->viterbi, tagger, context, features, prev_tag_features, labels, feature_function, tokenized, print_features);
+}
+
+bool crf_build_feature_filter(crf_t *self) {
+    if (self == NULL || self->state_features == NULL) return false;
+
+    bool ret = false;
+
+    cstring_array *keys = cstring_array_new();
+    uint32_array *values = uint32_array_new();
+    blocked_bloom_filter_t *filter = NULL;
+
+    if (keys == NULL || values == NULL || !trie_get_keys(self->state_features, keys, values)) {
+        goto exit_crf_build_feature_filter;
+    }
+
+    size_t num_keys = cstring_array_num_strings(keys);
+    filter = blocked_bloom_filter_new(num_keys > 0 ? num_keys : 1, CRF_FEATURE_FILTER_ERROR_RATE);
+    if (filter == NULL) {
+        goto exit_crf_build_feature_filter;
+    }
+
+    for (size_t i = 0; i < num_keys; i++) {
+        char *key = cstring_array_get_string(keys, i);
+        blocked_bloom_filter_add(filter, key, strlen(key));
+    }
+
+    if (self->state_features_filter != NULL) {
+        blocked_bloom_filter_destroy(self->state_features_filter);
+    }
+    self->state_features_filter = filter;
+    filter = NULL;
+    ret = true;
+
+exit_crf_build_feature_filter:
+    if (keys != NULL) cstring_array_destroy(keys);
+    if (values != NULL) uint32_array_destroy(values);
+    if (filter != NULL) blocked_bloom_filter_destroy(filter);
+    return ret;
+}
 
 bool crf_write(crf_t *self, FILE *f) {
+    bool hashed = self != NULL && self->hash_bits > 0;
+
     if (self == NULL || f == NULL || self->weights == NULL || self->classes == NULL ||
-        self->state_features == NULL || self->state_trans_features == NULL) {
+        (!hashed && (self->state_features == NULL || self->state_trans_features == NULL))) {
         log_info("something was NULL\n");
         return false;
     }
 
-    if (!file_write_uint32(f, CRF_SIGNATURE) ||
+    if (!file_write_uint32(f, hashed ? CRF_HASHED_SIGNATURE : CRF_SIGNATURE) ||
         !file_write_uint32(f, self->num_classes)) {
         log_info("error writing header\n");
         return false;
@@ -156,7 +221,13 @@ bool crf_write(crf_t *self, FILE *f) {
         return false;
     }
 
-    if (!trie_write(self->state_features, f)) {
+    // Hashed models store the hash parameters in place of the feature tries
+    if (hashed) {
+        if (!file_write_uint32(f, self->hash_bits) || !file_write_uint32(f, self->hash_seed)) {
+            log_info("error writing hash params\n");
+            return false;
+        }
+    } else if (!trie_write(self->state_features, f)) {
         log_info("error state_features\n");
         return false;
     }
@@ -166,7 +237,7 @@ bool crf_write(crf_t *self, FILE *f) {
         return false;
     }
 
-    if (!trie_write(self->state_trans_features, f)) {
+    if (!hashed && !trie_write(self->state_trans_features, f)) {
         log_info("error state_trans_features\n");
         return false;
     }
@@ -181,6 +252,11 @@ bool crf_write(crf_t *self, FILE *f) {
         return false;
     }
 
+    if (self->state_features_filter != NULL && !blocked_bloom_filter_write(self->state_features_filter, f)) {
+        log_info("error state_features_filter\n");
+        return false;
+    }
+
     return true;
 }
 
@@ -203,9 +279,10 @@ crf_t *crf_read(FILE *f) {
 
     uint32_t signature;
 
-    if (!file_read_uint32(f, &signature) || signature != CRF_SIGNATURE) {
+    if (!file_read_uint32(f, &signature) || (signature != CRF_SIGNATURE && signature != CRF_HASHED_SIGNATURE)) {
         return NULL;
     }
+    bool hashed = signature == CRF_HASHED_SIGNATURE;
 
     crf_t *crf = calloc(1, sizeof(crf_t));
     if (crf == NULL) return NULL;
@@ -240,9 +317,17 @@ crf_t *crf_read(FILE *f) {
         goto exit_crf_created;
     }
 
-    crf->state_features = trie_read(f);
-    if (crf->state_features == NULL) {
-        goto exit_crf_created;
+    if (hashed) {
+        if (!file_read_uint32(f, &crf->hash_bits) ||
+            !file_read_uint32(f, &crf->hash_seed) ||
+            !feature_hash_valid_bits(crf->hash_bits)) {
+            goto exit_crf_created;
+        }
+    } else {
+        crf->state_features = trie_read(f);
+        if (crf->state_features == NULL) {
+            goto exit_crf_created;
+        }
     }
 
     crf->weights = sparse_matrix_read(f);
@@ -250,9 +335,11 @@ crf_t *crf_read(FILE *f) {
         goto exit_crf_created;
     }
 
-    crf->state_trans_features = trie_read(f);
-    if (crf->state_trans_features == NULL) {
-        goto exit_crf_created;
+    if (!hashed) {
+        crf->state_trans_features = trie_read(f);
+        if (crf->state_trans_features == NULL) {
+            goto exit_crf_created;
+        }
     }
 
     crf->state_trans_weights = sparse_matrix_read(f);
@@ -265,6 +352,19 @@ crf_t *crf_read(FILE *f) {
         goto exit_crf_created;
     }
 
+    // Every hash id must have a row in the weight matrices
+    if (hashed && (crf->weights->m != (1U << crf->hash_bits) || crf->state_trans_weights->m != (1U << crf->hash_bits))) {
+        goto exit_crf_created;
+    }
+
+    // Models written before the feature filter existed end here
+    if (!file_at_eof(f)) {
+        crf->state_features_filter = blocked_bloom_filter_read(f);
+        if (crf->state_features_filter == NULL) {
+            goto exit_crf_created;
+        }
+    }
+
     crf->viterbi = uint32_array_new();
     if (crf->viterbi == NULL) {
         goto exit_crf_created;
@@ -302,6 +402,10 @@ void crf_destroy(crf_t *self) {
         trie_destroy(self->state_features);
     }
 
+    if (self->state_features_filter != NULL) {
+        blocked_bloom_filter_destroy(self->state_features_filter);
+    }
+
     if (self->weights != NULL) {
         sparse_matrix_destroy(self->weights);
     }
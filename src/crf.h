@@ -16,8 +16,10 @@ to predict the current transition matrix.
 #include <stdbool.h>
 #include <string.h>
 
+#include "bloom.h"
 #include "collections.h"
 #include "crf_context.h"
+#include "feature_hash.h"
 #include "matrix.h"
 #include "sparse_matrix.h"
 #include "tagger.h"
@@ -26,9 +28,12 @@ to predict the current transition matrix.
 typedef struct crf {
     uint32_t num_classes;
     cstring_array *classes;
-    trie_t *state_features;
+    trie_t *state_features;                         // NULL when features are hashed
+    blocked_bloom_filter_t *state_features_filter;  // Optional, rejects most unknown state features before the trie lookup
+    uint32_t hash_bits;                             // If nonzero, state and state-trans features are hashed into 2^hash_bits ids
+    uint32_t hash_seed;
     sparse_matrix_t *weights;
-    trie_t *state_trans_features;
+    trie_t *state_trans_features;                   // NULL when features are hashed
     sparse_matrix_t *state_trans_weights;
     double_matrix_t *trans_weights;
     uint32_array *viterbi;
@@ -37,11 +42,21 @@ typedef struct crf {
 
 bool crf_tagger_predict(crf_t *model, void *tagger, void *tagger_context, cstring_array *features, cstring_array *prev_tag_features, cstring_array *labels, tagger_feature_function feature_function, tokenized_string_t *tokenized, bool print_features);
 
+/*
+The _context variants score into caller-owned scratch space instead of the
+model's own context/viterbi arrays, so one loaded model can be used from
+several threads as long as each thread has its own crf_context_t.
+*/
+bool crf_tagger_predict_context(crf_t *self, crf_context_t *crf_context, uint32_array *viterbi, void *tagger, void *context, cstring_array *features, cstring_array *prev_tag_features, cstring_array *labels, tagger_feature_function feature_function, tokenized_string_t *tokenized, bool print_features);
+bool crf_tagger_score_context(crf_t *self, crf_context_t *crf_context, void *tagger, void *tagger_context, cstring_array *features, cstring_array *prev_tag_features, tagger_feature_function feature_function, tokenized_string_t *tokenized, bool print_features);
+
 bool crf_tagger_score(crf_t *self, void *tagger, void *tagger_context, cstring_array *features, cstring_array *prev_tag_features, tagger_feature_function feature_function, tokenized_string_t *tokenized, bool print_features);
 bool crf_tagger_score_viterbi(crf_t *self, void *tagger, void *tagger_context, cstring_array *features, cstring_array *prev_tag_features, tagger_feature_function feature_function, tokenized_string_t *tokenized, double *score, bool print_features);
 
 bool crf_tagger_predict(crf_t *self, void *tagger, void *context, cstring_array *features, cstring_array *prev_tag_features, cstring_array *labels, tagger_feature_function feature_function, tokenized_string_t *tokenized, bool print_features);
 
+bool crf_build_feature_filter(crf_t *self);
+
 bool crf_write(crf_t *self, FILE *f);
 bool crf_save(crf_t *self, char *filename);
 
@@ -43,6 +43,8 @@ crf_trainer_t *crf_trainer_new(size_t num_classes)  {
     if (trainer == NULL) return NULL;
 
     trainer->num_classes = num_classes;
+    trainer->hash_bits = 0;
+    trainer->hash_seed = 0;
 
     trainer->features = kh_init(str_uint32);
     if (trainer->features == NULL) {
@@ -144,6 +146,13 @@ crf_trainer_t *crf_trainer_new_classes(cstring_array *classes)  {
     return trainer;
 }
 
+bool crf_trainer_set_feature_hash(crf_trainer_t *self, uint32_t hash_bits, uint32_t hash_seed) {
+    if (self == NULL || !feature_hash_valid_bits(hash_bits)) return false;
+    self->hash_bits = hash_bits;
+    self->hash_seed = hash_seed;
+    return true;
+}
+
 bool crf_trainer_hash_to_id(khash_t(str_uint32) *features, char *feature, uint32_t *feature_id, bool *exists) {
     if (feature == NULL) {
         log_error("feature was NULL\n");
@@ -163,7 +172,17 @@ bool crf_trainer_hash_to_id(khash_t(str_uint32) *features, char *feature, uint32
 }
 
 
+static inline bool crf_trainer_feature_hash_id(crf_trainer_t *self, char *feature, uint32_t *feature_id) {
+    *feature_id = feature_hash_id(feature, self->hash_seed, self->hash_bits);
+    return true;
+}
+
 inline bool crf_trainer_hash_feature_to_id_exists(crf_trainer_t *self, char *feature, uint32_t *feature_id, bool *exists) {
+    if (self->hash_bits > 0) {
+        // Every hashed id exists, its update count was allocated up front
+        *exists = true;
+        return crf_trainer_feature_hash_id(self, feature, feature_id);
+    }
     return crf_trainer_hash_to_id(self->features, feature, feature_id, exists);
 }
 
@@ -174,6 +193,10 @@ inline bool crf_trainer_hash_feature_to_id(crf_trainer_t *self, char *feature, u
 
 
 inline bool crf_trainer_hash_prev_tag_feature_to_id_exists(crf_trainer_t *self, char *feature, uint32_t *feature_id, bool *exists) {
+    if (self->hash_bits > 0) {
+        *exists = true;
+        return crf_trainer_feature_hash_id(self, feature, feature_id);
+    }
     return crf_trainer_hash_to_id(self->prev_tag_features, feature, feature_id, exists);
 }
 
@@ -183,9 +206,15 @@ inline bool crf_trainer_hash_prev_tag_feature_to_id(crf_trainer_t *self, char *f
 }
 
 inline bool crf_trainer_get_feature_id(crf_trainer_t *self, char *feature, uint32_t *feature_id) {
+    if (self->hash_bits > 0) {
+        return crf_trainer_feature_hash_id(self, feature, feature_id);
+    }
     return str_uint32_hash_get(self->features, feature, feature_id);
 }
 
 inline bool crf_trainer_get_prev_tag_feature_id(crf_trainer_t *self, char *feature, uint32_t *feature_id) {
+    if (self->hash_bits > 0) {
+        return crf_trainer_feature_hash_id(self, feature, feature_id);
+    }
     return str_uint32_hash_get(self->prev_tag_features, feature, feature_id);
 }
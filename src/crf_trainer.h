@@ -6,6 +6,7 @@
 
 #include "collections.h"
 #include "crf_context.h"
+#include "feature_hash.h"
 #include "string_utils.h"
 #include "tokens.h"
 #include "trie.h"
@@ -13,6 +14,8 @@
 
 typedef struct crf_trainer {
     uint32_t num_classes;
+    uint32_t hash_bits;                             // If nonzero, features are hashed instead of added to the hashtables below
+    uint32_t hash_seed;
     khash_t(str_uint32) *features;
     khash_t(str_uint32) *prev_tag_features;
     khash_t(str_uint32) *classes;
@@ -23,6 +26,7 @@ typedef struct crf_trainer {
 
 crf_trainer_t *crf_trainer_new(size_t num_classes);
 void crf_trainer_destroy(crf_trainer_t *self);
+bool crf_trainer_set_feature_hash(crf_trainer_t *self, uint32_t hash_bits, uint32_t hash_seed);
 
 bool crf_trainer_get_class_id(crf_trainer_t *self, char *class_name, uint32_t *class_id, bool add_if_missing);
 bool crf_trainer_hash_feature_to_id(crf_trainer_t *self, char *feature, uint32_t *feature_id);
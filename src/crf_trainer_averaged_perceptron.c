@@ -150,6 +150,28 @@ exit_trainer_created:
     return NULL;
 }
 
+crf_averaged_perceptron_trainer_t *crf_averaged_perceptron_trainer_new_hashed(size_t num_classes, size_t min_updates, uint32_t hash_bits, uint32_t hash_seed) {
+    crf_averaged_perceptron_trainer_t *self = crf_averaged_perceptron_trainer_new(num_classes, min_updates);
+    if (self == NULL) return NULL;
+
+    if (!crf_trainer_set_feature_hash(self->base_trainer, hash_bits, hash_seed)) {
+        crf_averaged_perceptron_trainer_destroy(self);
+        return NULL;
+    }
+
+    // Update counts are indexed by feature id, which now covers the whole hash space up front
+    size_t num_features = (size_t)1 << hash_bits;
+    if (!uint64_array_resize_fixed(self->update_counts, num_features) ||
+        !uint64_array_resize_fixed(self->prev_tag_update_counts, num_features)) {
+        crf_averaged_perceptron_trainer_destroy(self);
+        return NULL;
+    }
+    uint64_array_zero(self->update_counts->a, num_features);
+    uint64_array_zero(self->prev_tag_update_counts->a, num_features);
+
+    return self;
+}
+
 static inline uint32_t tag_bigram_class_id(crf_averaged_perceptron_trainer_t *self, tag_bigram_t tag_bigram) {
     return tag_bigram.prev_class_id * self->base_trainer->num_classes + tag_bigram.class_id;
 }
@@ -712,12 +734,138 @@ bool crf_averaged_perceptron_trainer_train_example(crf_averaged_perceptron_train
 }
 
 
+static double_matrix_t *crf_averaged_perceptron_trainer_averaged_trans_weights(crf_averaged_perceptron_trainer_t *self) {
+    size_t num_classes = self->base_trainer->num_classes;
+    uint64_t updates = self->num_updates;
+
+    double_matrix_t *averaged_trans_weights = double_matrix_new_zeros(num_classes, num_classes);
+    if (averaged_trans_weights == NULL) {
+        return NULL;
+    }
+
+    double *trans = averaged_trans_weights->values;
+
+    tag_bigram_t tag_bigram;
+    uint64_t tag_bigram_key;
+    class_weight_t weight;
+    uint32_t class_id;
+
+    kh_foreach(self->trans_weights, tag_bigram_key, weight, {
+        tag_bigram.value = tag_bigram_key;
+        weight.total += (updates - weight.last_updated) * weight.value;
+        double value = weight.total / updates;
+        class_id = tag_bigram_class_id(self, tag_bigram);
+        trans[class_id] = value;
+    })
+
+    return averaged_trans_weights;
+}
+
+/*
+With feature hashing the feature ids are already final, so there's nothing
+to renumber. Every hash id gets a row in the weight matrices, and features
+with fewer than min_updates updates are pruned by leaving their rows empty.
+*/
+static crf_t *crf_averaged_perceptron_trainer_finalize_hashed(crf_averaged_perceptron_trainer_t *self) {
+    crf_trainer_t *base_trainer = self->base_trainer;
+    size_t num_features = (size_t)1 << base_trainer->hash_bits;
+    uint64_t updates = self->num_updates;
+
+    log_info("Finalizing hashed trainer, num_features=%zu\n", num_features);
+
+    sparse_matrix_t *averaged_weights = sparse_matrix_new();
+    sparse_matrix_t *averaged_state_trans_weights = sparse_matrix_new();
+    double_matrix_t *averaged_trans_weights = NULL;
+    if (averaged_weights == NULL || averaged_state_trans_weights == NULL) {
+        log_error("Error creating averaged weights\n");
+        goto exit_hashed_weights_created;
+    }
+
+    uint64_t *update_counts = self->update_counts->a;
+    uint64_t *prev_tag_update_counts = self->prev_tag_update_counts->a;
+
+    khiter_t k;
+    uint32_t class_id;
+    class_weight_t weight;
+    tag_bigram_t tag_bigram;
+    uint64_t tag_bigram_key;
+    size_t num_kept = 0;
+    size_t num_prev_tag_kept = 0;
+
+    for (uint32_t feature_id = 0; feature_id < num_features; feature_id++) {
+        k = kh_get(feature_class_weights, self->weights, feature_id);
+        if (k != kh_end(self->weights) && update_counts[feature_id] >= self->min_updates) {
+            khash_t(class_weights) *weights = kh_value(self->weights, k);
+            kh_foreach(weights, class_id, weight, {
+                weight.total += (updates - weight.last_updated) * weight.value;
+                double value = weight.total / updates;
+                sparse_matrix_append(averaged_weights, class_id, value);
+            })
+            num_kept++;
+        }
+        sparse_matrix_finalize_row(averaged_weights);
+
+        k = kh_get(feature_prev_tag_class_weights, self->prev_tag_weights, feature_id);
+        if (k != kh_end(self->prev_tag_weights) && prev_tag_update_counts[feature_id] >= self->min_updates) {
+            khash_t(prev_tag_class_weights) *prev_tag_weights = kh_value(self->prev_tag_weights, k);
+            kh_foreach(prev_tag_weights, tag_bigram_key, weight, {
+                tag_bigram.value = tag_bigram_key;
+                weight.total += (updates - weight.last_updated) * weight.value;
+                double value = weight.total / updates;
+                class_id = tag_bigram_class_id(self, tag_bigram);
+                sparse_matrix_append(averaged_state_trans_weights, class_id, value);
+            })
+            num_prev_tag_kept++;
+        }
+        sparse_matrix_finalize_row(averaged_state_trans_weights);
+    }
+
+    log_info("After pruning, %zu state feature ids and %zu state-trans feature ids are used\n", num_kept, num_prev_tag_kept);
+
+    averaged_trans_weights = crf_averaged_perceptron_trainer_averaged_trans_weights(self);
+    if (averaged_trans_weights == NULL) {
+        log_error("Error creating double matrix for transition weights\n");
+        goto exit_hashed_weights_created;
+    }
+
+    crf_t *crf = calloc(1, sizeof(crf_t));
+    if (crf == NULL) {
+        goto exit_hashed_weights_created;
+    }
+
+    crf->num_classes = base_trainer->num_classes;
+    crf->weights = averaged_weights;
+    crf->state_trans_weights = averaged_state_trans_weights;
+    crf->trans_weights = averaged_trans_weights;
+    crf->hash_bits = base_trainer->hash_bits;
+    crf->hash_seed = base_trainer->hash_seed;
+    crf->classes = base_trainer->class_strings;
+    base_trainer->class_strings = NULL;
+
+    crf->viterbi = uint32_array_new();
+    crf->context = crf_context_new(CRF_CONTEXT_VITERBI | CRF_CONTEXT_MARGINALS, crf->num_classes, CRF_CONTEXT_DEFAULT_NUM_ITEMS);
+
+    crf_averaged_perceptron_trainer_destroy(self);
+
+    return crf;
+
+exit_hashed_weights_created:
+    if (averaged_weights != NULL) sparse_matrix_destroy(averaged_weights);
+    if (averaged_state_trans_weights != NULL) sparse_matrix_destroy(averaged_state_trans_weights);
+    if (averaged_trans_weights != NULL) double_matrix_destroy(averaged_trans_weights);
+    return NULL;
+}
+
 crf_t *crf_averaged_perceptron_trainer_finalize(crf_averaged_perceptron_trainer_t *self) {
     if (self == NULL || self->base_trainer == NULL || self->base_trainer->num_classes == 0) {
         log_error("Something was NULL\n");
         return NULL;
     }
 
+    if (self->base_trainer->hash_bits > 0) {
+        return crf_averaged_perceptron_trainer_finalize_hashed(self);
+    }
+
     uint32_t class_id;
     class_weight_t weight;
 
@@ -898,23 +1046,13 @@ crf_t *crf_averaged_perceptron_trainer_finalize(crf_averaged_perceptron_trainer_
 
     size_t num_classes = self->base_trainer->num_classes;
 
-    double_matrix_t *averaged_trans_weights = double_matrix_new_zeros(num_classes, num_classes);
+    double_matrix_t *averaged_trans_weights = crf_averaged_perceptron_trainer_averaged_trans_weights(self);
     if (averaged_trans_weights == NULL) {
         log_error("Error creating double matrix for transition weights\n");
         return NULL;
     }
 
-    double *trans = averaged_trans_weights->values;
-
-    kh_foreach(self->trans_weights, tag_bigram_key, weight, {
-        tag_bigram.value = tag_bigram_key;
-        weight.total += (updates - weight.last_updated) * weight.value;
-        double value = weight.total / updates;
-        class_id = tag_bigram_class_id(self, tag_bigram);
-        trans[class_id] = value;
-    })
-
-    crf_t *crf = malloc(sizeof(crf_t));
+    crf_t *crf = calloc(1, sizeof(crf_t));
 
     crf->num_classes = num_classes;
     crf->weights = averaged_weights;
@@ -932,6 +1070,11 @@ crf_t *crf_averaged_perceptron_trainer_finalize(crf_averaged_perceptron_trainer_
 
     crf->state_features = state_features;
 
+    crf->state_features_filter = NULL;
+    if (!crf_build_feature_filter(crf)) {
+        log_warn("Could not build state feature filter, continuing without one\n");
+    }
+
     trie_t *state_trans_features = trie_new_from_hash(prev_tag_features);
     if (state_trans_features == NULL) {
         crf_averaged_perceptron_trainer_destroy(self);
@@ -46,6 +46,8 @@ typedef struct crf_averaged_perceptron_trainer {
 } crf_averaged_perceptron_trainer_t;
 
 crf_averaged_perceptron_trainer_t *crf_averaged_perceptron_trainer_new(size_t num_classes, size_t min_updates);
+// Uses the hashing trick (see feature_hash.h) instead of a feature dictionary
+crf_averaged_perceptron_trainer_t *crf_averaged_perceptron_trainer_new_hashed(size_t num_classes, size_t min_updates, uint32_t hash_bits, uint32_t hash_seed);
 
 uint32_t crf_averaged_perceptron_trainer_predict(crf_averaged_perceptron_trainer_t *self, cstring_array *features);
 
@@ -27,78 +27,68 @@ static inline bool is_slavo_germanic(char *s) {
         || strstr(s, "WITZ");
 }
 
-static inline bool substring_equals(char *str, size_t len, ssize_t index, size_t substr_len, ...) {
-    char *string_at_index = get_string_at(str, len, index);
-    if (string_at_index == NULL) return false;
-
-    va_list args;
-    va_start(args, substr_len);
-
-    bool matched = false;
-
-    while (true) {
-        char *sub = va_arg(args, char *);
-        if (sub == NULL) break;
-
-        if (utf8_compare_len(string_at_index, sub, substr_len) == 0) {
-            matched = true;
-            break;
+/* Each rule compares the input at some offset against a short list of
+   same-length alternatives. The lists are built from string literals at the
+   call site, so with the bounds check up front they reduce to a few fixed-size
+   memcmps instead of a varargs walk with UTF-8 decoding per candidate. */
+static inline bool substring_equals_any(char *str, size_t len, ssize_t index, size_t substr_len, const char *const *subs, size_t num_subs) {
+    if (index < 0 || (size_t)index + substr_len > len) return false;
+
+    char *string_at_index = str + index;
+
+    for (size_t i = 0; i < num_subs; i++) {
+        if (memcmp(string_at_index, subs[i], substr_len) == 0) {
+            return true;
         }
     }
 
-    va_end(args);
-
-    return matched;
-
+    return false;
 }
 
-double_metaphone_codes_t *double_metaphone(char *input) {
-    if (input == NULL) return NULL;
-
-    char *ptr = utf8_upper(input);
-
-    /* Note: NFD normalization will help with simple decomposable accent characters
-       like "É", "Ü", etc. which effectively become "E\u0301" and "U\u0308". It does
-       not handle characters like "Ł". For these, use Latin-ASCII transliteration
-       prior to calling this function.
-
-       We can still check for a specific accented character like C with cedilla (Ç),
-       by comparing with its decomposed form i.e. "C\xcc\xa7"
-    */
-
-    char *normalized = (char *)utf8proc_NFD((utf8proc_uint8_t *)ptr);
-
-    if (normalized != NULL) {
-        free(ptr);
-        ptr = normalized;        
-    }
-
-    if (ptr == NULL) {
-        return NULL;
+#define SUBSTRING_EQUALS(str, len, index, substr_len, ...)                                          \
+    substring_equals_any((str), (len), (index), (substr_len), (const char *const []){__VA_ARGS__},  \
+                         sizeof((const char *const []){__VA_ARGS__}) / sizeof(const char *))
+
+typedef struct double_metaphone_code {
+    char *str;
+    size_t len;
+    size_t size;
+    bool truncated;
+} double_metaphone_code_t;
+
+static inline void double_metaphone_code_append(double_metaphone_code_t *code, const char *s) {
+    for (; *s; s++) {
+        if (code->len + 1 >= code->size) {
+            code->truncated = true;
+            break;
+        }
+        code->str[code->len++] = *s;
     }
+    code->str[code->len] = '\0';
+}
 
-    char *str = ptr;
-
-    size_t len = strlen(str);
-    char_array *primary = char_array_new_size(len + 1);
-    char_array *secondary = char_array_new_size(len + 1);
-
+/* Applies the rules to an uppercased, NFD-normalized string, writing both
+   codes into the caller's buffers. Returns false if either was truncated. */
+static bool double_metaphone_encode(char *str, size_t len, double_metaphone_code_t *primary, double_metaphone_code_t *secondary) {
     bool slavo_germanic = is_slavo_germanic(str);
 
     size_t current = 0;
-    size_t last = len - 1;
 
-    if (substring_equals(str, len, current, 2, "ʻ", NULL)) {
+    if (SUBSTRING_EQUALS(str, len, current, 2, "ʻ")) {
         str += 2;
+        len -= 2;
     } else if (get_char_at(str, len, current) == '\'') {
         str++;
+        len--;
     }
 
-    if (substring_equals(str, len, current, 2, "GN", "KN", "PN", "WR", "PS", NULL)) {
+    size_t last = len - 1;
+
+    if (SUBSTRING_EQUALS(str, len, current, 2, "GN", "KN", "PN", "WR", "PS")) {
         current++;
     } else if (get_char_at(str, len, current) == 'X') {
-        char_array_append(primary, "S");
-        char_array_append(secondary, "S");
+        double_metaphone_code_append(primary, "S");
+        double_metaphone_code_append(secondary, "S");
         current++;
     }
 
@@ -107,14 +97,14 @@ double_metaphone_codes_t *double_metaphone(char *input) {
         if (c == '\x00') break;
 
         if (current == 0 && is_vowel(c)) {
-            char_array_append(primary, "A");
-            char_array_append(secondary, "A");
+            double_metaphone_code_append(primary, "A");
+            double_metaphone_code_append(secondary, "A");
             current++;
             continue;
         } else if (c == 'B') {
             /* "-mb", e.g", "dumb", already skipped over... */
-            char_array_append(primary, "P");
-            char_array_append(secondary, "P");
+            double_metaphone_code_append(primary, "P");
+            double_metaphone_code_append(secondary, "P");
 
             if (get_char_at(str, len, current + 1) == 'B') {
                 current += 2;
@@ -123,103 +113,103 @@ double_metaphone_codes_t *double_metaphone(char *input) {
             }
             continue;
         // Ç - C with cedilla (denormalized)
-        } else if (substring_equals(str, len, current, 3, "C\xcc\xa7", NULL)) { 
-            char_array_append(primary, "S");
-            char_array_append(secondary, "S");
+        } else if (SUBSTRING_EQUALS(str, len, current, 3, "C\xcc\xa7")) { 
+            double_metaphone_code_append(primary, "S");
+            double_metaphone_code_append(secondary, "S");
             current += 2;
         } else if (c == 'C') {
             // various germanic
             if ((current > 1)
                 && !is_vowel(get_char_at(str, len, current - 2))
-                && (substring_equals(str, len, current - 1, 3, "ACH", NULL)
-                    && !substring_equals(str, len, current + 2, 1, "O", "A", "U", NULL))
+                && (SUBSTRING_EQUALS(str, len, current - 1, 3, "ACH")
+                    && !SUBSTRING_EQUALS(str, len, current + 2, 1, "O", "A", "U"))
                 && ((get_char_at(str, len, current + 2) != 'I')
                     && ((get_char_at(str, len, current + 2) != 'E')
-                        || substring_equals(str, len, current - 2, 6, "BACHER", "MACHER", NULL))
+                        || SUBSTRING_EQUALS(str, len, current - 2, 6, "BACHER", "MACHER"))
                    )
                 ) 
             {
-                char_array_append(primary, "K");
-                char_array_append(secondary, "K");
+                double_metaphone_code_append(primary, "K");
+                double_metaphone_code_append(secondary, "K");
                 current += 2;
                 continue;
             }
 
             // special case for "caesar"
             if ((current == 0)
-                && substring_equals(str, len, current, 6, "CAESAR", NULL))
+                && SUBSTRING_EQUALS(str, len, current, 6, "CAESAR"))
             {
-                char_array_append(primary, "S");
-                char_array_append(secondary, "K");
+                double_metaphone_code_append(primary, "S");
+                double_metaphone_code_append(secondary, "K");
                 current += 2;
                 continue;
             }
 
             // Italian e.g. "chianti"
-            if (substring_equals(str, len, current, 4, "CHIA", NULL)) {
-                char_array_append(primary, "K");
-                char_array_append(secondary, "K");
+            if (SUBSTRING_EQUALS(str, len, current, 4, "CHIA")) {
+                double_metaphone_code_append(primary, "K");
+                double_metaphone_code_append(secondary, "K");
                 current += 2;
                 continue;
             }
 
-            if (substring_equals(str, len, current, 2, "CH", NULL)) {
+            if (SUBSTRING_EQUALS(str, len, current, 2, "CH")) {
                 // "michael"
                 if ((current > 0)
-                    && substring_equals(str, len, current, 4, "CHAE", NULL))
+                    && SUBSTRING_EQUALS(str, len, current, 4, "CHAE"))
                 {
-                    char_array_append(primary, "K");
-                    char_array_append(secondary, "X");
+                    double_metaphone_code_append(primary, "K");
+                    double_metaphone_code_append(secondary, "X");
                     current += 2;
                     continue;
                 }
 
                 // Greek roots e.g. "chemistry", "chorus"
                 if ((current == 0)
-                    && (substring_equals(str, len, current + 1, 5, "HARAC", "HARIS", "HOREO", NULL)
-                     || substring_equals(str, len, current + 1, 4, "HIRO", "HAOS", "HAOT", NULL)
-                     || (substring_equals(str, len, current + 1, 3, "HOR", "HYM", "HIA", "HEM", "HIM", NULL) && !substring_equals(str, len, current + 1, 5, "HEMIN", NULL)))
+                    && (SUBSTRING_EQUALS(str, len, current + 1, 5, "HARAC", "HARIS", "HOREO")
+                     || SUBSTRING_EQUALS(str, len, current + 1, 4, "HIRO", "HAOS", "HAOT")
+                     || (SUBSTRING_EQUALS(str, len, current + 1, 3, "HOR", "HYM", "HIA", "HEM", "HIM") && !SUBSTRING_EQUALS(str, len, current + 1, 5, "HEMIN")))
                     )
                 {
-                    char_array_append(primary, "K");
-                    char_array_append(secondary, "K");
+                    double_metaphone_code_append(primary, "K");
+                    double_metaphone_code_append(secondary, "K");
                     current += 2;
                     continue;
                 }
 
                 // Germanic, Greek, or otherwise "ch" for "kh" sound
                 if (
-                      (substring_equals(str, len, 0, 4, "VAN ", "VON ", NULL)
-                       || substring_equals(str, len, current - 5, 5, " VAN ", " VON ", NULL)
-                       || substring_equals(str, len, 0, 3, "SCH", NULL))
+                      (SUBSTRING_EQUALS(str, len, 0, 4, "VAN ", "VON ")
+                       || SUBSTRING_EQUALS(str, len, current - 5, 5, " VAN ", " VON ")
+                       || SUBSTRING_EQUALS(str, len, 0, 3, "SCH"))
                       // "ochestra", "orchid", "architect" but not "arch"
-                      || substring_equals(str, len, current - 2, 6, "ORCHES", "ARCHIT", "ORCHID", NULL)
-                      || substring_equals(str, len, current + 2, 1, "T", "S", NULL)
+                      || SUBSTRING_EQUALS(str, len, current - 2, 6, "ORCHES", "ARCHIT", "ORCHID")
+                      || SUBSTRING_EQUALS(str, len, current + 2, 1, "T", "S")
                       || (
-                            (((current == 0) || substring_equals(str, len, current - 1, 1, "A", "O", "U", "E", NULL))
+                            (((current == 0) || SUBSTRING_EQUALS(str, len, current - 1, 1, "A", "O", "U", "E"))
                              // e.g. not "breach", "broach", "pouch", "beech", etc.
-                             && !substring_equals(str, len, current - 2, 2, "EA", "OU", "EE", "OA", "OO", "AU", NULL)
+                             && !SUBSTRING_EQUALS(str, len, current - 2, 2, "EA", "OU", "EE", "OA", "OO", "AU")
                              // e.g. not "lunch", "birch", "gulch"
-                             && !substring_equals(str, len, current - 1, 1, "L", "R", "N", NULL))
+                             && !SUBSTRING_EQUALS(str, len, current - 1, 1, "L", "R", "N"))
                             // e.g. "wachtler", "wechsler", but not "tichner"
-                            && ((current + 1 == last) || substring_equals(str, len, current + 2, 1, "L", "R", "N", "M", "B", "H", "F", "V", "W", " ", NULL))
+                            && ((current + 1 == last) || SUBSTRING_EQUALS(str, len, current + 2, 1, "L", "R", "N", "M", "B", "H", "F", "V", "W", " "))
                          )
                    )
                 {
-                    char_array_append(primary, "K");
-                    char_array_append(secondary, "K");
+                    double_metaphone_code_append(primary, "K");
+                    double_metaphone_code_append(secondary, "K");
                 } else {
                     if (current > 0) {
-                        if (substring_equals(str, len, 0, 2, "MC", NULL)) {
-                            char_array_append(primary, "K");
-                            char_array_append(secondary, "K");
+                        if (SUBSTRING_EQUALS(str, len, 0, 2, "MC")) {
+                            double_metaphone_code_append(primary, "K");
+                            double_metaphone_code_append(secondary, "K");
                         } else {
-                            char_array_append(primary, "X");
-                            char_array_append(secondary, "K");
+                            double_metaphone_code_append(primary, "X");
+                            double_metaphone_code_append(secondary, "K");
                         }
                     } else {
-                        char_array_append(primary, "X");
-                        char_array_append(secondary, "X");
+                        double_metaphone_code_append(primary, "X");
+                        double_metaphone_code_append(secondary, "X");
                     }
                 }
                 current += 2;
@@ -227,77 +217,77 @@ double_metaphone_codes_t *double_metaphone(char *input) {
             }
 
             // e.g, "czerny"
-            if (substring_equals(str, len, current, 2, "CZ", NULL)
-                && !substring_equals(str, len, current - 2, 4, "WICZ", NULL))
+            if (SUBSTRING_EQUALS(str, len, current, 2, "CZ")
+                && !SUBSTRING_EQUALS(str, len, current - 2, 4, "WICZ"))
             {
-                char_array_append(primary, "S");
-                char_array_append(secondary, "X");
+                double_metaphone_code_append(primary, "S");
+                double_metaphone_code_append(secondary, "X");
                 current += 2;
                 continue;
             }
 
             // double 'C' but not if e.g. "McClellan"
-            if (substring_equals(str, len, current, 2, "CC", NULL)
+            if (SUBSTRING_EQUALS(str, len, current, 2, "CC")
                 && !((current == 1) && get_char_at(str, len, 0) == 'M'))
             {
                 // "bellocchio" but not "bacchus"
-                if (substring_equals(str, len, current + 2, 1, "I", "E", "H", NULL)
-                    && !substring_equals(str, len, current + 2, 3, "HUS", "HUM", "HUN", "HAN", NULL))
+                if (SUBSTRING_EQUALS(str, len, current + 2, 1, "I", "E", "H")
+                    && !SUBSTRING_EQUALS(str, len, current + 2, 3, "HUS", "HUM", "HUN", "HAN"))
                 {
                     // "accident", "accede", "succeed"
                     if (((current == 1)
                          && (get_char_at(str, len, current - 1) == 'A'))
-                        || substring_equals(str, len, current - 1, 5, "UCCEE", "UCCES", NULL))
+                        || SUBSTRING_EQUALS(str, len, current - 1, 5, "UCCEE", "UCCES"))
                     {
-                        char_array_append(primary, "KS");
-                        char_array_append(secondary, "KS");
+                        double_metaphone_code_append(primary, "KS");
+                        double_metaphone_code_append(secondary, "KS");
                     // "pinocchio" but not "riccio" or "picchu"
                     } else if (get_char_at(str, len, current + 2) == 'H'
-                           && !substring_equals(str, len, current + 2, 2, "HU", "HA", NULL)) {
-                        char_array_append(primary, "K");
-                        char_array_append(secondary, "X");
+                           && !SUBSTRING_EQUALS(str, len, current + 2, 2, "HU", "HA")) {
+                        double_metaphone_code_append(primary, "K");
+                        double_metaphone_code_append(secondary, "X");
                     } else {
-                        char_array_append(primary, "X");
-                        char_array_append(secondary, "X");
+                        double_metaphone_code_append(primary, "X");
+                        double_metaphone_code_append(secondary, "X");
                     }
                     current += 3;
                     continue;
                 } else {
                     // Pierce's rule
-                    char_array_append(primary, "K");
-                    char_array_append(secondary, "K");
+                    double_metaphone_code_append(primary, "K");
+                    double_metaphone_code_append(secondary, "K");
                     current += 2;
                     continue;
                 }
             }
 
-            if (substring_equals(str, len, current, 2, "CK", "CG", "CQ", NULL)) {
-                char_array_append(primary, "K");
-                char_array_append(secondary, "K");
+            if (SUBSTRING_EQUALS(str, len, current, 2, "CK", "CG", "CQ")) {
+                double_metaphone_code_append(primary, "K");
+                double_metaphone_code_append(secondary, "K");
                 current += 2;
                 continue;
             }
 
-            if (substring_equals(str, len, current, 2, "CI", "CJ", "CE", "CY", NULL)) {
-                if (substring_equals(str, len, current, 3, "CIO", "CIE", "CIA", "CIU", NULL)) {
-                    char_array_append(primary, "S");
-                    char_array_append(secondary, "X");         
+            if (SUBSTRING_EQUALS(str, len, current, 2, "CI", "CJ", "CE", "CY")) {
+                if (SUBSTRING_EQUALS(str, len, current, 3, "CIO", "CIE", "CIA", "CIU")) {
+                    double_metaphone_code_append(primary, "S");
+                    double_metaphone_code_append(secondary, "X");         
                 } else {
-                    char_array_append(primary, "S");
-                    char_array_append(secondary, "S");                    
+                    double_metaphone_code_append(primary, "S");
+                    double_metaphone_code_append(secondary, "S");                    
                 }
                 current += 2;
                 continue;
             }
 
             // else
-            char_array_append(primary, "K");
-            char_array_append(secondary, "K");
+            double_metaphone_code_append(primary, "K");
+            double_metaphone_code_append(secondary, "K");
 
-            if (substring_equals(str, len, current + 1, 2, " C", " Q", " G", NULL)) {
+            if (SUBSTRING_EQUALS(str, len, current + 1, 2, " C", " Q", " G")) {
                 current += 3;
-            } else if (substring_equals(str, len, current + 1, 1, "C", "K", "Q", NULL)
-                   && !substring_equals(str, len, current + 1, 2, "CE", "CI", NULL))
+            } else if (SUBSTRING_EQUALS(str, len, current + 1, 1, "C", "K", "Q")
+                   && !SUBSTRING_EQUALS(str, len, current + 1, 2, "CE", "CI"))
             {
                 current += 2;
             } else {
@@ -306,31 +296,31 @@ double_metaphone_codes_t *double_metaphone(char *input) {
 
             continue;
         } else if (c == 'D') {
-            if (substring_equals(str, len, current, 2, "DG", NULL)) {
-                if (substring_equals(str, len, current + 2, 1, "I", "E", "Y", NULL)) {
+            if (SUBSTRING_EQUALS(str, len, current, 2, "DG")) {
+                if (SUBSTRING_EQUALS(str, len, current + 2, 1, "I", "E", "Y")) {
                     // e.g. "edge"
-                    char_array_append(primary, "J");
-                    char_array_append(secondary, "J");
+                    double_metaphone_code_append(primary, "J");
+                    double_metaphone_code_append(secondary, "J");
                     current += 3;
                     continue;
                 } else {
-                    char_array_append(primary, "TK");
-                    char_array_append(secondary, "TK");
+                    double_metaphone_code_append(primary, "TK");
+                    double_metaphone_code_append(secondary, "TK");
                     current += 2;
                     continue;
                 }
             }
 
-            if (substring_equals(str, len, current, 2, "DT", "DD", NULL)) {
-                char_array_append(primary, "T");
-                char_array_append(secondary, "T");
+            if (SUBSTRING_EQUALS(str, len, current, 2, "DT", "DD")) {
+                double_metaphone_code_append(primary, "T");
+                double_metaphone_code_append(secondary, "T");
                 current += 2;
                 continue;
             }
 
             // else
-            char_array_append(primary, "T");
-            char_array_append(secondary, "T");
+            double_metaphone_code_append(primary, "T");
+            double_metaphone_code_append(secondary, "T");
             current++;
             continue;
         } else if (c == 'F') {
@@ -340,14 +330,14 @@ double_metaphone_codes_t *double_metaphone(char *input) {
                 current++;
             }
 
-            char_array_append(primary, "F");
-            char_array_append(secondary, "F");
+            double_metaphone_code_append(primary, "F");
+            double_metaphone_code_append(secondary, "F");
             continue;
         } else if (c == 'G') {
             if (get_char_at(str, len, current + 1) == 'H') {
                 if ((current > 0) && !is_vowel(get_char_at(str, len, current - 1))) {
-                    char_array_append(primary, "K");
-                    char_array_append(secondary, "K");
+                    double_metaphone_code_append(primary, "K");
+                    double_metaphone_code_append(secondary, "K");
                     current += 2;
                     continue;
                 }
@@ -355,11 +345,11 @@ double_metaphone_codes_t *double_metaphone(char *input) {
                 if (current == 0) {
                     // "ghislane", "ghiradelli"
                     if (get_char_at(str, len, current + 2) == 'I') {
-                        char_array_append(primary, "J");
-                        char_array_append(secondary, "J");
+                        double_metaphone_code_append(primary, "J");
+                        double_metaphone_code_append(secondary, "J");
                     } else {
-                        char_array_append(primary, "K");
-                        char_array_append(secondary, "K");
+                        double_metaphone_code_append(primary, "K");
+                        double_metaphone_code_append(secondary, "K");
                     }
                     current += 2;
                     continue;
@@ -368,13 +358,13 @@ double_metaphone_codes_t *double_metaphone(char *input) {
                 // Parker's rule (with some further refinements) - e.g. "hugh"
                 if (
                     ((current > 1)
-                     && substring_equals(str, len, current - 2, 1, "B", "H", "D", NULL))
+                     && SUBSTRING_EQUALS(str, len, current - 2, 1, "B", "H", "D"))
                     // e.g. "bough"
                     || ((current > 2)
-                        && substring_equals(str, len, current - 3, 1, "B", "H", "D", NULL))
+                        && SUBSTRING_EQUALS(str, len, current - 3, 1, "B", "H", "D"))
                     // e.g. "broughton"
                     || ((current > 3)
-                        && substring_equals(str, len, current - 4, 1, "B", "H", NULL))
+                        && SUBSTRING_EQUALS(str, len, current - 4, 1, "B", "H"))
                     )
                 {
                     current += 2;
@@ -383,15 +373,15 @@ double_metaphone_codes_t *double_metaphone(char *input) {
                     // e.g. "laugh", "McLaughlin", "cough", "gough", "rough", "tough"
                     if ((current > 2)
                         && (get_char_at(str, len, current - 1) == 'U')
-                        && substring_equals(str, len, current - 3, 1, "C", "G", "L", "R", "T", NULL))
+                        && SUBSTRING_EQUALS(str, len, current - 3, 1, "C", "G", "L", "R", "T"))
                     {
-                        char_array_append(primary, "F");
-                        char_array_append(secondary, "F");
+                        double_metaphone_code_append(primary, "F");
+                        double_metaphone_code_append(secondary, "F");
                     } else if ((current > 0)
                                && get_char_at(str, len, current - 1) != 'I')
                     {
-                        char_array_append(primary, "K");
-                        char_array_append(secondary, "K");
+                        double_metaphone_code_append(primary, "K");
+                        double_metaphone_code_append(secondary, "K");
                     }
                     current += 2;
                     continue;
@@ -403,29 +393,29 @@ double_metaphone_codes_t *double_metaphone(char *input) {
                 if ((current == 1) && is_vowel(get_char_at(str, len, 0))
                     && !slavo_germanic)
                 {
-                    char_array_append(primary, "KN");
-                    char_array_append(secondary, "N");
+                    double_metaphone_code_append(primary, "KN");
+                    double_metaphone_code_append(secondary, "N");
                 // not e.g. "cagney"
-                } else if (!substring_equals(str, len, current + 2, 2, "EY", NULL)
+                } else if (!SUBSTRING_EQUALS(str, len, current + 2, 2, "EY")
                         && (get_char_at(str, len, current + 1) != 'Y')
                         && !slavo_germanic)
                 {
-                    char_array_append(primary, "N");
-                    char_array_append(secondary, "KN");
+                    double_metaphone_code_append(primary, "N");
+                    double_metaphone_code_append(secondary, "KN");
                 } else {
-                    char_array_append(primary, "KN");
-                    char_array_append(secondary, "KN");
+                    double_metaphone_code_append(primary, "KN");
+                    double_metaphone_code_append(secondary, "KN");
                 }
                 current += 2;
                 continue;
             }
 
             // "tagliaro"
-            if (substring_equals(str, len, current + 1, 2, "LI", NULL)
+            if (SUBSTRING_EQUALS(str, len, current + 1, 2, "LI")
                 && !slavo_germanic)
             {
-                char_array_append(primary, "KL");
-                char_array_append(secondary, "L");
+                double_metaphone_code_append(primary, "KL");
+                double_metaphone_code_append(secondary, "L");
                 current += 2;
                 continue;
             }
@@ -433,54 +423,54 @@ double_metaphone_codes_t *double_metaphone(char *input) {
             // -ges-, -gep-, -gel-, -gie- at beginning
             if ((current == 0)
                 && ((get_char_at(str, len, current + 1) == 'Y')
-                    || substring_equals(str, len, current + 1, 2, "ES", "EP",
+                    || SUBSTRING_EQUALS(str, len, current + 1, 2, "ES", "EP",
                                         "EB", "EL", "EY", "IB", "IL", "IN", "IE",
-                                        "EI", "ER", NULL)))
+                                        "EI", "ER")))
             {
-                char_array_append(primary, "K");
-                char_array_append(secondary, "J");
+                double_metaphone_code_append(primary, "K");
+                double_metaphone_code_append(secondary, "J");
                 current += 2;
                 continue;
             }
 
             // -ger-, -gy-
             if (
-                (substring_equals(str, len, current + 1, 2, "ER", NULL)
+                (SUBSTRING_EQUALS(str, len, current + 1, 2, "ER")
                  || (get_char_at(str, len, current + 1) == 'Y'))
-                && !substring_equals(str, len, 0, 6, "DANGER", "RANGER", "MANGER", NULL)
-                && !substring_equals(str, len, current - 1, 1, "E", "I", NULL)
-                && !substring_equals(str, len, current - 1, 3, "RGY", "OGY", NULL)
+                && !SUBSTRING_EQUALS(str, len, 0, 6, "DANGER", "RANGER", "MANGER")
+                && !SUBSTRING_EQUALS(str, len, current - 1, 1, "E", "I")
+                && !SUBSTRING_EQUALS(str, len, current - 1, 3, "RGY", "OGY")
                 )
             {
-                char_array_append(primary, "K");
-                char_array_append(secondary, "J");
+                double_metaphone_code_append(primary, "K");
+                double_metaphone_code_append(secondary, "J");
                 current += 2;
                 continue;
             }
 
             // italian e.g. "viaggi"
-            if (substring_equals(str, len, current + 1, 1, "E", "I", "Y", NULL)
-                || substring_equals(str, len, current - 1, 4, "AGGI", "OGGI", NULL))
+            if (SUBSTRING_EQUALS(str, len, current + 1, 1, "E", "I", "Y")
+                || SUBSTRING_EQUALS(str, len, current - 1, 4, "AGGI", "OGGI"))
             {
                 // obvious germanic
                 if (
-                    (substring_equals(str, len, 0, 4, "VAN ", "VON ", NULL)
-                     || substring_equals(str, len, current - 5, 5, " VAN ", " VON ", NULL)
-                     || substring_equals(str, len, 0, 3, "SCH", NULL))
-                    || substring_equals(str, len, current + 1, 2, "ET", NULL))
+                    (SUBSTRING_EQUALS(str, len, 0, 4, "VAN ", "VON ")
+                     || SUBSTRING_EQUALS(str, len, current - 5, 5, " VAN ", " VON ")
+                     || SUBSTRING_EQUALS(str, len, 0, 3, "SCH"))
+                    || SUBSTRING_EQUALS(str, len, current + 1, 2, "ET"))
                 {
-                    char_array_append(primary, "K");
-                    char_array_append(secondary, "K");
+                    double_metaphone_code_append(primary, "K");
+                    double_metaphone_code_append(secondary, "K");
 
                 } else {
-                    if (substring_equals(str, len, current + 1, 4, "IER ", NULL)
-                        || ((current == len - 3) && substring_equals(str, len, current + 1, 3, "IER", NULL))) 
+                    if (SUBSTRING_EQUALS(str, len, current + 1, 4, "IER ")
+                        || ((current == len - 3) && SUBSTRING_EQUALS(str, len, current + 1, 3, "IER"))) 
                     {
-                        char_array_append(primary, "J");
-                        char_array_append(secondary, "J");
+                        double_metaphone_code_append(primary, "J");
+                        double_metaphone_code_append(secondary, "J");
                     } else {
-                        char_array_append(primary, "J");
-                        char_array_append(secondary, "K");
+                        double_metaphone_code_append(primary, "J");
+                        double_metaphone_code_append(secondary, "K");
                     }
                 }
                 current += 2;
@@ -493,16 +483,16 @@ double_metaphone_codes_t *double_metaphone(char *input) {
                 current++;
             }
 
-            char_array_append(primary, "K");
-            char_array_append(secondary, "K");
+            double_metaphone_code_append(primary, "K");
+            double_metaphone_code_append(secondary, "K");
             continue;
         } else if (c == 'H') {
             // only keep if first & before vowel or between 2 vowels
             if (((current == 0) || is_vowel(get_char_at(str, len, current - 1)))
                 && is_vowel(get_char_at(str, len, current + 1)))
             {
-                char_array_append(primary, "H");
-                char_array_append(secondary, "H");
+                double_metaphone_code_append(primary, "H");
+                double_metaphone_code_append(secondary, "H");
                 current += 2;
             // also takes care of "HH"
             } else {
@@ -511,19 +501,19 @@ double_metaphone_codes_t *double_metaphone(char *input) {
             continue;
         } else if (c == 'J') {
             // obvious Spanish, "Jose", "San Jacinto"
-            if (substring_equals(str, len, current, 4, "JOSE", NULL)
-                || substring_equals(str, len, current, 5, "JOSÉ", NULL)
-                || substring_equals(str, len, 0, 4, "SAN ", NULL))
+            if (SUBSTRING_EQUALS(str, len, current, 4, "JOSE")
+                || SUBSTRING_EQUALS(str, len, current, 5, "JOSÉ")
+                || SUBSTRING_EQUALS(str, len, 0, 4, "SAN "))
             {
                 if (((current == 0)
                      && (get_char_at(str, len, current + 4) == ' '))
-                    || substring_equals(str, len, 0, 4, "SAN ", NULL))
+                    || SUBSTRING_EQUALS(str, len, 0, 4, "SAN "))
                 {
-                    char_array_append(primary, "H");
-                    char_array_append(secondary, "H");
+                    double_metaphone_code_append(primary, "H");
+                    double_metaphone_code_append(secondary, "H");
                 } else {
-                    char_array_append(primary, "J");
-                    char_array_append(secondary, "H");                    
+                    double_metaphone_code_append(primary, "J");
+                    double_metaphone_code_append(secondary, "H");                    
                 }
 
                 current++;
@@ -531,12 +521,12 @@ double_metaphone_codes_t *double_metaphone(char *input) {
             }
 
             if ((current == 0)
-                && !substring_equals(str, len, current, 4, "JOSE", NULL)
-                && !substring_equals(str, len, current, 5, "JOSÉ", NULL))
+                && !SUBSTRING_EQUALS(str, len, current, 4, "JOSE")
+                && !SUBSTRING_EQUALS(str, len, current, 5, "JOSÉ"))
             {
                 // Yankelovich/Jankelowicz
-                char_array_append(primary, "J");
-                char_array_append(secondary, "A");
+                double_metaphone_code_append(primary, "J");
+                double_metaphone_code_append(secondary, "A");
                 current++;
                 continue;
             } else {
@@ -546,18 +536,18 @@ double_metaphone_codes_t *double_metaphone(char *input) {
                     && ((get_char_at(str, len, current + 1) == 'A')
                         || (get_char_at(str, len, current + 1) == 'O')))
                 {
-                    char_array_append(primary, "J");
-                    char_array_append(secondary, "H");
+                    double_metaphone_code_append(primary, "J");
+                    double_metaphone_code_append(secondary, "H");
                 } else {
-                    if (current == last || ((current == last - 1 || get_char_at(str, len, current + 2) == ' ') && isalpha(get_char_at(str, len, current - 1)) && substring_equals(str, len, current + 1, 1, "A", "O", NULL))) {
-                        char_array_append(primary, "J");
+                    if (current == last || ((current == last - 1 || get_char_at(str, len, current + 2) == ' ') && isalpha(get_char_at(str, len, current - 1)) && SUBSTRING_EQUALS(str, len, current + 1, 1, "A", "O"))) {
+                        double_metaphone_code_append(primary, "J");
                     } else {
-                        if (!substring_equals(str, len, current + 1, 1, "L", "T",
-                                              "K", "S", "N", "M", "B", "Z", NULL)
-                            && !substring_equals(str, len, current - 1, 1, "S", "K", "L", NULL))
+                        if (!SUBSTRING_EQUALS(str, len, current + 1, 1, "L", "T",
+                                              "K", "S", "N", "M", "B", "Z")
+                            && !SUBSTRING_EQUALS(str, len, current - 1, 1, "S", "K", "L"))
                         {
-                            char_array_append(primary, "J");
-                            char_array_append(secondary, "J");
+                            double_metaphone_code_append(primary, "J");
+                            double_metaphone_code_append(secondary, "J");
                         }
                     }
                 }
@@ -577,21 +567,21 @@ double_metaphone_codes_t *double_metaphone(char *input) {
                 current++;
             }
 
-            char_array_append(primary, "K");
-            char_array_append(secondary, "K");
+            double_metaphone_code_append(primary, "K");
+            double_metaphone_code_append(secondary, "K");
             continue;
         } else if (c == 'L') {
             if (get_char_at(str, len, current + 1) == 'L') {
                 // Spanish e.g. "Cabrillo", "Gallegos"
                 if (((current == (len - 3))
-                     && substring_equals(str, len, current - 1, 4, "ILLO", "ILLA", "ALLE", NULL))
-                    || ((substring_equals(str, len, last - 1, 2, "AS", "OS", NULL)
-                      || substring_equals(str, len, last, 1, "A", "O", NULL))
-                      && substring_equals(str, len, current - 1, 4, "ALLE", NULL)
+                     && SUBSTRING_EQUALS(str, len, current - 1, 4, "ILLO", "ILLA", "ALLE"))
+                    || ((SUBSTRING_EQUALS(str, len, last - 1, 2, "AS", "OS")
+                      || SUBSTRING_EQUALS(str, len, last, 1, "A", "O"))
+                      && SUBSTRING_EQUALS(str, len, current - 1, 4, "ALLE")
                       )
                     )
                 {
-                    char_array_append(primary, "L");
+                    double_metaphone_code_append(primary, "L");
                     current += 2;
                     continue;
                 }
@@ -600,27 +590,27 @@ double_metaphone_codes_t *double_metaphone(char *input) {
             } else {
                 current++;
             }
-            char_array_append(primary, "L");
-            char_array_append(secondary, "L");
+            double_metaphone_code_append(primary, "L");
+            double_metaphone_code_append(secondary, "L");
             continue;
         } else if (c == 'M') {
-            if ((substring_equals(str, len, current - 1, 3, "UMB", NULL)
+            if ((SUBSTRING_EQUALS(str, len, current - 1, 3, "UMB")
                 && (((current + 1) == last)
-                    || substring_equals(str, len, current + 2, 2, "ER", NULL)))
+                    || SUBSTRING_EQUALS(str, len, current + 2, 2, "ER")))
                 || (get_char_at(str, len, current + 1) == 'M'))
             {
                 current += 2;
             } else {
                 current++;
             }
-            char_array_append(primary, "M");
-            char_array_append(secondary, "M");
+            double_metaphone_code_append(primary, "M");
+            double_metaphone_code_append(secondary, "M");
             continue;
         // Ñ (NFD normalized)
-        } else if (substring_equals(str, len, current, 3, "N\xcc\x83", NULL)) {
+        } else if (SUBSTRING_EQUALS(str, len, current, 3, "N\xcc\x83")) {
             current += 3;
-            char_array_append(primary, "N");
-            char_array_append(secondary, "N");
+            double_metaphone_code_append(primary, "N");
+            double_metaphone_code_append(secondary, "N");
             continue;
         } else if (c == 'N') {
             if (get_char_at(str, len, current + 1) == 'N')  {
@@ -629,26 +619,26 @@ double_metaphone_codes_t *double_metaphone(char *input) {
                 current++;
             }
 
-            char_array_append(primary, "N");
-            char_array_append(secondary, "N");
+            double_metaphone_code_append(primary, "N");
+            double_metaphone_code_append(secondary, "N");
             continue;
         } else if (c == 'P') {
-            if (substring_equals(str, len, current + 1, 1, "H", "F", NULL)) {
-                char_array_append(primary, "F");
-                char_array_append(secondary, "F");
+            if (SUBSTRING_EQUALS(str, len, current + 1, 1, "H", "F")) {
+                double_metaphone_code_append(primary, "F");
+                double_metaphone_code_append(secondary, "F");
                 current += 2;
                 continue;
             }
 
             // also account for "Campbell", "raspberry"
-            if (substring_equals(str, len, current + 1, 1, "P", "B", NULL)) {
+            if (SUBSTRING_EQUALS(str, len, current + 1, 1, "P", "B")) {
                 current += 2;
             } else {
                 current++;
             }
 
-            char_array_append(primary, "P");
-            char_array_append(secondary, "P");
+            double_metaphone_code_append(primary, "P");
+            double_metaphone_code_append(secondary, "P");
             continue;
         } else if (c == 'Q') {
             if (get_char_at(str, len, current + 1) == 'Q') {
@@ -657,20 +647,20 @@ double_metaphone_codes_t *double_metaphone(char *input) {
                 current += 1;
             }
 
-            char_array_append(primary, "K");
-            char_array_append(secondary, "K");
+            double_metaphone_code_append(primary, "K");
+            double_metaphone_code_append(secondary, "K");
             continue;
         } else if (c == 'R') {
             // french e.g. "rogier", but exclude "hochmeier"
             if ((current == last)
                 && !slavo_germanic
-                && substring_equals(str, len, current - 2, 2, "IE", NULL)
-                && !substring_equals(str, len, current - 4, 2, "ME", "MA", NULL))
+                && SUBSTRING_EQUALS(str, len, current - 2, 2, "IE")
+                && !SUBSTRING_EQUALS(str, len, current - 4, 2, "ME", "MA"))
             {
-                char_array_append(secondary, "R");
+                double_metaphone_code_append(secondary, "R");
             } else {
-                char_array_append(primary, "R");
-                char_array_append(secondary, "R");
+                double_metaphone_code_append(primary, "R");
+                double_metaphone_code_append(secondary, "R");
             }
 
             if (get_char_at(str, len, current + 1) == 'R') {
@@ -681,44 +671,44 @@ double_metaphone_codes_t *double_metaphone(char *input) {
             continue;
         } else if (c == 'S') {
             // special cases "island", "isle", "carlisle", "carlysle"
-            if (substring_equals(str, len, current - 1, 3, "ISL", "YSL", NULL)) {
+            if (SUBSTRING_EQUALS(str, len, current - 1, 3, "ISL", "YSL")) {
                 current++;
                 continue;
             }
 
             // special case "sugar-"
             if ((current == 0)
-                && substring_equals(str, len, current, 5, "SUGAR", NULL))
+                && SUBSTRING_EQUALS(str, len, current, 5, "SUGAR"))
             {
-                char_array_append(primary, "X");
-                char_array_append(secondary, "S");
+                double_metaphone_code_append(primary, "X");
+                double_metaphone_code_append(secondary, "S");
                 current++;
                 continue;
             }
 
-            if (substring_equals(str, len, current, 2, "SH", NULL)) {
+            if (SUBSTRING_EQUALS(str, len, current, 2, "SH")) {
                 // Germanic
-                if (substring_equals(str, len, current + 1, 4, "HEIM", "HOEK", "HOLM", "HOLZ", NULL)) {
-                    char_array_append(primary, "S");
-                    char_array_append(secondary, "S");
+                if (SUBSTRING_EQUALS(str, len, current + 1, 4, "HEIM", "HOEK", "HOLM", "HOLZ")) {
+                    double_metaphone_code_append(primary, "S");
+                    double_metaphone_code_append(secondary, "S");
                 } else {
-                    char_array_append(primary, "X");
-                    char_array_append(secondary, "X");
+                    double_metaphone_code_append(primary, "X");
+                    double_metaphone_code_append(secondary, "X");
                 }
                 current += 2;
                 continue;
             }
 
             // Italian & Armenian
-            if (substring_equals(str, len, current, 3, "SIO", "SIA", NULL)
-                || substring_equals(str, len, current, 4, "SIAN", NULL))
+            if (SUBSTRING_EQUALS(str, len, current, 3, "SIO", "SIA")
+                || SUBSTRING_EQUALS(str, len, current, 4, "SIAN"))
             {
                 if (!slavo_germanic) {
-                    char_array_append(primary, "S");
-                    char_array_append(secondary, "X");
+                    double_metaphone_code_append(primary, "S");
+                    double_metaphone_code_append(secondary, "X");
                 } else {
-                    char_array_append(primary, "S");
-                    char_array_append(secondary, "S");
+                    double_metaphone_code_append(primary, "S");
+                    double_metaphone_code_append(secondary, "S");
                 }
                 current += 3;
                 continue;
@@ -727,12 +717,12 @@ double_metaphone_codes_t *double_metaphone(char *input) {
             /* German & Anglicisations, e.g. "Smith" match "Schmidt", "Snider" match "Schneider"
                also, -sz- in Slavic language although in Hungarian it is pronounced 's' */
             if (((current == 0)
-                 && substring_equals(str, len, current + 1, 1, "M", "N", "L", "W", NULL))
-                || substring_equals(str, len, current + 1, 1, "Z", NULL))
+                 && SUBSTRING_EQUALS(str, len, current + 1, 1, "M", "N", "L", "W"))
+                || SUBSTRING_EQUALS(str, len, current + 1, 1, "Z"))
             {
-                char_array_append(primary, "S");
-                char_array_append(secondary, "X");
-                if (substring_equals(str, len, current + 1, 1, "Z", NULL)) {
+                double_metaphone_code_append(primary, "S");
+                double_metaphone_code_append(secondary, "X");
+                if (SUBSTRING_EQUALS(str, len, current + 1, 1, "Z")) {
                     current += 2;
                 } else {
                     current++;
@@ -741,20 +731,20 @@ double_metaphone_codes_t *double_metaphone(char *input) {
             }
 
 
-            if (substring_equals(str, len, current, 2, "SC", NULL)) {
+            if (SUBSTRING_EQUALS(str, len, current, 2, "SC")) {
                 // Schlesinger's rule
                 if (get_char_at(str, len, current + 2) == 'H') {
                     // Dutch origin e.g. "school", "schooner"
-                    if (substring_equals(str, len, current + 3, 2, "OO", "ER", "EN",
-                                         "UY", "ED", "EM", NULL))
+                    if (SUBSTRING_EQUALS(str, len, current + 3, 2, "OO", "ER", "EN",
+                                         "UY", "ED", "EM"))
                     {
                         // "Schermerhorn", "Schenker"
-                        if (substring_equals(str, len, current + 3, 2, "ER", "EN", NULL)) {
-                            char_array_append(primary, "X");
-                            char_array_append(secondary, "SK");
+                        if (SUBSTRING_EQUALS(str, len, current + 3, 2, "ER", "EN")) {
+                            double_metaphone_code_append(primary, "X");
+                            double_metaphone_code_append(secondary, "SK");
                         } else {
-                            char_array_append(primary, "SK");
-                            char_array_append(secondary, "SK");
+                            double_metaphone_code_append(primary, "SK");
+                            double_metaphone_code_append(secondary, "SK");
                         }
                         current += 3;
                         continue;
@@ -762,25 +752,25 @@ double_metaphone_codes_t *double_metaphone(char *input) {
                         if ((current == 0) && !is_vowel(get_char_at(str, len, 3))
                             && (get_char_at(str, len, 3) != 'W'))
                         {
-                            char_array_append(primary, "X");
-                            char_array_append(secondary, "S");
+                            double_metaphone_code_append(primary, "X");
+                            double_metaphone_code_append(secondary, "S");
                         } else {
-                            char_array_append(primary, "X");
-                            char_array_append(secondary, "X");
+                            double_metaphone_code_append(primary, "X");
+                            double_metaphone_code_append(secondary, "X");
                         }
                         current += 3;
                         continue;
                     }
 
-                    if (substring_equals(str, len, current + 2, 1, "I", "E", "Y", NULL)) {
-                        char_array_append(primary, "S");
-                        char_array_append(secondary, "S");
+                    if (SUBSTRING_EQUALS(str, len, current + 2, 1, "I", "E", "Y")) {
+                        double_metaphone_code_append(primary, "S");
+                        double_metaphone_code_append(secondary, "S");
                         current += 3;
                         continue;
                     }
 
-                    char_array_append(primary, "SK");
-                    char_array_append(secondary, "SK");
+                    double_metaphone_code_append(primary, "SK");
+                    double_metaphone_code_append(secondary, "SK");
                     current += 3;
                     continue;
                 }
@@ -788,15 +778,15 @@ double_metaphone_codes_t *double_metaphone(char *input) {
 
             // French e.g. "resnais", "artois"
             if ((current == last)
-                && substring_equals(str, len, current - 2, 2, "AI", "OI", NULL))
+                && SUBSTRING_EQUALS(str, len, current - 2, 2, "AI", "OI"))
             {
-                char_array_append(secondary, "S");
+                double_metaphone_code_append(secondary, "S");
             } else {
-                char_array_append(primary, "S");
-                char_array_append(secondary, "S");
+                double_metaphone_code_append(primary, "S");
+                double_metaphone_code_append(secondary, "S");
             }
 
-            if (substring_equals(str, len, current + 1, 1, "S", "Z", NULL)) {
+            if (SUBSTRING_EQUALS(str, len, current + 1, 1, "S", "Z")) {
 
                 current += 2;
             } else {
@@ -805,49 +795,49 @@ double_metaphone_codes_t *double_metaphone(char *input) {
             continue;
         } else if (c == 'T') {
 
-            if (substring_equals(str, len, current, 4, "TION", NULL)) {
-                char_array_append(primary, "X");
-                char_array_append(secondary, "X");
+            if (SUBSTRING_EQUALS(str, len, current, 4, "TION")) {
+                double_metaphone_code_append(primary, "X");
+                double_metaphone_code_append(secondary, "X");
                 current += 3;
                 continue;
             }
 
-            if (substring_equals(str, len, current, 3, "TIA", "TCH", NULL)) {
-                char_array_append(primary, "X");
-                char_array_append(secondary, "X");
+            if (SUBSTRING_EQUALS(str, len, current, 3, "TIA", "TCH")) {
+                double_metaphone_code_append(primary, "X");
+                double_metaphone_code_append(secondary, "X");
                 current += 3;
                 continue;
             }
 
-            if (substring_equals(str, len, current, 2, "TH", NULL)
-                || substring_equals(str, len, current, 3, "TTH", NULL)) 
+            if (SUBSTRING_EQUALS(str, len, current, 2, "TH")
+                || SUBSTRING_EQUALS(str, len, current, 3, "TTH")) 
             {
                 // special case "Thomas", "Thames", or Germanic
-                if (substring_equals(str, len, current + 2, 2, "OM", "AM", NULL)
-                 || substring_equals(str, len, 0, 4, "VAN ", "VON ", NULL)
-                 || substring_equals(str, len, current - 5, 5, " VAN ", " VON ", NULL)
-                 || substring_equals(str, len, 0, 3, "SCH", NULL))
+                if (SUBSTRING_EQUALS(str, len, current + 2, 2, "OM", "AM")
+                 || SUBSTRING_EQUALS(str, len, 0, 4, "VAN ", "VON ")
+                 || SUBSTRING_EQUALS(str, len, current - 5, 5, " VAN ", " VON ")
+                 || SUBSTRING_EQUALS(str, len, 0, 3, "SCH"))
                 {
-                    char_array_append(primary, "T");
-                    char_array_append(secondary, "T");
+                    double_metaphone_code_append(primary, "T");
+                    double_metaphone_code_append(secondary, "T");
                 } else {
                     // yes, zero
-                    char_array_append(primary, "0");
-                    char_array_append(secondary, "T");
+                    double_metaphone_code_append(primary, "0");
+                    double_metaphone_code_append(secondary, "T");
                 }
 
                 current += 2;
                 continue;
             }
 
-            if (substring_equals(str, len, current + 1, 1, "T", "D", NULL)) {
+            if (SUBSTRING_EQUALS(str, len, current + 1, 1, "T", "D")) {
                 current += 2;
             } else {
                 current++;
             }
 
-            char_array_append(primary, "T");
-            char_array_append(secondary, "T");
+            double_metaphone_code_append(primary, "T");
+            double_metaphone_code_append(secondary, "T");
             continue;
         } else if (c == 'V') {
             if (get_char_at(str, len, current + 1) == 'V') {
@@ -856,48 +846,48 @@ double_metaphone_codes_t *double_metaphone(char *input) {
                 current++;
             }
 
-            char_array_append(primary, "F");
-            char_array_append(secondary, "F");
+            double_metaphone_code_append(primary, "F");
+            double_metaphone_code_append(secondary, "F");
             continue;
         } else if (c == 'W') {
             // can also be in the middle of word
-            if (substring_equals(str, len, current, 2, "WR", NULL)) {
-                char_array_append(primary, "R");
-                char_array_append(secondary, "R");
+            if (SUBSTRING_EQUALS(str, len, current, 2, "WR")) {
+                double_metaphone_code_append(primary, "R");
+                double_metaphone_code_append(secondary, "R");
                 current += 2;
                 continue;
             }
 
             if ((current == 0)
                 && (is_vowel(get_char_at(str, len, current + 1))
-                || substring_equals(str, len, current, 2, "WH", NULL)))
+                || SUBSTRING_EQUALS(str, len, current, 2, "WH")))
             {
                 // Wasserman should match Vasserman
                 if (is_vowel(get_char_at(str, len, current + 1))) {
-                    char_array_append(primary, "A");
-                    char_array_append(secondary, "F");
+                    double_metaphone_code_append(primary, "A");
+                    double_metaphone_code_append(secondary, "F");
                 } else {
                     // need Uomo to match Womo
-                    char_array_append(primary, "A");
-                    char_array_append(secondary, "A");
+                    double_metaphone_code_append(primary, "A");
+                    double_metaphone_code_append(secondary, "A");
                 }
             }
 
             // Arnow should match Arnoff
             if (((current == last) && is_vowel(get_char_at(str, len, current - 1)))
-                || substring_equals(str, len, current - 1, 5, "EWSKI", "EWSKY",
-                                    "OWSKI", "OWSKY", NULL)
-                || substring_equals(str, len, 0, 3, "SCH", NULL))
+                || SUBSTRING_EQUALS(str, len, current - 1, 5, "EWSKI", "EWSKY",
+                                    "OWSKI", "OWSKY")
+                || SUBSTRING_EQUALS(str, len, 0, 3, "SCH"))
             {
-                char_array_append(secondary, "F");
+                double_metaphone_code_append(secondary, "F");
                 current++;
                 continue;
             }
 
             // Polish e.g. "Filipowicz"
-            if (substring_equals(str, len, current, 4, "WICZ", "WITZ", NULL)) {
-                char_array_append(primary, "TS");
-                char_array_append(secondary, "FX");
+            if (SUBSTRING_EQUALS(str, len, current, 4, "WICZ", "WITZ")) {
+                double_metaphone_code_append(primary, "TS");
+                double_metaphone_code_append(secondary, "FX");
                 current += 4;
                 continue;
             }
@@ -908,14 +898,14 @@ double_metaphone_codes_t *double_metaphone(char *input) {
         } else if (c == 'X') {
             // French e.g. "breaux"
             if (!((current == last)
-                  && (substring_equals(str, len, current - 3, 3, "IAU", "EAU", NULL)
-                   || substring_equals(str, len, current - 2, 2, "AU", "OU", NULL))))
+                  && (SUBSTRING_EQUALS(str, len, current - 3, 3, "IAU", "EAU")
+                   || SUBSTRING_EQUALS(str, len, current - 2, 2, "AU", "OU"))))
             {
-                char_array_append(primary, "KS");
-                char_array_append(secondary, "KS");
+                double_metaphone_code_append(primary, "KS");
+                double_metaphone_code_append(secondary, "KS");
             }
 
-            if (substring_equals(str, len, current + 1, 1, "C", "X", NULL)) {
+            if (SUBSTRING_EQUALS(str, len, current + 1, 1, "C", "X")) {
                 current += 2;
             } else {
                 current++;
@@ -924,20 +914,20 @@ double_metaphone_codes_t *double_metaphone(char *input) {
         } else if (c == 'Z') {
             // Chinese Pinyin e.g. "Zhao"
             if (get_char_at(str, len, current + 1) == 'H') {
-                char_array_append(primary, "J");
-                char_array_append(secondary, "J");
+                double_metaphone_code_append(primary, "J");
+                double_metaphone_code_append(secondary, "J");
                 current += 2;
                 continue;
-            } else if (substring_equals(str, len, current + 1, 2, "ZO", "ZI", "ZA", NULL)
+            } else if (SUBSTRING_EQUALS(str, len, current + 1, 2, "ZO", "ZI", "ZA")
                    || (slavo_germanic
                        && ((current > 0)
                        && get_char_at(str, len, current - 1) != 'T')))
             {
-                char_array_append(primary, "S");
-                char_array_append(secondary, "TS");
+                double_metaphone_code_append(primary, "S");
+                double_metaphone_code_append(secondary, "TS");
             } else {
-                char_array_append(primary, "S");
-                char_array_append(secondary, "S");
+                double_metaphone_code_append(primary, "S");
+                double_metaphone_code_append(secondary, "S");
             }
 
             if (get_char_at(str, len, current + 1) == 'Z') {
@@ -951,19 +941,121 @@ double_metaphone_codes_t *double_metaphone(char *input) {
         }
     }
 
+    return !primary->truncated && !secondary->truncated;
+}
+
+double_metaphone_codes_t *double_metaphone(char *input) {
+    if (input == NULL) return NULL;
+
+    char *ptr = utf8_upper(input);
+
+    /* Note: NFD normalization will help with simple decomposable accent characters
+       like "É", "Ü", etc. which effectively become "E\u0301" and "U\u0308". It does
+       not handle characters like "Ł". For these, use Latin-ASCII transliteration
+       prior to calling this function.
+
+       We can still check for a specific accented character like C with cedilla (Ç),
+       by comparing with its decomposed form i.e. "C\xcc\xa7"
+    */
+
+    char *normalized = (char *)utf8proc_NFD((utf8proc_uint8_t *)ptr);
+
+    if (normalized != NULL) {
+        free(ptr);
+        ptr = normalized;        
+    }
+
+    if (ptr == NULL) {
+        return NULL;
+    }
+
+    char *str = ptr;
+
+    size_t len = strlen(str);
+
+    // Every rule consumes at least one byte and emits at most two
+    size_t size = 2 * len + 1;
+    double_metaphone_code_t primary = (double_metaphone_code_t){malloc(size), 0, size, false};
+    double_metaphone_code_t secondary = (double_metaphone_code_t){malloc(size), 0, size, false};
+
+    if (primary.str == NULL || secondary.str == NULL) {
+        goto exit_free_codes;
+    }
+
+    primary.str[0] = '\0';
+    secondary.str[0] = '\0';
+
+    double_metaphone_encode(str, len, &primary, &secondary);
+
     double_metaphone_codes_t *codes = calloc(1, sizeof(double_metaphone_codes_t));
     if (codes == NULL) {
-        char_array_destroy(primary);
-        char_array_destroy(secondary);
-        return NULL;
+        goto exit_free_codes;
     }
 
-    codes->primary = char_array_to_string(primary);
-    codes->secondary = char_array_to_string(secondary);
+    codes->primary = primary.str;
+    codes->secondary = secondary.str;
 
     free(ptr);
 
     return codes;
+
+exit_free_codes:
+    if (primary.str != NULL) {
+        free(primary.str);
+    }
+    if (secondary.str != NULL) {
+        free(secondary.str);
+    }
+    free(ptr);
+    return NULL;
+}
+
+/* Upper-cases and canonically decomposes input into codepoints in one pass,
+   leaving the UTF-8 result in the same buffer. ASCII input, the usual case
+   after Latin-ASCII transliteration, is just upper-cased byte by byte.
+   Returns the byte length or -1 if input doesn't fit in num_codepoints. */
+static ssize_t double_metaphone_normalize(char *input, utf8proc_int32_t *codepoints, size_t num_codepoints) {
+    char *str = (char *)codepoints;
+
+    size_t i;
+    for (i = 0; input[i] != '\0'; i++) {
+        char c = input[i];
+        if ((unsigned char)c >= 0x80) break;
+        if (i + 1 >= num_codepoints) return -1;
+        str[i] = c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c;
+    }
+
+    if (input[i] == '\0') {
+        str[i] = '\0';
+        return (ssize_t)i;
+    }
+
+    // Leave room for the NUL byte utf8proc_reencode appends
+    utf8proc_ssize_t n = utf8proc_decompose((utf8proc_uint8_t *)input, 0, codepoints, num_codepoints - 1, UTF8PROC_OPTIONS_NFD);
+    if (n < 0 || (size_t)n > num_codepoints - 1) return -1;
+
+    for (utf8proc_ssize_t j = 0; j < n; j++) {
+        codepoints[j] = utf8proc_toupper(codepoints[j]);
+    }
+
+    return (ssize_t)utf8proc_reencode(codepoints, n, UTF8PROC_OPTIONS_NFD);
+}
+
+bool double_metaphone_codes_buffer(char *input, char *primary, char *secondary, size_t size) {
+    if (input == NULL || primary == NULL || secondary == NULL || size == 0) return false;
+
+    utf8proc_int32_t codepoints[DOUBLE_METAPHONE_MAX_CODEPOINTS];
+
+    ssize_t len = double_metaphone_normalize(input, codepoints, DOUBLE_METAPHONE_MAX_CODEPOINTS);
+    if (len < 0) return false;
+
+    double_metaphone_code_t primary_code = (double_metaphone_code_t){primary, 0, size, false};
+    double_metaphone_code_t secondary_code = (double_metaphone_code_t){secondary, 0, size, false};
+
+    primary[0] = '\0';
+    secondary[0] = '\0';
+
+    return double_metaphone_encode((char *)codepoints, (size_t)len, &primary_code, &secondary_code);
 }
 
 void double_metaphone_codes_destroy(double_metaphone_codes_t *codes) {
@@ -3,6 +3,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+
+// Longest input (in codepoints after NFD) double_metaphone_codes_buffer normalizes on the stack
+#define DOUBLE_METAPHONE_MAX_CODEPOINTS 256
+// Rules emit at most two characters per codepoint, so codes always fit in this size
+#define DOUBLE_METAPHONE_CODE_SIZE (2 * DOUBLE_METAPHONE_MAX_CODEPOINTS + 1)
 
 typedef struct double_metaphone_codes {
     char *primary;
@@ -11,6 +17,11 @@ typedef struct double_metaphone_codes {
 
 double_metaphone_codes_t *double_metaphone(char *input);
 
+/* Same codes as double_metaphone, written into caller-provided buffers of size
+   bytes without allocating. Returns false if the input is too long or either
+   code doesn't fit, in which case the caller can use double_metaphone. */
+bool double_metaphone_codes_buffer(char *input, char *primary, char *secondary, size_t size);
+
 void double_metaphone_codes_destroy(double_metaphone_codes_t *codes);
 
 #endif
@@ -11,6 +11,7 @@
 #include "numex.h"
 #include "normalize.h"
 #include "scanner.h"
+#include "string_set.h"
 #include "string_utils.h"
 #include "token_types.h"
 #include "transliterate.h"
@@ -1422,7 +1423,7 @@ inline void add_normalized_strings_tokenized(string_tree_t *tree, char *str, tok
 }
 
 
-void expand_alternative_phrase_option(cstring_array *strings, khash_t(str_set) *unique_strings, char *str, libpostal_normalize_options_t options, expansion_phrase_option_t phrase_option) {
+void expand_alternative_phrase_option(cstring_array *strings, string_set_t *unique_strings, char *str, libpostal_normalize_options_t options, expansion_phrase_option_t phrase_option) {
     size_t len = strlen(str);
     token_array *tokens = tokenize_keep_whitespace(str);
     string_tree_t *token_tree = string_tree_new_size(len);
@@ -1439,12 +1440,10 @@ void expand_alternative_phrase_option(cstring_array *strings, khash_t(str_set) *
 
     char *lang;
 
-    kh_resize(str_set, unique_strings, kh_size(unique_strings) + tokenized_iter->remaining);
-
     bool excessive_perms_outer = tokenized_iter->remaining >= EXCESSIVE_PERMUTATIONS;
 
     if (!excessive_perms_outer) {
-        kh_resize(str_set, unique_strings, kh_size(unique_strings) + tokenized_iter->remaining);
+        string_set_reserve(unique_strings, string_set_size(unique_strings) + tokenized_iter->remaining);
     }
 
     log_debug("tokenized_iter->remaining=%d\n", tokenized_iter->remaining);
@@ -1464,7 +1463,6 @@ void expand_alternative_phrase_option(cstring_array *strings, khash_t(str_set) *
         
         string_tree_t *alternatives;
 
-        int ret;
         log_debug("Adding alternatives for single normalization\n");
         alternatives = add_string_alternatives_phrase_option(tokenized_str, options, phrase_option);
 
@@ -1507,17 +1505,15 @@ void expand_alternative_phrase_option(cstring_array *strings, khash_t(str_set) *
                     continue;
                 }
 
-                char *dupe_token = strndup(token + left_spaces, token_len - left_spaces - right_spaces);
-
                 log_debug("full string=%s\n", token);
-                khiter_t k = kh_get(str_set, unique_strings, dupe_token);
 
-                if (k == kh_end(unique_strings)) {
+                // Trim in place, the set copies the key into its own arena
+                token[token_len - right_spaces] = '\0';
+                char *dupe_token = token + left_spaces;
+
+                if (string_set_add_len(unique_strings, dupe_token, token_len - left_spaces - right_spaces) == 1) {
                     log_debug("doing postprocessing\n");
                     add_postprocessed_string(strings, dupe_token, options);
-                    k = kh_put(str_set, unique_strings, dupe_token, &ret);
-                } else {
-                    free(dupe_token);
                 }
 
                 log_debug("iter->remaining = %d\n", iter->remaining);
@@ -1545,7 +1541,7 @@ void expand_alternative_phrase_option(cstring_array *strings, khash_t(str_set) *
 
 
 
-void expand_alternative_phrase_option_languages(cstring_array *strings, khash_t(str_set) *unique_strings, char *str, libpostal_normalize_options_t options, expansion_phrase_option_t phrase_option) {
+void expand_alternative_phrase_option_languages(cstring_array *strings, string_set_t *unique_strings, char *str, libpostal_normalize_options_t options, expansion_phrase_option_t phrase_option) {
     char **temp_languages = calloc(1, sizeof(char *));
     libpostal_normalize_options_t temp_options = options;
 
@@ -1578,7 +1574,10 @@ cstring_array *expand_address_phrase_option(char *input, libpostal_normalize_opt
     libpostal_language_classifier_response_t *lang_response = NULL;
 
     if (options.num_languages == 0) {
-         lang_response = classify_languages(input);
+         lang_response = classify_languages_script(input);
+         if (lang_response == NULL) {
+            lang_response = classify_languages(input);
+         }
          if (lang_response != NULL) {
             options.num_languages = lang_response->num_languages;
             options.languages = lang_response->languages;
@@ -1590,7 +1589,7 @@ cstring_array *expand_address_phrase_option(char *input, libpostal_normalize_opt
     cstring_array *strings = cstring_array_new_size(len * 2);
     char_array *temp_string = char_array_new_size(len);
 
-    khash_t(str_set) *unique_strings = kh_init(str_set);
+    string_set_t *unique_strings = string_set_new();
 
     char *token;
 
@@ -1625,14 +1624,7 @@ cstring_array *expand_address_phrase_option(char *input, libpostal_normalize_opt
         string_tree_iterator_destroy(iter);
     }
 
-    char *key_str = NULL;
-    for (size_t i = kh_begin(unique_strings); i != kh_end(unique_strings); ++i) {
-        if (!kh_exist(unique_strings, i)) continue;
-        key_str = (char *)kh_key(unique_strings, i);
-        free(key_str);
-    }
-
-    kh_destroy(str_set, unique_strings);
+    string_set_destroy(unique_strings);
 
     if (lang_response != NULL) {
         libpostal_language_classifier_response_destroy(lang_response);
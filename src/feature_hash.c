@@ -0,0 +1,15 @@
+#include <string.h>
+
+#include "feature_hash.h"
+#include "murmur/murmur.h"
+
+uint64_t feature_hash(const char *feature, size_t len, uint32_t seed) {
+    uint64_t checksum[2];
+    MurmurHash3_x64_128(feature, (int)len, seed, checksum);
+    return checksum[0];
+}
+
+uint32_t feature_hash_id(const char *feature, uint32_t seed, uint32_t num_bits) {
+    uint64_t h = feature_hash(feature, strlen(feature), seed);
+    return (uint32_t)(h & ((1ULL << num_bits) - 1));
+}
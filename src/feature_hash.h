@@ -0,0 +1,35 @@
+/*
+feature_hash.h
+--------------
+
+Hashing trick for model features. Instead of assigning ids to feature
+strings through a dictionary (a khash while training, a trie in the saved
+model), each feature is mapped to one of 2^num_bits ids by a seeded 64-bit
+MurmurHash3. A model trained this way only needs to store the seed and the
+number of bits next to its weights, and neither the trainer nor inference
+keeps the feature strings around.
+
+Distinct features can collide on the same id, which acts like a mild
+regularizer. With enough bits for the feature space the effect on accuracy
+is small.
+*/
+
+#ifndef FEATURE_HASH_H
+#define FEATURE_HASH_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FEATURE_HASH_DEFAULT_SEED 0x4c1b7a3f
+#define FEATURE_HASH_MIN_BITS 8
+#define FEATURE_HASH_MAX_BITS 30
+
+uint64_t feature_hash(const char *feature, size_t len, uint32_t seed);
+uint32_t feature_hash_id(const char *feature, uint32_t seed, uint32_t num_bits);
+
+static inline bool feature_hash_valid_bits(uint32_t num_bits) {
+    return num_bits >= FEATURE_HASH_MIN_BITS && num_bits <= FEATURE_HASH_MAX_BITS;
+}
+
+#endif
@@ -39,6 +39,14 @@ bool file_exists(char *filename) {
     return exists;
 }
 
+// True if nothing is left to read, used for optional trailing sections
+bool file_at_eof(FILE *f) {
+    int c = fgetc(f);
+    if (c == EOF) return true;
+    ungetc(c, f);
+    return false;
+}
+
 bool is_relative_path(struct dirent *ent) {
     return strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0;
 }
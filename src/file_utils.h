@@ -56,6 +56,8 @@ char *file_getline(FILE * f);
 
 bool file_exists(char *filename);
 
+bool file_at_eof(FILE *f);
+
 bool is_relative_path(struct dirent *ent);
 
 char *path_join(int n, ...);
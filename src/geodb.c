@@ -1,7 +1,28 @@
+#include <pthread.h>
+
 #include "geodb.h"
+#include "msgpack_utils.h"
 
 static geodb_t *geodb = NULL;
 
+/*
+Each thread's reader for the global geodb hangs off a slot owned by that
+thread. Slots are also linked into a registry so that teardown can destroy
+every thread's reader, not just its own, before the geodb goes away. A slot
+whose reader was destroyed simply builds a new one on its next lookup.
+*/
+typedef struct geodb_thread_reader {
+    geodb_reader_t *reader;
+    struct geodb_thread_reader *prev;
+    struct geodb_thread_reader *next;
+} geodb_thread_reader_t;
+
+static pthread_key_t geodb_reader_key;
+static pthread_once_t geodb_reader_key_once = PTHREAD_ONCE_INIT;
+
+static pthread_mutex_t geodb_thread_readers_lock = PTHREAD_MUTEX_INITIALIZER;
+static geodb_thread_reader_t *geodb_thread_readers = NULL;
+
 geodb_t *get_geodb(void) {
     return geodb;
 }
@@ -21,24 +42,12 @@ void geodb_destroy(geodb_t *self) {
         cstring_array_destroy(self->postal_codes);
     }
 
-    if (self->hash_reader != NULL) {
-        sparkey_hash_close(&self->hash_reader);
-    }
-
-    if (self->log_iter != NULL) {
-        sparkey_logiter_close(&self->log_iter);
-    }
-
-    if (self->value_buf != NULL) {
-        char_array_destroy(self->value_buf);
-    }
-
-    if (self->geoname != NULL) {
-        geoname_destroy(self->geoname);
+    if (self->feature_graph != NULL) {
+        graph_destroy(self->feature_graph);
     }
 
-    if (self->postal_code != NULL) {
-        gn_postal_code_destroy(self->postal_code);
+    if (self->hash_reader != NULL) {
+        sparkey_hash_close(&self->hash_reader);
     }
 
     free(self);
@@ -74,6 +83,17 @@ geodb_t *geodb_init(char *dir) {
 
     char_array_clear(path);
 
+    char_array_cat_joined(path, PATH_SEPARATOR, true, 2, dir, GEODB_FEATURE_GRAPH_FILENAME);
+
+    char *feature_graph_path = char_array_get_string(path);
+
+    gdb->feature_graph = graph_load(feature_graph_path);
+    if (gdb->feature_graph == NULL) {
+        goto exit_geodb_created;
+    }
+
+    char_array_clear(path);
+
     char_array_cat_joined(path, PATH_SEPARATOR, true, 2, dir, GEODB_POSTAL_CODES_FILENAME);
     char *postal_codes_path = char_array_get_string(path);
 
@@ -128,27 +148,6 @@ geodb_t *geodb_init(char *dir) {
     free(hash_file_path);
     char_array_destroy(path);
 
-    gdb->log_iter = NULL;
-
-    if ((sparkey_logiter_create(&gdb->log_iter, sparkey_hash_getreader(gdb->hash_reader))) != SPARKEY_SUCCESS) {
-        goto exit_geodb_created;
-    }
-
-    gdb->value_buf = char_array_new_size(sparkey_logreader_maxvaluelen(sparkey_hash_getreader(gdb->hash_reader)));
-    if (gdb->value_buf == NULL) {
-        goto exit_geodb_created;
-    }
-
-    gdb->geoname = geoname_new();
-    if (gdb->geoname == NULL) {
-        goto exit_geodb_created;
-    }
-
-    gdb->postal_code = gn_postal_code_new();
-    if (gdb->postal_code == NULL) {
-        goto exit_geodb_created;
-    }
-
     return gdb;
 
 exit_geodb_created:
@@ -197,35 +196,436 @@ phrase_array *search_geodb_tokens(char *str, token_array *tokens) {
 }
 
 
-geonames_generic_t *geodb_get_len(char *key, size_t len) {
-    if (geodb == NULL || geodb->hash_reader == NULL || geodb->log_iter == NULL) return NULL;
-    sparkey_returncode ret = sparkey_hash_get(geodb->hash_reader, (uint8_t *)key, len, geodb->log_iter);
-    if (sparkey_logiter_state(geodb->log_iter) == SPARKEY_ITER_ACTIVE) {
-        uint64_t expected_value_len = sparkey_logiter_valuelen(geodb->log_iter);
-        uint64_t actual_value_len;
-        ret = sparkey_logiter_fill_value(geodb->log_iter, sparkey_hash_getreader(geodb->hash_reader), expected_value_len, (uint8_t *)geodb->value_buf->a, &actual_value_len);
-        if (ret == SPARKEY_SUCCESS) {
-            geonames_generic_t *generic = malloc(sizeof(geonames_generic_t));
-            if (geonames_generic_deserialize(&generic->type, geodb->geoname, geodb->postal_code, geodb->value_buf)) {
-                if (generic->type == GEONAMES_PLACE) {
-                    generic->geoname = geodb->geoname;
-                } else if (generic->type == GEONAMES_POSTAL_CODE) {
-                    generic->postal_code = geodb->postal_code;
-                } else {
-                    free(generic);
-                    return NULL;
-                }
-                return generic;
-            }
-        }
-    } 
+void geodb_reader_destroy(geodb_reader_t *self) {
+    if (self == NULL) return;
+
+    if (self->log_iter != NULL) {
+        sparkey_logiter_close(&self->log_iter);
+    }
+
+    if (self->value_buf != NULL) {
+        char_array_destroy(self->value_buf);
+    }
+
+    if (self->geoname != NULL) {
+        geoname_destroy(self->geoname);
+    }
+
+    if (self->postal_code != NULL) {
+        gn_postal_code_destroy(self->postal_code);
+    }
+
+    free(self);
+}
+
+geodb_reader_t *geodb_reader_new(geodb_t *gdb) {
+    if (gdb == NULL || gdb->hash_reader == NULL) return NULL;
+
+    geodb_reader_t *reader = calloc(1, sizeof(geodb_reader_t));
+    if (reader == NULL) return NULL;
+
+    reader->geodb = gdb;
+
+    sparkey_logreader *log_reader = sparkey_hash_getreader(gdb->hash_reader);
+
+    if ((sparkey_logiter_create(&reader->log_iter, log_reader)) != SPARKEY_SUCCESS) {
+        goto exit_reader_created;
+    }
+
+    reader->value_buf = char_array_new_size(sparkey_logreader_maxvaluelen(log_reader));
+    if (reader->value_buf == NULL) {
+        goto exit_reader_created;
+    }
+
+    reader->geoname = geoname_new();
+    if (reader->geoname == NULL) {
+        goto exit_reader_created;
+    }
+
+    reader->postal_code = gn_postal_code_new();
+    if (reader->postal_code == NULL) {
+        goto exit_reader_created;
+    }
+
+    return reader;
+
+exit_reader_created:
+    geodb_reader_destroy(reader);
     return NULL;
 }
 
+/*
+GeoNames places are keyed by their numeric id, postal codes by "{country}|{code}"
+*/
+static inline gn_type geodb_key_type(char *key, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (key[i] < '0' || key[i] > '9') {
+            return GEONAMES_POSTAL_CODE;
+        }
+    }
+    return GEONAMES_PLACE;
+}
+
+/*
+Points value at the record for key. The log is written uncompressed, so the
+value chunk is a pointer straight into the mmap'd log file and nothing is
+copied. The copy into value_buf is only a fallback for compressed logs.
+*/
+static bool geodb_reader_get_value(geodb_reader_t *self, char *key, size_t len, const uint8_t **value, size_t *value_len) {
+    sparkey_hashreader *hash_reader = self->geodb->hash_reader;
+    sparkey_logreader *log_reader = sparkey_hash_getreader(hash_reader);
+
+    if (sparkey_hash_get(hash_reader, (uint8_t *)key, len, self->log_iter) != SPARKEY_SUCCESS ||
+        sparkey_logiter_state(self->log_iter) != SPARKEY_ITER_ACTIVE) {
+        return false;
+    }
+
+    uint64_t expected_value_len = sparkey_logiter_valuelen(self->log_iter);
+    uint8_t *chunk = NULL;
+    uint64_t chunk_len = 0;
+
+    if (sparkey_logiter_valuechunk(self->log_iter, log_reader, expected_value_len, &chunk, &chunk_len) != SPARKEY_SUCCESS) {
+        return false;
+    }
+
+    if (chunk_len == expected_value_len) {
+        *value = chunk;
+        *value_len = (size_t)chunk_len;
+        return true;
+    }
+
+    char_array *buf = self->value_buf;
+    char_array_clear(buf);
+    char_array_append_len(buf, (char *)chunk, (size_t)chunk_len);
+
+    while (char_array_len(buf) < expected_value_len) {
+        if (sparkey_logiter_valuechunk(self->log_iter, log_reader, expected_value_len - char_array_len(buf), &chunk, &chunk_len) != SPARKEY_SUCCESS || chunk_len == 0) {
+            return false;
+        }
+        char_array_append_len(buf, (char *)chunk, (size_t)chunk_len);
+    }
+
+    *value = (const uint8_t *)buf->a;
+    *value_len = buf->n;
+    return true;
+}
+
+geonames_generic_t *geodb_reader_get_len(geodb_reader_t *self, char *key, size_t len) {
+    if (self == NULL || key == NULL) return NULL;
+
+    const uint8_t *value;
+    size_t value_len;
+
+    if (!geodb_reader_get_value(self, key, len, &value, &value_len)) {
+        return NULL;
+    }
+
+    geonames_generic_t *result = &self->result;
+    result->type = geodb_key_type(key, len);
+
+    if (result->type == GEONAMES_PLACE) {
+        if (!geoname_deserialize_bytes(self->geoname, value, value_len)) {
+            return NULL;
+        }
+        result->geoname = self->geoname;
+    } else {
+        if (!gn_postal_code_deserialize_bytes(self->postal_code, value, value_len)) {
+            return NULL;
+        }
+        result->postal_code = self->postal_code;
+    }
+
+    return result;
+}
+
+inline geonames_generic_t *geodb_reader_get(geodb_reader_t *self, char *key) {
+    return geodb_reader_get_len(self, key, strlen(key));
+}
+
+static bool msgpack_bytes_skip_str(cmp_ctx_t *ctx) {
+    cmp_object_t obj;
+    if (!cmp_read_object(ctx, &obj)) {
+        return false;
+    }
+
+    if (cmp_object_is_nil(&obj)) {
+        return true;
+    } else if (!cmp_object_is_str(&obj)) {
+        return false;
+    }
+
+    msgpack_bytes_t *buffer = ctx->buf;
+    if (buffer->offset + obj.as.str_size > buffer->len) {
+        return false;
+    }
+    buffer->offset += obj.as.str_size;
+    return true;
+}
+
+/*
+Only reads the fields up to the id we need (see geoname_serialize_ctx and
+gn_postal_code_serialize_ctx for the field order), skipping strings in place.
+*/
+static bool geodb_decode_geonames_id(gn_type type, const uint8_t *value, size_t value_len, uint32_t *geonames_id) {
+    cmp_ctx_t ctx;
+    msgpack_bytes_t buffer = (msgpack_bytes_t){value, value_len, 0};
+    cmp_init(&ctx, &buffer, msgpack_const_bytes_reader, NULL);
+
+    if (type == GEONAMES_PLACE) {
+        return cmp_read_uint(&ctx, geonames_id);
+    }
+
+    uint32_t country_geonames_id;
+    bool have_containing_geoname;
+
+    // postal_code, country_code
+    if (!msgpack_bytes_skip_str(&ctx) ||
+        !msgpack_bytes_skip_str(&ctx) ||
+        !cmp_read_uint(&ctx, &country_geonames_id) ||
+        !cmp_read_bool(&ctx, &have_containing_geoname)) {
+        return false;
+    }
+
+    if (have_containing_geoname) {
+        // containing_geoname
+        return msgpack_bytes_skip_str(&ctx) && cmp_read_uint(&ctx, geonames_id);
+    }
+
+    *geonames_id = country_geonames_id;
+    return true;
+}
+
+size_t geodb_reader_lookup_batch(geodb_reader_t *self, size_t n, char **keys, geodb_lookup_result_t *results) {
+    if (self == NULL || keys == NULL || results == NULL) return 0;
+
+    size_t num_found = 0;
+    const uint8_t *value;
+    size_t value_len;
+
+    for (size_t i = 0; i < n; i++) {
+        geodb_lookup_result_t *result = results + i;
+        result->found = false;
+        result->geonames_id = 0;
+
+        char *key = keys[i];
+        if (key == NULL) continue;
+
+        size_t len = strlen(key);
+        result->type = geodb_key_type(key, len);
+
+        if (!geodb_reader_get_value(self, key, len, &value, &value_len)) {
+            continue;
+        }
+
+        if (geodb_decode_geonames_id(result->type, value, value_len, &result->geonames_id)) {
+            result->found = true;
+            num_found++;
+        }
+    }
+
+    return num_found;
+}
+
+static bool geodb_reader_fetch_geonames_id(geodb_reader_t *self, gn_type type, char *key, uint32_t *geonames_id) {
+    const uint8_t *value;
+    size_t value_len;
+
+    return geodb_reader_get_value(self, key, strlen(key), &value, &value_len) &&
+           geodb_decode_geonames_id(type, value, value_len, geonames_id);
+}
+
+/*
+Postal codes are linked to the feature graph by their index in postal_codes,
+whose entries are "{country}|{code}"
+*/
+static bool geodb_is_postal_code_index(geodb_t *gdb, uint32_t index, char *name) {
+    if (index >= cstring_array_num_strings(gdb->postal_codes)) return false;
+
+    char *key = cstring_array_get_string(gdb->postal_codes, index);
+    char *code = strstr(key, NAMESPACE_SEPARATOR_CHAR);
+
+    return code != NULL && strcmp(code + NAMESPACE_SEPARATOR_CHAR_LEN, name) == 0;
+}
+
+/*
+Every place and postal code is linked to its bare name feature in the feature
+graph (see geodb_builder), so the ids for a name are that feature's row. For
+places the row holds GeoNames ids, for postal codes indices into postal_codes.
+A string can be both, e.g. a numeric place name, so indices that point back to
+a postal code with this name are kept apart from place ids.
+*/
+static void geodb_reader_add_name_ids(geodb_reader_t *self, char *name, gn_type type, uint32_array *ids) {
+    geodb_t *gdb = self->geodb;
+
+    geodb_value_t value;
+    if (!trie_get_data(gdb->names, name, &value.value)) return;
+
+    bool have_postal_code = (value.components & GEONAMES_ADDRESS_COMPONENT_POSTCODE) != 0;
+    if (type == GEONAMES_POSTAL_CODE && !have_postal_code) return;
+    if (type == GEONAMES_PLACE && value.components == GEONAMES_ADDRESS_COMPONENT_POSTCODE) return;
+
+    uint32_t feature_id;
+    if (!trie_get_data(gdb->features, name, &feature_id)) return;
+
+    graph_t *graph = gdb->feature_graph;
+    if ((size_t)feature_id + 1 >= graph->indptr->n) return;
+
+    uint32_t row_start = graph->indptr->a[feature_id];
+    uint32_t row_end = graph->indptr->a[feature_id + 1];
+
+    char id_string[INT32_MAX_STRING_SIZE + 1];
+    uint32_t geonames_id;
+
+    for (uint32_t j = row_start; j < row_end; j++) {
+        uint32_t col = graph->indices->a[j];
+        bool is_postal_code = have_postal_code && geodb_is_postal_code_index(gdb, col, name);
+
+        char *key;
+        if (type == GEONAMES_POSTAL_CODE && is_postal_code) {
+            key = cstring_array_get_string(gdb->postal_codes, col);
+        } else if (type == GEONAMES_PLACE && !is_postal_code) {
+            sprintf(id_string, "%d", col);
+            key = id_string;
+        } else {
+            continue;
+        }
+
+        if (geodb_reader_fetch_geonames_id(self, type, key, &geonames_id)) {
+            uint32_array_push(ids, geonames_id);
+        }
+    }
+}
+
+size_t geodb_reader_lookup_names_batch(geodb_reader_t *self, size_t n, char **names, gn_type type, uint32_array *ids, geodb_name_lookup_result_t *results) {
+    if (self == NULL || names == NULL || ids == NULL || results == NULL) return 0;
+
+    uint64_t normalize_options = type == GEONAMES_PLACE ? GEODB_NAME_NORMALIZE_OPTIONS : GEODB_POSTAL_CODE_NORMALIZE_OPTIONS;
+    size_t num_found = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        geodb_name_lookup_result_t *result = results + i;
+        result->found = false;
+        result->index = ids->n;
+        result->count = 0;
+
+        if (names[i] == NULL) continue;
+
+        char *normalized = normalize_string_utf8(names[i], normalize_options);
+        if (normalized == NULL) continue;
+
+        geodb_reader_add_name_ids(self, normalized, type, ids);
+        free(normalized);
+
+        result->count = ids->n - result->index;
+        if (result->count > 0) {
+            result->found = true;
+            num_found++;
+        }
+    }
+
+    return num_found;
+}
+
+static void geodb_thread_reader_destroy(void *ptr) {
+    geodb_thread_reader_t *slot = ptr;
+
+    pthread_mutex_lock(&geodb_thread_readers_lock);
+    if (slot->prev != NULL) {
+        slot->prev->next = slot->next;
+    } else {
+        geodb_thread_readers = slot->next;
+    }
+    if (slot->next != NULL) {
+        slot->next->prev = slot->prev;
+    }
+    geodb_reader_t *reader = __atomic_exchange_n(&slot->reader, NULL, __ATOMIC_ACQ_REL);
+    pthread_mutex_unlock(&geodb_thread_readers_lock);
+
+    geodb_reader_destroy(reader);
+    free(slot);
+}
+
+static void geodb_reader_key_create(void) {
+    pthread_key_create(&geodb_reader_key, geodb_thread_reader_destroy);
+}
+
+static geodb_thread_reader_t *geodb_thread_reader_slot(void) {
+    pthread_once(&geodb_reader_key_once, geodb_reader_key_create);
+
+    geodb_thread_reader_t *slot = pthread_getspecific(geodb_reader_key);
+    if (slot != NULL) return slot;
+
+    slot = calloc(1, sizeof(geodb_thread_reader_t));
+    if (slot == NULL) return NULL;
+
+    if (pthread_setspecific(geodb_reader_key, slot) != 0) {
+        free(slot);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&geodb_thread_readers_lock);
+    slot->next = geodb_thread_readers;
+    if (geodb_thread_readers != NULL) {
+        geodb_thread_readers->prev = slot;
+    }
+    geodb_thread_readers = slot;
+    pthread_mutex_unlock(&geodb_thread_readers_lock);
+
+    return slot;
+}
+
+static geodb_reader_t *geodb_thread_reader(void) {
+    geodb_thread_reader_t *slot = geodb_thread_reader_slot();
+    if (slot == NULL) return NULL;
+
+    geodb_reader_t *reader = __atomic_load_n(&slot->reader, __ATOMIC_ACQUIRE);
+    // Reader may belong to a geodb loaded without a teardown in between
+    if (reader != NULL && reader->geodb != geodb) {
+        geodb_reader_destroy(__atomic_exchange_n(&slot->reader, NULL, __ATOMIC_ACQ_REL));
+        reader = NULL;
+    }
+
+    if (reader == NULL && geodb != NULL) {
+        reader = geodb_reader_new(geodb);
+        __atomic_store_n(&slot->reader, reader, __ATOMIC_RELEASE);
+    }
+
+    return reader;
+}
+
+geonames_generic_t *geodb_get_len(char *key, size_t len) {
+    if (geodb == NULL || geodb->hash_reader == NULL) return NULL;
+
+    geodb_reader_t *reader = geodb_thread_reader();
+    if (reader == NULL) return NULL;
+
+    geonames_generic_t *result = geodb_reader_get_len(reader, key, len);
+    if (result == NULL) return NULL;
+
+    geonames_generic_t *generic = malloc(sizeof(geonames_generic_t));
+    if (generic == NULL) return NULL;
+    *generic = *result;
+    return generic;
+}
+
 inline geonames_generic_t *geodb_get(char *key) {
     return geodb_get_len(key, strlen(key));
 }
 
+size_t geodb_num_thread_readers(void) {
+    size_t num_readers = 0;
+
+    pthread_mutex_lock(&geodb_thread_readers_lock);
+    for (geodb_thread_reader_t *slot = geodb_thread_readers; slot != NULL; slot = slot->next) {
+        if (__atomic_load_n(&slot->reader, __ATOMIC_ACQUIRE) != NULL) {
+            num_readers++;
+        }
+    }
+    pthread_mutex_unlock(&geodb_thread_readers_lock);
+
+    return num_readers;
+}
+
 
 
 bool geodb_module_setup(char *dir) {
@@ -238,6 +638,13 @@ bool geodb_module_setup(char *dir) {
 
 
 void geodb_module_teardown(void) {
+    // Readers of all threads, which must not be doing lookups at this point
+    pthread_mutex_lock(&geodb_thread_readers_lock);
+    for (geodb_thread_reader_t *slot = geodb_thread_readers; slot != NULL; slot = slot->next) {
+        geodb_reader_destroy(__atomic_exchange_n(&slot->reader, NULL, __ATOMIC_ACQ_REL));
+    }
+    pthread_mutex_unlock(&geodb_thread_readers_lock);
+
     if (geodb != NULL) {
         geodb_destroy(geodb);
     }
@@ -8,6 +8,7 @@
 #include "libpostal_config.h"
 #include "geonames.h"
 #include "graph.h"
+#include "normalize.h"
 #include "sparkey/sparkey.h"
 #include "sparkey/sparkey-internal.h"
 #include "string_utils.h"
@@ -27,6 +28,10 @@
 #define GEODB_LOG_FILENAME "geodb.spl"
 #define GEODB_LOG_FILENAME_LEN strlen(GEODB_LOG_FILENAME)
 
+// Used both when building the names trie and when looking names up in it
+#define GEODB_NAME_NORMALIZE_OPTIONS (NORMALIZE_STRING_COMPOSE | NORMALIZE_STRING_LOWERCASE | NORMALIZE_STRING_TRIM)
+#define GEODB_POSTAL_CODE_NORMALIZE_OPTIONS NORMALIZE_STRING_LOWERCASE
+
 // Can manipulate the bit-packed values separately, or access the whole value
 typedef union geodb_value {
     uint32_t value;
@@ -37,17 +42,42 @@ typedef union geodb_value {
     };
 } geodb_value_t;
 
+/*
+The geodb itself is read-only after loading: the tries are only read and the
+sparkey hash/log are mmap'd, so a single geodb_t can be shared by any number
+of threads. All mutable lookup state (log iterator, decoded records) lives in
+a geodb_reader_t, of which each thread should own its own.
+*/
 typedef struct geodb {
     trie_t *names;
     trie_t *features;
     cstring_array *postal_codes;
     graph_t *feature_graph;
     sparkey_hashreader *hash_reader;
+} geodb_t;
+
+typedef struct geodb_reader {
+    geodb_t *geodb;
     sparkey_logiter *log_iter;
     char_array *value_buf;
     geoname_t *geoname;
     gn_postal_code_t *postal_code;
-} geodb_t;
+    geonames_generic_t result;
+} geodb_reader_t;
+
+typedef struct geodb_lookup_result {
+    bool found;
+    gn_type type;
+    // For places, the GeoNames id. For postal codes, the id of the containing place if any, otherwise the country
+    uint32_t geonames_id;
+} geodb_lookup_result_t;
+
+typedef struct geodb_name_lookup_result {
+    bool found;
+    // The name's GeoNames ids are ids->a[index] to ids->a[index + count - 1]
+    size_t index;
+    size_t count;
+} geodb_name_lookup_result_t;
 
 typedef struct gn_geocoding_result {
     int start;
@@ -70,7 +100,31 @@ phrase_array *search_geodb(char *str);
 bool search_geodb_tokens_with_phrases(char *str, token_array *tokens, phrase_array **phrases);
 phrase_array *search_geodb_tokens(char *str, token_array *tokens);
 
+// Per-thread readers
+
+geodb_reader_t *geodb_reader_new(geodb_t *geodb);
+void geodb_reader_destroy(geodb_reader_t *self);
+
+// Result is owned by the reader and valid until its next lookup
+geonames_generic_t *geodb_reader_get_len(geodb_reader_t *self, char *key, size_t len);
+geonames_generic_t *geodb_reader_get(geodb_reader_t *self, char *key);
+
+// Resolves n keys to GeoNames ids without fully decoding the records, returns the number found
+size_t geodb_reader_lookup_batch(geodb_reader_t *self, size_t n, char **keys, geodb_lookup_result_t *results);
+
+/*
+Resolves n place names (type=GEONAMES_PLACE) or postal codes (type=GEONAMES_POSTAL_CODE)
+as they appear in an address, e.g. parser output, to the GeoNames ids of every matching
+record, appending them to ids. For postal codes the id is that of the containing place
+if any, otherwise the country. Returns the number of names found.
+*/
+size_t geodb_reader_lookup_names_batch(geodb_reader_t *self, size_t n, char **names, gn_type type, uint32_array *ids, geodb_name_lookup_result_t *results);
+
+// Uses a thread-local reader on the global geodb. Caller frees the returned struct but not its contents
 geonames_generic_t *geodb_get_len(char *key, size_t len);
 geonames_generic_t *geodb_get(char *key);
 
+// Number of threads currently holding a reader on the global geodb
+size_t geodb_num_thread_readers(void);
+
 #endif
\ No newline at end of file
@@ -1,6 +1,8 @@
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 #include <unistd.h>
 
 #include "log/log.h"
@@ -545,257 +547,427 @@ bool geodb_builder_finalize(geodb_builder_t *self, char *output_dir) {
 }
 
 /*
-Read generated geonames.tsv and add to the geodb builder
+Parallel ingestion
+
+Parsing, normalization, msgpack serialization and disambiguation features are
+independent per line, so the input is read in chunks which are processed on
+a pool of worker threads. The results are then merged into the builder in
+input order on the main thread. The merge is what touches shared state (the
+names/features tries, the feature graph and the sparkey log), and doing it in
+input order keeps the name deduplication (which relies on the input being
+sorted by name) and the output files identical to a serial build.
 */
-void import_geonames(geodb_builder_t *self, char *filename) {
-    FILE *f = fopen(filename, "r");
-    if (f == NULL) {
-        printf("Couldn't open file\n");
-        exit(1);
-    }
 
-    char *line;
-    char *prev_name = NULL;
-    geoname_t *g = geoname_new();
+#define GEODB_BUILDER_CHUNK_SIZE 10000
+
+typedef enum {
+    GEODB_BUILDER_GEONAMES,
+    GEODB_BUILDER_POSTAL_CODES
+} geodb_builder_input_type_t;
+
+typedef struct geodb_builder_record {
+    bool valid;
+    bool is_canonical;
+    uint32_t geonames_id;
+    uint32_t boundary_type;
+    uint32_t num_features;
+} geodb_builder_record_t;
+
+VECTOR_INIT(geodb_builder_record_array, geodb_builder_record_t)
+
+typedef struct geodb_builder_chunk {
+    geodb_builder_input_type_t type;
+    cstring_array *lines;
+    geodb_builder_record_array *records;
+    // Normalized name (or postal code) per record
+    cstring_array *names;
+    // Sparkey key per record (postal codes only, GeoNames are keyed by id)
+    cstring_array *keys;
+    // Concatenated serialized values, record i is [value_offsets[i], value_offsets[i + 1])
+    char_array *values;
+    uint32_array *value_offsets;
+    // Flattened disambiguation features, record i has records[i].num_features of them
+    cstring_array *features;
+} geodb_builder_chunk_t;
+
+static void geodb_builder_chunk_destroy(geodb_builder_chunk_t *self) {
+    if (self == NULL) return;
 
-    char_array *serialized = char_array_new();
+    if (self->lines != NULL) {
+        cstring_array_destroy(self->lines);
+    }
 
-    graph_builder_t *features = self->feature_graph_builder;
+    if (self->records != NULL) {
+        geodb_builder_record_array_destroy(self->records);
+    }
 
-    // Just a set of all ids in GeoNames so we only add keys once, takes up < 50MB
-    khash_t(int_set) *all_ids = kh_init(int_set);
+    if (self->names != NULL) {
+        cstring_array_destroy(self->names);
+    }
 
-    khash_t(int_set) *distinct_ids = kh_init(int_set);
+    if (self->keys != NULL) {
+        cstring_array_destroy(self->keys);
+    }
 
-    khiter_t key;
-    int ret;
+    if (self->values != NULL) {
+        char_array_destroy(self->values);
+    }
 
-    cstring_array *geo_features = cstring_array_new();
-    uint32_array *feature_lengths = uint32_array_new();
+    if (self->value_offsets != NULL) {
+        uint32_array_destroy(self->value_offsets);
+    }
 
-    char id_string[INT32_MAX_STRING_SIZE + 1];
+    if (self->features != NULL) {
+        cstring_array_destroy(self->features);
+    }
 
-    int normalize_utf8_options = NORMALIZE_STRING_COMPOSE | NORMALIZE_STRING_LOWERCASE | NORMALIZE_STRING_TRIM;
-    //int normalize_latin_options = normalize_utf8_options | NORMALIZE_STRING_LATIN_ASCII;
+    free(self);
+}
 
-    int i = 0;
-    int ambiguous = 0;
-    int disambiguations = 0;
+static geodb_builder_chunk_t *geodb_builder_chunk_new(geodb_builder_input_type_t type) {
+    geodb_builder_chunk_t *chunk = calloc(1, sizeof(geodb_builder_chunk_t));
+    if (chunk == NULL) return NULL;
+
+    chunk->type = type;
+    chunk->lines = cstring_array_new();
+    chunk->records = geodb_builder_record_array_new_size(GEODB_BUILDER_CHUNK_SIZE);
+    chunk->names = cstring_array_new();
+    chunk->keys = cstring_array_new();
+    chunk->values = char_array_new();
+    chunk->value_offsets = uint32_array_new_size(GEODB_BUILDER_CHUNK_SIZE + 1);
+    chunk->features = cstring_array_new();
+
+    if (chunk->lines == NULL || chunk->records == NULL || chunk->names == NULL || chunk->keys == NULL ||
+        chunk->values == NULL || chunk->value_offsets == NULL || chunk->features == NULL) {
+        geodb_builder_chunk_destroy(chunk);
+        return NULL;
+    }
 
-    while ((line = file_getline(f)) != NULL) {
-        read_geoname_from_line(g, line);
-        char *name = char_array_get_string(g->name);
+    return chunk;
+}
 
-        char *canonical = char_array_get_string(g->canonical);
+static void geodb_builder_chunk_clear(geodb_builder_chunk_t *self) {
+    cstring_array_clear(self->lines);
+    geodb_builder_record_array_clear(self->records);
+    cstring_array_clear(self->names);
+    cstring_array_clear(self->keys);
+    char_array_clear(self->values);
+    uint32_array_clear(self->value_offsets);
+    cstring_array_clear(self->features);
+}
 
-        bool is_canonical = strcmp(name, canonical) == 0;
+// Reads up to GEODB_BUILDER_CHUNK_SIZE lines, returns the number read
+static size_t geodb_builder_chunk_read(geodb_builder_chunk_t *self, FILE *f) {
+    geodb_builder_chunk_clear(self);
 
-        char *utf8_normalized = NULL;
+    char *line;
+    size_t num_lines = 0;
 
-        size_t id_len = sprintf(id_string, "%d", g->geonames_id);
+    while (num_lines < GEODB_BUILDER_CHUNK_SIZE && (line = file_getline(f)) != NULL) {
+        cstring_array_add_string(self->lines, line);
+        free(line);
+        num_lines++;
+    }
 
-        if (name != NULL) {
-            utf8_normalized = normalize_string_utf8(name, normalize_utf8_options);
-        }
+    return num_lines;
+}
 
-        if (utf8_normalized != NULL && (prev_name == NULL || strcmp(utf8_normalized, prev_name) != 0)) {
-            // New name
-            if (!geodb_builder_add_name(self, utf8_normalized, is_canonical, get_address_component(g->type))) {
-                log_error("Error adding geoname %s\n", utf8_normalized);
-                exit(EXIT_FAILURE);
-            }
+static inline void geodb_builder_chunk_add_value(geodb_builder_chunk_t *self, char_array *serialized) {
+    // Includes the NUL terminator, as the serial builder always wrote it to the log
+    char_array_append_len(self->values, serialized->a, serialized->n);
+    uint32_array_push(self->value_offsets, (uint32_t)self->values->n);
+}
 
-            // Only add disambiguation features if there's > 1 id for this name
-            if (kh_size(distinct_ids) > 1) {
-                ambiguous++;
+static void geodb_builder_chunk_process_geonames(geodb_builder_chunk_t *self) {
+    geoname_t *g = geoname_new();
+    char_array *serialized = char_array_new();
+    if (g == NULL || serialized == NULL) {
+        log_error("Could not allocate worker state\n");
+        exit(EXIT_FAILURE);
+    }
 
-                uint32_t string_index = 0;
-                uint32_t lengths_index = 0;
+    int normalize_utf8_options = GEODB_NAME_NORMALIZE_OPTIONS;
 
-                uint32_t geonames_id;
+    uint32_array_push(self->value_offsets, 0);
 
-                kh_foreach_key(distinct_ids, key, {
-                    disambiguations++;
-                    uint32_t length = feature_lengths->a[lengths_index];
-                    for (int i = 0; i < length; i++) {
-                        char *token = cstring_array_get_string(geo_features, string_index);
-                        uint32_t feature_id = geodb_builder_get_feature_id(self, token);
+    size_t num_lines = cstring_array_num_strings(self->lines);
 
-                        graph_builder_add_edge(self->feature_graph_builder, feature_id, geonames_id);
+    for (size_t i = 0; i < num_lines; i++) {
+        char *line = cstring_array_get_string(self->lines, (uint32_t)i);
+        geodb_builder_record_t record = (geodb_builder_record_t){false, false, 0, 0, 0};
 
-                        string_index++;
-                    }
+        char *utf8_normalized = NULL;
+        char_array_clear(serialized);
 
-                    lengths_index++;
-                })
-            }
+        if (read_geoname_from_line(g, line)) {
+            char *name = char_array_get_string(g->name);
+            char *canonical = char_array_get_string(g->canonical);
 
-            uint32_array_clear(feature_lengths);
-            cstring_array_clear(geo_features);
-            kh_clear(int_set, distinct_ids);
+            record.geonames_id = g->geonames_id;
+            record.boundary_type = g->type;
+            record.is_canonical = strcmp(name, canonical) == 0;
 
-        } else if (utf8_normalized != NULL) {
-            key = kh_get(int_set, distinct_ids, g->geonames_id);
-            if (key == kh_end(distinct_ids)) {
-                if (!geodb_builder_add_name(self, utf8_normalized, is_canonical, get_address_component(g->type))) {
-                    log_error("Error adding geoname %s\n", utf8_normalized);
-                    exit(EXIT_FAILURE);
-                }
-            }
-        } else {
-            log_error("normalization failed for name %s\n", name);
-            exit(EXIT_FAILURE);
+            utf8_normalized = normalize_string_utf8(name, normalize_utf8_options);
         }
 
-        char_array_clear(serialized);
+        if (utf8_normalized != NULL && geoname_serialize(g, serialized)) {
+            size_t prev_num_features = cstring_array_num_strings(self->features);
 
-        if (!geoname_serialize(g, serialized)) {
-            log_error("geoname_serialize failed for id=%d\n", g->geonames_id);
-            exit(EXIT_FAILURE);
+            char_array_clear(g->name);
+            char_array_cat(g->name, utf8_normalized);
+
+            record.valid = geodisambig_add_geoname_features(self->features, g);
+            record.num_features = (uint32_t)(cstring_array_num_strings(self->features) - prev_num_features);
         }
 
-        key = kh_get(int_set, all_ids, g->geonames_id);
-        if (key == kh_end(all_ids)) {
+        cstring_array_add_string(self->names, utf8_normalized != NULL ? utf8_normalized : "");
+        geodb_builder_chunk_add_value(self, serialized);
+        geodb_builder_record_array_push(self->records, record);
 
-            if ((sparkey_logwriter_put(self->log_writer, strlen(id_string), (uint8_t *)id_string, serialized->n, (uint8_t *)char_array_get_string(serialized))) != SPARKEY_SUCCESS) {
-                log_error("Error writing to Sparkey with id=%d\n", g->geonames_id);
-                exit(EXIT_FAILURE);
-            }
-
-            key = kh_put(int_set, all_ids, g->geonames_id, &ret);
+        if (utf8_normalized != NULL) {
+            free(utf8_normalized);
         }
+    }
 
-        key = kh_get(int_set, distinct_ids, g->geonames_id);
+    char_array_destroy(serialized);
+    geoname_destroy(g);
+}
 
-        if (key == kh_end(distinct_ids)) {
-            key = kh_put(int_set, distinct_ids, g->geonames_id, &ret);
-            if (ret < 0) {
-                log_error("Error adding id %d to set\n", g->geonames_id);
-                exit(EXIT_FAILURE);
-            }
+static void geodb_builder_chunk_process_postal_codes(geodb_builder_chunk_t *self) {
+    gn_postal_code_t *pc = gn_postal_code_new();
+    char_array *serialized = char_array_new();
+    char_array *key = char_array_new();
+    if (pc == NULL || serialized == NULL || key == NULL) {
+        log_error("Could not allocate worker state\n");
+        exit(EXIT_FAILURE);
+    }
 
-            char_array_clear(g->name);
-            char_array_cat(g->name, utf8_normalized);
+    uint32_array_push(self->value_offsets, 0);
 
-            size_t prev_num_geo_features = cstring_array_num_strings(geo_features);
+    size_t num_lines = cstring_array_num_strings(self->lines);
 
-            if (!geodisambig_add_geoname_features(geo_features, g)) {
-                log_error("Could not add geonames features for id=%d\n", g->geonames_id);
-                exit(EXIT_FAILURE);
-            }
+    for (size_t i = 0; i < num_lines; i++) {
+        char *line = cstring_array_get_string(self->lines, (uint32_t)i);
+        geodb_builder_record_t record = (geodb_builder_record_t){false, true, 0, 0, 0};
 
-            uint32_t num_geo_features = cstring_array_num_strings(geo_features);
-            uint32_t feature_length = (uint32_t)(num_geo_features - prev_num_geo_features);
-            uint32_array_push(feature_lengths, feature_length);
-        }
+        char *utf8_normalized = NULL;
+        char_array_clear(serialized);
+        char_array_clear(key);
 
-        if (prev_name != NULL) {
-            free(prev_name);
-            prev_name = NULL;
+        if (read_gn_postal_code_from_line(pc, line)) {
+            char *code = char_array_get_string(pc->postal_code);
+            utf8_normalized = normalize_string_utf8(code, GEODB_POSTAL_CODE_NORMALIZE_OPTIONS);
         }
 
-        if (utf8_normalized != NULL) {
-            prev_name = utf8_normalized;
-        }
+        if (utf8_normalized != NULL && gn_postal_code_serialize(pc, serialized)) {
+            char *country_code = char_array_get_string(pc->country_code);
+            char_array_cat_joined(key, NAMESPACE_SEPARATOR_CHAR, false, 2, country_code, utf8_normalized);
 
-        free(line);
-        i++;
+            size_t prev_num_features = cstring_array_num_strings(self->features);
+
+            char_array_clear(pc->postal_code);
+            char_array_cat(pc->postal_code, utf8_normalized);
 
-        if (i % 1000 == 0) {
-            log_info("Did %d geonames, %d ambiguous, %d disambiguations, names=%d, features=%d\n", i, ambiguous, disambiguations, self->names->num_keys, self->features->num_keys);
+            record.valid = geodisambig_add_postal_code_features(self->features, pc);
+            record.num_features = (uint32_t)(cstring_array_num_strings(self->features) - prev_num_features);
         }
-    }
 
-    if (prev_name != NULL) {
-        free(prev_name);
+        cstring_array_add_string(self->names, utf8_normalized != NULL ? utf8_normalized : "");
+        cstring_array_add_string(self->keys, char_array_get_string(key));
+        geodb_builder_chunk_add_value(self, serialized);
+        geodb_builder_record_array_push(self->records, record);
+
+        if (utf8_normalized != NULL) {
+            free(utf8_normalized);
+        }
     }
 
-    uint32_array_destroy(feature_lengths);
-    cstring_array_destroy(geo_features);
+    char_array_destroy(key);
+    char_array_destroy(serialized);
+    gn_postal_code_destroy(pc);
+}
 
-    kh_destroy(int_set, distinct_ids);
-    kh_destroy(int_set, all_ids);
+static void *geodb_builder_chunk_worker(void *arg) {
+    geodb_builder_chunk_t *chunk = arg;
 
-    char_array_destroy(serialized);
+    if (chunk->type == GEODB_BUILDER_GEONAMES) {
+        geodb_builder_chunk_process_geonames(chunk);
+    } else {
+        geodb_builder_chunk_process_postal_codes(chunk);
+    }
 
-    geoname_destroy(g);
-    fclose(f);
+    return NULL;
 }
 
+typedef struct geodb_builder_geonames_state {
+    char *prev_name;
+    // Just a set of all ids in GeoNames so we only add keys once, takes up < 50MB
+    khash_t(int_set) *all_ids;
+    khash_t(int_set) *distinct_ids;
+    cstring_array *geo_features;
+    uint32_array *feature_lengths;
+    // GeoNames id of each entry in feature_lengths, in the order the ids were first seen
+    uint32_array *feature_geonames_ids;
+    size_t num_records;
+    size_t ambiguous;
+    size_t disambiguations;
+} geodb_builder_geonames_state_t;
 
 /*
-Read generated postal_codes.tsv and add to the geodb builder
+Link the GeoNames ids seen for the previous name to their features in the
+feature graph. Every id gets an edge from the bare name feature, which is how
+geodb_reader_lookup_names_batch resolves a name to its ids. Only names with
+> 1 id get the rest of the disambiguation features.
 */
-void import_geonames_postal_codes(geodb_builder_t *self, char *filename) {
-    FILE *f = fopen(filename, "r");
-    if (f == NULL) {
-        printf("Couldn't open file\n");
-        exit(1);
+static void geodb_builder_link_geonames_features(geodb_builder_t *self, geodb_builder_geonames_state_t *state) {
+    bool ambiguous = kh_size(state->distinct_ids) > 1;
+    if (ambiguous) {
+        state->ambiguous++;
     }
 
-    char *line;
+    uint32_t string_index = 0;
 
-    char *prev_code = NULL;
-    gn_postal_code_t *pc = gn_postal_code_new();
+    // Not the khash, whose iteration order doesn't match the feature arrays
+    for (size_t k = 0; k < state->feature_geonames_ids->n; k++) {
+        uint32_t distinct_id = state->feature_geonames_ids->a[k];
+        uint32_t length = state->feature_lengths->a[k];
+        // The name feature comes first, see geodisambig_add_geoname_features
+        uint32_t num_linked = ambiguous ? length : (length > 0 ? 1 : 0);
 
-    char_array *postal_code = char_array_new();
-    char_array *serialized = char_array_new();
+        if (ambiguous) {
+            state->disambiguations++;
+        }
+
+        for (uint32_t j = 0; j < num_linked; j++) {
+            char *token = cstring_array_get_string(state->geo_features, string_index + j);
+            uint32_t feature_id = geodb_builder_get_feature_id(self, token);
 
-    cstring_array *postal_code_features = cstring_array_new();
+            graph_builder_add_edge(self->feature_graph_builder, feature_id, distinct_id);
+        }
 
+        string_index += length;
+    }
+
+    uint32_array_clear(state->feature_lengths);
+    uint32_array_clear(state->feature_geonames_ids);
+    cstring_array_clear(state->geo_features);
+    kh_clear(int_set, state->distinct_ids);
+}
+
+/*
+Merge one processed chunk of geonames.tsv into the builder. Same logic as
+a serial pass over the lines, minus the per-line work done by the workers.
+*/
+static void geodb_builder_merge_geonames_chunk(geodb_builder_t *self, geodb_builder_geonames_state_t *state, geodb_builder_chunk_t *chunk) {
     khiter_t key;
     int ret;
 
-    int i = 0;
+    char id_string[INT32_MAX_STRING_SIZE + 1];
 
-    // Always true for postal codes
-    bool is_canonical = true;
+    uint32_t feature_index = 0;
+    size_t num_records = chunk->records->n;
 
-    while ((line = file_getline(f)) != NULL) {
-        if (!read_gn_postal_code_from_line(pc, line)) {
-            log_error("Error reading line: %s\n", line);
-            exit(EXIT_FAILURE);
-        }
+    for (size_t i = 0; i < num_records; i++) {
+        geodb_builder_record_t record = chunk->records->a[i];
+        char *utf8_normalized = cstring_array_get_string(chunk->names, (uint32_t)i);
 
-        char *code = char_array_get_string(pc->postal_code);
-        char *utf8_normalized = normalize_string_utf8(code, NORMALIZE_STRING_LOWERCASE);
-        
-        if (utf8_normalized == NULL) {
-            log_error("normalization failed for postal code %s\n", code);
+        if (!record.valid) {
+            log_error("Error processing geonames line: %s\n", cstring_array_get_string(chunk->lines, (uint32_t)i));
             exit(EXIT_FAILURE);
         }
 
-        geodb_builder_add_name(self, utf8_normalized, is_canonical, GEONAMES_ADDRESS_COMPONENT_POSTCODE);
+        uint32_t geonames_id = record.geonames_id;
+        uint16_t address_components = get_address_component(record.boundary_type);
 
-        char_array_clear(serialized);
-        if (!gn_postal_code_serialize(pc, serialized)) {
-            log_error("gn_postal_code_serialize failed for postal code=%s\n", code);
-            exit(EXIT_FAILURE);
+        if (state->prev_name == NULL || strcmp(utf8_normalized, state->prev_name) != 0) {
+            // New name
+            if (!geodb_builder_add_name(self, utf8_normalized, record.is_canonical, address_components)) {
+                log_error("Error adding geoname %s\n", utf8_normalized);
+                exit(EXIT_FAILURE);
+            }
+
+            geodb_builder_link_geonames_features(self, state);
+        } else {
+            key = kh_get(int_set, state->distinct_ids, geonames_id);
+            if (key == kh_end(state->distinct_ids)) {
+                if (!geodb_builder_add_name(self, utf8_normalized, record.is_canonical, address_components)) {
+                    log_error("Error adding geoname %s\n", utf8_normalized);
+                    exit(EXIT_FAILURE);
+                }
+            }
         }
 
-        char *country_code = char_array_get_string(pc->country_code);
+        key = kh_get(int_set, state->all_ids, geonames_id);
+        if (key == kh_end(state->all_ids)) {
+            sprintf(id_string, "%d", geonames_id);
 
-        char_array_clear(postal_code);
-        char_array_cat_joined(postal_code, NAMESPACE_SEPARATOR_CHAR, false, 2, country_code, utf8_normalized);
+            uint32_t value_offset = chunk->value_offsets->a[i];
+            uint32_t value_len = chunk->value_offsets->a[i + 1] - value_offset;
 
-        char *key = char_array_get_string(postal_code);
-        cstring_array_add_string(self->postal_codes, key);
+            if ((sparkey_logwriter_put(self->log_writer, strlen(id_string), (uint8_t *)id_string, value_len, (uint8_t *)chunk->values->a + value_offset)) != SPARKEY_SUCCESS) {
+                log_error("Error writing to Sparkey with id=%d\n", geonames_id);
+                exit(EXIT_FAILURE);
+            }
 
-        uint32_t postal_code_index = (uint32_t)cstring_array_num_strings(self->postal_codes);
-        cstring_array_clear(postal_code_features);
+            key = kh_put(int_set, state->all_ids, geonames_id, &ret);
+        }
 
-        char_array_clear(pc->postal_code);
-        char_array_cat(pc->postal_code, utf8_normalized);
+        key = kh_get(int_set, state->distinct_ids, geonames_id);
 
-        if (sparkey_logwriter_put(self->log_writer, strlen(key), (uint8_t *)key, serialized->n, (uint8_t *)char_array_get_string(serialized)) != SPARKEY_SUCCESS) {
-            log_error("Error writing key %s to Sparkey\n", key);
+        if (key == kh_end(state->distinct_ids)) {
+            key = kh_put(int_set, state->distinct_ids, geonames_id, &ret);
+            if (ret < 0) {
+                log_error("Error adding id %d to set\n", geonames_id);
+                exit(EXIT_FAILURE);
+            }
+
+            for (uint32_t j = 0; j < record.num_features; j++) {
+                cstring_array_add_string(state->geo_features, cstring_array_get_string(chunk->features, feature_index + j));
+            }
+            uint32_array_push(state->feature_lengths, record.num_features);
+            uint32_array_push(state->feature_geonames_ids, geonames_id);
+        }
+
+        feature_index += record.num_features;
+
+        if (state->prev_name != NULL) {
+            free(state->prev_name);
         }
+        state->prev_name = strdup(utf8_normalized);
+
+        state->num_records++;
+    }
+}
+
+/*
+Merge one processed chunk of postal_codes.tsv into the builder
+*/
+static void geodb_builder_merge_postal_codes_chunk(geodb_builder_t *self, geodb_builder_chunk_t *chunk) {
+    uint32_t feature_index = 0;
+    size_t num_records = chunk->records->n;
+
+    for (size_t i = 0; i < num_records; i++) {
+        geodb_builder_record_t record = chunk->records->a[i];
+        char *utf8_normalized = cstring_array_get_string(chunk->names, (uint32_t)i);
 
-        if (!geodisambig_add_postal_code_features(postal_code_features, pc)) {
-            log_error("Could not add geonames features for postal code=%s\n", code);
+        if (!record.valid) {
+            log_error("Error processing postal codes line: %s\n", cstring_array_get_string(chunk->lines, (uint32_t)i));
             exit(EXIT_FAILURE);
         }
 
+        geodb_builder_add_name(self, utf8_normalized, record.is_canonical, GEONAMES_ADDRESS_COMPONENT_POSTCODE);
+
+        char *key = cstring_array_get_string(chunk->keys, (uint32_t)i);
+        uint32_t postal_code_index = (uint32_t)cstring_array_num_strings(self->postal_codes);
+        cstring_array_add_string(self->postal_codes, key);
+
+        uint32_t value_offset = chunk->value_offsets->a[i];
+        uint32_t value_len = chunk->value_offsets->a[i + 1] - value_offset;
+
+        if (sparkey_logwriter_put(self->log_writer, strlen(key), (uint8_t *)key, value_len, (uint8_t *)chunk->values->a + value_offset) != SPARKEY_SUCCESS) {
+            log_error("Error writing key %s to Sparkey\n", key);
+        }
+
         /*
         In the Geonames case, the column indices in the graph refer to GeoNames ids.
         Since postal codes do not have ids, only names, the indices in the postal code
@@ -804,52 +976,164 @@ void import_geonames_postal_codes(geodb_builder_t *self, char *filename) {
         Since postal code features are namespaced differently, we can do this without
         offsets, etc.
         */
-        for (int i = 0; i < cstring_array_num_strings(postal_code_features); i++) {
-            char *token = cstring_array_get_string(postal_code_features, i);
+        for (uint32_t j = 0; j < record.num_features; j++) {
+            char *token = cstring_array_get_string(chunk->features, feature_index + j);
             uint32_t feature_id = geodb_builder_get_feature_id(self, token);
             graph_builder_add_edge(self->feature_graph_builder, feature_id, postal_code_index);
         }
 
-        if (prev_code != NULL) {
-            free(prev_code);
-            prev_code = NULL;
+        feature_index += record.num_features;
+    }
+}
+
+static double elapsed_seconds(struct timeval start) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (double)(now.tv_sec - start.tv_sec) + (double)(now.tv_usec - start.tv_usec) / 1e6;
+}
+
+/*
+Read a TSV file in rounds of num_threads chunks, process the chunks in
+parallel and merge them in order.
+*/
+static void geodb_builder_import_parallel(geodb_builder_t *self, char *filename, geodb_builder_input_type_t type, size_t num_threads) {
+    FILE *f = fopen(filename, "r");
+    if (f == NULL) {
+        log_error("Couldn't open file %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    if (num_threads == 0) num_threads = 1;
+
+    geodb_builder_chunk_t **chunks = calloc(num_threads, sizeof(geodb_builder_chunk_t *));
+    pthread_t *threads = calloc(num_threads, sizeof(pthread_t));
+    if (chunks == NULL || threads == NULL) {
+        log_error("Could not allocate chunks\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < num_threads; i++) {
+        chunks[i] = geodb_builder_chunk_new(type);
+        if (chunks[i] == NULL) {
+            log_error("Could not allocate chunk\n");
+            exit(EXIT_FAILURE);
         }
+    }
 
-        if (utf8_normalized != NULL) {
-            prev_code = utf8_normalized;
+    geodb_builder_geonames_state_t state = (geodb_builder_geonames_state_t){
+        .prev_name = NULL,
+        .all_ids = kh_init(int_set),
+        .distinct_ids = kh_init(int_set),
+        .geo_features = cstring_array_new(),
+        .feature_lengths = uint32_array_new(),
+        .feature_geonames_ids = uint32_array_new(),
+        .num_records = 0,
+        .ambiguous = 0,
+        .disambiguations = 0
+    };
+
+    struct timeval start;
+    gettimeofday(&start, NULL);
+
+    size_t num_records = 0;
+    bool done = false;
+
+    while (!done) {
+        size_t num_chunks = 0;
+        for (; num_chunks < num_threads; num_chunks++) {
+            if (geodb_builder_chunk_read(chunks[num_chunks], f) == 0) {
+                done = true;
+                break;
+            }
         }
 
-        free(line);
-        i++;
+        if (num_chunks == 0) break;
 
-        if (i % 1000 == 0) {
-            log_info("Did %d postal codes\n", i);
+        for (size_t i = 0; i < num_chunks; i++) {
+            if (pthread_create(&threads[i], NULL, geodb_builder_chunk_worker, chunks[i]) != 0) {
+                log_error("Could not create worker thread\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        for (size_t i = 0; i < num_chunks; i++) {
+            pthread_join(threads[i], NULL);
+        }
+
+        for (size_t i = 0; i < num_chunks; i++) {
+            if (type == GEODB_BUILDER_GEONAMES) {
+                geodb_builder_merge_geonames_chunk(self, &state, chunks[i]);
+            } else {
+                geodb_builder_merge_postal_codes_chunk(self, chunks[i]);
+            }
+            num_records += chunks[i]->records->n;
+        }
+
+        double seconds = elapsed_seconds(start);
+        double records_per_second = seconds > 0.0 ? (double)num_records / seconds : 0.0;
+
+        if (type == GEODB_BUILDER_GEONAMES) {
+            log_info("Did %zu geonames in %.1fs (%.0f/s), %zu ambiguous, %zu disambiguations, names=%d, features=%d\n", num_records, seconds, records_per_second, state.ambiguous, state.disambiguations, self->names->num_keys, self->features->num_keys);
+        } else {
+            log_info("Did %zu postal codes in %.1fs (%.0f/s)\n", num_records, seconds, records_per_second);
         }
     }
 
-    if (prev_code != NULL) {
-        free(prev_code);
+    // The last name is never followed by a new one
+    if (type == GEODB_BUILDER_GEONAMES) {
+        geodb_builder_link_geonames_features(self, &state);
     }
 
-    char_array_destroy(postal_code);
-    char_array_destroy(serialized);
-    cstring_array_destroy(postal_code_features);
+    if (state.prev_name != NULL) {
+        free(state.prev_name);
+    }
 
-    gn_postal_code_destroy(pc);
+    uint32_array_destroy(state.feature_lengths);
+    uint32_array_destroy(state.feature_geonames_ids);
+    cstring_array_destroy(state.geo_features);
+    kh_destroy(int_set, state.distinct_ids);
+    kh_destroy(int_set, state.all_ids);
+
+    for (size_t i = 0; i < num_threads; i++) {
+        geodb_builder_chunk_destroy(chunks[i]);
+    }
+    free(chunks);
+    free(threads);
 
     fclose(f);
 }
 
+/*
+Read generated geonames.tsv and add to the geodb builder
+*/
+void import_geonames(geodb_builder_t *self, char *filename, size_t num_threads) {
+    geodb_builder_import_parallel(self, filename, GEODB_BUILDER_GEONAMES, num_threads);
+}
+
+/*
+Read generated postal_codes.tsv and add to the geodb builder
+*/
+void import_geonames_postal_codes(geodb_builder_t *self, char *filename, size_t num_threads) {
+    geodb_builder_import_parallel(self, filename, GEODB_BUILDER_POSTAL_CODES, num_threads);
+}
+
+static size_t geodb_builder_default_num_threads(void) {
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return num_cpus > 0 ? (size_t)num_cpus : 1;
+}
+
 /*
 Usage with no parameters:
 ./build_geodb
 
 Usage with parameters:
-./build_geodb input_dir output_dir
+./build_geodb input_dir output_dir [num_threads]
 */
 int main(int argc, char **argv) {
     char *input_dir;
     char *output_dir;
+    size_t num_threads = geodb_builder_default_num_threads();
+
     if (argc > 2) {
         input_dir = argv[1];
         output_dir = argv[2];
@@ -858,6 +1142,20 @@ int main(int argc, char **argv) {
         output_dir = LIBPOSTAL_GEODB_DIR;
     }
 
+    if (argc > 3) {
+        long arg_threads = strtol(argv[3], NULL, 10);
+        if (arg_threads <= 0) {
+            log_error("Invalid number of threads: %s\n", argv[3]);
+            exit(EXIT_FAILURE);
+        }
+        num_threads = (size_t)arg_threads;
+    }
+
+    log_info("Building geodb with %zu threads\n", num_threads);
+
+    struct timeval start;
+    gettimeofday(&start, NULL);
+
     char *geonames_filename = "geonames.tsv";
 
     char_array *path = char_array_new_size(strlen(input_dir));
@@ -873,7 +1171,7 @@ int main(int argc, char **argv) {
 
     geodb_builder_t *builder = geodb_builder_new(log_filename);
 
-    import_geonames(builder, geonames_path);
+    import_geonames(builder, geonames_path, num_threads);
 
     free(geonames_path);
     printf("\n\n");
@@ -887,15 +1185,19 @@ int main(int argc, char **argv) {
 
     log_info("Doing postal_codes\n");
 
-    import_geonames_postal_codes(builder, postal_codes_path);
+    import_geonames_postal_codes(builder, postal_codes_path, num_threads);
 
     char_array_destroy(path);
 
+    log_info("Finalizing geodb\n");
+
     if (!geodb_builder_finalize(builder, output_dir)) {
         exit(EXIT_FAILURE);
     }
     geodb_builder_destroy(builder);
 
+    log_info("Built geodb in %.1fs\n", elapsed_seconds(start));
+
     exit(EXIT_SUCCESS);
 
 }
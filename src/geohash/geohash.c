@@ -12,6 +12,10 @@ typedef unsigned __int64 uint64_t;
 #include <stdint.h>
 #endif
 
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
 
 static inline uint16_t interleave(uint8_t upper, uint8_t lower) {
     static const uint16_t map[256] = {
@@ -507,8 +511,8 @@ int geohash_neighbors(char *hashcode, char *dst, size_t dst_length, int *string_
     
     size_t blen = hashcode_length;
 
-    char buffer[blen];
-    memset(buffer, 0, blen);
+    char buffer[blen + 1];
+    memset(buffer, 0, blen + 1);
     
     size_t t = hashcode_length + 1;
     for (unsigned int i=0; i<dst_count; i++) {
@@ -525,3 +529,167 @@ int geohash_neighbors(char *hashcode, char *dst, size_t dst_length, int *string_
     
     return GEOHASH_OK;
 }
+
+
+/**
+ * spread the 32 bits of x over the even bits of a uint64_t and back.
+ * With BMI2 (e.g. -march=native on Haswell or later) these are single
+ * PDEP/PEXT instructions, otherwise the usual shift-and-mask ladders.
+ */
+#define EVEN_BITS_MASK UINT64_C(0x5555555555555555)
+
+static inline uint64_t spread_bits(uint32_t x) {
+#if defined(__BMI2__)
+    return _pdep_u64(x, EVEN_BITS_MASK);
+#else
+    uint64_t v = x;
+    v = (v | (v << 16)) & UINT64_C(0x0000FFFF0000FFFF);
+    v = (v | (v << 8))  & UINT64_C(0x00FF00FF00FF00FF);
+    v = (v | (v << 4))  & UINT64_C(0x0F0F0F0F0F0F0F0F);
+    v = (v | (v << 2))  & UINT64_C(0x3333333333333333);
+    v = (v | (v << 1))  & EVEN_BITS_MASK;
+    return v;
+#endif
+}
+
+static inline uint32_t squash_bits(uint64_t v) {
+#if defined(__BMI2__)
+    return (uint32_t)_pext_u64(v, EVEN_BITS_MASK);
+#else
+    v &= EVEN_BITS_MASK;
+    v = (v | (v >> 1))  & UINT64_C(0x3333333333333333);
+    v = (v | (v >> 2))  & UINT64_C(0x0F0F0F0F0F0F0F0F);
+    v = (v | (v >> 4))  & UINT64_C(0x00FF00FF00FF00FF);
+    v = (v | (v >> 8))  & UINT64_C(0x0000FFFF0000FFFF);
+    v = (v | (v >> 16)) & UINT64_C(0x00000000FFFFFFFF);
+    return (uint32_t)v;
+#endif
+}
+
+/**
+ * longitude takes the odd (first) bits, latitude the even bits.
+ * lon and lat are left-aligned fixed point values.
+ */
+static inline uint64_t interleave64(uint32_t lon, uint32_t lat) {
+    return (spread_bits(lon) << 1) | spread_bits(lat);
+}
+
+static inline int geohash_fixed_point(double latitude, double longitude, uint32_t *lat32, uint32_t *lon32) {
+    uint64_t lat64, lon64;
+
+    while (longitude < -180.0) longitude += 360.0;
+    while (longitude >= 180.0) longitude -= 360.0;
+
+    if (!double_to_i64(latitude/90.0, &lat64) || !double_to_i64(longitude/180.0, &lon64)) {
+        return GEOHASH_INVALIDARGUMENT;
+    }
+
+    // 12 characters only use the top 30 bits of each coordinate
+    *lat32 = (uint32_t)(lat64 >> 32);
+    *lon32 = (uint32_t)(lon64 >> 32);
+    return GEOHASH_OK;
+}
+
+int geohash_encode_uint64(double latitude, double longitude, size_t precision, uint64_t *hash) {
+    if (precision == 0 || precision > GEOHASH_UINT64_MAX_PRECISION || hash == NULL) {
+        return GEOHASH_INVALIDARGUMENT;
+    }
+
+    uint32_t lat32, lon32;
+    int ret = geohash_fixed_point(latitude, longitude, &lat32, &lon32);
+    if (ret != GEOHASH_OK) {
+        return ret;
+    }
+
+    *hash = interleave64(lon32, lat32) >> (64 - precision * 5);
+    return GEOHASH_OK;
+}
+
+size_t geohash_encode_batch(const double *latitudes, const double *longitudes, size_t n, size_t precision, uint64_t *hashes) {
+    if (precision == 0 || precision > GEOHASH_UINT64_MAX_PRECISION) {
+        for (size_t i = 0; i < n; i++) {
+            hashes[i] = GEOHASH_UINT64_INVALID;
+        }
+        return 0;
+    }
+
+    size_t shift = 64 - precision * 5;
+    size_t num_valid = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        uint32_t lat32, lon32;
+        if (geohash_fixed_point(latitudes[i], longitudes[i], &lat32, &lon32) == GEOHASH_OK) {
+            hashes[i] = interleave64(lon32, lat32) >> shift;
+            num_valid++;
+        } else {
+            hashes[i] = GEOHASH_UINT64_INVALID;
+        }
+    }
+
+    return num_valid;
+}
+
+int geohash_neighbors_uint64(uint64_t hash, size_t precision, uint64_t *neighbors, size_t *count) {
+    if (precision == 0 || precision > GEOHASH_UINT64_MAX_PRECISION || neighbors == NULL) {
+        return GEOHASH_INVALIDARGUMENT;
+    }
+
+    unsigned int bitlength = (unsigned int)precision * 5;
+    unsigned int shift = 64 - bitlength;
+    unsigned int lat_len = bitlength/2;
+    unsigned int lon_len = bitlength/2+bitlength%2;
+
+    uint64_t aligned = hash << shift;
+    uint32_t lat = squash_bits(aligned) >> (32 - lat_len);
+    uint32_t lon = squash_bits(aligned >> 1) >> (32 - lon_len);
+
+    uint32_t lat_max = (uint32_t)((UINT64_C(1) << lat_len) - 1);
+    uint32_t lon_mask = (uint32_t)((UINT64_C(1) << lon_len) - 1);
+
+    // latitude doesn't wrap around at the poles, the duplicates cause those rows to be skipped
+    uint32_t lats[3];
+    lats[0] = lat;
+    lats[1] = lat == 0 ? lat : lat - 1;
+    lats[2] = lat == lat_max ? lats[1] : lat + 1;
+
+    uint32_t lons[3] = {lon, (lon - 1) & lon_mask, (lon + 1) & lon_mask};
+
+    size_t neighbor_count = 0;
+    for (unsigned int i=0;i<3;i++) {
+        if (i>0 && lats[i-1] == lats[i]) {
+            continue;
+        }
+        for (unsigned int j=0;j<3;j++) {
+            if (j>0 && lons[j-1] == lons[j]) {
+                continue;
+            }
+            if (i==0 && j==0) {
+                continue;
+            }
+
+            uint64_t neighbor = interleave64(lons[j] << (32 - lon_len), lats[i] << (32 - lat_len));
+            neighbors[neighbor_count++] = neighbor >> shift;
+        }
+    }
+
+    if (count) {
+        *count = neighbor_count;
+    }
+
+    return GEOHASH_OK;
+}
+
+int geohash_uint64_to_string(uint64_t hash, size_t precision, char *dst, size_t dst_length) {
+    static const char *map="0123456789bcdefghjkmnpqrstuvwxyz";
+
+    if (precision == 0 || precision > GEOHASH_UINT64_MAX_PRECISION || dst_length < precision + 1) {
+        return GEOHASH_INVALIDARGUMENT;
+    }
+
+    for (size_t i = 0; i < precision; i++) {
+        dst[i] = map[(hash >> ((precision - 1 - i) * 5)) & 0x1F];
+    }
+    dst[precision] = '\0';
+
+    return GEOHASH_OK;
+}
@@ -24,6 +24,7 @@ THE SOFTWARE.
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 
  
 
@@ -40,6 +41,21 @@ int geohash_encode(double latitude, double longitude, char* r, size_t capacity);
 int geohash_decode(char* r, size_t length, double *latitude, double *longitude);
 int geohash_neighbors(char *hashcode, char* dst, size_t dst_length, int *string_count);
 
+/*
+  Integer geohashes: the first 5 * precision interleaved bits of the
+  geohash, right-aligned in a uint64_t. Neighbors are computed on the
+  integers directly and converted to base32 only when a string is needed.
+*/
+#define GEOHASH_UINT64_MAX_PRECISION 12
+#define GEOHASH_UINT64_INVALID UINT64_MAX
+
+int geohash_encode_uint64(double latitude, double longitude, size_t precision, uint64_t *hash);
+// Encodes n points, invalid ones are set to GEOHASH_UINT64_INVALID. Returns the number of valid hashes
+size_t geohash_encode_batch(const double *latitudes, const double *longitudes, size_t n, size_t precision, uint64_t *hashes);
+// Writes up to 8 neighbors, in the same order as geohash_neighbors
+int geohash_neighbors_uint64(uint64_t hash, size_t precision, uint64_t *neighbors, size_t *count);
+int geohash_uint64_to_string(uint64_t hash, size_t precision, char *dst, size_t dst_length);
+
  
 
 #endif
\ No newline at end of file
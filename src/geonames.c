@@ -217,6 +217,14 @@ bool geoname_deserialize(geoname_t *self, char_array *str) {
     return geoname_deserialize_ctx(self, &ctx);
 }
 
+bool geoname_deserialize_bytes(geoname_t *self, const uint8_t *data, size_t len) {
+    cmp_ctx_t ctx;
+    msgpack_bytes_t buffer = (msgpack_bytes_t){data, len, 0};
+    cmp_init(&ctx, &buffer, msgpack_const_bytes_reader, NULL);
+
+    return geoname_deserialize_ctx(self, &ctx);
+}
+
 bool geoname_serialize_ctx(geoname_t *self, cmp_ctx_t *ctx) {
 
     if (!cmp_write_uint(ctx, self->geonames_id) ||
@@ -431,6 +439,15 @@ bool gn_postal_code_deserialize(gn_postal_code_t *self, char_array *str) {
     return gn_postal_code_deserialize_ctx(self, &ctx);
 }
 
+bool gn_postal_code_deserialize_bytes(gn_postal_code_t *self, const uint8_t *data, size_t len) {
+    cmp_ctx_t ctx;
+    msgpack_bytes_t buffer = (msgpack_bytes_t){data, len, 0};
+    cmp_init(&ctx, &buffer, msgpack_const_bytes_reader, NULL);
+
+    gn_postal_code_clear(self);
+    return gn_postal_code_deserialize_ctx(self, &ctx);
+}
+
 static bool gn_postal_code_serialize_ctx(gn_postal_code_t *self, cmp_ctx_t *ctx) {
 
     if (!cmp_write_str_or_nil(ctx, self->postal_code) ||
@@ -69,6 +69,8 @@ typedef struct geoname {
 */
 geoname_t *geoname_new(void);
 bool geoname_deserialize(geoname_t *self, char_array *str);
+// Deserialize directly from a read-only buffer (e.g. mmap'd data) without copying it first
+bool geoname_deserialize_bytes(geoname_t *self, const uint8_t *data, size_t len);
 bool geoname_serialize(geoname_t *self, char_array *str);
 void geoname_print(geoname_t *self);
 void geoname_clear(geoname_t *self);
@@ -92,6 +94,7 @@ typedef struct gn_postal_code {
 
 gn_postal_code_t *gn_postal_code_new(void);
 bool gn_postal_code_deserialize(gn_postal_code_t *self, char_array *str);
+bool gn_postal_code_deserialize_bytes(gn_postal_code_t *self, const uint8_t *data, size_t len);
 bool gn_postal_code_serialize(gn_postal_code_t *self, char_array *str);
 void gn_postal_code_print(gn_postal_code_t *self);
 void gn_postal_code_clear(gn_postal_code_t *self);
@@ -86,7 +86,8 @@ graph_t *graph_builder_finalize(graph_builder_t *self, bool sort_edges, bool rem
 }
 
 void graph_builder_add_edge(graph_builder_t *self, uint32_t v1, uint32_t v2) {
-    if (v1 == v2) return;
+    // In a bipartite graph v1 and v2 index different vertex sets, so equal ids are not a self-loop
+    if (v1 == v2 && self->type != GRAPH_BIPARTITE) return;
     graph_edge_t edge;
 
     if (self->type != GRAPH_UNDIRECTED || v2 > v1) {
@@ -0,0 +1,190 @@
+#include <string.h>
+#include <inttypes.h>
+
+#include "huge_pages.h"
+#include "file_utils.h"
+#include "log/log.h"
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#define HAVE_HUGE_PAGES
+#endif
+
+#define HUGE_PAGES_SMAPS_PATH "/proc/self/smaps"
+
+huge_pages_t *huge_pages_new(uint64_t options) {
+    huge_pages_t *self = calloc(1, sizeof(huge_pages_t));
+    if (self == NULL) return NULL;
+
+    self->options = options;
+    self->regions = uint64_array_new();
+    if (self->regions == NULL) {
+        free(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+bool huge_pages_remap(huge_pages_t *self, void **ptr, size_t size, size_t elem_size, size_t *capacity) {
+#ifdef HAVE_HUGE_PAGES
+    if (self == NULL || ptr == NULL || *ptr == NULL || size == 0) return false;
+
+    void *data = *ptr;
+
+    if ((self->options & HUGE_PAGES_ADVISE) && size >= HUGE_PAGE_SIZE) {
+        size_t alloc_size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        void *moved = NULL;
+
+        if (posix_memalign(&moved, HUGE_PAGE_SIZE, alloc_size) == 0) {
+            // Advise before touching the memory so the copy faults in huge pages
+            if (madvise(moved, alloc_size, MADV_HUGEPAGE) != 0) {
+                log_debug("madvise(MADV_HUGEPAGE) failed\n");
+            }
+            memcpy(moved, data, size);
+            free(data);
+
+            data = moved;
+            *ptr = moved;
+            if (capacity != NULL && elem_size > 0) {
+                *capacity = alloc_size / elem_size;
+            }
+
+            self->num_arrays++;
+            self->moved_bytes += alloc_size;
+            uint64_array_push(self->regions, (uint64_t)(uintptr_t)moved);
+            uint64_array_push(self->regions, (uint64_t)alloc_size);
+        }
+    }
+
+    if (self->options & HUGE_PAGES_MLOCK) {
+        if (mlock(data, size) == 0) {
+            self->locked_bytes += size;
+        } else {
+            log_debug("mlock of %zu bytes failed\n", size);
+        }
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+void huge_pages_remap_trie(huge_pages_t *self, trie_t *trie) {
+    if (self == NULL || trie == NULL) return;
+
+    huge_pages_remap_array(self, trie->nodes);
+    huge_pages_remap_array(self, trie->data);
+    huge_pages_remap_array(self, trie->tail);
+
+    succinct_trie_t *succinct = trie->succinct;
+    if (succinct != NULL) {
+        huge_pages_remap_array(self, succinct->labels);
+        huge_pages_remap_array(self, succinct->has_child->bits);
+        huge_pages_remap_array(self, succinct->has_child->ranks);
+        huge_pages_remap_array(self, succinct->has_child->selects);
+        huge_pages_remap_array(self, succinct->louds->bits);
+        huge_pages_remap_array(self, succinct->louds->ranks);
+        huge_pages_remap_array(self, succinct->louds->selects);
+        huge_pages_remap_array(self, succinct->values);
+        huge_pages_remap_array(self, succinct->tail_offsets);
+        huge_pages_remap_array(self, succinct->tail);
+    }
+}
+
+void huge_pages_remap_sparse_matrix(huge_pages_t *self, sparse_matrix_t *matrix) {
+    if (self == NULL || matrix == NULL) return;
+
+    huge_pages_remap_array(self, matrix->indptr);
+    huge_pages_remap_array(self, matrix->indices);
+    huge_pages_remap_array(self, matrix->data);
+}
+
+void huge_pages_remap_double_matrix(huge_pages_t *self, double_matrix_t *matrix) {
+    if (self == NULL || matrix == NULL) return;
+
+    huge_pages_remap(self, (void **)&matrix->values, matrix->m * matrix->n * sizeof(double), sizeof(double), NULL);
+}
+
+void huge_pages_remap_blocked_bloom_filter(huge_pages_t *self, blocked_bloom_filter_t *filter) {
+    if (self == NULL || filter == NULL) return;
+
+    huge_pages_remap(self, (void **)&filter->blocks, filter->num_blocks * BLOCKED_BLOOM_FILTER_BLOCK_SIZE, BLOCKED_BLOOM_FILTER_BLOCK_SIZE, NULL);
+}
+
+void huge_pages_remap_crf(huge_pages_t *self, crf_t *crf) {
+    if (self == NULL || crf == NULL) return;
+
+    huge_pages_remap_trie(self, crf->state_features);
+    huge_pages_remap_blocked_bloom_filter(self, crf->state_features_filter);
+    huge_pages_remap_sparse_matrix(self, crf->weights);
+    huge_pages_remap_trie(self, crf->state_trans_features);
+    huge_pages_remap_sparse_matrix(self, crf->state_trans_weights);
+    huge_pages_remap_double_matrix(self, crf->trans_weights);
+}
+
+void huge_pages_remap_averaged_perceptron(huge_pages_t *self, averaged_perceptron_t *perceptron) {
+    if (self == NULL || perceptron == NULL) return;
+
+    huge_pages_remap_trie(self, perceptron->features);
+    huge_pages_remap_blocked_bloom_filter(self, perceptron->feature_filter);
+    huge_pages_remap_sparse_matrix(self, perceptron->weights);
+}
+
+/*
+smaps reports AnonHugePages per mapping. Adjacent anonymous mappings can be
+merged by the kernel, so a mapping's huge pages are attributed to the moved
+regions in proportion to the overlap, which makes this an estimate.
+*/
+size_t huge_pages_resident_bytes(huge_pages_t *self) {
+#ifdef HAVE_HUGE_PAGES
+    if (self == NULL || self->regions->n == 0) return 0;
+
+    FILE *f = fopen(HUGE_PAGES_SMAPS_PATH, "r");
+    if (f == NULL) return 0;
+
+    double total = 0.0;
+    uint64_t start = 0, end = 0;
+    uint64_t overlap = 0;
+    char *line;
+
+    while ((line = file_getline(f)) != NULL) {
+        uint64_t line_start, line_end;
+        uint64_t huge_kb;
+
+        if (sscanf(line, "%" SCNx64 "-%" SCNx64 " ", &line_start, &line_end) == 2) {
+            start = line_start;
+            end = line_end;
+            overlap = 0;
+
+            for (size_t i = 0; i + 1 < self->regions->n; i += 2) {
+                uint64_t region_start = self->regions->a[i];
+                uint64_t region_end = region_start + self->regions->a[i + 1];
+                uint64_t lo = region_start > start ? region_start : start;
+                uint64_t hi = region_end < end ? region_end : end;
+                if (hi > lo) overlap += hi - lo;
+            }
+        } else if (overlap > 0 && end > start && sscanf(line, "AnonHugePages: %" SCNu64 " kB", &huge_kb) == 1) {
+            total += (double)huge_kb * 1024.0 * ((double)overlap / (double)(end - start));
+        }
+
+        free(line);
+    }
+
+    fclose(f);
+    return (size_t)total;
+#else
+    return 0;
+#endif
+}
+
+void huge_pages_destroy(huge_pages_t *self) {
+    if (self == NULL) return;
+
+    if (self->regions != NULL) {
+        uint64_array_destroy(self->regions);
+    }
+
+    free(self);
+}
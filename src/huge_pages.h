@@ -0,0 +1,68 @@
+/*
+huge_pages.h
+------------
+
+Moves large, randomly accessed model arrays (trie nodes, sparse matrix
+weights, feature filters) onto transparent huge pages after they are loaded.
+Each array of at least HUGE_PAGE_SIZE bytes is copied into a 2MB-aligned
+allocation which is advised with madvise(MADV_HUGEPAGE) before the copy, so
+the pages are faulted in as huge pages by the copy itself. Optionally the
+arrays are also mlock'd so they stay resident.
+
+Moved arrays remain ordinary heap allocations and are released by the usual
+destroy functions. On platforms without madvise/mlock everything is a no-op.
+
+The huge_pages_t context records the moved regions so that
+huge_pages_resident_bytes can report, from /proc/self/smaps, how much of them
+the kernel actually placed on huge pages.
+*/
+
+#ifndef HUGE_PAGES_H
+#define HUGE_PAGES_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "averaged_perceptron.h"
+#include "bloom.h"
+#include "collections.h"
+#include "crf.h"
+#include "matrix.h"
+#include "sparse_matrix.h"
+#include "succinct_trie.h"
+#include "trie.h"
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+#define HUGE_PAGES_ADVISE (1 << 0)
+#define HUGE_PAGES_MLOCK (1 << 1)
+
+typedef struct huge_pages {
+    uint64_t options;
+    size_t num_arrays;
+    size_t moved_bytes;
+    size_t locked_bytes;
+    uint64_array *regions;  // start, length pairs of the moved arrays
+} huge_pages_t;
+
+huge_pages_t *huge_pages_new(uint64_t options);
+
+// Moves/locks one array in place. capacity (in elements) may be NULL for fixed-size arrays
+bool huge_pages_remap(huge_pages_t *self, void **ptr, size_t size, size_t elem_size, size_t *capacity);
+
+#define huge_pages_remap_array(self, array) huge_pages_remap((self), (void **)&(array)->a, (array)->n * sizeof(*(array)->a), sizeof(*(array)->a), &(array)->m)
+
+void huge_pages_remap_trie(huge_pages_t *self, trie_t *trie);
+void huge_pages_remap_sparse_matrix(huge_pages_t *self, sparse_matrix_t *matrix);
+void huge_pages_remap_double_matrix(huge_pages_t *self, double_matrix_t *matrix);
+void huge_pages_remap_blocked_bloom_filter(huge_pages_t *self, blocked_bloom_filter_t *filter);
+void huge_pages_remap_crf(huge_pages_t *self, crf_t *crf);
+void huge_pages_remap_averaged_perceptron(huge_pages_t *self, averaged_perceptron_t *perceptron);
+
+// Bytes of the moved arrays currently backed by huge pages (Linux only, 0 elsewhere)
+size_t huge_pages_resident_bytes(huge_pages_t *self);
+
+void huge_pages_destroy(huge_pages_t *self);
+
+#endif
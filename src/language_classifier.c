@@ -3,6 +3,7 @@
 #include <float.h>
 
 #include "language_features.h"
+#include "logistic.h"
 #include "minibatch.h"
 #include "normalize.h"
 #include "token_types.h"
@@ -10,6 +11,8 @@
 
 #define LANGUAGE_CLASSIFIER_SIGNATURE 0xCCCCCCCC
 #define LANGUAGE_CLASSIFIER_SPARSE_SIGNATURE 0xC0C0C0C0
+#define LANGUAGE_CLASSIFIER_HASHED_SIGNATURE 0xCCCCCCC1
+#define LANGUAGE_CLASSIFIER_HASHED_SPARSE_SIGNATURE 0xC0C0C0C1
 
 #define LANGUAGE_CLASSIFIER_SETUP_ERROR "language_classifier not loaded, run libpostal_setup_language_classifier()\n"
 
@@ -59,6 +62,201 @@ void language_classifier_response_destroy(libpostal_language_classifier_response
     free(self);
 }
 
+typedef struct language_classifier_scores {
+    language_classifier_t *classifier;
+    double *scores;
+} language_classifier_scores_t;
+
+static inline void language_classifier_add_feature_id_scores(language_classifier_t *classifier, uint32_t feature_id, double count, double *scores) {
+    size_t n = classifier->num_labels;
+    size_t j;
+
+    if (classifier->weights_type == MATRIX_DENSE) {
+        double_matrix_t *weights = classifier->weights.dense;
+        if (feature_id >= weights->m) return;
+        double *row = double_matrix_get_row(weights, feature_id);
+        for (j = 0; j < n; j++) {
+            scores[j] += count * row[j];
+        }
+    } else if (classifier->weights_type == MATRIX_SPARSE) {
+        sparse_matrix_t *weights = classifier->weights.sparse;
+        if (feature_id >= weights->m) return;
+        uint32_t *indptr = weights->indptr->a;
+        uint32_t *indices = weights->indices->a;
+        double *data = weights->data->a;
+        for (j = indptr[feature_id]; j < indptr[feature_id + 1]; j++) {
+            scores[indices[j]] += count * data[j];
+        }
+    }
+}
+
+/*
+Feature sink for inference. Equivalent to building the sparse feature vector
+and multiplying by the weights, since x * W is linear in the feature counts,
+but each feature is looked up and accumulated as soon as it's generated.
+*/
+static void language_classifier_add_feature_scores(void *data, char *feature, double count) {
+    language_classifier_scores_t *scores = data;
+    language_classifier_t *classifier = scores->classifier;
+    uint32_t feature_id;
+
+    if (classifier->features == NULL) {
+        // Hashed feature ids are offset by one for the bias unit, as in feature_matrix_hashed
+        feature_id = feature_hash_id(feature, classifier->hash_seed, classifier->hash_bits) + 1;
+    } else if (!trie_get_data(classifier->features, feature, &feature_id)) {
+        return;
+    }
+
+    language_classifier_add_feature_id_scores(scores->classifier, feature_id, count, scores->scores);
+}
+
+/*
+Partial selection of the top labels by probability. The response only includes
+labels with prob > min_prob (plus the best label), and min_prob >= MIN_PROB,
+so there can be at most 1 / MIN_PROB of them and a bounded insertion sort
+is much cheaper than sorting all of the labels.
+*/
+static size_t language_classifier_top_k(double *probs, size_t n, double min_prob, size_t *indices, size_t k) {
+    size_t num_indices = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        double prob = probs[i];
+        // Below the threshold and not the best label, can never be returned
+        if (num_indices > 0 && prob <= min_prob && prob <= probs[indices[0]]) continue;
+
+        if (num_indices == k && prob <= probs[indices[k - 1]]) continue;
+
+        size_t j = num_indices < k ? num_indices++ : k - 1;
+        while (j > 0 && probs[indices[j - 1]] < prob) {
+            indices[j] = indices[j - 1];
+            j--;
+        }
+        indices[j] = i;
+    }
+
+    // Keep the best label plus any others above the threshold
+    size_t num_languages = num_indices > 0 ? 1 : 0;
+    while (num_languages < num_indices && probs[indices[num_languages]] > min_prob) {
+        num_languages++;
+    }
+
+    return num_languages;
+}
+
+typedef struct script_language_hint {
+    script_t script;
+    char *language;
+} script_language_hint_t;
+
+// Scripts which identify the language when mixed with Han characters
+static script_language_hint_t han_script_language_hints[] = {
+    {SCRIPT_HIRAGANA, "ja"},
+    {SCRIPT_KATAKANA, "ja"},
+    {SCRIPT_HANGUL, "ko"}
+};
+
+#define NUM_HAN_SCRIPT_LANGUAGE_HINTS (sizeof(han_script_language_hints) / sizeof(han_script_language_hints[0]))
+
+// Updated concurrently by callers on any thread
+static uint64_t script_classifier_num_calls = 0;
+static uint64_t script_classifier_num_hits = 0;
+
+static char *han_script_language_hint(script_t script) {
+    for (size_t i = 0; i < NUM_HAN_SCRIPT_LANGUAGE_HINTS; i++) {
+        if (han_script_language_hints[i].script == script) {
+            return han_script_language_hints[i].language;
+        }
+    }
+    return NULL;
+}
+
+static inline bool is_script_neutral(script_t script) {
+    return script == SCRIPT_UNKNOWN || script == SCRIPT_COMMON || script == SCRIPT_INHERITED;
+}
+
+/*
+Pre-classifier for strings whose language is determined by the script alone,
+e.g. all Greek, Thai or Hangul (possibly with digits/punctuation). Han by
+itself is not enough to distinguish Chinese from Japanese, but Han mixed with
+kana or Hangul is. Returns NULL whenever the model needs to decide.
+*/
+libpostal_language_classifier_response_t *classify_languages_script(char *address) {
+    if (address == NULL) return NULL;
+
+    __atomic_fetch_add(&script_classifier_num_calls, 1, __ATOMIC_RELAXED);
+
+    size_t len = strlen(address);
+    size_t consumed = 0;
+    char *str = address;
+
+    script_t script = SCRIPT_UNKNOWN;
+    bool have_han = false;
+
+    while (consumed < len) {
+        string_script_t str_script = get_string_script(str, len - consumed);
+        if (str_script.len == 0) {
+            return NULL;
+        }
+
+        if (str_script.script == SCRIPT_HAN) {
+            have_han = true;
+        } else if (!is_script_neutral(str_script.script)) {
+            if (script != SCRIPT_UNKNOWN && script != str_script.script) {
+                return NULL;
+            }
+            script = str_script.script;
+        }
+
+        consumed += str_script.len;
+        str += str_script.len;
+    }
+
+    if (script == SCRIPT_UNKNOWN) {
+        return NULL;
+    }
+
+    char *language = NULL;
+
+    if (have_han) {
+        language = han_script_language_hint(script);
+    } else {
+        script_languages_t script_langs = get_script_languages(script);
+        if (script_langs.num_languages == 1) {
+            language = script_langs.languages[0];
+        }
+    }
+
+    if (language == NULL) {
+        return NULL;
+    }
+
+    libpostal_language_classifier_response_t *response = malloc(sizeof(libpostal_language_classifier_response_t));
+    if (response == NULL) return NULL;
+
+    response->languages = malloc(sizeof(char *));
+    response->probs = malloc(sizeof(double));
+    if (response->languages == NULL || response->probs == NULL) {
+        language_classifier_response_destroy(response);
+        return NULL;
+    }
+
+    response->num_languages = 1;
+    response->languages[0] = language;
+    response->probs[0] = 1.0;
+
+    __atomic_fetch_add(&script_classifier_num_hits, 1, __ATOMIC_RELAXED);
+
+    return response;
+}
+
+uint64_t classify_languages_script_num_calls(void) {
+    return __atomic_load_n(&script_classifier_num_calls, __ATOMIC_RELAXED);
+}
+
+uint64_t classify_languages_script_num_hits(void) {
+    return __atomic_load_n(&script_classifier_num_hits, __ATOMIC_RELAXED);
+}
+
 libpostal_language_classifier_response_t *classify_languages(char *address) {
     language_classifier_t *classifier = get_language_classifier();
     
@@ -68,85 +266,65 @@ libpostal_language_classifier_response_t *classify_languages(char *address) {
     }
 
     char *normalized = language_classifier_normalize_string(address);
+    if (normalized == NULL) {
+        return NULL;
+    }
 
-    token_array *tokens = token_array_new();
-    char_array *feature_array = char_array_new();
-
-    khash_t(str_double) *feature_counts = extract_language_features(normalized, NULL, tokens, feature_array);
-    if (feature_counts == NULL || kh_size(feature_counts) == 0) {
-        token_array_destroy(tokens);
-        char_array_destroy(feature_array);
-        if (feature_counts != NULL) {
-            kh_destroy(str_double, feature_counts);
-        }
+    size_t n = classifier->num_labels;
+    double *predictions = calloc(n, sizeof(double));
+    if (predictions == NULL) {
         free(normalized);
         return NULL;
     }
 
-    sparse_matrix_t *x = feature_vector(classifier->features, feature_counts);
+    token_array *tokens = token_array_new();
+    char_array *feature_array = char_array_new();
 
-    size_t n = classifier->num_labels;
-    double_matrix_t *p_y = double_matrix_new_zeros(1, n);
+    // Bias unit
+    language_classifier_add_feature_id_scores(classifier, BIAS_FEATURE_ID, 1.0, predictions);
 
-    libpostal_language_classifier_response_t *response = NULL;
-    bool model_exp = false;
-    if (classifier->weights_type == MATRIX_DENSE) {
-        model_exp = logistic_regression_model_expectation(classifier->weights.dense, x, p_y);
-    } else if (classifier->weights_type == MATRIX_SPARSE) {
-        model_exp = logistic_regression_model_expectation_sparse(classifier->weights.sparse, x, p_y);
+    language_classifier_scores_t scores = (language_classifier_scores_t){classifier, predictions};
+    language_feature_sink_t sink = (language_feature_sink_t){language_classifier_add_feature_scores, &scores, 0};
+
+    size_t num_features = extract_language_features_sink(normalized, NULL, tokens, feature_array, &sink);
+
+    token_array_destroy(tokens);
+    char_array_destroy(feature_array);
+    free(normalized);
+
+    if (num_features == 0) {
+        free(predictions);
+        return NULL;
     }
 
-    if (model_exp) {
-        double *predictions = double_matrix_get_row(p_y, 0);
-        size_t *indices = double_array_argsort(predictions, n);
-        size_t num_languages = 0;
-        size_t i;
-        double prob;
+    softmax_vector(predictions, n);
 
-        double min_prob = 1.0 / n;
-        if (min_prob < MIN_PROB) min_prob = MIN_PROB;
+    double min_prob = 1.0 / n;
+    if (min_prob < MIN_PROB) min_prob = MIN_PROB;
 
-        for (i = 0; i < n; i++) {
-            size_t idx = indices[n - i - 1];
-            prob = predictions[idx];
+    size_t max_languages = (size_t)(1.0 / MIN_PROB) + 1;
+    if (max_languages > n) max_languages = n;
 
-            if (i == 0 || prob > min_prob) {
-                num_languages++;
-            } else {
-                break;
-            }
-        }
-        char **languages = malloc(sizeof(char *) * num_languages);
-        double *probs = malloc(sizeof(double) * num_languages);
-
-        for (i = 0; i < num_languages; i++) {
-            size_t idx = indices[n - i - 1];
-            char *lang = cstring_array_get_string(classifier->labels, (uint32_t)idx);
-            prob = predictions[idx];
-            languages[i] = lang;
-            probs[i] = prob;
-        }
+    size_t indices[max_languages];
+    size_t num_languages = language_classifier_top_k(predictions, n, min_prob, indices, max_languages);
 
-        free(indices);
+    char **languages = malloc(sizeof(char *) * num_languages);
+    double *probs = malloc(sizeof(double) * num_languages);
 
-        response = malloc(sizeof(libpostal_language_classifier_response_t));
-        response->num_languages = num_languages;
-        response->languages = languages;
-        response->probs = probs;
+    for (size_t i = 0; i < num_languages; i++) {
+        size_t idx = indices[i];
+        languages[i] = cstring_array_get_string(classifier->labels, (uint32_t)idx);
+        probs[i] = predictions[idx];
     }
 
-    sparse_matrix_destroy(x);
-    double_matrix_destroy(p_y);
-    token_array_destroy(tokens);
-    char_array_destroy(feature_array);
-    const char *key;
-    kh_foreach_key(feature_counts, key, {
-        free((char *)key);
-    })
-    kh_destroy(str_double, feature_counts);
-    free(normalized);
-    return response;
+    free(predictions);
+
+    libpostal_language_classifier_response_t *response = malloc(sizeof(libpostal_language_classifier_response_t));
+    response->num_languages = num_languages;
+    response->languages = languages;
+    response->probs = probs;
 
+    return response;
 }
 
 language_classifier_t *language_classifier_read(FILE *f) {
@@ -159,7 +337,10 @@ language_classifier_t *language_classifier_read(FILE *f) {
         goto exit_file_read;
     }
 
-    if (signature != LANGUAGE_CLASSIFIER_SIGNATURE && signature != LANGUAGE_CLASSIFIER_SPARSE_SIGNATURE) {
+    bool hashed = signature == LANGUAGE_CLASSIFIER_HASHED_SIGNATURE || signature == LANGUAGE_CLASSIFIER_HASHED_SPARSE_SIGNATURE;
+    bool sparse = signature == LANGUAGE_CLASSIFIER_SPARSE_SIGNATURE || signature == LANGUAGE_CLASSIFIER_HASHED_SPARSE_SIGNATURE;
+
+    if (signature != LANGUAGE_CLASSIFIER_SIGNATURE && signature != LANGUAGE_CLASSIFIER_SPARSE_SIGNATURE && !hashed) {
         goto exit_file_read;
     }
 
@@ -168,11 +349,20 @@ language_classifier_t *language_classifier_read(FILE *f) {
         goto exit_file_read;
     }
 
-    trie_t *features = trie_read(f);
-    if (features == NULL) {
-        goto exit_classifier_created;
+    if (hashed) {
+        // Hashed models store the hash parameters in place of the feature trie
+        if (!file_read_uint32(f, &classifier->hash_bits) ||
+            !file_read_uint32(f, &classifier->hash_seed) ||
+            !feature_hash_valid_bits(classifier->hash_bits)) {
+            goto exit_classifier_created;
+        }
+    } else {
+        trie_t *features = trie_read(f);
+        if (features == NULL) {
+            goto exit_classifier_created;
+        }
+        classifier->features = features;
     }
-    classifier->features = features;
     uint64_t num_features;
     if (!file_read_uint64(f, &num_features)) {
         goto exit_classifier_created;
@@ -204,14 +394,14 @@ language_classifier_t *language_classifier_read(FILE *f) {
     }
     classifier->num_labels = cstring_array_num_strings(classifier->labels);
 
-    if (signature == LANGUAGE_CLASSIFIER_SIGNATURE) {
+    if (!sparse) {
         double_matrix_t *weights = double_matrix_read(f);
         if (weights == NULL) {
             goto exit_classifier_created;
         }
         classifier->weights_type = MATRIX_DENSE;
         classifier->weights.dense = weights;
-    } else if (signature == LANGUAGE_CLASSIFIER_SPARSE_SIGNATURE) {
+    } else {
         sparse_matrix_t *sparse_weights = sparse_matrix_read(f);
         if (sparse_weights == NULL) {
             goto exit_classifier_created;
@@ -245,14 +435,27 @@ language_classifier_t *language_classifier_load(char *path) {
 bool language_classifier_write(language_classifier_t *self, FILE *f) {
     if (f == NULL || self == NULL) return false;
 
-    if (self->weights_type == MATRIX_DENSE && !file_write_uint32(f, LANGUAGE_CLASSIFIER_SIGNATURE)) {
+    bool hashed = self->features == NULL;
+    uint32_t signature;
+    if (self->weights_type == MATRIX_DENSE) {
+        signature = hashed ? LANGUAGE_CLASSIFIER_HASHED_SIGNATURE : LANGUAGE_CLASSIFIER_SIGNATURE;
+    } else {
+        signature = hashed ? LANGUAGE_CLASSIFIER_HASHED_SPARSE_SIGNATURE : LANGUAGE_CLASSIFIER_SPARSE_SIGNATURE;
+    }
+
+    if (!file_write_uint32(f, signature)) {
         return false;
-    } else if (self->weights_type == MATRIX_SPARSE && !file_write_uint32(f, LANGUAGE_CLASSIFIER_SPARSE_SIGNATURE)) {
+    }
+
+    if (hashed) {
+        if (!file_write_uint32(f, self->hash_bits) || !file_write_uint32(f, self->hash_seed)) {
+            return false;
+        }
+    } else if (!trie_write(self->features, f)) {
         return false;
     }
 
-    if (!trie_write(self->features, f) ||
-        !file_write_uint64(f, self->num_features) ||
+    if (!file_write_uint64(f, self->num_features) ||
         !file_write_uint64(f, self->labels->str->n) ||
         !file_write_chars(f, (const char *)self->labels->str->a, self->labels->str->n)) {
         return false;
@@ -9,6 +9,7 @@
 #include "libpostal.h"
 
 #include "collections.h"
+#include "feature_hash.h"
 #include "language_features.h"
 #include "logistic_regression.h"
 #include "matrix.h"
@@ -22,7 +23,9 @@
 typedef struct language_classifier {
     size_t num_labels;
     size_t num_features;
-    trie_t *features;
+    trie_t *features;           // NULL for models trained with feature hashing
+    uint32_t hash_bits;
+    uint32_t hash_seed;
     cstring_array *labels;
     matrix_type_t weights_type;
     union {
@@ -38,6 +41,11 @@ language_classifier_t *get_language_classifier(void);
 language_classifier_t *get_language_classifier_country(void);
 
 libpostal_language_classifier_response_t *classify_languages(char *address);
+
+// Script-only pre-classifier, returns NULL if the script doesn't determine the language
+libpostal_language_classifier_response_t *classify_languages_script(char *address);
+uint64_t classify_languages_script_num_calls(void);
+uint64_t classify_languages_script_num_hits(void);
 void language_classifier_response_destroy(libpostal_language_classifier_response_t *self);
 
 void language_classifier_destroy(language_classifier_t *self);
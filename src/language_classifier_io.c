@@ -5,6 +5,7 @@
 #include "constants.h"
 #include "collections.h"
 #include "language_features.h"
+#include "minibatch.h"
 
 language_classifier_data_set_t *language_classifier_data_set_init(char *filename) {
     language_classifier_data_set_t *data_set = malloc(sizeof(language_classifier_data_set_t));
@@ -94,11 +95,19 @@ void language_classifier_minibatch_destroy(language_classifier_minibatch_t *self
         cstring_array_destroy(self->labels);
     }
 
+    if (self->x != NULL) {
+        sparse_matrix_destroy(self->x);
+    }
+
+    if (self->y != NULL) {
+        uint32_array_destroy(self->y);
+    }
+
     free(self);
 }
 
 language_classifier_minibatch_t *language_classifier_minibatch_new(void) {
-    language_classifier_minibatch_t *minibatch = malloc(sizeof(language_classifier_minibatch_t));
+    language_classifier_minibatch_t *minibatch = calloc(1, sizeof(language_classifier_minibatch_t));
     if (minibatch == NULL) return NULL;
 
     minibatch->features = feature_count_array_new();
@@ -200,4 +209,339 @@ void language_classifier_data_set_destroy(language_classifier_data_set_t *self)
     }
 
     free(self);
-}
\ No newline at end of file
+}
+static void language_classifier_minibatch_slot_clear(language_classifier_minibatch_slot_t *slot) {
+    if (slot->addresses != NULL) {
+        cstring_array_destroy(slot->addresses);
+        slot->addresses = NULL;
+    }
+
+    if (slot->languages != NULL) {
+        cstring_array_destroy(slot->languages);
+        slot->languages = NULL;
+    }
+
+    if (slot->minibatch != NULL) {
+        language_classifier_minibatch_destroy(slot->minibatch);
+        slot->minibatch = NULL;
+    }
+
+    slot->ready = false;
+}
+
+static void *language_classifier_minibatch_reader_read(void *arg) {
+    language_classifier_minibatch_reader_t *self = arg;
+
+    char *line;
+    cstring_array *addresses = NULL;
+    cstring_array *languages = NULL;
+    bool stop = false;
+
+    while (!stop) {
+        line = file_getline(self->f);
+
+        if (line != NULL) {
+            size_t token_count;
+            cstring_array *fields = cstring_array_split(line, TAB_SEPARATOR, TAB_SEPARATOR_LEN, &token_count);
+
+            if (token_count != LANGUAGE_CLASSIFIER_FILE_NUM_TOKENS) {
+                log_error("Token count did not match, expected %d, got %zu, line=%s\n", LANGUAGE_CLASSIFIER_FILE_NUM_TOKENS, token_count, line);
+            }
+            free(line);
+
+            char *language = cstring_array_get_string(fields, LANGUAGE_CLASSIFIER_FIELD_LANGUAGE);
+            char *address = cstring_array_get_string(fields, LANGUAGE_CLASSIFIER_FIELD_ADDRESS);
+
+            if (language != NULL && address != NULL && language_classifier_language_is_valid(language) &&
+                (self->labels == NULL || kh_get(str_uint32, self->labels, language) != kh_end(self->labels))) {
+                if (addresses == NULL) {
+                    addresses = cstring_array_new();
+                    languages = cstring_array_new();
+                }
+                cstring_array_add_string(addresses, address);
+                cstring_array_add_string(languages, language);
+            }
+
+            cstring_array_destroy(fields);
+
+            if (addresses == NULL || cstring_array_num_strings(addresses) < self->batch_size) {
+                continue;
+            }
+        }
+
+        pthread_mutex_lock(&self->lock);
+
+        if (addresses != NULL) {
+            while (!self->stop && self->num_read - self->num_returned >= self->num_slots) {
+                pthread_cond_wait(&self->cond, &self->lock);
+            }
+
+            if (!self->stop) {
+                language_classifier_minibatch_slot_t *slot = self->slots + (self->num_read % self->num_slots);
+                slot->addresses = addresses;
+                slot->languages = languages;
+                self->num_read++;
+                addresses = NULL;
+                languages = NULL;
+            }
+        }
+
+        if (line == NULL) {
+            self->done = true;
+        }
+        stop = self->stop || self->done;
+
+        pthread_cond_broadcast(&self->cond);
+        pthread_mutex_unlock(&self->lock);
+    }
+
+    if (addresses != NULL) {
+        cstring_array_destroy(addresses);
+        cstring_array_destroy(languages);
+    }
+
+    return NULL;
+}
+
+static language_classifier_minibatch_t *language_classifier_minibatch_featurize(language_classifier_minibatch_reader_t *self, cstring_array *addresses, cstring_array *languages, token_array *tokens, char_array *feature_array) {
+    language_classifier_minibatch_t *minibatch = language_classifier_minibatch_new();
+    if (minibatch == NULL) return NULL;
+
+    size_t num_strings = cstring_array_num_strings(addresses);
+
+    for (size_t i = 0; i < num_strings; i++) {
+        char *address = cstring_array_get_string(addresses, i);
+        char *language = cstring_array_get_string(languages, i);
+
+        char *normalized = language_classifier_normalize_string(address);
+        if (normalized == NULL) {
+            normalized = strdup(address);
+            if (normalized == NULL) goto exit_minibatch_created;
+        }
+
+        if (strlen(normalized) == 0) {
+            free(normalized);
+            continue;
+        }
+
+        khash_t(str_double) *feature_counts = extract_language_features(normalized, NULL, tokens, feature_array);
+        if (feature_counts == NULL) {
+            log_error("Could not extract features for: %s\n", normalized);
+            free(normalized);
+            goto exit_minibatch_created;
+        }
+        free(normalized);
+
+        feature_count_array_push(minibatch->features, feature_counts);
+        cstring_array_add_string(minibatch->labels, language);
+    }
+
+    if (minibatch->features->n == 0) {
+        return minibatch;
+    }
+
+    if (self->feature_ids != NULL) {
+        minibatch->x = feature_matrix(self->feature_ids, minibatch->features);
+    } else {
+        minibatch->x = feature_matrix_hashed(self->hash_bits, self->hash_seed, minibatch->features);
+    }
+    if (minibatch->x == NULL) {
+        goto exit_minibatch_created;
+    }
+
+    minibatch->y = label_vector(self->labels, minibatch->labels);
+    if (minibatch->y == NULL) {
+        goto exit_minibatch_created;
+    }
+
+    return minibatch;
+
+exit_minibatch_created:
+    language_classifier_minibatch_destroy(minibatch);
+    return NULL;
+}
+
+static void *language_classifier_minibatch_reader_featurize(void *arg) {
+    language_classifier_minibatch_reader_t *self = arg;
+
+    token_array *tokens = token_array_new();
+    char_array *feature_array = char_array_new();
+
+    pthread_mutex_lock(&self->lock);
+
+    while (true) {
+        while (!self->stop && self->num_claimed == self->num_read && !self->done) {
+            pthread_cond_wait(&self->cond, &self->lock);
+        }
+
+        if (self->stop || self->num_claimed == self->num_read) break;
+
+        language_classifier_minibatch_slot_t *slot = self->slots + (self->num_claimed % self->num_slots);
+        self->num_claimed++;
+
+        cstring_array *addresses = slot->addresses;
+        cstring_array *languages = slot->languages;
+        slot->addresses = NULL;
+        slot->languages = NULL;
+
+        pthread_mutex_unlock(&self->lock);
+
+        language_classifier_minibatch_t *minibatch = language_classifier_minibatch_featurize(self, addresses, languages, tokens, feature_array);
+        cstring_array_destroy(addresses);
+        cstring_array_destroy(languages);
+
+        pthread_mutex_lock(&self->lock);
+
+        if (minibatch == NULL) {
+            log_error("Error featurizing minibatch\n");
+            self->error = true;
+        }
+        slot->minibatch = minibatch;
+        slot->ready = true;
+
+        pthread_cond_broadcast(&self->cond);
+    }
+
+    pthread_mutex_unlock(&self->lock);
+
+    token_array_destroy(tokens);
+    char_array_destroy(feature_array);
+
+    return NULL;
+}
+
+language_classifier_minibatch_reader_t *language_classifier_minibatch_reader_new(char *filename, trie_t *feature_ids, uint32_t hash_bits, uint32_t hash_seed, khash_t(str_uint32) *labels, size_t batch_size, size_t num_threads, size_t max_batches) {
+    if (filename == NULL || labels == NULL || batch_size == 0) return NULL;
+    if (feature_ids == NULL && !feature_hash_valid_bits(hash_bits)) return NULL;
+
+    if (num_threads == 0) num_threads = 1;
+    if (max_batches < num_threads) max_batches = num_threads;
+
+    language_classifier_minibatch_reader_t *self = calloc(1, sizeof(language_classifier_minibatch_reader_t));
+    if (self == NULL) return NULL;
+
+    self->f = fopen(filename, "r");
+    if (self->f == NULL) {
+        free(self);
+        return NULL;
+    }
+
+    self->feature_ids = feature_ids;
+    self->hash_bits = hash_bits;
+    self->hash_seed = hash_seed;
+    self->labels = labels;
+    self->batch_size = batch_size;
+    self->num_slots = max_batches;
+
+    pthread_mutex_init(&self->lock, NULL);
+    pthread_cond_init(&self->cond, NULL);
+
+    self->slots = calloc(max_batches, sizeof(language_classifier_minibatch_slot_t));
+    self->threads = calloc(num_threads, sizeof(pthread_t));
+    if (self->slots == NULL || self->threads == NULL) {
+        language_classifier_minibatch_reader_destroy(self);
+        return NULL;
+    }
+
+    if (pthread_create(&self->reader_thread, NULL, language_classifier_minibatch_reader_read, self) != 0) {
+        language_classifier_minibatch_reader_destroy(self);
+        return NULL;
+    }
+    self->reader_started = true;
+
+    for (size_t i = 0; i < num_threads; i++) {
+        if (pthread_create(&self->threads[i], NULL, language_classifier_minibatch_reader_featurize, self) != 0) {
+            break;
+        }
+        self->num_threads++;
+    }
+
+    if (self->num_threads == 0) {
+        log_error("Could not start featurizer threads\n");
+        language_classifier_minibatch_reader_destroy(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+language_classifier_minibatch_t *language_classifier_minibatch_reader_next(language_classifier_minibatch_reader_t *self) {
+    if (self == NULL) return NULL;
+
+    language_classifier_minibatch_t *minibatch = NULL;
+
+    pthread_mutex_lock(&self->lock);
+
+    while (minibatch == NULL) {
+        language_classifier_minibatch_slot_t *slot = self->slots + (self->num_returned % self->num_slots);
+
+        while (!self->error && !slot->ready && !(self->done && self->num_returned == self->num_read)) {
+            pthread_cond_wait(&self->cond, &self->lock);
+        }
+
+        if (self->error || !slot->ready) break;
+
+        minibatch = slot->minibatch;
+        slot->minibatch = NULL;
+        slot->ready = false;
+        self->num_returned++;
+        pthread_cond_broadcast(&self->cond);
+
+        // Every line in the batch normalized to an empty string
+        if (minibatch->features->n == 0) {
+            language_classifier_minibatch_destroy(minibatch);
+            minibatch = NULL;
+        }
+    }
+
+    pthread_mutex_unlock(&self->lock);
+
+    return minibatch;
+}
+
+bool language_classifier_minibatch_reader_error(language_classifier_minibatch_reader_t *self) {
+    if (self == NULL) return true;
+
+    pthread_mutex_lock(&self->lock);
+    bool error = self->error;
+    pthread_mutex_unlock(&self->lock);
+
+    return error;
+}
+
+void language_classifier_minibatch_reader_destroy(language_classifier_minibatch_reader_t *self) {
+    if (self == NULL) return;
+
+    pthread_mutex_lock(&self->lock);
+    self->stop = true;
+    pthread_cond_broadcast(&self->cond);
+    pthread_mutex_unlock(&self->lock);
+
+    if (self->reader_started) {
+        pthread_join(self->reader_thread, NULL);
+    }
+
+    for (size_t i = 0; i < self->num_threads; i++) {
+        pthread_join(self->threads[i], NULL);
+    }
+
+    if (self->slots != NULL) {
+        for (size_t i = 0; i < self->num_slots; i++) {
+            language_classifier_minibatch_slot_clear(self->slots + i);
+        }
+        free(self->slots);
+    }
+
+    if (self->threads != NULL) {
+        free(self->threads);
+    }
+
+    if (self->f != NULL) {
+        fclose(self->f);
+    }
+
+    pthread_mutex_destroy(&self->lock);
+    pthread_cond_destroy(&self->cond);
+
+    free(self);
+}
@@ -4,13 +4,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <pthread.h>
 
 #include "collections.h"
 #include "features.h"
 #include "file_utils.h"
 #include "language_classifier.h"
 #include "scanner.h"
+#include "sparse_matrix.h"
 #include "string_utils.h"
+#include "trie.h"
 
 #define AMBIGUOUS_LANGUAGE "xxx"
 #define UNKNOWN_LANGUAGE "unk"
@@ -36,8 +39,49 @@ typedef struct language_classifier_data_set {
 typedef struct language_classifier_minibatch {
     feature_count_array *features;
     cstring_array *labels;
+    sparse_matrix_t *x;         // Prepared feature matrix, only set by the minibatch reader
+    uint32_array *y;            // Prepared label vector, only set by the minibatch reader
 } language_classifier_minibatch_t;
 
+/*
+Minibatch reader with a bounded producer/consumer pipeline. A reader thread
+splits the file into batches of raw lines, featurizer threads normalize and
+extract features for whole batches and build the sparse matrix and label
+vector, and the caller receives ready minibatches in file order. At most
+max_batches batches are in flight, so the reader blocks once the caller
+falls behind.
+*/
+
+typedef struct language_classifier_minibatch_slot {
+    cstring_array *addresses;
+    cstring_array *languages;
+    language_classifier_minibatch_t *minibatch;
+    bool ready;
+} language_classifier_minibatch_slot_t;
+
+typedef struct language_classifier_minibatch_reader {
+    FILE *f;
+    trie_t *feature_ids;        // NULL when features are hashed
+    uint32_t hash_bits;
+    uint32_t hash_seed;
+    khash_t(str_uint32) *labels;
+    size_t batch_size;
+    size_t num_slots;
+    language_classifier_minibatch_slot_t *slots;
+    size_t num_read;            // Batches read from the file
+    size_t num_claimed;         // Batches taken by a featurizer
+    size_t num_returned;        // Batches returned to the caller
+    bool done;
+    bool stop;
+    bool error;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool reader_started;
+    pthread_t reader_thread;
+    size_t num_threads;
+    pthread_t *threads;
+} language_classifier_minibatch_reader_t;
+
 language_classifier_data_set_t *language_classifier_data_set_init(char *filename);
 bool language_classifier_data_set_next(language_classifier_data_set_t *self);
 void language_classifier_data_set_destroy(language_classifier_data_set_t *self);
@@ -46,4 +90,11 @@ language_classifier_minibatch_t *language_classifier_data_set_get_minibatch_with
 language_classifier_minibatch_t *language_classifier_data_set_get_minibatch(language_classifier_data_set_t *self, khash_t(str_uint32) *labels);
 void language_classifier_minibatch_destroy(language_classifier_minibatch_t *self);
 
+language_classifier_minibatch_reader_t *language_classifier_minibatch_reader_new(char *filename, trie_t *feature_ids, uint32_t hash_bits, uint32_t hash_seed, khash_t(str_uint32) *labels, size_t batch_size, size_t num_threads, size_t max_batches);
+// Returns the next minibatch (caller destroys it) or NULL at the end of the file or on error
+language_classifier_minibatch_t *language_classifier_minibatch_reader_next(language_classifier_minibatch_reader_t *self);
+// True if reading or featurizing failed, to tell an error apart from the end of the file
+bool language_classifier_minibatch_reader_error(language_classifier_minibatch_reader_t *self);
+void language_classifier_minibatch_reader_destroy(language_classifier_minibatch_reader_t *self);
+
 #endif
\ No newline at end of file
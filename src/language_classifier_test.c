@@ -1,89 +1,306 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "log/log.h"
 #include "address_dictionary.h"
 #include "language_classifier.h"
 #include "language_classifier_io.h"
+#include "language_features.h"
+#include "scanner.h"
 #include "string_utils.h"
 #include "trie_utils.h"
 #include "transliterate.h"
 
+#define LANGUAGE_CLASSIFIER_TEST_BATCH_SIZE 256
+#define LANGUAGE_CLASSIFIER_TEST_LOG_LINES 100000
 
-double test_accuracy(char *filename) {
-    language_classifier_data_set_t *data_set = language_classifier_data_set_init(filename);
-    if (data_set == NULL) {
-        log_error("Error creating data set\n");
-        exit(EXIT_FAILURE);
+/*
+Lines are handed out in batches from a shared file handle. Each worker
+classifies its batches independently and keeps its own counts and latencies,
+which are combined after all the workers have finished.
+*/
+typedef struct language_classifier_test_reader {
+    pthread_mutex_t lock;
+    FILE *f;
+    size_t num_lines;
+    bool done;
+} language_classifier_test_reader_t;
+
+typedef struct language_classifier_test_worker {
+    pthread_t thread;
+    language_classifier_test_reader_t *reader;
+    trie_t *label_ids;
+    size_t correct;
+    size_t total;
+    size_t num_tokens;
+    double_array *latencies;    // Seconds spent in classify_languages per address
+} language_classifier_test_worker_t;
+
+static double language_classifier_test_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static size_t language_classifier_test_reader_read(language_classifier_test_reader_t *reader, cstring_array *lines, size_t max_lines) {
+    cstring_array_clear(lines);
+
+    size_t num_lines = 0;
+
+    pthread_mutex_lock(&reader->lock);
+    while (!reader->done && num_lines < max_lines) {
+        char *line = file_getline(reader->f);
+        if (line == NULL) {
+            reader->done = true;
+            break;
+        }
+        cstring_array_add_string(lines, line);
+        free(line);
+        num_lines++;
     }
 
-    language_classifier_minibatch_t *minibatch;
+    size_t prev_lines = reader->num_lines;
+    reader->num_lines += num_lines;
+    if (reader->num_lines / LANGUAGE_CLASSIFIER_TEST_LOG_LINES > prev_lines / LANGUAGE_CLASSIFIER_TEST_LOG_LINES) {
+        log_info("Read %zu lines\n", reader->num_lines);
+    }
+    pthread_mutex_unlock(&reader->lock);
 
-    uint32_t correct = 0;
-    uint32_t total = 0;
+    return num_lines;
+}
 
-    language_classifier_t *classifier = get_language_classifier();
-    trie_t *label_ids = trie_new_from_cstring_array(classifier->labels);
+static void language_classifier_test_line(language_classifier_test_worker_t *worker, char *line, token_array *tokens) {
+    size_t token_count;
+    cstring_array *fields = cstring_array_split(line, TAB_SEPARATOR, TAB_SEPARATOR_LEN, &token_count);
+    if (fields == NULL) return;
+
+    if (token_count != LANGUAGE_CLASSIFIER_FILE_NUM_TOKENS) {
+        log_error("Token count did not match, expected %d, got %zu, line=%s\n", LANGUAGE_CLASSIFIER_FILE_NUM_TOKENS, token_count, line);
+        goto exit_destroy_fields;
+    }
+
+    char *language = cstring_array_get_string(fields, LANGUAGE_CLASSIFIER_FIELD_LANGUAGE);
+    char *raw_address = cstring_array_get_string(fields, LANGUAGE_CLASSIFIER_FIELD_ADDRESS);
+
+    uint32_t label_id;
+    if (!trie_get_data(worker->label_ids, language, &label_id)) {
+        goto exit_destroy_fields;
+    }
+
+    // Same preprocessing as language_classifier_data_set_next
+    char *address = language_classifier_normalize_string(raw_address);
+    if (address == NULL) {
+        address = strdup(raw_address);
+        if (address == NULL) goto exit_destroy_fields;
+    }
 
-    while (language_classifier_data_set_next(data_set)) {
-        char *address = char_array_get_string(data_set->address);
-        char *language = char_array_get_string(data_set->language);
-        
-        uint32_t label_id;
-        if (!trie_get_data(label_ids, language, &label_id)) {
-            continue;
+    double start_time = language_classifier_test_time();
+    libpostal_language_classifier_response_t *response = classify_languages(address);
+    double_array_push(worker->latencies, language_classifier_test_time() - start_time);
+
+    token_array_clear(tokens);
+    tokenize_add_tokens(tokens, address, strlen(address), false);
+    worker->num_tokens += tokens->n;
+
+    if (response == NULL || response->num_languages == 0) {
+        printf("%s\tNULL\t%s\n", language, address);
+        if (response != NULL) {
+            language_classifier_response_destroy(response);
         }
+        free(address);
+        goto exit_destroy_fields;
+    }
+
+    char *top_lang = response->languages[0];
+
+    if (string_equals(top_lang, language)) {
+        worker->correct++;
+    } else {
+        printf("%s\t%s\t%s\n", language, top_lang, address);
+    }
+
+    worker->total++;
+
+    language_classifier_response_destroy(response);
+    free(address);
 
-        libpostal_language_classifier_response_t *response = classify_languages(address);
-        if (response == NULL || response->num_languages == 0) {
-            printf("%s\tNULL\t%s\n", language, address);
-            continue;
+exit_destroy_fields:
+    cstring_array_destroy(fields);
+}
+
+static void *language_classifier_test_worker_run(void *arg) {
+    language_classifier_test_worker_t *worker = (language_classifier_test_worker_t *)arg;
+
+    cstring_array *lines = cstring_array_new();
+    token_array *tokens = token_array_new();
+
+    if (lines == NULL || tokens == NULL) {
+        log_error("Error allocating test worker\n");
+        goto exit_worker;
+    }
+
+    while (language_classifier_test_reader_read(worker->reader, lines, LANGUAGE_CLASSIFIER_TEST_BATCH_SIZE) > 0) {
+        size_t num_lines = cstring_array_num_strings(lines);
+        for (size_t i = 0; i < num_lines; i++) {
+            char *line = cstring_array_get_string(lines, i);
+            language_classifier_test_line(worker, line, tokens);
         }
+    }
 
-        char *top_lang = response->languages[0];
+exit_worker:
+    if (lines != NULL) {
+        cstring_array_destroy(lines);
+    }
+    if (tokens != NULL) {
+        token_array_destroy(tokens);
+    }
+    return NULL;
+}
+
+static double language_classifier_test_percentile(double_array *sorted, double p) {
+    if (sorted->n == 0) return 0.0;
+    size_t idx = (size_t)(p * (double)(sorted->n - 1) + 0.5);
+    return sorted->a[idx];
+}
+
+double test_accuracy(char *filename, size_t num_threads) {
+    FILE *f = fopen(filename, "r");
+    if (f == NULL) {
+        log_error("Error opening %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    if (num_threads == 0) num_threads = 1;
+
+    language_classifier_t *classifier = get_language_classifier();
+    trie_t *label_ids = trie_new_from_cstring_array(classifier->labels);
+
+    language_classifier_test_reader_t reader = (language_classifier_test_reader_t){
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .f = f,
+        .num_lines = 0,
+        .done = false
+    };
+
+    language_classifier_test_worker_t *workers = calloc(num_threads, sizeof(language_classifier_test_worker_t));
+    if (workers == NULL) {
+        log_error("Error allocating workers\n");
+        exit(EXIT_FAILURE);
+    }
 
-        if (string_equals(top_lang, language)) {
-            correct++;
-        } else {
-            printf("%s\t%s\t%s\n", language, top_lang, address);
+    double start_time = language_classifier_test_time();
+
+    size_t num_started = 0;
+    for (size_t i = 0; i < num_threads; i++) {
+        language_classifier_test_worker_t *worker = &workers[i];
+        worker->reader = &reader;
+        worker->label_ids = label_ids;
+        worker->latencies = double_array_new();
+        if (worker->latencies == NULL || pthread_create(&worker->thread, NULL, language_classifier_test_worker_run, worker) != 0) {
+            log_error("Error starting test thread\n");
+            break;
         }
+        num_started++;
+    }
+
+    if (num_started == 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    size_t correct = 0;
+    size_t total = 0;
+    size_t num_tokens = 0;
+    double_array *latencies = double_array_new();
 
-        total++;
+    for (size_t i = 0; i < num_started; i++) {
+        pthread_join(workers[i].thread, NULL);
+        correct += workers[i].correct;
+        total += workers[i].total;
+        num_tokens += workers[i].num_tokens;
+        double_array_extend(latencies, workers[i].latencies);
+    }
 
-        language_classifier_response_destroy(response);
+    double elapsed = language_classifier_test_time() - start_time;
 
+    for (size_t i = 0; i < num_threads; i++) {
+        if (workers[i].latencies != NULL) {
+            double_array_destroy(workers[i].latencies);
+        }
     }
+    free(workers);
 
-    log_info("total=%" PRIu32 "\n", total);
+    log_info("total=%zu\n", total);
 
+    // Wall-clock throughput includes reading and normalization, latencies only classify_languages
+    log_info("Threads: %zu, time: %.2fs\n", num_started, elapsed);
+    if (elapsed > 0.0) {
+        log_info("Throughput: %.1f addresses/s, %.1f tokens/s\n", (double)latencies->n / elapsed, (double)num_tokens / elapsed);
+    }
+
+    double_array_sort(latencies->a, latencies->n);
+    log_info("Latency per address (us): p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f max=%.1f\n",
+             language_classifier_test_percentile(latencies, 0.5) * 1e6,
+             language_classifier_test_percentile(latencies, 0.9) * 1e6,
+             language_classifier_test_percentile(latencies, 0.99) * 1e6,
+             language_classifier_test_percentile(latencies, 0.999) * 1e6,
+             language_classifier_test_percentile(latencies, 1.0) * 1e6);
+
+    double_array_destroy(latencies);
     trie_destroy(label_ids);
+    pthread_mutex_destroy(&reader.lock);
+    fclose(f);
 
     return (double) correct / total;
+}
 
-
+static size_t language_classifier_test_default_num_threads(void) {
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return num_cpus > 0 ? (size_t)num_cpus : 1;
 }
 
+#define LANGUAGE_CLASSIFIER_TEST_USAGE "Usage: language_classifier_test [dir] filename [--threads number]\n"
 
 int main(int argc, char **argv) {
-    if (argc < 2) {
-        log_error("Usage: language_classifier_test [dir] filename\n");
-        exit(EXIT_FAILURE);
-    }
-
     char *dir = LIBPOSTAL_LANGUAGE_CLASSIFIER_DIR;
     char *filename = NULL;
 
-    if (argc >= 3) {
-        dir = argv[1];
-        filename = argv[2];
+    size_t num_threads = language_classifier_test_default_num_threads();
+    ssize_t arg_threads;
+
+    char *positional[2];
+    size_t num_positional = 0;
+
+    for (int i = 1; i < argc; i++) {
+        char *arg = argv[i];
+        if (string_equals(arg, "--threads")) {
+            if (i + 1 >= argc || sscanf(argv[i + 1], "%zd", &arg_threads) != 1 || arg_threads < 1) {
+                log_error("Bad arg for --threads\n");
+                exit(EXIT_FAILURE);
+            }
+            num_threads = (size_t)arg_threads;
+            i++;
+        } else if (num_positional < 2) {
+            positional[num_positional++] = arg;
+        }
+    }
+
+    if (num_positional == 0) {
+        log_error(LANGUAGE_CLASSIFIER_TEST_USAGE);
+        exit(EXIT_FAILURE);
+    } else if (num_positional == 2) {
+        dir = positional[0];
+        filename = positional[1];
     } else {
-        filename = argv[1];
+        filename = positional[0];
     }
 
     if (!language_classifier_module_setup(dir) || !address_dictionary_module_setup(NULL) || !transliteration_module_setup(NULL)) {
         log_error("Error setting up classifier\n");
     }
 
-    double accuracy = test_accuracy(filename);
+    double accuracy = test_accuracy(filename, num_threads);
     log_info("Done. Accuracy: %f\n", accuracy);
 }
@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <float.h>
+#include <pthread.h>
 
 #include "log/log.h"
 #include "address_dictionary.h"
@@ -27,6 +28,9 @@
 
 #define LANGUAGE_CLASSIFIER_HYPERPARAMETER_BATCHES 50
 
+#define LANGUAGE_CLASSIFIER_PREFETCH_THREADS 4
+#define LANGUAGE_CLASSIFIER_PREFETCH_BATCHES 8
+
 // Hyperparameters for stochastic gradient descent
 
 static double GAMMA_SCHEDULE[] = {0.01, 0.1, 0.2, 0.5, 1.0, 2.0, 5.0, 10.0};
@@ -58,7 +62,7 @@ static double DEFAULT_BETA = 1.0;
 
 #define HYPERPARAMETER_EPOCHS 5
 
-logistic_regression_trainer_t *language_classifier_init_params(char *filename, double feature_count_threshold, uint32_t label_count_threshold, size_t minibatch_size, logistic_regression_optimizer_type optim_type, regularization_type_t reg_type) {
+logistic_regression_trainer_t *language_classifier_init_params(char *filename, double feature_count_threshold, uint32_t label_count_threshold, size_t minibatch_size, logistic_regression_optimizer_type optim_type, regularization_type_t reg_type, uint32_t hash_bits) {
     if (filename == NULL) {
         log_error("Filename was NULL\n");
         return NULL;
@@ -106,6 +110,27 @@ logistic_regression_trainer_t *language_classifier_init_params(char *filename, d
     // Don't free the label strings as the pointers are reused in select_labels_threshold
     kh_destroy(str_uint32, label_counts);
 
+    // With feature hashing there's no feature dictionary to build, so skip the counting pass
+    if (hash_bits > 0) {
+        language_classifier_data_set_destroy(data_set);
+        kh_destroy(str_double, feature_counts);
+        log_info("Hashing features into 2^%u ids\n", hash_bits);
+
+        if (optim_type == LOGISTIC_REGRESSION_OPTIMIZER_SGD) {
+            bool fit_intercept = true;
+            double default_lambda = 0.0;
+            if (reg_type == REGULARIZATION_L2){
+                default_lambda = DEFAULT_L2;
+            } else if (reg_type == REGULARIZATION_L1) {
+                default_lambda = DEFAULT_L1;
+            }
+            return logistic_regression_trainer_init_sgd_hashed(hash_bits, FEATURE_HASH_DEFAULT_SEED, label_ids, fit_intercept, reg_type, default_lambda, DEFAULT_GAMMA_0);
+        } else if (optim_type == LOGISTIC_REGRESSION_OPTIMIZER_FTRL) {
+            return logistic_regression_trainer_init_ftrl_hashed(hash_bits, FEATURE_HASH_DEFAULT_SEED, label_ids, DEFAULT_ALPHA, DEFAULT_BETA, DEFAULT_L1, DEFAULT_L2);
+        }
+        return NULL;
+    }
+
     // Run through the training set again, counting only features which co-occur with valid classes
     while ((minibatch = language_classifier_data_set_get_minibatch(data_set, label_ids)) != NULL) {
         if (!count_features_minibatch(feature_counts, minibatch->features, true)){
@@ -159,16 +184,16 @@ logistic_regression_trainer_t *language_classifier_init_params(char *filename, d
     return trainer;
 }
 
-logistic_regression_trainer_t *language_classifier_init_optim_reg(char *filename, size_t minibatch_size, logistic_regression_optimizer_type optim_type, regularization_type_t reg_type) {
-    return language_classifier_init_params(filename, LANGUAGE_CLASSIFIER_FEATURE_COUNT_THRESHOLD, LANGUAGE_CLASSIFIER_LABEL_COUNT_THRESHOLD, minibatch_size, optim_type, reg_type);
+logistic_regression_trainer_t *language_classifier_init_optim_reg(char *filename, size_t minibatch_size, logistic_regression_optimizer_type optim_type, regularization_type_t reg_type, uint32_t hash_bits) {
+    return language_classifier_init_params(filename, LANGUAGE_CLASSIFIER_FEATURE_COUNT_THRESHOLD, LANGUAGE_CLASSIFIER_LABEL_COUNT_THRESHOLD, minibatch_size, optim_type, reg_type, hash_bits);
 }
 
-logistic_regression_trainer_t *language_classifier_init_sgd_reg(char *filename, size_t minibatch_size, regularization_type_t reg_type) {
-    return language_classifier_init_params(filename, LANGUAGE_CLASSIFIER_FEATURE_COUNT_THRESHOLD, LANGUAGE_CLASSIFIER_LABEL_COUNT_THRESHOLD, minibatch_size, LOGISTIC_REGRESSION_OPTIMIZER_SGD, reg_type);
+logistic_regression_trainer_t *language_classifier_init_sgd_reg(char *filename, size_t minibatch_size, regularization_type_t reg_type, uint32_t hash_bits) {
+    return language_classifier_init_params(filename, LANGUAGE_CLASSIFIER_FEATURE_COUNT_THRESHOLD, LANGUAGE_CLASSIFIER_LABEL_COUNT_THRESHOLD, minibatch_size, LOGISTIC_REGRESSION_OPTIMIZER_SGD, reg_type, hash_bits);
 }
 
-logistic_regression_trainer_t *language_classifier_init_ftrl(char *filename, size_t minibatch_size) {
-    return language_classifier_init_params(filename, LANGUAGE_CLASSIFIER_FEATURE_COUNT_THRESHOLD, LANGUAGE_CLASSIFIER_LABEL_COUNT_THRESHOLD, minibatch_size, LOGISTIC_REGRESSION_OPTIMIZER_FTRL, REGULARIZATION_NONE);
+logistic_regression_trainer_t *language_classifier_init_ftrl(char *filename, size_t minibatch_size, uint32_t hash_bits) {
+    return language_classifier_init_params(filename, LANGUAGE_CLASSIFIER_FEATURE_COUNT_THRESHOLD, LANGUAGE_CLASSIFIER_LABEL_COUNT_THRESHOLD, minibatch_size, LOGISTIC_REGRESSION_OPTIMIZER_FTRL, REGULARIZATION_NONE, hash_bits);
 }
 
 double compute_cv_accuracy(logistic_regression_trainer_t *trainer, char *filename) {
@@ -182,7 +207,7 @@ double compute_cv_accuracy(logistic_regression_trainer_t *trainer, char *filenam
     double_matrix_t *p_y = double_matrix_new_zeros(LANGUAGE_CLASSIFIER_DEFAULT_BATCH_SIZE, trainer->num_labels);
 
     while ((minibatch = language_classifier_data_set_get_minibatch(data_set, trainer->label_ids)) != NULL) {
-        sparse_matrix_t *x = feature_matrix(trainer->feature_ids, minibatch->features);
+        sparse_matrix_t *x = logistic_regression_trainer_feature_matrix(trainer, minibatch->features);
         uint32_array *y = label_vector(trainer->label_ids, minibatch->labels);
 
         if (!double_matrix_resize_aligned(p_y, x->m, trainer->num_labels, 16)) {
@@ -273,25 +298,37 @@ double compute_total_cost(logistic_regression_trainer_t *trainer, char *filename
 }
 
 
-bool language_classifier_train_epoch(logistic_regression_trainer_t *trainer, char *filename, char *cv_filename, ssize_t train_batches, size_t minibatch_size) {
-    if (filename == NULL) {
-        log_error("Filename was NULL\n");
-        return false;
-    }
-
+static bool language_classifier_shuffle(char *filename) {
     #if defined(HAVE_SHUF) || defined(HAVE_GSHUF)
     log_info("Shuffling\n");
 
     if (!shuffle_file_chunked_size(filename, DEFAULT_SHUFFLE_CHUNK_SIZE)) {
         log_error("Error in shuffle\n");
-        logistic_regression_trainer_destroy(trainer);
-        return NULL;
+        return false;
     }
 
     log_info("Shuffle complete\n");
     #endif
+    return true;
+}
 
-    language_classifier_data_set_t *data_set = language_classifier_data_set_init(filename);
+static bool language_classifier_train_epoch_shuffle(logistic_regression_trainer_t *trainer, char *filename, char *cv_filename, ssize_t train_batches, size_t minibatch_size, bool shuffle) {
+    if (filename == NULL) {
+        log_error("Filename was NULL\n");
+        return false;
+    }
+
+    if (shuffle && !language_classifier_shuffle(filename)) {
+        logistic_regression_trainer_destroy(trainer);
+        return false;
+    }
+
+    // Minibatches are read and featurized ahead of the optimizer by a pool of threads
+    language_classifier_minibatch_reader_t *reader = language_classifier_minibatch_reader_new(filename, trainer->feature_ids, trainer->hash_bits, trainer->hash_seed, trainer->label_ids, minibatch_size, LANGUAGE_CLASSIFIER_PREFETCH_THREADS, LANGUAGE_CLASSIFIER_PREFETCH_BATCHES);
+    if (reader == NULL) {
+        log_error("Error creating minibatch reader\n");
+        return false;
+    }
 
     language_classifier_minibatch_t *minibatch;
 
@@ -303,7 +340,7 @@ bool language_classifier_train_epoch(logistic_regression_trainer_t *trainer, cha
     double train_cost = 0.0;
     double cv_accuracy = 0.0;
 
-    while ((minibatch = language_classifier_data_set_get_minibatch_with_size(data_set, trainer->label_ids, minibatch_size)) != NULL) {
+    while ((minibatch = language_classifier_minibatch_reader_next(reader)) != NULL) {
         bool compute_cost = num_batches % COMPUTE_COST_INTERVAL == 0;
         bool compute_cv = num_batches % COMPUTE_CV_INTERVAL == 0 && num_batches > 0 && cv_filename != NULL;
 
@@ -316,7 +353,7 @@ bool language_classifier_train_epoch(logistic_regression_trainer_t *trainer, cha
             log_info("cost = %f\n", train_cost);
         }
 
-        if (!logistic_regression_trainer_train_minibatch(trainer, minibatch->features, minibatch->labels)){
+        if (!logistic_regression_trainer_train_minibatch_sparse(trainer, minibatch->x, minibatch->y)){
             log_error("Train batch failed\n");
             exit(EXIT_FAILURE);
         }
@@ -332,6 +369,7 @@ bool language_classifier_train_epoch(logistic_regression_trainer_t *trainer, cha
             log_info("Epoch %u, trained %zu examples\n", trainer->epochs, num_batches * minibatch_size);
             train_cost = logistic_regression_trainer_minibatch_cost_regularized(trainer, minibatch->features, minibatch->labels);
             log_info("cost = %f\n", train_cost);
+            language_classifier_minibatch_destroy(minibatch);
             break;
         }
 
@@ -339,11 +377,21 @@ bool language_classifier_train_epoch(logistic_regression_trainer_t *trainer, cha
 
     }
 
-    language_classifier_data_set_destroy(data_set);
+    bool error = language_classifier_minibatch_reader_error(reader);
+    language_classifier_minibatch_reader_destroy(reader);
+
+    if (error) {
+        log_error("Error reading minibatches from %s, epoch %u failed\n", filename, trainer->epochs);
+        return false;
+    }
 
     return true;
 }
 
+bool language_classifier_train_epoch(logistic_regression_trainer_t *trainer, char *filename, char *cv_filename, ssize_t train_batches, size_t minibatch_size) {
+    return language_classifier_train_epoch_shuffle(trainer, filename, cv_filename, train_batches, minibatch_size, true);
+}
+
 static double language_classifier_cv_cost(logistic_regression_trainer_t *trainer, char *filename, char *cv_filename, size_t minibatch_size, bool *diverged) {
     ssize_t cost_batches;
     char *cost_file;
@@ -376,6 +424,109 @@ static double language_classifier_cv_cost(logistic_regression_trainer_t *trainer
     return final_cost;
 }
 
+/*
+Concurrent hyperparameter candidates. Each candidate gets its own trainer
+sharing the feature and label ids, and the candidates in a group move
+through the same steps as language_classifier_cv_cost in lockstep. The
+subset file is shuffled in place between epochs, so it's shuffled once per
+epoch for the whole group rather than by each candidate.
+*/
+
+typedef enum {
+    LANGUAGE_CLASSIFIER_SWEEP_INITIAL_COST,
+    LANGUAGE_CLASSIFIER_SWEEP_EPOCH,
+    LANGUAGE_CLASSIFIER_SWEEP_FINAL_COST
+} language_classifier_sweep_step_t;
+
+typedef struct language_classifier_sweep_task {
+    logistic_regression_trainer_t *trainer;
+    char *filename;
+    char *cost_file;
+    ssize_t cost_batches;
+    size_t minibatch_size;
+    language_classifier_sweep_step_t step;
+    double initial_cost;
+    double final_cost;
+    bool success;
+} language_classifier_sweep_task_t;
+
+static void *language_classifier_sweep_task_run(void *arg) {
+    language_classifier_sweep_task_t *task = arg;
+
+    switch (task->step) {
+        case LANGUAGE_CLASSIFIER_SWEEP_INITIAL_COST:
+            task->initial_cost = compute_total_cost(task->trainer, task->cost_file, task->cost_batches);
+            break;
+        case LANGUAGE_CLASSIFIER_SWEEP_EPOCH:
+            task->success = language_classifier_train_epoch_shuffle(task->trainer, task->filename, NULL, LANGUAGE_CLASSIFIER_HYPERPARAMETER_BATCHES, task->minibatch_size, false);
+            break;
+        case LANGUAGE_CLASSIFIER_SWEEP_FINAL_COST:
+            task->final_cost = compute_total_cost(task->trainer, task->cost_file, task->cost_batches);
+            break;
+    }
+
+    return NULL;
+}
+
+static bool language_classifier_sweep_step(language_classifier_sweep_task_t *tasks, size_t num_tasks, language_classifier_sweep_step_t step) {
+    pthread_t threads[num_tasks];
+    bool started[num_tasks];
+
+    for (size_t i = 0; i < num_tasks; i++) {
+        tasks[i].step = step;
+        tasks[i].success = true;
+        started[i] = pthread_create(&threads[i], NULL, language_classifier_sweep_task_run, &tasks[i]) == 0;
+        if (!started[i]) {
+            language_classifier_sweep_task_run(&tasks[i]);
+        }
+    }
+
+    bool success = true;
+    for (size_t i = 0; i < num_tasks; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+        success = success && tasks[i].success;
+    }
+
+    return success;
+}
+
+static void language_classifier_cv_cost_threads(logistic_regression_trainer_t **trainers, size_t num_trainers, char *filename, char *cv_filename, size_t minibatch_size, double *costs, bool *diverged) {
+    language_classifier_sweep_task_t tasks[num_trainers];
+
+    for (size_t i = 0; i < num_trainers; i++) {
+        tasks[i] = (language_classifier_sweep_task_t){
+            .trainer = trainers[i],
+            .filename = filename,
+            .cost_file = cv_filename != NULL ? cv_filename : filename,
+            .cost_batches = cv_filename != NULL ? -1 : LANGUAGE_CLASSIFIER_HYPERPARAMETER_BATCHES,
+            .minibatch_size = minibatch_size
+        };
+    }
+
+    language_classifier_sweep_step(tasks, num_trainers, LANGUAGE_CLASSIFIER_SWEEP_INITIAL_COST);
+
+    for (size_t k = 0; k < HYPERPARAMETER_EPOCHS; k++) {
+        for (size_t i = 0; i < num_trainers; i++) {
+            trainers[i]->epochs = k;
+        }
+
+        if (!language_classifier_shuffle(filename) || !language_classifier_sweep_step(tasks, num_trainers, LANGUAGE_CLASSIFIER_SWEEP_EPOCH)) {
+            log_error("Error in epoch\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    language_classifier_sweep_step(tasks, num_trainers, LANGUAGE_CLASSIFIER_SWEEP_FINAL_COST);
+
+    for (size_t i = 0; i < num_trainers; i++) {
+        costs[i] = tasks[i].final_cost;
+        diverged[i] = tasks[i].final_cost > tasks[i].initial_cost;
+        log_info("final_cost = %f, initial_cost = %f\n", tasks[i].final_cost, tasks[i].initial_cost);
+    }
+}
+
 typedef struct language_classifier_sgd_params {
     double lambda;
     double gamma_0;
@@ -421,24 +572,61 @@ language_classifier_sgd_params_t language_classifier_parameter_sweep_sgd(logisti
     double cost;
     language_classifier_sgd_params_t params;
 
+    language_classifier_sgd_param_array *candidates = language_classifier_sgd_param_array_new();
+
     cartesian_product_iterator_t *iter = cartesian_product_iterator_new(2, lambda_schedule_size, GAMMA_SCHEDULE_SIZE);
     for (uint32_t *vals = cartesian_product_iterator_start(iter); !cartesian_product_iterator_done(iter); vals = cartesian_product_iterator_next(iter)) {
-        double lambda = lambda_schedule[vals[0]];
-        double gamma_0 = GAMMA_SCHEDULE[vals[1]];
+        params.lambda = lambda_schedule[vals[0]];
+        params.gamma_0 = GAMMA_SCHEDULE[vals[1]];
+        language_classifier_sgd_param_array_push(candidates, params);
+    }
+    cartesian_product_iterator_destroy(iter);
+
+    size_t num_candidates = candidates->n;
+    double *candidate_costs = malloc(num_candidates * sizeof(double));
+    bool *candidate_diverged = malloc(num_candidates * sizeof(bool));
+    if (candidate_costs == NULL || candidate_diverged == NULL) {
+        log_error("Error allocating candidate costs\n");
+        exit(EXIT_FAILURE);
+    }
 
-        params.lambda = lambda,
-        params.gamma_0 = gamma_0;
+    // With multiple threads, evaluate groups of candidates concurrently, otherwise reuse the trainer
+    size_t num_threads = trainer->num_threads;
 
-        if (!logistic_regression_trainer_reset_params_sgd(trainer, lambda, gamma_0)) {
-            log_error("Error resetting params\n");
-            logistic_regression_trainer_destroy(trainer);
-            exit(EXIT_FAILURE);
+    for (size_t start = 0; start < num_candidates; start += num_threads) {
+        size_t group_size = num_candidates - start < num_threads ? num_candidates - start : num_threads;
+        logistic_regression_trainer_t *group[group_size];
+
+        for (size_t i = 0; i < group_size; i++) {
+            params = candidates->a[start + i];
+            group[i] = num_threads > 1 ? logistic_regression_trainer_init_shared(trainer) : trainer;
+
+            if (group[i] == NULL || !logistic_regression_trainer_reset_params_sgd(group[i], params.lambda, params.gamma_0)) {
+                log_error("Error resetting params\n");
+                logistic_regression_trainer_destroy(trainer);
+                exit(EXIT_FAILURE);
+            }
+
+            log_info("Optimizing hyperparameters. Trying lambda=%.7f, gamma_0=%f\n", params.lambda, params.gamma_0);
         }
 
-        log_info("Optimizing hyperparameters. Trying lambda=%.7f, gamma_0=%f\n", lambda, gamma_0);
+        if (num_threads > 1) {
+            language_classifier_cv_cost_threads(group, group_size, filename, cv_filename, minibatch_size, candidate_costs + start, candidate_diverged + start);
+            for (size_t i = 0; i < group_size; i++) {
+                logistic_regression_trainer_destroy(group[i]);
+            }
+        } else {
+            candidate_costs[start] = language_classifier_cv_cost(trainer, filename, cv_filename, minibatch_size, &candidate_diverged[start]);
+        }
+    }
+
+    for (size_t c = 0; c < num_candidates; c++) {
+        params = candidates->a[c];
+        double lambda = params.lambda;
+        double gamma_0 = params.gamma_0;
 
-        bool diverged = false;
-        cost = language_classifier_cv_cost(trainer, filename, cv_filename, minibatch_size, &diverged);
+        cost = candidate_costs[c];
+        bool diverged = candidate_diverged[c];
 
         if (!diverged) {
             language_classifier_sgd_param_array_push(all_params, params);
@@ -477,6 +665,9 @@ language_classifier_sgd_params_t language_classifier_parameter_sweep_sgd(logisti
         }
     }
 
+    language_classifier_sgd_param_array_destroy(candidates);
+    free(candidate_costs);
+    free(candidate_diverged);
     language_classifier_sgd_param_array_destroy(all_params);
     double_array_destroy(costs);
 
@@ -494,26 +685,63 @@ language_classifier_ftrl_params_t language_classifier_parameter_sweep_ftrl(logis
     language_classifier_ftrl_params_t params;
     double cost;
 
+    language_classifier_ftrl_param_array *candidates = language_classifier_ftrl_param_array_new();
+
     cartesian_product_iterator_t *iter = cartesian_product_iterator_new(3, L1_SCHEDULE_SIZE, L2_SCHEDULE_SIZE, ALPHA_SCHEDULE_SIZE);
     for (uint32_t *vals = cartesian_product_iterator_start(iter); !cartesian_product_iterator_done(iter); vals = cartesian_product_iterator_next(iter)) {
-        double lambda1 = L1_SCHEDULE[vals[0]];
-        double lambda2 = L2_SCHEDULE[vals[1]];
-        double alpha = ALPHA_SCHEDULE[vals[2]];
+        params.lambda1 = L1_SCHEDULE[vals[0]];
+        params.lambda2 = L2_SCHEDULE[vals[1]];
+        params.alpha = ALPHA_SCHEDULE[vals[2]];
+        language_classifier_ftrl_param_array_push(candidates, params);
+    }
+    cartesian_product_iterator_destroy(iter);
 
-        params.lambda1 = lambda1,
-        params.lambda2 = lambda2,
-        params.alpha = alpha;
+    size_t num_candidates = candidates->n;
+    double *candidate_costs = malloc(num_candidates * sizeof(double));
+    bool *candidate_diverged = malloc(num_candidates * sizeof(bool));
+    if (candidate_costs == NULL || candidate_diverged == NULL) {
+        log_error("Error allocating candidate costs\n");
+        exit(EXIT_FAILURE);
+    }
 
-        if (!logistic_regression_trainer_reset_params_ftrl(trainer, alpha, DEFAULT_BETA, lambda1, lambda2)) {
-            log_error("Error resetting params\n");
-            logistic_regression_trainer_destroy(trainer);
-            exit(EXIT_FAILURE);
+    // With multiple threads, evaluate groups of candidates concurrently, otherwise reuse the trainer
+    size_t num_threads = trainer->num_threads;
+
+    for (size_t start = 0; start < num_candidates; start += num_threads) {
+        size_t group_size = num_candidates - start < num_threads ? num_candidates - start : num_threads;
+        logistic_regression_trainer_t *group[group_size];
+
+        for (size_t i = 0; i < group_size; i++) {
+            params = candidates->a[start + i];
+            group[i] = num_threads > 1 ? logistic_regression_trainer_init_shared(trainer) : trainer;
+
+            if (group[i] == NULL || !logistic_regression_trainer_reset_params_ftrl(group[i], params.alpha, DEFAULT_BETA, params.lambda1, params.lambda2)) {
+                log_error("Error resetting params\n");
+                logistic_regression_trainer_destroy(trainer);
+                exit(EXIT_FAILURE);
+            }
+
+            log_info("Optimizing hyperparameters. Trying lambda1=%.7f, lambda2=%.7f, alpha=%f\n", params.lambda1, params.lambda2, params.alpha);
+        }
+
+        if (num_threads > 1) {
+            language_classifier_cv_cost_threads(group, group_size, filename, cv_filename, minibatch_size, candidate_costs + start, candidate_diverged + start);
+            for (size_t i = 0; i < group_size; i++) {
+                logistic_regression_trainer_destroy(group[i]);
+            }
+        } else {
+            candidate_costs[start] = language_classifier_cv_cost(trainer, filename, cv_filename, minibatch_size, &candidate_diverged[start]);
         }
+    }
 
-        log_info("Optimizing hyperparameters. Trying lambda1=%.7f, lambda2=%.7f, alpha=%f\n", lambda1, lambda2, alpha);
+    for (size_t c = 0; c < num_candidates; c++) {
+        params = candidates->a[c];
+        double lambda1 = params.lambda1;
+        double lambda2 = params.lambda2;
+        double alpha = params.alpha;
 
-        bool diverged = false;
-        cost = language_classifier_cv_cost(trainer, filename, cv_filename, minibatch_size, &diverged);
+        cost = candidate_costs[c];
+        bool diverged = candidate_diverged[c];
 
         if (!diverged) {
             language_classifier_ftrl_param_array_push(all_params, params);
@@ -562,6 +790,9 @@ language_classifier_ftrl_params_t language_classifier_parameter_sweep_ftrl(logis
         }
     }
 
+    language_classifier_ftrl_param_array_destroy(candidates);
+    free(candidate_costs);
+    free(candidate_diverged);
     language_classifier_ftrl_param_array_destroy(all_params);
     double_array_destroy(costs);
 
@@ -611,6 +842,8 @@ static language_classifier_t *trainer_finalize(logistic_regression_trainer_t *tr
 
     classifier->num_features = trainer->num_features;
     classifier->features = trainer->feature_ids;
+    classifier->hash_bits = trainer->hash_bits;
+    classifier->hash_seed = trainer->hash_seed;
     // Set trainer feature_ids to NULL so it doesn't get destroyed
     trainer->feature_ids = NULL;
 
@@ -642,8 +875,12 @@ static language_classifier_t *trainer_finalize(logistic_regression_trainer_t *tr
 }
 
 
-language_classifier_t *language_classifier_train_sgd(char *filename, char *subset_filename, bool cross_validation_set, char *cv_filename, char *test_filename, uint32_t num_iterations, size_t minibatch_size, regularization_type_t reg_type) {
-    logistic_regression_trainer_t *trainer = language_classifier_init_sgd_reg(filename, minibatch_size, reg_type);
+language_classifier_t *language_classifier_train_sgd(char *filename, char *subset_filename, bool cross_validation_set, char *cv_filename, char *test_filename, uint32_t num_iterations, size_t minibatch_size, regularization_type_t reg_type, size_t num_threads, uint32_t hash_bits) {
+    logistic_regression_trainer_t *trainer = language_classifier_init_sgd_reg(filename, minibatch_size, reg_type, hash_bits);
+    if (trainer == NULL || !logistic_regression_trainer_set_num_threads(trainer, num_threads)) {
+        log_error("Error creating trainer\n");
+        return NULL;
+    }
 
     language_classifier_sgd_params_t params = language_classifier_parameter_sweep_sgd(trainer, subset_filename, cv_filename, minibatch_size);
     log_info("Best params: lambda=%f, gamma_0=%f\n", params.lambda, params.gamma_0);
@@ -678,8 +915,12 @@ language_classifier_t *language_classifier_train_sgd(char *filename, char *subse
     return trainer_finalize(trainer, test_filename);
 }
 
-language_classifier_t *language_classifier_train_ftrl(char *filename, char *subset_filename, bool cross_validation_set, char *cv_filename, char *test_filename, uint32_t num_iterations, size_t minibatch_size) {
-    logistic_regression_trainer_t *trainer = language_classifier_init_ftrl(filename, minibatch_size);
+language_classifier_t *language_classifier_train_ftrl(char *filename, char *subset_filename, bool cross_validation_set, char *cv_filename, char *test_filename, uint32_t num_iterations, size_t minibatch_size, size_t num_threads, uint32_t hash_bits) {
+    logistic_regression_trainer_t *trainer = language_classifier_init_ftrl(filename, minibatch_size, hash_bits);
+    if (trainer == NULL || !logistic_regression_trainer_set_num_threads(trainer, num_threads)) {
+        log_error("Error creating trainer\n");
+        return NULL;
+    }
 
     language_classifier_ftrl_params_t params = language_classifier_parameter_sweep_ftrl(trainer, subset_filename, cv_filename, minibatch_size);
     log_info("Best params: lambda1=%.7f, lambda2=%.7f, alpha=%f\n", params.lambda1, params.lambda2, params.alpha);
@@ -721,10 +962,12 @@ typedef enum {
     LANGUAGE_CLASSIFIER_TRAIN_ARG_ITERATIONS,
     LANGUAGE_CLASSIFIER_TRAIN_ARG_OPTIMIZER,
     LANGUAGE_CLASSIFIER_TRAIN_ARG_REGULARIZATION,
-    LANGUAGE_CLASSIFIER_TRAIN_ARG_MINIBATCH_SIZE
+    LANGUAGE_CLASSIFIER_TRAIN_ARG_MINIBATCH_SIZE,
+    LANGUAGE_CLASSIFIER_TRAIN_ARG_THREADS,
+    LANGUAGE_CLASSIFIER_TRAIN_ARG_HASH_BITS
 } language_classifier_train_keyword_arg_t;
 
-#define LANGUAGE_CLASSIFIER_TRAIN_USAGE "Usage: ./language_classifier_train [train|cv] filename [cv_filename] [test_filename] [output_dir] [--iterations number --opt (sgd|ftrl) --reg (l1|l2) --minibatch-size number]\n"
+#define LANGUAGE_CLASSIFIER_TRAIN_USAGE "Usage: ./language_classifier_train [train|cv] filename [cv_filename] [test_filename] [output_dir] [--iterations number --opt (sgd|ftrl) --reg (l1|l2) --minibatch-size number --threads number --hash-bits number]\n"
 
 int main(int argc, char **argv) {
     if (argc < 3) {
@@ -740,11 +983,15 @@ int main(int argc, char **argv) {
     size_t minibatch_size = LANGUAGE_CLASSIFIER_DEFAULT_BATCH_SIZE;
     logistic_regression_optimizer_type optim_type = LOGISTIC_REGRESSION_OPTIMIZER_SGD;
     regularization_type_t reg_type = REGULARIZATION_L2;
+    size_t num_threads = 1;
+    uint32_t hash_bits = 0;
 
     size_t position = 0;
 
     ssize_t arg_iterations;
     ssize_t arg_minibatch_size;
+    ssize_t arg_threads;
+    uint32_t arg_hash_bits;
 
     char *command = NULL;
     char *filename = NULL;
@@ -779,6 +1026,16 @@ int main(int argc, char **argv) {
             continue;
         }
 
+        if (string_equals(arg, "--threads")) {
+            kwarg = LANGUAGE_CLASSIFIER_TRAIN_ARG_THREADS;
+            continue;
+        }
+
+        if (string_equals(arg, "--hash-bits")) {
+            kwarg = LANGUAGE_CLASSIFIER_TRAIN_ARG_HASH_BITS;
+            continue;
+        }
+
         if (kwarg == LANGUAGE_CLASSIFIER_TRAIN_ARG_ITERATIONS) {
             if (sscanf(arg, "%zd", &arg_iterations) != 1 || arg_iterations < 0) {
                 log_error("Bad arg for --iterations: %s\n", arg);
@@ -810,6 +1067,18 @@ int main(int argc, char **argv) {
                 exit(EXIT_FAILURE);
             }
             minibatch_size = (size_t)arg_minibatch_size;
+        } else if (kwarg == LANGUAGE_CLASSIFIER_TRAIN_ARG_THREADS) {
+            if (sscanf(arg, "%zd", &arg_threads) != 1 || arg_threads < 1) {
+                log_error("Bad arg for --threads: %s\n", arg);
+                exit(EXIT_FAILURE);
+            }
+            num_threads = (size_t)arg_threads;
+        } else if (kwarg == LANGUAGE_CLASSIFIER_TRAIN_ARG_HASH_BITS) {
+            if (sscanf(arg, "%u", &arg_hash_bits) != 1 || !feature_hash_valid_bits(arg_hash_bits)) {
+                log_error("Bad arg for --hash-bits: %s, must be between %d and %d\n", arg, FEATURE_HASH_MIN_BITS, FEATURE_HASH_MAX_BITS);
+                exit(EXIT_FAILURE);
+            }
+            hash_bits = arg_hash_bits;
         } else if (position == 0) {
             command = arg;
             if (string_equals(command, "cv")) {
@@ -895,9 +1164,9 @@ int main(int argc, char **argv) {
     language_classifier_t *language_classifier = NULL;
 
     if (optim_type == LOGISTIC_REGRESSION_OPTIMIZER_SGD) {
-        language_classifier = language_classifier_train_sgd(filename, temp_filename, cross_validation_set, cv_filename, test_filename, num_epochs, minibatch_size, reg_type);
+        language_classifier = language_classifier_train_sgd(filename, temp_filename, cross_validation_set, cv_filename, test_filename, num_epochs, minibatch_size, reg_type, num_threads, hash_bits);
     } else if (optim_type == LOGISTIC_REGRESSION_OPTIMIZER_FTRL) {
-        language_classifier = language_classifier_train_ftrl(filename, temp_filename, cross_validation_set, cv_filename, test_filename, num_epochs, minibatch_size);
+        language_classifier = language_classifier_train_ftrl(filename, temp_filename, cross_validation_set, cv_filename, test_filename, num_epochs, minibatch_size, num_threads, hash_bits);
     }
 
     remove(temp_filename);
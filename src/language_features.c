@@ -29,6 +29,11 @@ inline void language_classifier_normalize_token(char_array *array, char *str, to
 }
 
 
+static inline void language_feature_sink_add(language_feature_sink_t *sink, char *feature, double count) {
+    sink->num_features++;
+    sink->add(sink->data, feature, count);
+}
+
 static inline void append_prefix(char_array *array, char *prefix) {
     if (prefix != NULL) {
         char_array_append(array, prefix);
@@ -36,7 +41,7 @@ static inline void append_prefix(char_array *array, char *prefix) {
     }
 }
 
-static inline void add_full_token_feature(khash_t(str_double) *features, char *prefix, char_array *feature_array, char *str, token_t token) {
+static inline void add_full_token_feature(language_feature_sink_t *features, char *prefix, char_array *feature_array, char *str, token_t token) {
     if (features == NULL || feature_array == NULL) return;
 
     char_array_clear(feature_array);
@@ -47,11 +52,11 @@ static inline void add_full_token_feature(khash_t(str_double) *features, char *p
     if (feature_array->n <= 1) return;
     char *feature = char_array_get_string(feature_array);
     log_debug("full token feature=%s\n", feature);
-    feature_counts_add(features, feature, 1.0);
+    language_feature_sink_add(features, feature, 1.0);
 }
 
 
-static void add_ngram_features(khash_t(str_double) *features, char *prefix, char_array *feature_array, char *str, token_t token, size_t n) {
+static void add_ngram_features(language_feature_sink_t *features, char *prefix, char_array *feature_array, char *str, token_t token, size_t n) {
     char *feature_namespace;
     if (features == NULL || feature_array == NULL) return;
 
@@ -118,7 +123,7 @@ static void add_ngram_features(khash_t(str_double) *features, char *prefix, char
             char *feature = char_array_get_string(feature_array);
             log_debug("feature=%s\n", feature);
 
-            feature_counts_add(features, feature, 1.0);
+            language_feature_sink_add(features, feature, 1.0);
         }
 
         idx += char_len;
@@ -132,7 +137,7 @@ static void add_ngram_features(khash_t(str_double) *features, char *prefix, char
 
 }
 
-static void add_phrase_feature(khash_t(str_double) *features, char *prefix, char_array *feature_array, char *str, phrase_t phrase, token_array *tokens) {
+static void add_phrase_feature(language_feature_sink_t *features, char *prefix, char_array *feature_array, char *str, phrase_t phrase, token_array *tokens) {
     if (features == NULL || feature_array == NULL || tokens == NULL || tokens->n == 0) return;
     char_array_clear(feature_array);
     append_prefix(feature_array, prefix);
@@ -149,11 +154,11 @@ static void add_phrase_feature(khash_t(str_double) *features, char *prefix, char
     char_array_terminate(feature_array);
     if (feature_array->n <= 1) return;
     char *feature = char_array_get_string(feature_array);
-    feature_counts_add(features, feature, 1.0);
+    language_feature_sink_add(features, feature, 1.0);
 }
 
 
-static void add_prefix_phrase_feature(khash_t(str_double) *features, char *prefix, char_array *feature_array, char *str, phrase_t phrase, token_t token) {
+static void add_prefix_phrase_feature(language_feature_sink_t *features, char *prefix, char_array *feature_array, char *str, phrase_t phrase, token_t token) {
     if (features == NULL || feature_array == NULL || phrase.len == 0 || phrase.len >= token.len) return;
     char_array_clear(feature_array);
 
@@ -165,12 +170,12 @@ static void add_prefix_phrase_feature(khash_t(str_double) *features, char *prefi
 
     if (feature_array->n <= 1) return;
     char *feature = char_array_get_string(feature_array);
-    feature_counts_add(features, feature, 1.0);
+    language_feature_sink_add(features, feature, 1.0);
 
 }
 
 
-static void add_suffix_phrase_feature(khash_t(str_double) *features, char *prefix, char_array *feature_array, char *str, phrase_t phrase, token_t token) {
+static void add_suffix_phrase_feature(language_feature_sink_t *features, char *prefix, char_array *feature_array, char *str, phrase_t phrase, token_t token) {
     if (features == NULL || feature_array == NULL || phrase.len == 0 || phrase.len >= token.len) return;
     char_array_clear(feature_array);
 
@@ -182,12 +187,12 @@ static void add_suffix_phrase_feature(khash_t(str_double) *features, char *prefi
 
     if (feature_array->n <= 1) return;
     char *feature = char_array_get_string(feature_array);
-    feature_counts_add(features, feature, 1.0);
+    language_feature_sink_add(features, feature, 1.0);
 
 }
 
 
-static void add_token_features(khash_t(str_double) *features, char *prefix, char_array *feature_array, char *str, token_t token) {
+static void add_token_features(language_feature_sink_t *features, char *prefix, char_array *feature_array, char *str, token_t token) {
     // Non-words don't convey any language information
     // TODO: ordinal number suffixes may be worth investigating
     if (!is_word_token(token.type)) {
@@ -213,17 +218,17 @@ static void add_token_features(khash_t(str_double) *features, char *prefix, char
     }
 }
 
-static void add_script_feature(khash_t(str_double) *features, char *prefix, char_array *feature_array, script_t script) {
+static void add_script_feature(language_feature_sink_t *features, char *prefix, char_array *feature_array, script_t script) {
     char_array_clear(feature_array);
     char_array_append(feature_array, "sc=");
     char_array_cat_printf(feature_array, "%d", script);
     char *feature = char_array_get_string(feature_array);
-    feature_counts_add(features, feature, 1.0);
+    language_feature_sink_add(features, feature, 1.0);
 }
 
 
-khash_t(str_double) *extract_language_features(char *str, char *country, token_array *tokens, char_array *feature_array) {
-    if (str == NULL || tokens == NULL || feature_array == NULL) return NULL;
+size_t extract_language_features_sink(char *str, char *country, token_array *tokens, char_array *feature_array, language_feature_sink_t *features) {
+    if (str == NULL || tokens == NULL || feature_array == NULL || features == NULL) return 0;
 
     char *feature;
 
@@ -231,18 +236,14 @@ khash_t(str_double) *extract_language_features(char *str, char *country, token_a
 
     size_t consumed = 0;
     size_t len = strlen(str);
-    if (len == 0) return NULL;
+    if (len == 0) return 0;
 
     char_array *normalized = char_array_new_size(len);
     if (normalized == NULL) {
-        return NULL;
+        return 0;
     }
 
-    khash_t(str_double) *features = kh_init(str_double);
-    if (features == NULL) {
-        char_array_destroy(normalized);
-        return NULL;
-    }
+    size_t num_features_start = features->num_features;
 
     while (consumed < len) {
         string_script_t str_script = get_string_script(str, len - consumed);
@@ -311,5 +312,24 @@ khash_t(str_double) *extract_language_features(char *str, char *country, token_a
 
     char_array_destroy(normalized);
 
-    return features;
+    return features->num_features - num_features_start;
+}
+
+static void language_feature_counts_add(void *data, char *feature, double count) {
+    khash_t(str_double) *feature_counts = data;
+    feature_counts_add(feature_counts, feature, count);
+}
+
+khash_t(str_double) *extract_language_features(char *str, char *country, token_array *tokens, char_array *feature_array) {
+    if (str == NULL || tokens == NULL || feature_array == NULL || *str == '\0') return NULL;
+
+    khash_t(str_double) *feature_counts = kh_init(str_double);
+    if (feature_counts == NULL) {
+        return NULL;
+    }
+
+    language_feature_sink_t sink = (language_feature_sink_t){language_feature_counts_add, feature_counts, 0};
+    extract_language_features_sink(str, country, tokens, feature_array, &sink);
+
+    return feature_counts;
 }
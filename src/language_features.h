@@ -11,6 +11,22 @@
 char *language_classifier_normalize_string(char *str);
 void language_classifier_normalize_token(char_array *array, char *str, token_t token);
 
+/*
+Feature sinks receive each feature string as it is generated. The string is
+only valid for the duration of the call, so sinks that need to keep it
+(e.g. to count features into a hash) must copy it.
+*/
+typedef void (*language_feature_add_function)(void *data, char *feature, double count);
+
+typedef struct language_feature_sink {
+    language_feature_add_function add;
+    void *data;
+    size_t num_features;
+} language_feature_sink_t;
+
+// Streams features to the sink, returns the number of features generated
+size_t extract_language_features_sink(char *str, char *country, token_array *tokens, char_array *feature_array, language_feature_sink_t *features);
+
 khash_t(str_double) *extract_language_features(char *str, char *country, token_array *tokens, char_array *feature_array);
 
 #endif
\ No newline at end of file
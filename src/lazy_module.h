@@ -0,0 +1,94 @@
+/*
+lazy_module.h
+-------------
+
+Deferred, thread-safe loading for the global data modules (numex,
+transliteration). A module registered with lazy_module_defer is loaded by the
+first thread that calls lazy_module_ensure. Concurrent callers wait on the
+mutex until the load has finished, and every caller that sees the module as
+no longer pending also sees its fully built tables.
+
+lazy_module_ensure must not be reached from the module's own load function.
+*/
+
+#ifndef LAZY_MODULE_H
+#define LAZY_MODULE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "log/log.h"
+
+typedef bool (*lazy_module_load_function)(char *filename);
+
+typedef struct lazy_module {
+    pthread_mutex_t lock;
+    bool pending;
+    char *name;
+    char *filename;     // NULL loads from the module's default path
+    lazy_module_load_function load;
+} lazy_module_t;
+
+#define LAZY_MODULE_INIT(name, load) {PTHREAD_MUTEX_INITIALIZER, false, (name), NULL, (load)}
+
+static inline bool lazy_module_defer(lazy_module_t *self, char *filename) {
+    pthread_mutex_lock(&self->lock);
+
+    if (self->filename != NULL) {
+        free(self->filename);
+        self->filename = NULL;
+    }
+
+    if (filename != NULL) {
+        self->filename = strdup(filename);
+        if (self->filename == NULL) {
+            pthread_mutex_unlock(&self->lock);
+            return false;
+        }
+    }
+
+    __atomic_store_n(&self->pending, true, __ATOMIC_RELEASE);
+
+    pthread_mutex_unlock(&self->lock);
+    return true;
+}
+
+// Loads the module if it was deferred. A failed load is logged and leaves the module unloaded
+static inline void lazy_module_ensure(lazy_module_t *self) {
+    if (!__atomic_load_n(&self->pending, __ATOMIC_ACQUIRE)) return;
+
+    pthread_mutex_lock(&self->lock);
+
+    if (self->pending) {
+        if (!self->load(self->filename)) {
+            log_error("Error loading %s module, path=%s\n", self->name, self->filename);
+        }
+
+        if (self->filename != NULL) {
+            free(self->filename);
+            self->filename = NULL;
+        }
+
+        __atomic_store_n(&self->pending, false, __ATOMIC_RELEASE);
+    }
+
+    pthread_mutex_unlock(&self->lock);
+}
+
+// Drops a deferred load which never happened, called on teardown
+static inline void lazy_module_cancel(lazy_module_t *self) {
+    pthread_mutex_lock(&self->lock);
+
+    if (self->filename != NULL) {
+        free(self->filename);
+        self->filename = NULL;
+    }
+
+    __atomic_store_n(&self->pending, false, __ATOMIC_RELEASE);
+
+    pthread_mutex_unlock(&self->lock);
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <pthread.h>
 
 #include "libpostal.h"
 
@@ -10,17 +11,28 @@
 #include "address_parser.h"
 #include "dedupe.h"
 #include "expand.h"
+#include "huge_pages.h"
 
 #include "language_classifier.h"
 #include "near_dupe.h"
 #include "normalize.h"
+#include "numex.h"
 #include "place.h"
 #include "scanner.h"
 #include "string_utils.h"
+#include "token_cache.h"
 #include "token_types.h"
+#include "transliterate.h"
 
 #include <ctype.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#define HAVE_EVENTFD
+#endif
 
 // Country heuristics helpers
 
@@ -429,8 +441,9 @@ inline libpostal_address_parser_options_t libpostal_get_address_parser_default_o
     return LIBPOSTAL_ADDRESS_PARSER_DEFAULT_OPTIONS;
 }
 
-libpostal_address_parser_response_t *libpostal_parse_address(char *address, libpostal_address_parser_options_t options) {
-    libpostal_address_parser_response_t *parsed = address_parser_parse(address, options.language, options.country);
+// context may be NULL to use the parser's own context
+static libpostal_address_parser_response_t *libpostal_parse_address_context(char *address, libpostal_address_parser_options_t options, address_parser_context_t *context) {
+    libpostal_address_parser_response_t *parsed = address_parser_parse_context(address, options.language, options.country, context);
 
     if (parsed == NULL) {
         log_error("Parser returned NULL\n");
@@ -515,6 +528,38 @@ libpostal_address_parser_response_t *libpostal_parse_address(char *address, libp
     return parsed;
 }
 
+libpostal_address_parser_response_t *libpostal_parse_address(char *address, libpostal_address_parser_options_t options) {
+    return libpostal_parse_address_context(address, options, NULL);
+}
+
+// Contexts don't reference the model, so a thread's context outlives parser teardown/reload
+static pthread_key_t parser_context_key;
+static pthread_once_t parser_context_key_once = PTHREAD_ONCE_INIT;
+
+static void libpostal_thread_parser_context_destroy(void *context) {
+    address_parser_context_destroy((address_parser_context_t *)context);
+}
+
+static void libpostal_parser_context_key_create(void) {
+    pthread_key_create(&parser_context_key, libpostal_thread_parser_context_destroy);
+}
+
+libpostal_address_parser_response_t *libpostal_parse_address_concurrent(char *address, libpostal_address_parser_options_t options) {
+    pthread_once(&parser_context_key_once, libpostal_parser_context_key_create);
+
+    address_parser_context_t *context = pthread_getspecific(parser_context_key);
+    if (context == NULL) {
+        context = address_parser_context_new();
+        if (context == NULL) return NULL;
+        if (pthread_setspecific(parser_context_key, context) != 0) {
+            address_parser_context_destroy(context);
+            return NULL;
+        }
+    }
+
+    return libpostal_parse_address_context(address, options, context);
+}
+
 bool libpostal_parser_print_features(bool print_features) {
     return address_parser_print_features(print_features);
 }
@@ -566,6 +611,166 @@ bool libpostal_setup(void) {
     return libpostal_setup_datadir(NULL);
 }
 
+typedef bool (*libpostal_module_setup_function)(char *path);
+
+typedef struct libpostal_setup_task {
+    char *name;
+    libpostal_module_setup_function setup;
+    char *path;
+    bool result;
+} libpostal_setup_task_t;
+
+#define LIBPOSTAL_MAX_SETUP_TASKS 5
+
+static void *libpostal_setup_task_run(void *arg) {
+    libpostal_setup_task_t *task = arg;
+    task->result = task->setup(task->path);
+    return NULL;
+}
+
+static libpostal_memory_report_t libpostal_memory_report = {0, 0, 0, 0};
+
+static void libpostal_setup_huge_pages(uint64_t options) {
+    uint64_t huge_pages_options = 0;
+    if (options & LIBPOSTAL_SETUP_HUGE_PAGES) huge_pages_options |= HUGE_PAGES_ADVISE;
+    if (options & LIBPOSTAL_SETUP_MLOCK) huge_pages_options |= HUGE_PAGES_MLOCK;
+
+    huge_pages_t *huge_pages = huge_pages_new(huge_pages_options);
+    if (huge_pages == NULL) return;
+
+    address_dictionary_t *dictionary = get_address_dictionary();
+    if (dictionary != NULL) {
+        huge_pages_remap_trie(huge_pages, dictionary->trie);
+    }
+
+    address_parser_t *parser = (options & LIBPOSTAL_SETUP_PARSER) ? get_address_parser() : NULL;
+    if (parser != NULL) {
+        if (parser->model_type == ADDRESS_PARSER_TYPE_CRF) {
+            huge_pages_remap_crf(huge_pages, parser->model.crf);
+        } else {
+            huge_pages_remap_averaged_perceptron(huge_pages, parser->model.ap);
+        }
+        huge_pages_remap_trie(huge_pages, parser->vocab);
+        huge_pages_remap_trie(huge_pages, parser->phrases);
+        huge_pages_remap_trie(huge_pages, parser->postal_codes);
+    }
+
+    language_classifier_t *classifier = (options & LIBPOSTAL_SETUP_LANGUAGE_CLASSIFIER) ? get_language_classifier() : NULL;
+    if (classifier != NULL) {
+        huge_pages_remap_trie(huge_pages, classifier->features);
+        if (classifier->weights_type == MATRIX_DENSE) {
+            huge_pages_remap_double_matrix(huge_pages, classifier->weights.dense);
+        } else {
+            huge_pages_remap_sparse_matrix(huge_pages, classifier->weights.sparse);
+        }
+    }
+
+    libpostal_memory_report = (libpostal_memory_report_t){
+        .num_arrays = huge_pages->num_arrays,
+        .moved_bytes = huge_pages->moved_bytes,
+        .huge_page_bytes = huge_pages_resident_bytes(huge_pages),
+        .locked_bytes = huge_pages->locked_bytes
+    };
+
+    log_info("Moved %zu arrays (%zu bytes) to huge pages, %zu bytes backed by huge pages, %zu bytes locked\n",
+             libpostal_memory_report.num_arrays, libpostal_memory_report.moved_bytes,
+             libpostal_memory_report.huge_page_bytes, libpostal_memory_report.locked_bytes);
+
+    huge_pages_destroy(huge_pages);
+}
+
+libpostal_memory_report_t libpostal_get_memory_report(void) {
+    return libpostal_memory_report;
+}
+
+libpostal_token_cache_stats_t libpostal_get_token_cache_stats(void) {
+    token_cache_stats_t stats = token_cache_get_stats();
+    uint64_t lookups = stats.hits + stats.misses;
+
+    return (libpostal_token_cache_stats_t){
+        .hits = stats.hits,
+        .misses = stats.misses,
+        .inserts = stats.inserts,
+        .evictions = stats.evictions,
+        .hit_rate = lookups > 0 ? (double)stats.hits / (double)lookups : 0.0
+    };
+}
+
+static void libpostal_add_setup_task(libpostal_setup_task_t *tasks, size_t *num_tasks, char *name, libpostal_module_setup_function setup, char *path) {
+    tasks[(*num_tasks)++] = (libpostal_setup_task_t){name, setup, path, false};
+}
+
+bool libpostal_setup_datadir_options(char *datadir, uint64_t options) {
+    libpostal_setup_task_t tasks[LIBPOSTAL_MAX_SETUP_TASKS];
+    size_t num_tasks = 0;
+
+    libpostal_add_setup_task(tasks, &num_tasks, "transliteration",
+                             options & LIBPOSTAL_SETUP_LAZY_TRANSLITERATION ? transliteration_module_setup_lazy : transliteration_module_setup,
+                             datadir != NULL ? path_join(3, datadir, LIBPOSTAL_TRANSLITERATION_SUBDIR, TRANSLITERATION_DATA_FILE) : NULL);
+
+    libpostal_add_setup_task(tasks, &num_tasks, "numex",
+                             options & LIBPOSTAL_SETUP_LAZY_NUMEX ? numex_module_setup_lazy : numex_module_setup,
+                             datadir != NULL ? path_join(3, datadir, LIBPOSTAL_NUMEX_SUBDIR, NUMEX_DATA_FILE) : NULL);
+
+    libpostal_add_setup_task(tasks, &num_tasks, "dictionary", address_dictionary_module_setup,
+                             datadir != NULL ? path_join(3, datadir, LIBPOSTAL_ADDRESS_EXPANSIONS_SUBDIR, ADDRESS_DICTIONARY_DATA_FILE) : NULL);
+
+    if (options & LIBPOSTAL_SETUP_PARSER) {
+        libpostal_add_setup_task(tasks, &num_tasks, "address parser", address_parser_module_setup,
+                                 datadir != NULL ? path_join(2, datadir, LIBPOSTAL_ADDRESS_PARSER_SUBDIR) : NULL);
+    }
+
+    if (options & LIBPOSTAL_SETUP_LANGUAGE_CLASSIFIER) {
+        libpostal_add_setup_task(tasks, &num_tasks, "language classifier", language_classifier_module_setup,
+                                 datadir != NULL ? path_join(2, datadir, LIBPOSTAL_LANGUAGE_CLASSIFIER_SUBDIR) : NULL);
+    }
+
+    // The modules share no state while loading, so each can be read on its own thread
+    pthread_t threads[LIBPOSTAL_MAX_SETUP_TASKS];
+    bool started[LIBPOSTAL_MAX_SETUP_TASKS] = {false};
+
+    for (size_t i = 0; i < num_tasks; i++) {
+        if (options & LIBPOSTAL_SETUP_PARALLEL) {
+            started[i] = pthread_create(&threads[i], NULL, libpostal_setup_task_run, &tasks[i]) == 0;
+        }
+        if (!started[i]) {
+            libpostal_setup_task_run(&tasks[i]);
+        }
+    }
+
+    bool setup_succeed = true;
+
+    for (size_t i = 0; i < num_tasks; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+
+        if (!tasks[i].result) {
+            log_error("Error loading %s module, dir=%s\n", tasks[i].name, tasks[i].path);
+            setup_succeed = false;
+        }
+
+        if (tasks[i].path != NULL) {
+            free(tasks[i].path);
+        }
+    }
+
+    // Done after loading so the arrays are final and no thread is using them yet
+    if (setup_succeed && (options & (LIBPOSTAL_SETUP_HUGE_PAGES | LIBPOSTAL_SETUP_MLOCK))) {
+        libpostal_setup_huge_pages(options);
+    }
+
+    if (setup_succeed && (options & LIBPOSTAL_SETUP_TOKEN_CACHE)) {
+        token_cache_enable(TOKEN_CACHE_DEFAULT_SIZE);
+    }
+
+    return setup_succeed;
+}
+
+bool libpostal_setup_options(uint64_t options) {
+    return libpostal_setup_datadir_options(NULL, options);
+}
+
 bool libpostal_setup_language_classifier_datadir(char *datadir) {
     char *language_classifier_dir = NULL;
 
@@ -693,6 +898,8 @@ bool libpostal_setup_parser(void) {
 }
 
 void libpostal_teardown(void) {
+    token_cache_disable();
+
     transliteration_module_teardown();
 
     numex_module_teardown();
@@ -706,4 +913,403 @@ void libpostal_teardown_language_classifier(void) {
 
 void libpostal_teardown_parser(void) {
     address_parser_module_teardown();
-}
\ No newline at end of file
+}
+/*
+Asynchronous API
+*/
+
+typedef enum {
+    LIBPOSTAL_ASYNC_PARSE,
+    LIBPOSTAL_ASYNC_EXPAND
+} libpostal_async_request_type_t;
+
+typedef struct libpostal_async_request {
+    libpostal_async_request_type_t type;
+    char *input;
+    libpostal_address_parser_options_t parser_options;
+    libpostal_normalize_options_t normalize_options;
+    libpostal_parse_callback parse_callback;
+    libpostal_expand_callback expand_callback;
+    void *userdata;
+    libpostal_address_parser_response_t *parsed;
+    char **expansions;
+    size_t num_expansions;
+    struct libpostal_async_request *next;
+} libpostal_async_request_t;
+
+typedef struct libpostal_async_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t idle;
+    libpostal_async_options_t options;
+    libpostal_async_request_t *head;
+    libpostal_async_request_t *tail;
+    // Completed requests waiting for libpostal_async_dispatch (use_notify_fd only)
+    libpostal_async_request_t *completed_head;
+    libpostal_async_request_t *completed_tail;
+    size_t num_active;          // queued or running
+    size_t num_pending;         // submitted and callback not yet run
+    bool stopped;
+    int notify_fd;
+    int notify_write_fd;
+    size_t num_workers;
+    pthread_t *workers;
+} libpostal_async_queue_t;
+
+static libpostal_async_queue_t *async_queue = NULL;
+
+static libpostal_async_options_t LIBPOSTAL_ASYNC_DEFAULT_OPTIONS = {
+    .num_workers = 4,
+    .max_pending = 0,
+    .use_notify_fd = false
+};
+
+libpostal_async_options_t libpostal_get_async_default_options(void) {
+    return LIBPOSTAL_ASYNC_DEFAULT_OPTIONS;
+}
+
+static void libpostal_async_request_destroy(libpostal_async_request_t *request) {
+    if (request == NULL) return;
+
+    if (request->input != NULL) free(request->input);
+    if (request->parser_options.language != NULL) free(request->parser_options.language);
+    if (request->parser_options.country != NULL) free(request->parser_options.country);
+
+    if (request->normalize_options.languages != NULL) {
+        for (size_t i = 0; i < request->normalize_options.num_languages; i++) {
+            if (request->normalize_options.languages[i] != NULL) free(request->normalize_options.languages[i]);
+        }
+        free(request->normalize_options.languages);
+    }
+
+    free(request);
+}
+
+// Callbacks own the results, only the request itself is freed afterward
+static void libpostal_async_request_complete(libpostal_async_request_t *request) {
+    if (request->type == LIBPOSTAL_ASYNC_PARSE) {
+        request->parse_callback(request->parsed, request->userdata);
+    } else {
+        request->expand_callback(request->expansions, request->num_expansions, request->userdata);
+    }
+    libpostal_async_request_destroy(request);
+}
+
+static void libpostal_async_notify(libpostal_async_queue_t *queue) {
+#ifdef HAVE_EVENTFD
+    uint64_t one = 1;
+    if (write(queue->notify_write_fd, &one, sizeof(one)) < 0) {
+        log_debug("eventfd write failed\n");
+    }
+#else
+    // A full pipe already has a notification waiting
+    char one = 1;
+    if (write(queue->notify_write_fd, &one, sizeof(one)) < 0) {
+        log_debug("notify pipe write failed\n");
+    }
+#endif
+}
+
+static void libpostal_async_clear_notify(libpostal_async_queue_t *queue) {
+#ifdef HAVE_EVENTFD
+    uint64_t count;
+    if (read(queue->notify_fd, &count, sizeof(count)) < 0) return;
+#else
+    char buf[256];
+    while (read(queue->notify_fd, buf, sizeof(buf)) > 0);
+#endif
+}
+
+static void *libpostal_async_worker(void *arg) {
+    libpostal_async_queue_t *queue = arg;
+
+    // Reused for every parse on this thread
+    address_parser_context_t *context = address_parser_context_new();
+
+    while (true) {
+        pthread_mutex_lock(&queue->lock);
+        while (queue->head == NULL && !queue->stopped) {
+            pthread_cond_wait(&queue->not_empty, &queue->lock);
+        }
+
+        libpostal_async_request_t *request = queue->head;
+        if (request == NULL) {
+            pthread_mutex_unlock(&queue->lock);
+            break;
+        }
+
+        queue->head = request->next;
+        if (queue->head == NULL) queue->tail = NULL;
+        request->next = NULL;
+        pthread_mutex_unlock(&queue->lock);
+
+        if (request->type == LIBPOSTAL_ASYNC_PARSE) {
+            request->parsed = context != NULL ? libpostal_parse_address_context(request->input, request->parser_options, context) : NULL;
+        } else {
+            request->expansions = libpostal_expand_address(request->input, request->normalize_options, &request->num_expansions);
+            if (request->expansions == NULL) request->num_expansions = 0;
+        }
+
+        bool use_notify_fd = queue->options.use_notify_fd;
+        if (!use_notify_fd) {
+            libpostal_async_request_complete(request);
+        }
+
+        pthread_mutex_lock(&queue->lock);
+        if (use_notify_fd) {
+            if (queue->completed_tail != NULL) {
+                queue->completed_tail->next = request;
+            } else {
+                queue->completed_head = request;
+            }
+            queue->completed_tail = request;
+        } else {
+            queue->num_pending--;
+        }
+        queue->num_active--;
+        if (queue->num_active == 0) {
+            pthread_cond_broadcast(&queue->idle);
+        }
+        pthread_mutex_unlock(&queue->lock);
+
+        if (use_notify_fd) {
+            libpostal_async_notify(queue);
+        }
+    }
+
+    if (context != NULL) {
+        address_parser_context_destroy(context);
+    }
+
+    return NULL;
+}
+
+static void libpostal_async_queue_destroy(libpostal_async_queue_t *queue) {
+    if (queue == NULL) return;
+
+    if (queue->notify_fd >= 0) close(queue->notify_fd);
+    if (queue->notify_write_fd >= 0 && queue->notify_write_fd != queue->notify_fd) close(queue->notify_write_fd);
+
+    if (queue->workers != NULL) free(queue->workers);
+
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->idle);
+
+    free(queue);
+}
+
+static void libpostal_async_stop_workers(libpostal_async_queue_t *queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->stopped = true;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+
+    for (size_t i = 0; i < queue->num_workers; i++) {
+        pthread_join(queue->workers[i], NULL);
+    }
+    queue->num_workers = 0;
+}
+
+bool libpostal_setup_async(libpostal_async_options_t options) {
+    if (async_queue != NULL) return true;
+    if (options.num_workers == 0) return false;
+
+    libpostal_async_queue_t *queue = calloc(1, sizeof(libpostal_async_queue_t));
+    if (queue == NULL) return false;
+
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->idle, NULL);
+    queue->options = options;
+    queue->notify_fd = -1;
+    queue->notify_write_fd = -1;
+
+    if (options.use_notify_fd) {
+#ifdef HAVE_EVENTFD
+        queue->notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        queue->notify_write_fd = queue->notify_fd;
+#else
+        int fds[2];
+        if (pipe(fds) == 0) {
+            fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+            fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+            queue->notify_fd = fds[0];
+            queue->notify_write_fd = fds[1];
+        }
+#endif
+        if (queue->notify_fd < 0) {
+            log_error("Could not create async notification descriptor\n");
+            libpostal_async_queue_destroy(queue);
+            return false;
+        }
+    }
+
+    queue->workers = malloc(options.num_workers * sizeof(pthread_t));
+    if (queue->workers == NULL) {
+        libpostal_async_queue_destroy(queue);
+        return false;
+    }
+
+    for (size_t i = 0; i < options.num_workers; i++) {
+        if (pthread_create(&queue->workers[i], NULL, libpostal_async_worker, queue) != 0) {
+            log_error("Could not start async worker\n");
+            libpostal_async_stop_workers(queue);
+            libpostal_async_queue_destroy(queue);
+            return false;
+        }
+        queue->num_workers++;
+    }
+
+    async_queue = queue;
+    return true;
+}
+
+static bool libpostal_async_submit(libpostal_async_request_t *request) {
+    libpostal_async_queue_t *queue = async_queue;
+    if (queue == NULL) {
+        log_error("async queue is not setup, call libpostal_setup_async()\n");
+        libpostal_async_request_destroy(request);
+        return false;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->stopped || (queue->options.max_pending > 0 && queue->num_pending >= queue->options.max_pending)) {
+        pthread_mutex_unlock(&queue->lock);
+        libpostal_async_request_destroy(request);
+        return false;
+    }
+
+    if (queue->tail != NULL) {
+        queue->tail->next = request;
+    } else {
+        queue->head = request;
+    }
+    queue->tail = request;
+    queue->num_active++;
+    queue->num_pending++;
+
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+    return true;
+}
+
+static char *libpostal_async_strdup(char *str) {
+    return str != NULL ? strdup(str) : NULL;
+}
+
+bool libpostal_submit_parse(char *address, libpostal_address_parser_options_t options, libpostal_parse_callback callback, void *userdata) {
+    if (address == NULL || callback == NULL) return false;
+
+    libpostal_async_request_t *request = calloc(1, sizeof(libpostal_async_request_t));
+    if (request == NULL) return false;
+
+    request->type = LIBPOSTAL_ASYNC_PARSE;
+    request->parse_callback = callback;
+    request->userdata = userdata;
+    request->input = strdup(address);
+    request->parser_options.language = libpostal_async_strdup(options.language);
+    request->parser_options.country = libpostal_async_strdup(options.country);
+
+    if (request->input == NULL || (options.language != NULL && request->parser_options.language == NULL) ||
+        (options.country != NULL && request->parser_options.country == NULL)) {
+        libpostal_async_request_destroy(request);
+        return false;
+    }
+
+    return libpostal_async_submit(request);
+}
+
+bool libpostal_submit_expand(char *input, libpostal_normalize_options_t options, libpostal_expand_callback callback, void *userdata) {
+    if (input == NULL || callback == NULL) return false;
+
+    libpostal_async_request_t *request = calloc(1, sizeof(libpostal_async_request_t));
+    if (request == NULL) return false;
+
+    request->type = LIBPOSTAL_ASYNC_EXPAND;
+    request->expand_callback = callback;
+    request->userdata = userdata;
+    request->input = strdup(input);
+    request->normalize_options = options;
+    request->normalize_options.languages = NULL;
+    request->normalize_options.num_languages = 0;
+
+    if (request->input == NULL) {
+        libpostal_async_request_destroy(request);
+        return false;
+    }
+
+    if (options.num_languages > 0 && options.languages != NULL) {
+        request->normalize_options.languages = calloc(options.num_languages, sizeof(char *));
+        if (request->normalize_options.languages == NULL) {
+            libpostal_async_request_destroy(request);
+            return false;
+        }
+        request->normalize_options.num_languages = options.num_languages;
+        for (size_t i = 0; i < options.num_languages; i++) {
+            request->normalize_options.languages[i] = strdup(options.languages[i]);
+            if (request->normalize_options.languages[i] == NULL) {
+                libpostal_async_request_destroy(request);
+                return false;
+            }
+        }
+    }
+
+    return libpostal_async_submit(request);
+}
+
+int libpostal_async_notify_fd(void) {
+    return async_queue != NULL ? async_queue->notify_fd : -1;
+}
+
+size_t libpostal_async_dispatch(void) {
+    libpostal_async_queue_t *queue = async_queue;
+    if (queue == NULL || !queue->options.use_notify_fd) return 0;
+
+    libpostal_async_clear_notify(queue);
+
+    pthread_mutex_lock(&queue->lock);
+    libpostal_async_request_t *request = queue->completed_head;
+    queue->completed_head = NULL;
+    queue->completed_tail = NULL;
+    pthread_mutex_unlock(&queue->lock);
+
+    size_t num_dispatched = 0;
+    while (request != NULL) {
+        libpostal_async_request_t *next = request->next;
+        libpostal_async_request_complete(request);
+        request = next;
+        num_dispatched++;
+    }
+
+    if (num_dispatched > 0) {
+        pthread_mutex_lock(&queue->lock);
+        queue->num_pending -= num_dispatched;
+        pthread_mutex_unlock(&queue->lock);
+    }
+
+    return num_dispatched;
+}
+
+void libpostal_async_wait(void) {
+    libpostal_async_queue_t *queue = async_queue;
+    if (queue == NULL) return;
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->num_active > 0) {
+        pthread_cond_wait(&queue->idle, &queue->lock);
+    }
+    pthread_mutex_unlock(&queue->lock);
+}
+
+void libpostal_teardown_async(void) {
+    libpostal_async_queue_t *queue = async_queue;
+    if (queue == NULL) return;
+
+    // Workers drain the queue before exiting
+    libpostal_async_stop_workers(queue);
+    libpostal_async_dispatch();
+
+    async_queue = NULL;
+    libpostal_async_queue_destroy(queue);
+}
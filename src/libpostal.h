@@ -165,6 +165,8 @@ LIBPOSTAL_EXPORT void libpostal_address_parser_response_destroy(libpostal_addres
 LIBPOSTAL_EXPORT libpostal_address_parser_options_t libpostal_get_address_parser_default_options(void);
 
 LIBPOSTAL_EXPORT libpostal_address_parser_response_t *libpostal_parse_address(char *address, libpostal_address_parser_options_t options);
+// Same as above, safe to call from several threads at once: each calling thread parses with its own scratch context
+LIBPOSTAL_EXPORT libpostal_address_parser_response_t *libpostal_parse_address_concurrent(char *address, libpostal_address_parser_options_t options);
 
 LIBPOSTAL_EXPORT bool libpostal_parser_print_features(bool print_features);
 
@@ -276,6 +278,99 @@ LIBPOSTAL_EXPORT bool libpostal_setup_language_classifier(void);
 LIBPOSTAL_EXPORT bool libpostal_setup_language_classifier_datadir(char *datadir);
 LIBPOSTAL_EXPORT void libpostal_teardown_language_classifier(void);
 
+/*
+Combined setup. Loads the modules of libpostal_setup plus, if requested, the
+parser and language classifier. With LIBPOSTAL_SETUP_PARALLEL the modules are
+read concurrently, one thread each. The LAZY options defer reading the numex or
+transliteration tables until the first call that needs them, which is safe to
+race from multiple threads. Tear down with the usual libpostal_teardown* calls.
+
+LIBPOSTAL_SETUP_HUGE_PAGES moves the large model arrays (dictionary, parser and
+classifier tries and weights) onto 2MB transparent huge pages after loading,
+which prefaults them, and LIBPOSTAL_SETUP_MLOCK locks them in memory (Linux
+only, results are unchanged). libpostal_get_memory_report describes the outcome.
+
+LIBPOSTAL_SETUP_TOKEN_CACHE memoizes token normalization and transliteration of
+short strings in a small per-thread cache, which pays off on large batches
+since the same tokens recur constantly. libpostal_get_token_cache_stats reports
+hits and misses across threads. The cache is dropped by libpostal_teardown.
+*/
+#define LIBPOSTAL_SETUP_PARALLEL (1 << 0)
+#define LIBPOSTAL_SETUP_PARSER (1 << 1)
+#define LIBPOSTAL_SETUP_LANGUAGE_CLASSIFIER (1 << 2)
+#define LIBPOSTAL_SETUP_LAZY_NUMEX (1 << 3)
+#define LIBPOSTAL_SETUP_LAZY_TRANSLITERATION (1 << 4)
+#define LIBPOSTAL_SETUP_HUGE_PAGES (1 << 5)
+#define LIBPOSTAL_SETUP_MLOCK (1 << 6)
+#define LIBPOSTAL_SETUP_TOKEN_CACHE (1 << 7)
+
+LIBPOSTAL_EXPORT bool libpostal_setup_options(uint64_t options);
+LIBPOSTAL_EXPORT bool libpostal_setup_datadir_options(char *datadir, uint64_t options);
+
+typedef struct libpostal_memory_report {
+    size_t num_arrays;          // Arrays moved onto huge pages
+    size_t moved_bytes;
+    size_t huge_page_bytes;     // Of those, bytes the kernel backed with huge pages (estimate)
+    size_t locked_bytes;
+} libpostal_memory_report_t;
+
+LIBPOSTAL_EXPORT libpostal_memory_report_t libpostal_get_memory_report(void);
+
+typedef struct libpostal_token_cache_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t inserts;
+    uint64_t evictions;
+    double hit_rate;
+} libpostal_token_cache_stats_t;
+
+LIBPOSTAL_EXPORT libpostal_token_cache_stats_t libpostal_get_token_cache_stats(void);
+
+/*
+Asynchronous parsing and expansion. libpostal_setup_async starts a pool of
+worker threads, each with its own parser context, so submissions run
+concurrently without blocking the caller. Inputs and options are copied on
+submit. Submission fails (returns false) when max_pending requests are
+outstanding, which caps the work queued behind the pool.
+
+Each callback receives ownership of its result, to be freed with
+libpostal_address_parser_response_destroy/libpostal_expansion_array_destroy,
+or NULL on error.
+
+By default callbacks run on the worker threads. With use_notify_fd they are
+queued instead: libpostal_async_notify_fd returns a descriptor (an eventfd on
+Linux) that becomes readable when completions are waiting, and
+libpostal_async_dispatch runs the waiting callbacks on the calling thread,
+which suits epoll/kqueue event loops.
+
+The modules used (libpostal_setup, the parser for parses) must be set up
+first and stay loaded until libpostal_teardown_async, which finishes all
+submitted work and delivers the remaining callbacks.
+*/
+
+typedef void (*libpostal_parse_callback)(libpostal_address_parser_response_t *response, void *userdata);
+typedef void (*libpostal_expand_callback)(char **expansions, size_t num_expansions, void *userdata);
+
+typedef struct libpostal_async_options {
+    size_t num_workers;
+    size_t max_pending;     // 0 for no limit
+    bool use_notify_fd;
+} libpostal_async_options_t;
+
+LIBPOSTAL_EXPORT libpostal_async_options_t libpostal_get_async_default_options(void);
+LIBPOSTAL_EXPORT bool libpostal_setup_async(libpostal_async_options_t options);
+
+LIBPOSTAL_EXPORT bool libpostal_submit_parse(char *address, libpostal_address_parser_options_t options, libpostal_parse_callback callback, void *userdata);
+LIBPOSTAL_EXPORT bool libpostal_submit_expand(char *input, libpostal_normalize_options_t options, libpostal_expand_callback callback, void *userdata);
+
+LIBPOSTAL_EXPORT int libpostal_async_notify_fd(void);
+// Runs the callbacks of completed requests, returns how many ran
+LIBPOSTAL_EXPORT size_t libpostal_async_dispatch(void);
+// Blocks until every submitted request has completed
+LIBPOSTAL_EXPORT void libpostal_async_wait(void);
+
+LIBPOSTAL_EXPORT void libpostal_teardown_async(void);
+
 /* Tokenization and token normalization APIs */
 
 typedef struct libpostal_token {
@@ -1,4 +1,6 @@
 #include <math.h>
+#include <pthread.h>
+#include <string.h>
 
 #include "logistic_regression.h"
 #include "logistic.h"
@@ -121,3 +123,168 @@ bool logistic_regression_gradient(double_matrix_t *theta, double_matrix_t *gradi
 
     return true;
 }
+
+/*
+Multi-threaded gradient. Rows of the minibatch are split between threads.
+Each thread computes p_y for its rows and accumulates x.T.dot(y - p_y) into
+its own gradient buffer, since rows from different threads can share
+columns. The buffers are then summed into gradient, with each thread
+reducing a slice of the gradient rows.
+*/
+
+typedef struct logistic_regression_gradient_task {
+    double_matrix_t *theta;
+    sparse_matrix_t *x;
+    uint32_array *y;
+    double_matrix_t *p_y;
+    double_matrix_t **partials;
+    size_t num_partials;
+    size_t index;
+    uint32_t row_start;
+    uint32_t row_end;
+    size_t reduce_start;
+    size_t reduce_end;
+} logistic_regression_gradient_task_t;
+
+static void *logistic_regression_gradient_rows(void *arg) {
+    logistic_regression_gradient_task_t *task = arg;
+
+    double_matrix_t *theta = task->theta;
+    double_matrix_t *gradient = task->partials[task->index];
+    double_matrix_zero(gradient);
+
+    size_t num_classes = theta->n;
+    uint32_t *indptr = task->x->indptr->a;
+    uint32_t *indices = task->x->indices->a;
+    double *data = task->x->data->a;
+
+    for (uint32_t row = task->row_start; row < task->row_end; row++) {
+        double *predicted = double_matrix_get_row(task->p_y, row);
+        memset(predicted, 0, num_classes * sizeof(double));
+
+        for (uint32_t k = indptr[row]; k < indptr[row + 1]; k++) {
+            double *theta_row = double_matrix_get_row(theta, indices[k]);
+            double value = data[k];
+            for (size_t j = 0; j < num_classes; j++) {
+                predicted[j] += value * theta_row[j];
+            }
+        }
+
+        softmax_vector(predicted, num_classes);
+
+        uint32_t y_i = task->y->a[row];
+        for (uint32_t k = indptr[row]; k < indptr[row + 1]; k++) {
+            double *gradient_row = double_matrix_get_row(gradient, indices[k]);
+            double value = data[k];
+            for (size_t j = 0; j < num_classes; j++) {
+                double residual = (y_i == j ? 1.0 : 0.0) - predicted[j];
+                gradient_row[j] += value * residual;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static void *logistic_regression_gradient_reduce(void *arg) {
+    logistic_regression_gradient_task_t *task = arg;
+
+    double_matrix_t *gradient = task->partials[0];
+    size_t num_classes = gradient->n;
+    double scale = -1.0 / task->x->m;
+
+    for (size_t i = task->reduce_start; i < task->reduce_end; i++) {
+        double *gradient_row = double_matrix_get_row(gradient, i);
+        for (size_t t = 1; t < task->num_partials; t++) {
+            double *partial_row = double_matrix_get_row(task->partials[t], i);
+            for (size_t j = 0; j < num_classes; j++) {
+                gradient_row[j] += partial_row[j];
+            }
+        }
+        for (size_t j = 0; j < num_classes; j++) {
+            gradient_row[j] *= scale;
+        }
+    }
+
+    return NULL;
+}
+
+static void logistic_regression_gradient_run(void *(*func)(void *), logistic_regression_gradient_task_t *tasks, size_t num_threads) {
+    pthread_t threads[num_threads];
+    bool started[num_threads];
+
+    // The calling thread takes the first task
+    for (size_t i = 1; i < num_threads; i++) {
+        started[i] = pthread_create(&threads[i], NULL, func, &tasks[i]) == 0;
+    }
+    func(&tasks[0]);
+
+    for (size_t i = 1; i < num_threads; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        } else {
+            func(&tasks[i]);
+        }
+    }
+}
+
+bool logistic_regression_gradient_threads(double_matrix_t *theta, double_matrix_t *gradient, sparse_matrix_t *x, uint32_array *y, double_matrix_t *p_y, double_matrix_t **thread_gradients, size_t num_threads) {
+    size_t m = x->m;
+    if (num_threads > m) num_threads = m;
+
+    if (num_threads <= 1 || thread_gradients == NULL) {
+        return logistic_regression_gradient(theta, gradient, x, y, p_y);
+    }
+
+    if (m != y->n || theta->m != gradient->m || theta->n != gradient->n) return false;
+
+    if (!double_matrix_resize_aligned(p_y, m, theta->n, 16)) {
+        return false;
+    }
+
+    double_matrix_t *partials[num_threads];
+    partials[0] = gradient;
+    for (size_t i = 1; i < num_threads; i++) {
+        partials[i] = thread_gradients[i - 1];
+        if (partials[i] == NULL || !double_matrix_resize(partials[i], gradient->m, gradient->n)) {
+            return false;
+        }
+    }
+
+    logistic_regression_gradient_task_t tasks[num_threads];
+
+    // Split rows so each thread gets about the same number of nonzeros
+    uint32_t *indptr = x->indptr->a;
+    size_t nnz = indptr[m];
+    uint32_t row = 0;
+    size_t gradient_rows = gradient->m;
+
+    for (size_t i = 0; i < num_threads; i++) {
+        size_t target = nnz * (i + 1) / num_threads;
+        uint32_t row_start = row;
+        if (i == num_threads - 1) {
+            row = (uint32_t)m;
+        } else {
+            while (row < m && indptr[row + 1] <= target) row++;
+        }
+
+        tasks[i] = (logistic_regression_gradient_task_t){
+            .theta = theta,
+            .x = x,
+            .y = y,
+            .p_y = p_y,
+            .partials = partials,
+            .num_partials = num_threads,
+            .index = i,
+            .row_start = row_start,
+            .row_end = row,
+            .reduce_start = gradient_rows * i / num_threads,
+            .reduce_end = gradient_rows * (i + 1) / num_threads
+        };
+    }
+
+    logistic_regression_gradient_run(logistic_regression_gradient_rows, tasks, num_threads);
+    logistic_regression_gradient_run(logistic_regression_gradient_reduce, tasks, num_threads);
+
+    return true;
+}
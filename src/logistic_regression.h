@@ -30,5 +30,7 @@ bool logistic_regression_model_expectation(double_matrix_t *theta, sparse_matrix
 bool logistic_regression_model_expectation_sparse(sparse_matrix_t *theta, sparse_matrix_t *x, double_matrix_t *p_y);
 double logistic_regression_cost_function(double_matrix_t *theta, sparse_matrix_t *x, uint32_array *y, double_matrix_t *p_y);
 bool logistic_regression_gradient(double_matrix_t *theta, double_matrix_t *gradient, sparse_matrix_t *x, uint32_array *y, double_matrix_t *p_y);
+// Same result as logistic_regression_gradient computed on num_threads threads, thread_gradients holds num_threads - 1 scratch matrices
+bool logistic_regression_gradient_threads(double_matrix_t *theta, double_matrix_t *gradient, sparse_matrix_t *x, uint32_array *y, double_matrix_t *p_y, double_matrix_t **thread_gradients, size_t num_threads);
 
 #endif
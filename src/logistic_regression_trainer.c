@@ -6,11 +6,11 @@
 void logistic_regression_trainer_destroy(logistic_regression_trainer_t *self) {
     if (self == NULL) return;
 
-    if (self->feature_ids != NULL) {
+    if (self->feature_ids != NULL && !self->shared_ids) {
         trie_destroy(self->feature_ids);
     }
 
-    if (self->label_ids != NULL) {
+    if (self->label_ids != NULL && !self->shared_ids) {
         kh_destroy(str_uint32, self->label_ids);
     }
 
@@ -30,18 +30,32 @@ void logistic_regression_trainer_destroy(logistic_regression_trainer_t *self) {
         double_matrix_destroy(self->gradient);
     }
 
+    if (self->thread_gradients != NULL) {
+        for (size_t i = 0; i + 1 < self->num_threads; i++) {
+            double_matrix_destroy(self->thread_gradients[i]);
+        }
+        free(self->thread_gradients);
+    }
+
     free(self);
 }
 
-static logistic_regression_trainer_t *logistic_regression_trainer_init(trie_t *feature_ids, khash_t(str_uint32) *label_ids) {
-    if (feature_ids == NULL || label_ids == NULL) return NULL;
+static logistic_regression_trainer_t *logistic_regression_trainer_init(trie_t *feature_ids, uint32_t hash_bits, uint32_t hash_seed, khash_t(str_uint32) *label_ids) {
+    if (label_ids == NULL) return NULL;
+    if (feature_ids == NULL && !feature_hash_valid_bits(hash_bits)) return NULL;
 
-    logistic_regression_trainer_t *trainer = malloc(sizeof(logistic_regression_trainer_t));
+    logistic_regression_trainer_t *trainer = calloc(1, sizeof(logistic_regression_trainer_t));
     if (trainer == NULL) return NULL;
 
     trainer->feature_ids = feature_ids;
-    // Add one feature for the bias unit
-    trainer->num_features = trie_num_keys(feature_ids) + 1;
+    trainer->hash_bits = feature_ids == NULL ? hash_bits : 0;
+    trainer->hash_seed = hash_seed;
+    if (feature_ids != NULL) {
+        // Add one feature for the bias unit
+        trainer->num_features = trie_num_keys(feature_ids) + 1;
+    } else {
+        trainer->num_features = FEATURE_HASH_NUM_FEATURES(hash_bits);
+    }
 
     trainer->label_ids = label_ids;
     trainer->num_labels = kh_size(label_ids);
@@ -65,6 +79,10 @@ static logistic_regression_trainer_t *logistic_regression_trainer_init(trie_t *f
         goto exit_trainer_created;
     }
 
+    trainer->num_threads = 1;
+    trainer->thread_gradients = NULL;
+    trainer->shared_ids = false;
+
     trainer->epochs = 0;
 
     return trainer;
@@ -74,8 +92,8 @@ exit_trainer_created:
     return NULL;
 }
 
-logistic_regression_trainer_t *logistic_regression_trainer_init_sgd(trie_t *feature_ids, khash_t(str_uint32) *label_ids, bool fit_intercept, regularization_type_t reg_type, double lambda, double gamma_0) {
-    logistic_regression_trainer_t *trainer = logistic_regression_trainer_init(feature_ids, label_ids);
+static logistic_regression_trainer_t *logistic_regression_trainer_init_sgd_params(trie_t *feature_ids, uint32_t hash_bits, uint32_t hash_seed, khash_t(str_uint32) *label_ids, bool fit_intercept, regularization_type_t reg_type, double lambda, double gamma_0) {
+    logistic_regression_trainer_t *trainer = logistic_regression_trainer_init(feature_ids, hash_bits, hash_seed, label_ids);
     if (trainer == NULL) {
         return NULL;
     }
@@ -90,8 +108,8 @@ logistic_regression_trainer_t *logistic_regression_trainer_init_sgd(trie_t *feat
     return trainer;
 }
 
-logistic_regression_trainer_t *logistic_regression_trainer_init_ftrl(trie_t *feature_ids, khash_t(str_uint32) *label_ids, double lambda1, double lambda2, double alpha, double beta) {
-    logistic_regression_trainer_t *trainer = logistic_regression_trainer_init(feature_ids, label_ids);
+static logistic_regression_trainer_t *logistic_regression_trainer_init_ftrl_params(trie_t *feature_ids, uint32_t hash_bits, uint32_t hash_seed, khash_t(str_uint32) *label_ids, double lambda1, double lambda2, double alpha, double beta) {
+    logistic_regression_trainer_t *trainer = logistic_regression_trainer_init(feature_ids, hash_bits, hash_seed, label_ids);
     if (trainer == NULL) {
         return NULL;
     }
@@ -108,6 +126,87 @@ logistic_regression_trainer_t *logistic_regression_trainer_init_ftrl(trie_t *fea
     return trainer;
 }
 
+sparse_matrix_t *logistic_regression_trainer_feature_matrix(logistic_regression_trainer_t *self, feature_count_array *features) {
+    if (self->feature_ids == NULL) {
+        return feature_matrix_hashed(self->hash_bits, self->hash_seed, features);
+    }
+    return feature_matrix(self->feature_ids, features);
+}
+
+logistic_regression_trainer_t *logistic_regression_trainer_init_sgd(trie_t *feature_ids, khash_t(str_uint32) *label_ids, bool fit_intercept, regularization_type_t reg_type, double lambda, double gamma_0) {
+    if (feature_ids == NULL) return NULL;
+    return logistic_regression_trainer_init_sgd_params(feature_ids, 0, 0, label_ids, fit_intercept, reg_type, lambda, gamma_0);
+}
+
+logistic_regression_trainer_t *logistic_regression_trainer_init_sgd_hashed(uint32_t hash_bits, uint32_t hash_seed, khash_t(str_uint32) *label_ids, bool fit_intercept, regularization_type_t reg_type, double lambda, double gamma_0) {
+    return logistic_regression_trainer_init_sgd_params(NULL, hash_bits, hash_seed, label_ids, fit_intercept, reg_type, lambda, gamma_0);
+}
+
+logistic_regression_trainer_t *logistic_regression_trainer_init_ftrl(trie_t *feature_ids, khash_t(str_uint32) *label_ids, double lambda1, double lambda2, double alpha, double beta) {
+    if (feature_ids == NULL) return NULL;
+    return logistic_regression_trainer_init_ftrl_params(feature_ids, 0, 0, label_ids, lambda1, lambda2, alpha, beta);
+}
+
+logistic_regression_trainer_t *logistic_regression_trainer_init_ftrl_hashed(uint32_t hash_bits, uint32_t hash_seed, khash_t(str_uint32) *label_ids, double lambda1, double lambda2, double alpha, double beta) {
+    return logistic_regression_trainer_init_ftrl_params(NULL, hash_bits, hash_seed, label_ids, lambda1, lambda2, alpha, beta);
+}
+
+logistic_regression_trainer_t *logistic_regression_trainer_init_shared(logistic_regression_trainer_t *other) {
+    if (other == NULL) return NULL;
+
+    logistic_regression_trainer_t *trainer = logistic_regression_trainer_init(other->feature_ids, other->hash_bits, other->hash_seed, other->label_ids);
+    if (trainer == NULL) return NULL;
+    trainer->shared_ids = true;
+
+    trainer->optimizer_type = other->optimizer_type;
+    if (other->optimizer_type == LOGISTIC_REGRESSION_OPTIMIZER_SGD) {
+        sgd_trainer_t *sgd = other->optimizer.sgd;
+        trainer->optimizer.sgd = sgd_trainer_new(trainer->num_features, trainer->num_labels, sgd->fit_intercept, sgd->reg_type, sgd->lambda, sgd->gamma_0);
+    } else if (other->optimizer_type == LOGISTIC_REGRESSION_OPTIMIZER_FTRL) {
+        ftrl_trainer_t *ftrl = other->optimizer.ftrl;
+        trainer->optimizer.ftrl = ftrl_trainer_new(trainer->num_features, trainer->num_labels, ftrl->fit_intercept, ftrl->alpha, ftrl->beta, ftrl->lambda1, ftrl->lambda2);
+    }
+
+    if (trainer->optimizer.sgd == NULL) {
+        logistic_regression_trainer_destroy(trainer);
+        return NULL;
+    }
+
+    return trainer;
+}
+
+bool logistic_regression_trainer_set_num_threads(logistic_regression_trainer_t *self, size_t num_threads) {
+    if (self == NULL || num_threads == 0) return false;
+
+    double_matrix_t **thread_gradients = NULL;
+    if (num_threads > 1) {
+        thread_gradients = calloc(num_threads - 1, sizeof(double_matrix_t *));
+        if (thread_gradients == NULL) return false;
+
+        for (size_t i = 0; i + 1 < num_threads; i++) {
+            thread_gradients[i] = double_matrix_new_zeros(INITIAL_FEATURE_BATCH_SIZE, self->num_labels);
+            if (thread_gradients[i] == NULL) {
+                for (size_t j = 0; j < i; j++) {
+                    double_matrix_destroy(thread_gradients[j]);
+                }
+                free(thread_gradients);
+                return false;
+            }
+        }
+    }
+
+    if (self->thread_gradients != NULL) {
+        for (size_t i = 0; i + 1 < self->num_threads; i++) {
+            double_matrix_destroy(self->thread_gradients[i]);
+        }
+        free(self->thread_gradients);
+    }
+
+    self->thread_gradients = thread_gradients;
+    self->num_threads = num_threads;
+    return true;
+}
+
 bool logistic_regression_trainer_reset_params_sgd(logistic_regression_trainer_t *self, double lambda, double gamma_0) {
     if (self == NULL || self->optimizer_type != LOGISTIC_REGRESSION_OPTIMIZER_SGD || self->optimizer.sgd == NULL) return false;
 
@@ -125,7 +224,7 @@ bool logistic_regression_trainer_reset_params_ftrl(logistic_regression_trainer_t
 static double logistic_regression_trainer_minibatch_cost_params(logistic_regression_trainer_t *self, feature_count_array *features, cstring_array *labels, bool regularized) {
     size_t n = self->num_labels;
 
-    sparse_matrix_t *x = feature_matrix(self->feature_ids, features);
+    sparse_matrix_t *x = logistic_regression_trainer_feature_matrix(self, features);
     uint32_array *y = label_vector(self->label_ids, labels);
     double_matrix_t *p_y = double_matrix_new_aligned(x->m, n, 16);
     double_matrix_zero(p_y);
@@ -182,9 +281,7 @@ double logistic_regression_trainer_regularization_cost(logistic_regression_train
 
 
 bool logistic_regression_trainer_train_minibatch(logistic_regression_trainer_t *self, feature_count_array *features, cstring_array *labels) {
-    double_matrix_t *gradient = self->gradient;
-
-    sparse_matrix_t *x = feature_matrix(self->feature_ids, features);
+    sparse_matrix_t *x = logistic_regression_trainer_feature_matrix(self, features);
     if (x == NULL) {
         log_error("x == NULL\n");
         return false;
@@ -192,9 +289,20 @@ bool logistic_regression_trainer_train_minibatch(logistic_regression_trainer_t *
     uint32_array *y = label_vector(self->label_ids, labels);
     if (y == NULL) {
         log_error("y == NULL\n");
+        sparse_matrix_destroy(x);
         return false;
     }
 
+    bool ret = logistic_regression_trainer_train_minibatch_sparse(self, x, y);
+
+    uint32_array_destroy(y);
+    sparse_matrix_destroy(x);
+    return ret;
+}
+
+bool logistic_regression_trainer_train_minibatch_sparse(logistic_regression_trainer_t *self, sparse_matrix_t *x, uint32_array *y) {
+    double_matrix_t *gradient = self->gradient;
+
     bool ret = false;
 
     if (!sparse_matrix_add_unique_columns_alias(x, self->unique_columns, self->batch_columns)) {
@@ -220,7 +328,7 @@ bool logistic_regression_trainer_train_minibatch(logistic_regression_trainer_t *
         return false;
     }
 
-    if (!logistic_regression_gradient(weights, gradient, x, y, p_y)) {
+    if (!logistic_regression_gradient_threads(weights, gradient, x, y, p_y, self->thread_gradients, self->num_threads)) {
         log_error("Gradient failed\n");
         goto exit_matrices_created;
     }
@@ -238,8 +346,6 @@ bool logistic_regression_trainer_train_minibatch(logistic_regression_trainer_t *
 
 exit_matrices_created:
     double_matrix_destroy(p_y);
-    uint32_array_destroy(y);
-    sparse_matrix_destroy(x);
     return ret;
 }
 
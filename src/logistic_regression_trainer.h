@@ -28,7 +28,9 @@
  } logistic_regression_optimizer_type;
 
 typedef struct logistic_regression_trainer {
-    trie_t *feature_ids;                                // Trie mapping features to array indices
+    trie_t *feature_ids;                                // Trie mapping features to array indices, NULL when hashing features
+    uint32_t hash_bits;                                 // Features are hashed into 2^hash_bits ids (see feature_hash.h)
+    uint32_t hash_seed;                                 // Seed for feature hashing
     size_t num_features;                                // Number of features
     khash_t(str_uint32) *label_ids;                     // Hashtable mapping labels to array indices
     size_t num_labels;                                  // Number of labels
@@ -36,6 +38,9 @@ typedef struct logistic_regression_trainer {
     khash_t(int_uint32) *unique_columns;                // Unique columns set
     uint32_array *batch_columns;                        // Unique columns as array
     double_matrix_t *batch_weights;                     // Weights updated in this batch
+    size_t num_threads;                                 // Threads used to compute each minibatch gradient
+    double_matrix_t **thread_gradients;                 // Per-thread gradient buffers (num_threads - 1)
+    bool shared_ids;                                    // feature_ids/label_ids are borrowed from another trainer
     uint32_t epochs;                                    // Number of epochs
     logistic_regression_optimizer_type optimizer_type;  // Trainer type
     union {
@@ -46,9 +51,18 @@ typedef struct logistic_regression_trainer {
 
 logistic_regression_trainer_t *logistic_regression_trainer_init_sgd(trie_t *feature_ids, khash_t(str_uint32) *label_ids, bool fit_intercept, regularization_type_t reg_type, double lambda, double gamma_0);
 logistic_regression_trainer_t *logistic_regression_trainer_init_ftrl(trie_t *feature_ids, khash_t(str_uint32) *label_ids, double lambda1, double lambda2, double alpha, double beta);
+// Same as above using the hashing trick instead of a feature trie
+logistic_regression_trainer_t *logistic_regression_trainer_init_sgd_hashed(uint32_t hash_bits, uint32_t hash_seed, khash_t(str_uint32) *label_ids, bool fit_intercept, regularization_type_t reg_type, double lambda, double gamma_0);
+logistic_regression_trainer_t *logistic_regression_trainer_init_ftrl_hashed(uint32_t hash_bits, uint32_t hash_seed, khash_t(str_uint32) *label_ids, double lambda1, double lambda2, double alpha, double beta);
+// New trainer with the same optimizer settings as other, borrowing its feature and label ids (other must outlive it)
+logistic_regression_trainer_t *logistic_regression_trainer_init_shared(logistic_regression_trainer_t *other);
+bool logistic_regression_trainer_set_num_threads(logistic_regression_trainer_t *self, size_t num_threads);
 bool logistic_regression_trainer_reset_params_sgd(logistic_regression_trainer_t *self, double lambda, double gamma_0);
 bool logistic_regression_trainer_reset_params_ftrl(logistic_regression_trainer_t *self, double alpha, double beta, double lambda1, double lambda2);
+sparse_matrix_t *logistic_regression_trainer_feature_matrix(logistic_regression_trainer_t *self, feature_count_array *features);
 bool logistic_regression_trainer_train_minibatch(logistic_regression_trainer_t *self, feature_count_array *features, cstring_array *labels);
+// Same as above for a prepared feature matrix and label vector. The columns of x are renumbered in place
+bool logistic_regression_trainer_train_minibatch_sparse(logistic_regression_trainer_t *self, sparse_matrix_t *x, uint32_array *y);
 double logistic_regression_trainer_minibatch_cost(logistic_regression_trainer_t *self, feature_count_array *features, cstring_array *labels);
 double logistic_regression_trainer_minibatch_cost_regularized(logistic_regression_trainer_t *self, feature_count_array *features, cstring_array *labels);
 double logistic_regression_trainer_regularization_cost(logistic_regression_trainer_t *self, size_t m);
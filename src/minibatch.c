@@ -1,8 +1,6 @@
 #include "minibatch.h"
 #include "float_utils.h"
 
-#define BIAS_FEATURE_ID 0
-
 bool count_features_minibatch(khash_t(str_double) *feature_counts, feature_count_array *minibatch, bool unique) {
     const char *feature;
     uint32_t feature_id;
@@ -169,6 +167,32 @@ sparse_matrix_t *feature_matrix(trie_t *feature_ids, feature_count_array *featur
     return matrix;
 }
 
+sparse_matrix_t *feature_matrix_hashed(uint32_t hash_bits, uint32_t hash_seed, feature_count_array *feature_counts) {
+    if (feature_counts == NULL || !feature_hash_valid_bits(hash_bits)) return NULL;
+
+    const char *feature;
+    double count;
+
+    size_t m = feature_counts->n;
+    size_t n = FEATURE_HASH_NUM_FEATURES(hash_bits);
+
+    sparse_matrix_t *matrix = sparse_matrix_new_shape(m, n);
+
+    for (size_t i = 0; i < m; i++) {
+        khash_t(str_double) *counts = feature_counts->a[i];
+        sparse_matrix_append(matrix, BIAS_FEATURE_ID, 1.0);
+
+        kh_foreach(counts, feature, count, {
+            uint32_t feature_id = feature_hash_id(feature, hash_seed, hash_bits) + 1;
+            sparse_matrix_append(matrix, feature_id, count);
+        })
+
+        sparse_matrix_finalize_row(matrix);
+    }
+
+    return matrix;
+}
+
 sparse_matrix_t *feature_vector(trie_t *feature_ids, khash_t(str_double) *feature_counts) {
     const char *feature;
     uint32_t feature_id;
@@ -5,12 +5,14 @@
 #include <stdlib.h>
 
 #include "collections.h"
+#include "feature_hash.h"
 #include "features.h"
 #include "sparse_matrix.h"
 #include "trie.h"
 #include "trie_utils.h"
 #include "vector_math.h"
 
+#define BIAS_FEATURE_ID 0
 
 bool count_features_minibatch(khash_t(str_double) *feature_counts, feature_count_array *minibatch, bool unique);
 bool count_labels_minibatch(khash_t(str_uint32) *label_counts, cstring_array *labels);
@@ -20,6 +22,9 @@ khash_t(str_uint32) *select_labels_threshold(khash_t(str_uint32) *label_counts,
 
 sparse_matrix_t *feature_matrix(trie_t *feature_ids, feature_count_array *feature_counts);
 sparse_matrix_t *feature_vector(trie_t *feature_ids, khash_t(str_double) *feature_counts);
+// Hashed feature space, feature ids are 1 + the feature's hash id so the bias unit stays at 0
+#define FEATURE_HASH_NUM_FEATURES(num_bits) ((1UL << (num_bits)) + 1)
+sparse_matrix_t *feature_matrix_hashed(uint32_t hash_bits, uint32_t hash_seed, feature_count_array *feature_counts);
 uint32_array *label_vector(khash_t(str_uint32) *label_ids, cstring_array *labels);
 
 
@@ -1,10 +1,17 @@
 #include "msgpack_utils.h"
 
-static char_array *read_string(char_array *str, size_t len, msgpack_buffer_t *buffer) {
+static bool read_string(cmp_ctx_t *ctx, char_array *str, size_t len) {
     char_array_clear(str);
-    char_array_cat_len(str, buffer->data->a + buffer->offset, len);
-    buffer->offset += len;
-    return str;
+    if (!char_array_resize(str, len + 1)) {
+        return false;
+    }
+
+    if (len > 0 && !ctx->read(ctx, str->a, len)) {
+        return false;
+    }
+    str->n = len;
+    char_array_terminate(str);
+    return true;
 }
 
 bool msgpack_bytes_reader(cmp_ctx_t *ctx, void *data, size_t size) {
@@ -17,6 +24,16 @@ bool msgpack_bytes_reader(cmp_ctx_t *ctx, void *data, size_t size) {
     return true;
 }
 
+bool msgpack_const_bytes_reader(cmp_ctx_t *ctx, void *data, size_t size) {
+    msgpack_bytes_t *buffer = ctx->buf;
+    if (buffer->offset + size > buffer->len) {
+        return false;
+    }
+    memcpy(data, buffer->data + buffer->offset, size);
+    buffer->offset += size;
+    return true;
+}
+
 size_t msgpack_bytes_writer(cmp_ctx_t *ctx, const void *data, size_t count) {
     msgpack_buffer_t *buffer = (msgpack_buffer_t *)ctx->buf;
     char_array_cat_len(buffer->data, (char *)data, count);
@@ -33,7 +50,9 @@ bool cmp_read_str_size_or_nil(cmp_ctx_t *ctx, char_array **str, uint32_t *size)
 
     if (cmp_object_is_str(&obj)) {
         *size = obj.as.str_size;
-        *str = read_string(*str, *size, ctx->buf);
+        if (!read_string(ctx, *str, *size)) {
+            return false;
+        }
     } else if (cmp_object_is_nil(&obj)) {
         *size = 0;
         char_array_clear(*str);
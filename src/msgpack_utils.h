@@ -14,9 +14,18 @@ typedef struct msgpack_buffer {
     int offset;
 } msgpack_buffer_t;
 
+// Read-only view of serialized bytes owned by someone else, e.g. a memory-mapped file
+typedef struct msgpack_bytes {
+    const uint8_t *data;
+    size_t len;
+    size_t offset;
+} msgpack_bytes_t;
+
 bool msgpack_bytes_reader(cmp_ctx_t *ctx, void *data, size_t size);
 size_t msgpack_bytes_writer(cmp_ctx_t *ctx, const void *data, size_t count);
 
+bool msgpack_const_bytes_reader(cmp_ctx_t *ctx, void *data, size_t size);
+
 bool cmp_read_str_size_or_nil(cmp_ctx_t *ctx, char_array **str, uint32_t *size);
 bool cmp_write_str_or_nil(cmp_ctx_t *ctx, char_array *str);
 
@@ -13,6 +13,7 @@
 #include "ngrams.h"
 #include "place.h"
 #include "scanner.h"
+#include "string_set.h"
 #include "string_utils.h"
 #include "tokens.h"
 #include "unicode_scripts.h"
@@ -160,45 +161,40 @@ cstring_array *expanded_component_combined(char *input, libpostal_normalize_opti
         *n = num_root_expansions;
         return root_expansions;
     } else {
-        khash_t(str_set) *unique_strings = kh_init(str_set);
-        khiter_t k;
+        string_set_t *unique_strings = string_set_new_size(num_expansions + num_root_expansions);
         int ret;
 
         cstring_array *all_expansions = cstring_array_new();
 
         for (size_t i = 0; i < num_expansions; i++) {
             expansion = cstring_array_get_string(expansions, i);
-            k = kh_get(str_set, unique_strings, expansion);
+            ret = string_set_add(unique_strings, expansion);
 
-            if (k == kh_end(unique_strings)) {
+            if (ret < 0) {
+                break;
+            } else if (ret > 0) {
                 cstring_array_add_string(all_expansions, expansion);
-                k = kh_put(str_set, unique_strings, expansion, &ret);
-                if (ret < 0) {
-                    break;
-                }
             }
         }
 
         for (size_t i = 0; i < num_root_expansions; i++) {
             expansion = cstring_array_get_string(root_expansions, i);
-            k = kh_get(str_set, unique_strings, expansion);
+            ret = string_set_add(unique_strings, expansion);
 
-            if (k == kh_end(unique_strings)) {
+            if (ret < 0) {
+                break;
+            } else if (ret > 0) {
                 if (remove_spaces) {
                     cstring_array_add_string_no_whitespace(all_expansions, expansion);
                 } else {
                     cstring_array_add_string(all_expansions, expansion);
                 }
-                k = kh_put(str_set, unique_strings, expansion, &ret);
-                if (ret < 0) {
-                    break;
-                }
             }
         }
 
         *n = cstring_array_num_strings(all_expansions);
 
-        kh_destroy(str_set, unique_strings);
+        string_set_destroy(unique_strings);
         cstring_array_destroy(root_expansions);
         cstring_array_destroy(expansions);
 
@@ -223,23 +219,25 @@ static cstring_array *geohash_and_neighbors(double latitude, double longitude, s
     if (geohash_precision > MAX_GEOHASH_PRECISION) geohash_precision = MAX_GEOHASH_PRECISION;
     size_t geohash_len = geohash_precision + 1;
 
-    char geohash[geohash_len];
-    if (geohash_encode(latitude, longitude, geohash, geohash_len) != GEOHASH_OK) {
+    // Neighbors are computed on the integer geohash, strings are only built for the output
+    uint64_t geohash;
+    if (geohash_encode_uint64(latitude, longitude, geohash_precision, &geohash) != GEOHASH_OK) {
         return NULL;
     }
 
-    size_t neighbors_size = geohash_len * 8;
-    char neighbors[neighbors_size];
-
-    int num_strings = 0;
+    uint64_t neighbors[8];
+    size_t num_neighbors = 0;
 
-    if (geohash_neighbors(geohash, neighbors, neighbors_size, &num_strings) == GEOHASH_OK && num_strings == 8) {
+    if (geohash_neighbors_uint64(geohash, geohash_precision, neighbors, &num_neighbors) == GEOHASH_OK && num_neighbors == 8) {
         cstring_array *strings = cstring_array_new_size(9 * geohash_len);
-        cstring_array_add_string(strings, geohash);
+        char geohash_str[geohash_len];
 
-        for (int i = 0; i < num_strings; i++) {
-            char *neighbor = neighbors + geohash_len * i;
-            cstring_array_add_string(strings, neighbor);
+        geohash_uint64_to_string(geohash, geohash_precision, geohash_str, geohash_len);
+        cstring_array_add_string(strings, geohash_str);
+
+        for (size_t i = 0; i < num_neighbors; i++) {
+            geohash_uint64_to_string(neighbors[i], geohash_precision, geohash_str, geohash_len);
+            cstring_array_add_string(strings, geohash_str);
         }
         return strings;
     }
@@ -248,22 +246,15 @@ static cstring_array *geohash_and_neighbors(double latitude, double longitude, s
 }
 
 
-static inline bool add_string_to_array_if_unique(char *str, cstring_array *strings, khash_t(str_set) *unique_strings) {
-    khiter_t k = kh_get(str_set, unique_strings, str);
-    int ret = 0;
-    if (k == kh_end(unique_strings)) {
+static inline bool add_string_to_array_if_unique(char *str, cstring_array *strings, string_set_t *unique_strings) {
+    if (string_set_add(unique_strings, str) == 1) {
         cstring_array_add_string(strings, str);
-        k = kh_put(str_set, unique_strings, strdup(str), &ret);
-
-        if (ret < 0) {
-            return false;
-        }
         return true;
     }
     return false;
 }
 
-static inline bool add_quadgrams_or_string_to_array_if_unique(char *str, cstring_array *strings, khash_t(str_set) *unique_strings, cstring_array *ngrams) {
+static inline bool add_quadgrams_or_string_to_array_if_unique(char *str, cstring_array *strings, string_set_t *unique_strings, cstring_array *ngrams) {
     if (str == NULL || strings == NULL || unique_strings == NULL || ngrams == NULL) return false;
     cstring_array_clear(ngrams);
     bool prefix = false;
@@ -280,14 +271,25 @@ static inline bool add_quadgrams_or_string_to_array_if_unique(char *str, cstring
     return true;
 }
 
-static inline bool add_double_metaphone_to_array_if_unique(char *str, cstring_array *strings, khash_t(str_set) *unique_strings, cstring_array *ngrams) {
+static inline bool add_double_metaphone_to_array_if_unique(char *str, cstring_array *strings, string_set_t *unique_strings, cstring_array *ngrams) {
     if (str == NULL) return false;
-    double_metaphone_codes_t *dm_codes = double_metaphone(str);
-    if (dm_codes == NULL) {
-        return false;
+
+    char dm_primary_buffer[DOUBLE_METAPHONE_CODE_SIZE];
+    char dm_secondary_buffer[DOUBLE_METAPHONE_CODE_SIZE];
+
+    double_metaphone_codes_t *dm_codes = NULL;
+    char *dm_primary = dm_primary_buffer;
+    char *dm_secondary = dm_secondary_buffer;
+
+    // Only very long tokens need the allocating version
+    if (!double_metaphone_codes_buffer(str, dm_primary_buffer, dm_secondary_buffer, DOUBLE_METAPHONE_CODE_SIZE)) {
+        dm_codes = double_metaphone(str);
+        if (dm_codes == NULL) {
+            return false;
+        }
+        dm_primary = dm_codes->primary;
+        dm_secondary = dm_codes->secondary;
     }
-    char *dm_primary = dm_codes->primary;
-    char *dm_secondary = dm_codes->secondary;
 
     if (!string_equals(dm_primary, "")) {
         add_quadgrams_or_string_to_array_if_unique(dm_primary, strings, unique_strings, ngrams);
@@ -296,12 +298,15 @@ static inline bool add_double_metaphone_to_array_if_unique(char *str, cstring_ar
             add_quadgrams_or_string_to_array_if_unique(dm_secondary, strings, unique_strings, ngrams);
         }
     }
-    double_metaphone_codes_destroy(dm_codes);
+
+    if (dm_codes != NULL) {
+        double_metaphone_codes_destroy(dm_codes);
+    }
 
     return true;
 }
 
-static inline bool add_double_metaphone_or_token_if_unique(char *str, cstring_array *strings, khash_t(str_set) *unique_strings, cstring_array *ngrams) {
+static inline bool add_double_metaphone_or_token_if_unique(char *str, cstring_array *strings, string_set_t *unique_strings, cstring_array *ngrams) {
     if (str == NULL) return false;
     size_t len = strlen(str);
     string_script_t token_script = get_string_script(str, len);
@@ -345,7 +350,7 @@ cstring_array *name_word_hashes(char *name, libpostal_normalize_options_t normal
 
     cstring_array *ngrams = cstring_array_new();
 
-    khash_t(str_set) *unique_strings = kh_init(str_set);
+    string_set_t *unique_strings = string_set_new();
     bool keep_whitespace = false;
 
     for (size_t i = 0; i < num_expansions; i++) {
@@ -574,12 +579,7 @@ cstring_array *name_word_hashes(char *name, libpostal_normalize_options_t normal
 
     cstring_array_destroy(name_expansions);
 
-    const char *key;
-
-    kh_foreach_key(unique_strings, key, {
-        free((char *)key);
-    });
-    kh_destroy(str_set, unique_strings);
+    string_set_destroy(unique_strings);
 
     return strings;
 }
@@ -1,5 +1,6 @@
 #include "normalize.h"
 #include "strndup.h"
+#include "token_cache.h"
 
 #define FULL_STOP_CODEPOINT 0x002e
 #define APOSTROPHE_CODEPOINT 0x0027
@@ -390,7 +391,7 @@ bool numeric_starts_with_alpha(char *str, token_t token) {
     return false;
 }
 
-void add_normalized_token(char_array *array, char *str, token_t token, uint64_t options) {
+static void add_normalized_token_chars(char_array *array, char *str, token_t token, uint64_t options) {
     size_t idx = 0;
 
     uint8_t *ptr = (uint8_t *)str + token.offset;
@@ -500,9 +501,36 @@ void add_normalized_token(char_array *array, char *str, token_t token, uint64_t
             last_was_number = is_number;
         }
     }
+}
 
-    char_array_terminate(array);
+static bool token_ends_with_hyphen(char *str, token_t token) {
+    int32_t ch;
+    ssize_t char_len = utf8proc_iterate_reversed((uint8_t *)str + token.offset, token.len, &ch);
+    return char_len > 0 && utf8_is_hyphen(ch);
+}
+
+void add_normalized_token(char_array *array, char *str, token_t token, uint64_t options) {
+    /*
+    Hyphen handling looks at the character after each hyphen, which for a
+    trailing hyphen lies past the end of the token. Other tokens normalize
+    the same way given their bytes, type and options, so only those are cached.
+    */
+    if (token_ends_with_hyphen(str, token)) {
+        add_normalized_token_chars(array, str, token, options);
+        char_array_terminate(array);
+        return;
+    }
+
+    char *key = str + token.offset;
+    uint64_t tag = TOKEN_CACHE_TAG(TOKEN_CACHE_NORMALIZE_TOKEN, (options << 16) | token.type);
 
+    if (!token_cache_get(tag, key, token.len, array)) {
+        size_t start = array->n;
+        add_normalized_token_chars(array, str, token, options);
+        token_cache_put(tag, key, token.len, array->a + start, array->n - start);
+    }
+
+    char_array_terminate(array);
 }
 
 inline void normalize_token(cstring_array *array, char *str, token_t token, uint64_t options) {
@@ -2,6 +2,7 @@
 #include <float.h>
 #include "numex.h"
 #include "file_utils.h"
+#include "lazy_module.h"
 
 #include "log/log.h"
 
@@ -24,6 +25,8 @@
 
 numex_table_t *numex_table = NULL;
 
+static lazy_module_t numex_lazy_module = LAZY_MODULE_INIT("numex", numex_module_setup);
+
 numex_table_t *get_numex_table(void) {
     return numex_table;
 }
@@ -116,6 +119,9 @@ numex_language_t *numex_language_new(char *name, bool whole_tokens_only, size_t
     language->ordinals_index = ordinals_index;
     language->num_ordinals = num_ordinals;
 
+    memset(language->first_bytes, 0, sizeof(language->first_bytes));
+    language->prefixes = NULL;
+
     return language;
 }
 
@@ -126,9 +132,137 @@ void numex_language_destroy(numex_language_t *self) {
         free(self->name);
     }
 
+    if (self->prefixes != NULL) {
+        free(self->prefixes);
+    }
+
     free(self);
 }
 
+static inline bool numex_trie_has_transition(trie_t *trie, uint32_t node_id, unsigned char c, uint32_t *next_id) {
+    uint8_t char_index = trie->alpha_map[c];
+    if (char_index >= trie->alphabet_size || (unsigned char)trie->alphabet[char_index] != c) return false;
+
+    trie_node_t node = trie_get_node(trie, node_id);
+    if (node.base < 0) return false;
+
+    *next_id = trie_get_transition_index(trie, node, c);
+    return trie_get_node(trie, *next_id).check == (int32_t)node_id;
+}
+
+static inline size_t numex_prefix_index(unsigned char first, unsigned char second) {
+    return (size_t)first << 8 | second;
+}
+
+static inline bool numex_language_has_prefix(numex_language_t *self, unsigned char first, unsigned char second) {
+    size_t index = numex_prefix_index(first, second);
+    return (self->prefixes[index / 64] >> (index % 64)) & 1;
+}
+
+/*
+Most strings passed to convert_numeric_expressions have no number words at all
+(only digits), so each language records the first byte and the first two bytes
+of its keys, the latter as an exact bitmap over all 65536 byte pairs. A key can
+only start matching at the beginning of the string or after a separator/hyphen,
+which is all numex_language_may_match checks.
+*/
+bool numex_language_build_prefilter(numex_language_t *self, trie_t *trie) {
+    if (self == NULL || trie == NULL) return false;
+
+    trie_prefix_result_t prefix = trie_get_prefix(trie, self->name);
+    if (prefix.node_id == NULL_NODE_ID) return false;
+    prefix = trie_get_prefix_from_index(trie, NAMESPACE_SEPARATOR_CHAR, NAMESPACE_SEPARATOR_CHAR_LEN, prefix.node_id, prefix.tail_pos);
+    // Namespace ends in a tail, keep the slow path
+    if (prefix.node_id == NULL_NODE_ID || prefix.tail_pos > 0) return false;
+
+    uint32_t start_node_id = prefix.node_id;
+    uint64_t *prefixes = calloc(NUMEX_PREFIX_BITMAP_WORDS, sizeof(uint64_t));
+    if (prefixes == NULL) return false;
+
+    for (int c0 = 1; c0 < NUM_CHARS; c0++) {
+        uint32_t first_id;
+        if (!numex_trie_has_transition(trie, start_node_id, (unsigned char)c0, &first_id)) continue;
+
+        self->first_bytes[c0 / 64] |= 1ULL << (c0 % 64);
+
+        trie_node_t first_node = trie_get_node(trie, first_id);
+        if (first_node.base < 0) {
+            trie_data_node_t data_node = trie_get_data_node(trie, first_node);
+            size_t index = numex_prefix_index((unsigned char)c0, trie->tail->a[data_node.tail]);
+            prefixes[index / 64] |= 1ULL << (index % 64);
+            continue;
+        }
+
+        for (int c1 = 0; c1 < NUM_CHARS; c1++) {
+            uint32_t second_id;
+            if (numex_trie_has_transition(trie, first_id, (unsigned char)c1, &second_id)) {
+                size_t index = numex_prefix_index((unsigned char)c0, (unsigned char)c1);
+                prefixes[index / 64] |= 1ULL << (index % 64);
+            }
+        }
+    }
+
+    if (self->prefixes != NULL) {
+        free(self->prefixes);
+    }
+    self->prefixes = prefixes;
+
+    return true;
+}
+
+static inline bool numex_language_has_first_byte(numex_language_t *self, unsigned char c) {
+    return (self->first_bytes[c / 64] >> (c % 64)) & 1;
+}
+
+static bool numex_language_may_start_at(numex_language_t *self, uint8_t *ptr, size_t len, size_t char_len, bool is_separator) {
+    // The trie search tries a plain space for any other separator
+    if (is_separator && numex_language_has_first_byte(self, ' ')) return true;
+
+    unsigned char first = ptr[0];
+    if (!numex_language_has_first_byte(self, first)) return false;
+
+    if (numex_language_has_prefix(self, first, '\0')) return true;
+
+    if (len < 2) return false;
+
+    if (char_len == 1) {
+        // Hyphens and separators after the first char may be skipped or rewritten by the search
+        int32_t codepoint;
+        ssize_t next_len = utf8proc_iterate(ptr + 1, len - 1, &codepoint);
+        if (next_len <= 0 || utf8_is_hyphen(codepoint) || utf8_is_separator(utf8proc_category(codepoint))) {
+            return true;
+        }
+    }
+
+    return numex_language_has_prefix(self, first, ptr[1]);
+}
+
+bool numex_language_may_match(numex_language_t *self, char *str, size_t len) {
+    if (self == NULL || self->prefixes == NULL) return true;
+
+    uint8_t *ptr = (uint8_t *)str;
+    size_t idx = 0;
+    bool token_start = true;
+
+    while (idx < len) {
+        int32_t codepoint;
+        ssize_t char_len = utf8proc_iterate(ptr + idx, len - idx, &codepoint);
+        if (char_len <= 0) return true;
+
+        bool is_separator = utf8_is_separator(utf8proc_category(codepoint));
+        bool is_hyphen = utf8_is_hyphen(codepoint);
+
+        if (token_start && numex_language_may_start_at(self, ptr + idx, len - idx, (size_t)char_len, is_separator)) {
+            return true;
+        }
+
+        token_start = is_separator || is_hyphen;
+        idx += char_len;
+    }
+
+    return false;
+}
+
 bool numex_table_add_language(numex_language_t *language) {
     if (numex_table == NULL) {
         log_error(NUMEX_SETUP_ERROR);
@@ -143,6 +277,7 @@ bool numex_table_add_language(numex_language_t *language) {
 }
 
 numex_language_t *get_numex_language(char *name) {
+    lazy_module_ensure(&numex_lazy_module);
     if (numex_table == NULL) {
         log_error(NUMEX_SETUP_ERROR);
         return NULL;
@@ -506,6 +641,13 @@ bool numex_table_read(FILE *f) {
 
     log_debug("read trie\n");
 
+    const char *language_name;
+    kh_foreach(numex_table->languages, language_name, language, {
+        if (!numex_language_build_prefilter(language, numex_table->trie)) {
+            log_debug("No numex prefilter for %s\n", language_name);
+        }
+    })
+
     return true;
 
 exit_numex_table_load_error:
@@ -615,11 +757,20 @@ bool numex_module_setup(char *filename) {
     return true;
 }
 
+// Records the path and loads the table on first use instead
+bool numex_module_setup_lazy(char *filename) {
+    if (numex_table != NULL) {
+        return true;
+    }
+    return lazy_module_defer(&numex_lazy_module, filename);
+}
+
 /* Teardown method for the module
 Called once when done with the module (usually at
 the end of a main method)
 */
 void numex_module_teardown(void) {
+    lazy_module_cancel(&numex_lazy_module);
     numex_table_destroy();
     numex_table = NULL;
 }
@@ -647,6 +798,7 @@ static inline numex_rule_t get_numex_rule(size_t i) {
 }
 
 numex_result_array *convert_numeric_expressions(char *str, char *lang) {
+    lazy_module_ensure(&numex_lazy_module);
     if (numex_table == NULL) {
         log_error(NUMEX_SETUP_ERROR);
         return NULL;
@@ -659,6 +811,12 @@ numex_result_array *convert_numeric_expressions(char *str, char *lang) {
 
     if (language == NULL) return NULL;
 
+    size_t len = strlen(str);
+
+    if (!numex_language_may_match(language, str, len)) {
+        return NULL;
+    }
+
     bool whole_tokens_only = language->whole_tokens_only;
 
     trie_prefix_result_t prefix = trie_get_prefix(trie, lang);
@@ -693,7 +851,6 @@ numex_result_array *convert_numeric_expressions(char *str, char *lang) {
 
     phrase_t stopword_phrase;
 
-    size_t len = strlen(str);
     size_t idx = 0;
 
     int cat;
@@ -1115,6 +1272,7 @@ size_t ordinal_suffix_len(char *str, size_t len, char *lang) {
         return 0;
     }
 
+    lazy_module_ensure(&numex_lazy_module);
     if (numex_table == NULL) {
         log_error(NUMEX_SETUP_ERROR);
         return 0;
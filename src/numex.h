@@ -25,6 +25,8 @@
 
 #define LATIN_LANGUAGE_CODE "la"
 
+#define NUMEX_PREFIX_BITMAP_WORDS ((1 << 16) / 64)
+
 #define GENDER_MASCULINE_PREFIX "m"
 #define GENDER_FEMININE_PREFIX "f"
 #define GENDER_NEUTER_PREFIX "n"
@@ -116,6 +118,9 @@ typedef struct numex_language {
     size_t num_rules;
     size_t ordinals_index;
     size_t num_ordinals;
+    // Prefilter built at load time: first bytes and first two bytes of the language's keys
+    uint64_t first_bytes[4];
+    uint64_t *prefixes;     // NUMEX_PREFIX_BITMAP_WORDS words, bit (first << 8 | second)
 } numex_language_t;
 
 KHASH_MAP_INIT_STR(str_numex_language, numex_language_t *)
@@ -131,6 +136,8 @@ numex_table_t *get_numex_table(void);
 
 numex_language_t *numex_language_new(char *name, bool whole_tokens_only, size_t rules_index, size_t num_rules, size_t ordinals_index, size_t num_ordinals);
 void numex_language_destroy(numex_language_t *self);
+bool numex_language_build_prefilter(numex_language_t *self, trie_t *trie);
+bool numex_language_may_match(numex_language_t *self, char *str, size_t len);
 
 bool numex_table_add_language(numex_language_t *language);
 
@@ -163,6 +170,7 @@ bool numex_table_save(char *filename);
 
 bool numex_module_init(void);
 bool numex_module_setup(char *filename);
+bool numex_module_setup_lazy(char *filename);
 void numex_module_teardown(void);
 
  
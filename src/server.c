@@ -0,0 +1,1119 @@
+/*
+server.c
+--------
+
+libpostal_server loads the models once and answers requests from many
+clients over a Unix domain socket and, optionally, a minimal HTTP endpoint.
+
+Both front ends accept the same request form, a path with a URL-encoded
+query string:
+
+    /expand?address=...[&language=en...][&root=1]
+    /parse?address=...[&language=..][&country=..]
+    /classify?text=...
+    /near_dupe?name=...&house_number=...&road=...[&language=..][&latitude=..&longitude=..]
+    /stats
+
+On the Unix socket every request is one line and every response is one line
+of JSON. Over HTTP the request target is the path and the response body is
+the same JSON.
+
+The loaded models are shared read-only, so libpostal calls run on a pool of
+model threads (--model-workers, one per CPU by default), parsing with
+libpostal_parse_address_concurrent. A separate pool of connection threads
+(--workers) reads and decodes requests and enqueues them. Each model thread
+takes micro-batches off the queue: everything pending, up to --max-batch,
+optionally waiting --batch-wait-us for a batch to fill. This amortizes the
+handoff between threads across concurrent clients.
+
+A connection that sends nothing for --idle-timeout-sec seconds is closed so
+that idle persistent clients don't hold on to connection threads.
+
+Usage: ./libpostal_server [--socket path] [--port n] [--host addr] [--workers n] [--model-workers n]
+                          [--max-batch n] [--batch-wait-us n] [--idle-timeout-sec n] [--datadir dir] [--huge-pages]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "libpostal.h"
+#include "json_encode.h"
+#include "log/log.h"
+#include "string_utils.h"
+
+#define LIBPOSTAL_SERVER_USAGE "Usage: ./libpostal_server [--socket path] [--port n] [--host addr] [--workers n] [--model-workers n] [--max-batch n] [--batch-wait-us n] [--idle-timeout-sec n] [--datadir dir] [--huge-pages]\n"
+
+#define DEFAULT_SERVER_SOCKET_PATH "/tmp/libpostal.sock"
+#define DEFAULT_SERVER_HOST "127.0.0.1"
+#define DEFAULT_SERVER_WORKERS 16
+#define DEFAULT_SERVER_MAX_BATCH 64
+#define DEFAULT_SERVER_BATCH_WAIT_US 0
+#define DEFAULT_SERVER_IDLE_TIMEOUT_SEC 30
+
+#define SERVER_LISTEN_BACKLOG 128
+#define SERVER_CONNECTION_QUEUE_SIZE 1024
+#define SERVER_MAX_LINE_LEN (64 * 1024)
+#define SERVER_READ_BUFFER_SIZE 4096
+#define SERVER_POLL_TIMEOUT_MS 500
+#define SERVER_RECV_TIMEOUT_SEC 1
+
+#define HTTP_OK 200
+#define HTTP_BAD_REQUEST 400
+#define HTTP_NOT_FOUND 404
+#define HTTP_METHOD_NOT_ALLOWED 405
+
+static volatile sig_atomic_t server_running = 1;
+
+static uint64_t server_idle_timeout_sec = DEFAULT_SERVER_IDLE_TIMEOUT_SEC;
+
+typedef enum {
+    SERVER_REQUEST_EXPAND,
+    SERVER_REQUEST_PARSE,
+    SERVER_REQUEST_CLASSIFY,
+    SERVER_REQUEST_NEAR_DUPE,
+    SERVER_REQUEST_STATS
+} server_request_type_t;
+
+typedef struct server_request {
+    server_request_type_t type;
+    cstring_array *keys;
+    cstring_array *values;
+    int status;
+    char_array *response;
+    bool done;
+    uint64_t enqueued_ns;
+    struct server_request *next;
+} server_request_t;
+
+typedef struct server_stats {
+    uint64_t num_requests;
+    uint64_t num_batches;
+    uint64_t total_latency_ns;
+    uint64_t max_latency_ns;
+    size_t max_batch_size;
+} server_stats_t;
+
+typedef struct server_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t done;
+    server_request_t *head;
+    server_request_t *tail;
+    size_t size;
+    size_t max_batch;
+    uint64_t batch_wait_us;
+    bool stopped;
+} server_queue_t;
+
+typedef struct server_connection {
+    int fd;
+    bool http;
+} server_connection_t;
+
+typedef struct server_connection_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    server_connection_t connections[SERVER_CONNECTION_QUEUE_SIZE];
+    size_t head;
+    size_t size;
+    bool stopped;
+} server_connection_queue_t;
+
+typedef struct server_reader {
+    int fd;
+    char buf[SERVER_READ_BUFFER_SIZE];
+    size_t pos;
+    size_t len;
+} server_reader_t;
+
+static server_queue_t request_queue = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .not_empty = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER
+};
+
+static server_connection_queue_t connection_queue = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .not_empty = PTHREAD_COND_INITIALIZER,
+    .not_full = PTHREAD_COND_INITIALIZER
+};
+
+// Guarded by request_queue.lock
+static server_stats_t server_stats;
+
+static uint64_t server_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void server_signal_handler(int sig) {
+    (void)sig;
+    server_running = 0;
+}
+
+/*
+Requests
+*/
+
+static server_request_t *server_request_new(server_request_type_t type) {
+    server_request_t *request = calloc(1, sizeof(server_request_t));
+    if (request == NULL) return NULL;
+
+    request->type = type;
+    request->keys = cstring_array_new();
+    request->values = cstring_array_new();
+    request->response = char_array_new();
+    request->status = HTTP_OK;
+
+    if (request->keys == NULL || request->values == NULL || request->response == NULL) {
+        if (request->keys != NULL) cstring_array_destroy(request->keys);
+        if (request->values != NULL) cstring_array_destroy(request->values);
+        if (request->response != NULL) char_array_destroy(request->response);
+        free(request);
+        return NULL;
+    }
+
+    return request;
+}
+
+static void server_request_destroy(server_request_t *self) {
+    if (self == NULL) return;
+
+    cstring_array_destroy(self->keys);
+    cstring_array_destroy(self->values);
+    char_array_destroy(self->response);
+    free(self);
+}
+
+static char *server_request_get(server_request_t *self, char *key) {
+    size_t n = cstring_array_num_strings(self->keys);
+    for (size_t i = 0; i < n; i++) {
+        if (string_equals(cstring_array_get_string(self->keys, i), key)) {
+            return cstring_array_get_string(self->values, i);
+        }
+    }
+    return NULL;
+}
+
+static bool server_request_get_bool(server_request_t *self, char *key) {
+    char *value = server_request_get(self, key);
+    return value != NULL && (string_equals(value, "1") || string_equals(value, "true"));
+}
+
+// Returns every value of a repeated key, e.g. language=en&language=fr
+static char **server_request_get_all(server_request_t *self, char *key, size_t *num_values) {
+    size_t n = cstring_array_num_strings(self->keys);
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (string_equals(cstring_array_get_string(self->keys, i), key)) count++;
+    }
+
+    *num_values = count;
+    if (count == 0) return NULL;
+
+    char **values = malloc(count * sizeof(char *));
+    if (values == NULL) {
+        *num_values = 0;
+        return NULL;
+    }
+
+    count = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (string_equals(cstring_array_get_string(self->keys, i), key)) {
+            values[count++] = cstring_array_get_string(self->values, i);
+        }
+    }
+    return values;
+}
+
+static void server_request_error(server_request_t *self, int status, char *message) {
+    self->status = status;
+    char_array_clear(self->response);
+    char *json_message = json_encode_string(message);
+    char_array_cat_printf(self->response, "{\"error\": %s}", json_message);
+    free(json_message);
+}
+
+static void server_json_append_string(char_array *json, char *str) {
+    char *encoded = json_encode_string(str);
+    char_array_cat(json, encoded);
+    free(encoded);
+}
+
+static void server_json_append_strings(char_array *json, char *key, char **strings, size_t n) {
+    char_array_cat_printf(json, "{\"%s\": [", key);
+    for (size_t i = 0; i < n; i++) {
+        if (i > 0) char_array_cat(json, ", ");
+        server_json_append_string(json, strings[i]);
+    }
+    char_array_cat(json, "]}");
+}
+
+static int server_hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static void server_url_decode(char_array *out, char *str, size_t len) {
+    char_array_clear(out);
+    for (size_t i = 0; i < len; i++) {
+        char c = str[i];
+        int hi, lo;
+        if (c == '+') {
+            char_array_push(out, ' ');
+        } else if (c == '%' && i + 2 < len &&
+                   (hi = server_hex_value(str[i + 1])) >= 0 && (lo = server_hex_value(str[i + 2])) >= 0) {
+            char_array_push(out, (char)(hi * 16 + lo));
+            i += 2;
+        } else {
+            char_array_push(out, c);
+        }
+    }
+    char_array_terminate(out);
+}
+
+/*
+Parses "/command?key=value&..." into a request. Returns NULL with *status
+set for unknown commands.
+*/
+static server_request_t *server_request_from_target(char *target, int *status) {
+    if (*target == '/') target++;
+
+    char *query = strchr(target, '?');
+    size_t command_len = query != NULL ? (size_t)(query - target) : strlen(target);
+
+    server_request_type_t type;
+    if (command_len == strlen("expand") && strncmp(target, "expand", command_len) == 0) {
+        type = SERVER_REQUEST_EXPAND;
+    } else if (command_len == strlen("parse") && strncmp(target, "parse", command_len) == 0) {
+        type = SERVER_REQUEST_PARSE;
+    } else if (command_len == strlen("classify") && strncmp(target, "classify", command_len) == 0) {
+        type = SERVER_REQUEST_CLASSIFY;
+    } else if (command_len == strlen("near_dupe") && strncmp(target, "near_dupe", command_len) == 0) {
+        type = SERVER_REQUEST_NEAR_DUPE;
+    } else if (command_len == strlen("stats") && strncmp(target, "stats", command_len) == 0) {
+        type = SERVER_REQUEST_STATS;
+    } else {
+        *status = HTTP_NOT_FOUND;
+        return NULL;
+    }
+
+    server_request_t *request = server_request_new(type);
+    if (request == NULL) {
+        *status = HTTP_BAD_REQUEST;
+        return NULL;
+    }
+
+    if (query == NULL) return request;
+
+    char_array *decoded = char_array_new();
+    char *ptr = query + 1;
+
+    while (*ptr) {
+        char *end = strchr(ptr, '&');
+        size_t len = end != NULL ? (size_t)(end - ptr) : strlen(ptr);
+        char *eq = memchr(ptr, '=', len);
+
+        size_t key_len = eq != NULL ? (size_t)(eq - ptr) : len;
+        if (key_len > 0) {
+            server_url_decode(decoded, ptr, key_len);
+            cstring_array_add_string(request->keys, decoded->a);
+
+            if (eq != NULL) {
+                server_url_decode(decoded, eq + 1, len - key_len - 1);
+            } else {
+                char_array_clear(decoded);
+                char_array_terminate(decoded);
+            }
+            cstring_array_add_string(request->values, decoded->a);
+        }
+
+        if (end == NULL) break;
+        ptr = end + 1;
+    }
+
+    char_array_destroy(decoded);
+
+    return request;
+}
+
+/*
+Model threads
+*/
+
+static void server_handle_expand(server_request_t *request) {
+    char *address = server_request_get(request, "address");
+    if (address == NULL) {
+        server_request_error(request, HTTP_BAD_REQUEST, "expand requires address");
+        return;
+    }
+
+    libpostal_normalize_options_t options = libpostal_get_default_options();
+    size_t num_languages = 0;
+    char **languages = server_request_get_all(request, "language", &num_languages);
+    if (languages != NULL) {
+        options.languages = languages;
+        options.num_languages = num_languages;
+    }
+
+    size_t num_expansions = 0;
+    char **expansions;
+    if (server_request_get_bool(request, "root")) {
+        expansions = libpostal_expand_address_root(address, options, &num_expansions);
+    } else {
+        expansions = libpostal_expand_address(address, options, &num_expansions);
+    }
+
+    server_json_append_strings(request->response, "expansions", expansions, expansions != NULL ? num_expansions : 0);
+
+    if (expansions != NULL) {
+        libpostal_expansion_array_destroy(expansions, num_expansions);
+    }
+    if (languages != NULL) {
+        free(languages);
+    }
+}
+
+static void server_handle_parse(server_request_t *request) {
+    char *address = server_request_get(request, "address");
+    if (address == NULL) {
+        server_request_error(request, HTTP_BAD_REQUEST, "parse requires address");
+        return;
+    }
+
+    libpostal_address_parser_options_t options = libpostal_get_address_parser_default_options();
+    options.language = server_request_get(request, "language");
+    options.country = server_request_get(request, "country");
+
+    libpostal_address_parser_response_t *parsed = libpostal_parse_address_concurrent(address, options);
+    if (parsed == NULL) {
+        server_request_error(request, HTTP_BAD_REQUEST, "error parsing address");
+        return;
+    }
+
+    char_array *json = request->response;
+    char_array_cat(json, "{\"components\": [");
+    for (size_t i = 0; i < parsed->num_components; i++) {
+        if (i > 0) char_array_cat(json, ", ");
+        char_array_cat(json, "{\"label\": ");
+        server_json_append_string(json, parsed->labels[i]);
+        char_array_cat(json, ", \"value\": ");
+        server_json_append_string(json, parsed->components[i]);
+        char_array_cat(json, "}");
+    }
+    char_array_cat(json, "]");
+    if (parsed->country_guess != NULL) {
+        char_array_cat(json, ", \"country_guess\": ");
+        server_json_append_string(json, parsed->country_guess);
+    }
+    char_array_cat(json, "}");
+
+    libpostal_address_parser_response_destroy(parsed);
+}
+
+static void server_handle_classify(server_request_t *request) {
+    char *text = server_request_get(request, "text");
+    if (text == NULL) {
+        text = server_request_get(request, "address");
+    }
+    if (text == NULL) {
+        server_request_error(request, HTTP_BAD_REQUEST, "classify requires text");
+        return;
+    }
+
+    libpostal_language_classifier_response_t *response = libpostal_classify_language(text);
+
+    char_array *json = request->response;
+    char_array_cat(json, "{\"languages\": [");
+    if (response != NULL) {
+        for (size_t i = 0; i < response->num_languages; i++) {
+            if (i > 0) char_array_cat(json, ", ");
+            char_array_cat(json, "{\"language\": ");
+            server_json_append_string(json, response->languages[i]);
+            char_array_cat_printf(json, ", \"probability\": %g}", response->probs[i]);
+        }
+        libpostal_language_classifier_response_destroy(response);
+    }
+    char_array_cat(json, "]}");
+}
+
+static char *near_dupe_option_keys[] = {
+    "language", "latitude", "longitude", "geohash_precision", "with_unit", "use_city",
+    "use_containing", "use_postal_code", "name_only_keys", "address_only_keys", NULL
+};
+
+static bool server_is_near_dupe_option(char *key) {
+    for (char **option = near_dupe_option_keys; *option != NULL; option++) {
+        if (string_equals(key, *option)) return true;
+    }
+    return false;
+}
+
+// Every parameter which is not an option is an address component, e.g. road=main st
+static void server_handle_near_dupe(server_request_t *request) {
+    libpostal_near_dupe_hash_options_t options = libpostal_get_near_dupe_hash_default_options();
+    options.with_unit = server_request_get_bool(request, "with_unit");
+    options.with_city_or_equivalent = server_request_get_bool(request, "use_city");
+    options.with_small_containing_boundaries = server_request_get_bool(request, "use_containing");
+    options.with_postal_code = server_request_get_bool(request, "use_postal_code");
+    options.name_only_keys = server_request_get_bool(request, "name_only_keys");
+    options.address_only_keys = server_request_get_bool(request, "address_only_keys");
+
+    char *latitude = server_request_get(request, "latitude");
+    char *longitude = server_request_get(request, "longitude");
+    if (latitude != NULL && longitude != NULL) {
+        options.with_latlon = true;
+        options.latitude = strtod(latitude, NULL);
+        options.longitude = strtod(longitude, NULL);
+    }
+
+    char *geohash_precision = server_request_get(request, "geohash_precision");
+    if (geohash_precision != NULL) {
+        options.geohash_precision = (uint32_t)strtoul(geohash_precision, NULL, 10);
+    }
+
+    size_t n = cstring_array_num_strings(request->keys);
+    char **labels = malloc((n + 1) * sizeof(char *));
+    char **values = malloc((n + 1) * sizeof(char *));
+    size_t num_components = 0;
+
+    if (labels == NULL || values == NULL) {
+        server_request_error(request, HTTP_BAD_REQUEST, "out of memory");
+        goto exit_near_dupe;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        char *key = cstring_array_get_string(request->keys, i);
+        if (server_is_near_dupe_option(key)) continue;
+        labels[num_components] = key;
+        values[num_components] = cstring_array_get_string(request->values, i);
+        num_components++;
+    }
+
+    if (num_components == 0) {
+        server_request_error(request, HTTP_BAD_REQUEST, "near_dupe requires address components");
+        goto exit_near_dupe;
+    }
+
+    size_t num_languages = 0;
+    char **languages = server_request_get_all(request, "language", &num_languages);
+
+    size_t num_hashes = 0;
+    char **hashes = libpostal_near_dupe_hashes_languages(num_components, labels, values, options, num_languages, languages, &num_hashes);
+
+    server_json_append_strings(request->response, "hashes", hashes, hashes != NULL ? num_hashes : 0);
+
+    if (hashes != NULL) {
+        libpostal_expansion_array_destroy(hashes, num_hashes);
+    }
+    if (languages != NULL) {
+        free(languages);
+    }
+
+exit_near_dupe:
+    if (labels != NULL) free(labels);
+    if (values != NULL) free(values);
+}
+
+static void server_handle_stats(server_request_t *request, size_t queue_size) {
+    pthread_mutex_lock(&request_queue.lock);
+    server_stats_t stats = server_stats;
+    pthread_mutex_unlock(&request_queue.lock);
+
+    double mean_batch_size = stats.num_batches > 0 ? (double)stats.num_requests / stats.num_batches : 0.0;
+    double mean_latency_us = stats.num_requests > 0 ? (double)stats.total_latency_ns / stats.num_requests / 1000.0 : 0.0;
+
+    char_array_cat_printf(request->response,
+        "{\"requests\": %" PRIu64 ", \"batches\": %" PRIu64 ", \"mean_batch_size\": %.2f, \"max_batch_size\": %zu, "
+        "\"mean_latency_us\": %.1f, \"max_latency_us\": %.1f, \"queue_size\": %zu}",
+        stats.num_requests, stats.num_batches, mean_batch_size, stats.max_batch_size,
+        mean_latency_us, (double)stats.max_latency_ns / 1000.0, queue_size);
+}
+
+static void server_handle_request(server_request_t *request, size_t queue_size) {
+    switch (request->type) {
+        case SERVER_REQUEST_EXPAND:
+            server_handle_expand(request);
+            break;
+        case SERVER_REQUEST_PARSE:
+            server_handle_parse(request);
+            break;
+        case SERVER_REQUEST_CLASSIFY:
+            server_handle_classify(request);
+            break;
+        case SERVER_REQUEST_NEAR_DUPE:
+            server_handle_near_dupe(request);
+            break;
+        case SERVER_REQUEST_STATS:
+            server_handle_stats(request, queue_size);
+            break;
+    }
+}
+
+static void *server_model_worker(void *arg) {
+    (void)arg;
+    server_queue_t *queue = &request_queue;
+
+    while (true) {
+        pthread_mutex_lock(&queue->lock);
+
+        while (queue->head == NULL && !queue->stopped) {
+            pthread_cond_wait(&queue->not_empty, &queue->lock);
+        }
+
+        if (queue->head == NULL && queue->stopped) {
+            pthread_mutex_unlock(&queue->lock);
+            break;
+        }
+
+        // Give a partial batch a short window to fill up
+        if (queue->batch_wait_us > 0 && queue->size < queue->max_batch) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            uint64_t nsec = (uint64_t)deadline.tv_nsec + queue->batch_wait_us * 1000;
+            deadline.tv_sec += nsec / 1000000000ULL;
+            deadline.tv_nsec = nsec % 1000000000ULL;
+
+            while (queue->size < queue->max_batch && !queue->stopped) {
+                if (pthread_cond_timedwait(&queue->not_empty, &queue->lock, &deadline) == ETIMEDOUT) break;
+            }
+
+            // Another model thread may have taken everything in the meantime
+            if (queue->head == NULL) {
+                pthread_mutex_unlock(&queue->lock);
+                continue;
+            }
+        }
+
+        server_request_t *batch = queue->head;
+        server_request_t *last = batch;
+        size_t batch_size = 1;
+        while (last->next != NULL && batch_size < queue->max_batch) {
+            last = last->next;
+            batch_size++;
+        }
+
+        queue->head = last->next;
+        if (queue->head == NULL) queue->tail = NULL;
+        queue->size -= batch_size;
+        last->next = NULL;
+
+        size_t queue_size = queue->size;
+
+        pthread_mutex_unlock(&queue->lock);
+
+        for (server_request_t *request = batch; request != NULL; request = request->next) {
+            server_handle_request(request, queue_size);
+        }
+
+        uint64_t now = server_time_ns();
+
+        pthread_mutex_lock(&queue->lock);
+        server_request_t *request = batch;
+        while (request != NULL) {
+            // The client may free the request as soon as done is set
+            server_request_t *next = request->next;
+            uint64_t latency = now - request->enqueued_ns;
+            server_stats.total_latency_ns += latency;
+            if (latency > server_stats.max_latency_ns) server_stats.max_latency_ns = latency;
+            request->done = true;
+            request = next;
+        }
+        server_stats.num_requests += batch_size;
+        server_stats.num_batches++;
+        if (batch_size > server_stats.max_batch_size) server_stats.max_batch_size = batch_size;
+
+        pthread_cond_broadcast(&queue->done);
+        pthread_mutex_unlock(&queue->lock);
+    }
+
+    return NULL;
+}
+
+// Called from connection threads, blocks until a model thread has answered
+static void server_submit(server_request_t *request) {
+    server_queue_t *queue = &request_queue;
+
+    request->enqueued_ns = server_time_ns();
+    request->next = NULL;
+
+    pthread_mutex_lock(&queue->lock);
+
+    if (queue->stopped) {
+        pthread_mutex_unlock(&queue->lock);
+        server_request_error(request, HTTP_BAD_REQUEST, "server shutting down");
+        return;
+    }
+
+    if (queue->tail != NULL) {
+        queue->tail->next = request;
+    } else {
+        queue->head = request;
+    }
+    queue->tail = request;
+    queue->size++;
+
+    pthread_cond_signal(&queue->not_empty);
+
+    while (!request->done) {
+        pthread_cond_wait(&queue->done, &queue->lock);
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/*
+Connections
+*/
+
+static bool server_write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(fd, data, len);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        len -= (size_t)written;
+    }
+    return true;
+}
+
+/*
+Reads one line without its terminator (\n or \r\n). Returns false on EOF,
+error, an overlong line, shutdown, or after the client has sent nothing for
+the idle timeout. Sockets have a short receive timeout so this wakes up
+regularly to check.
+*/
+static bool server_read_line(server_reader_t *reader, char_array *line) {
+    char_array_clear(line);
+
+    uint64_t idle_sec = 0;
+
+    while (true) {
+        if (reader->pos == reader->len) {
+            ssize_t n = read(reader->fd, reader->buf, SERVER_READ_BUFFER_SIZE);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                idle_sec += SERVER_RECV_TIMEOUT_SEC;
+                if (server_running && idle_sec < server_idle_timeout_sec) continue;
+                return false;
+            }
+            if (n <= 0) return false;
+            reader->pos = 0;
+            reader->len = (size_t)n;
+        }
+
+        char *start = reader->buf + reader->pos;
+        size_t available = reader->len - reader->pos;
+        char *newline = memchr(start, '\n', available);
+        size_t chunk_len = newline != NULL ? (size_t)(newline - start) : available;
+
+        if (line->n + chunk_len > SERVER_MAX_LINE_LEN) return false;
+        char_array_append_len(line, start, chunk_len);
+        reader->pos += chunk_len;
+
+        if (newline != NULL) {
+            reader->pos++;
+            if (line->n > 0 && line->a[line->n - 1] == '\r') line->n--;
+            char_array_terminate(line);
+            return true;
+        }
+    }
+}
+
+static server_request_t *server_request_or_error(char *target, server_request_t **error) {
+    int status = HTTP_OK;
+    server_request_t *request = server_request_from_target(target, &status);
+    if (request != NULL) {
+        server_submit(request);
+        return request;
+    }
+
+    // Unknown commands are answered without going through the model threads
+    *error = server_request_new(SERVER_REQUEST_STATS);
+    if (*error != NULL) {
+        server_request_error(*error, status, status == HTTP_NOT_FOUND ? "unknown command" : "invalid request");
+    }
+    return *error;
+}
+
+static void server_handle_unix_connection(int fd) {
+    server_reader_t reader = {.fd = fd, .pos = 0, .len = 0};
+    char_array *line = char_array_new();
+
+    while (server_read_line(&reader, line)) {
+        if (char_array_len(line) == 0) continue;
+
+        server_request_t *error = NULL;
+        server_request_t *request = server_request_or_error(line->a, &error);
+        if (request == NULL) break;
+
+        char_array_cat(request->response, "\n");
+        bool ok = server_write_all(fd, request->response->a, char_array_len(request->response));
+        server_request_destroy(request);
+
+        if (!ok) break;
+    }
+
+    char_array_destroy(line);
+}
+
+static const char *server_http_reason(int status) {
+    switch (status) {
+        case HTTP_OK: return "OK";
+        case HTTP_BAD_REQUEST: return "Bad Request";
+        case HTTP_NOT_FOUND: return "Not Found";
+        case HTTP_METHOD_NOT_ALLOWED: return "Method Not Allowed";
+        default: return "Error";
+    }
+}
+
+static void server_http_respond(int fd, int status, char_array *body) {
+    char_array *response = char_array_new();
+    char_array_cat_printf(response, "HTTP/1.0 %d %s\r\nContent-Type: application/json\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                          status, server_http_reason(status), char_array_len(body));
+    char_array_cat_len(response, body->a, char_array_len(body));
+    server_write_all(fd, response->a, char_array_len(response));
+    char_array_destroy(response);
+}
+
+// One request per connection: "GET /command?query HTTP/1.x", headers ignored
+static void server_handle_http_connection(int fd) {
+    server_reader_t reader = {.fd = fd, .pos = 0, .len = 0};
+    char_array *request_line = char_array_new();
+    char_array *header = char_array_new();
+
+    if (!server_read_line(&reader, request_line)) {
+        goto exit_http_connection;
+    }
+
+    while (server_read_line(&reader, header) && char_array_len(header) > 0);
+
+    char *method = request_line->a;
+    char *target = strchr(method, ' ');
+    if (target == NULL) {
+        char_array *body = char_array_new();
+        char_array_cat(body, "{\"error\": \"malformed request line\"}");
+        server_http_respond(fd, HTTP_BAD_REQUEST, body);
+        char_array_destroy(body);
+        goto exit_http_connection;
+    }
+    *target++ = '\0';
+    char *version = strchr(target, ' ');
+    if (version != NULL) *version = '\0';
+
+    if (!string_equals(method, "GET")) {
+        char_array *body = char_array_new();
+        char_array_cat(body, "{\"error\": \"only GET is supported\"}");
+        server_http_respond(fd, HTTP_METHOD_NOT_ALLOWED, body);
+        char_array_destroy(body);
+        goto exit_http_connection;
+    }
+
+    server_request_t *error = NULL;
+    server_request_t *request = server_request_or_error(target, &error);
+    if (request != NULL) {
+        server_http_respond(fd, request->status, request->response);
+        server_request_destroy(request);
+    }
+
+exit_http_connection:
+    char_array_destroy(request_line);
+    char_array_destroy(header);
+}
+
+static bool server_connection_push(server_connection_t connection) {
+    server_connection_queue_t *queue = &connection_queue;
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->size == SERVER_CONNECTION_QUEUE_SIZE && !queue->stopped) {
+        pthread_cond_wait(&queue->not_full, &queue->lock);
+    }
+    if (queue->stopped) {
+        pthread_mutex_unlock(&queue->lock);
+        return false;
+    }
+
+    queue->connections[(queue->head + queue->size) % SERVER_CONNECTION_QUEUE_SIZE] = connection;
+    queue->size++;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+    return true;
+}
+
+static bool server_connection_pop(server_connection_t *connection) {
+    server_connection_queue_t *queue = &connection_queue;
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->size == 0 && !queue->stopped) {
+        pthread_cond_wait(&queue->not_empty, &queue->lock);
+    }
+    if (queue->size == 0) {
+        pthread_mutex_unlock(&queue->lock);
+        return false;
+    }
+
+    *connection = queue->connections[queue->head];
+    queue->head = (queue->head + 1) % SERVER_CONNECTION_QUEUE_SIZE;
+    queue->size--;
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+    return true;
+}
+
+static void *server_connection_worker(void *arg) {
+    (void)arg;
+    server_connection_t connection;
+
+    while (server_connection_pop(&connection)) {
+        if (connection.http) {
+            server_handle_http_connection(connection.fd);
+        } else {
+            server_handle_unix_connection(connection.fd);
+        }
+        close(connection.fd);
+    }
+
+    return NULL;
+}
+
+/*
+Listening sockets
+*/
+
+static int server_listen_unix(char *path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        log_error("Socket path too long: %s\n", path);
+        return -1;
+    }
+
+    // Only replace a stale socket, never an unrelated file at the same path
+    struct stat st;
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            log_error("%s exists and is not a socket\n", path);
+            return -1;
+        }
+        unlink(path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, SERVER_LISTEN_BACKLOG) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static int server_listen_tcp(char *host, int port) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+        log_error("Invalid host: %s\n", host);
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, SERVER_LISTEN_BACKLOG) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int main(int argc, char **argv) {
+    char *socket_path = DEFAULT_SERVER_SOCKET_PATH;
+    char *host = DEFAULT_SERVER_HOST;
+    char *datadir = NULL;
+    int port = 0;
+    size_t num_workers = DEFAULT_SERVER_WORKERS;
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t num_model_workers = num_cpus > 0 ? (size_t)num_cpus : 1;
+    size_t max_batch = DEFAULT_SERVER_MAX_BATCH;
+    uint64_t batch_wait_us = DEFAULT_SERVER_BATCH_WAIT_US;
+    uint64_t setup_options = LIBPOSTAL_SETUP_PARALLEL | LIBPOSTAL_SETUP_PARSER | LIBPOSTAL_SETUP_LANGUAGE_CLASSIFIER;
+
+    for (int i = 1; i < argc; i++) {
+        char *arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (string_equals(arg, "-h") || string_equals(arg, "--help")) {
+            printf(LIBPOSTAL_SERVER_USAGE);
+            exit(EXIT_SUCCESS);
+        } else if (string_equals(arg, "--socket") && has_value) {
+            socket_path = argv[++i];
+        } else if (string_equals(arg, "--port") && has_value) {
+            port = atoi(argv[++i]);
+        } else if (string_equals(arg, "--host") && has_value) {
+            host = argv[++i];
+        } else if (string_equals(arg, "--workers") && has_value) {
+            num_workers = (size_t)strtoul(argv[++i], NULL, 10);
+        } else if (string_equals(arg, "--model-workers") && has_value) {
+            num_model_workers = (size_t)strtoul(argv[++i], NULL, 10);
+        } else if (string_equals(arg, "--max-batch") && has_value) {
+            max_batch = (size_t)strtoul(argv[++i], NULL, 10);
+        } else if (string_equals(arg, "--batch-wait-us") && has_value) {
+            batch_wait_us = strtoull(argv[++i], NULL, 10);
+        } else if (string_equals(arg, "--idle-timeout-sec") && has_value) {
+            server_idle_timeout_sec = strtoull(argv[++i], NULL, 10);
+        } else if (string_equals(arg, "--datadir") && has_value) {
+            datadir = argv[++i];
+        } else if (string_equals(arg, "--huge-pages")) {
+            setup_options |= LIBPOSTAL_SETUP_HUGE_PAGES;
+        } else {
+            log_error(LIBPOSTAL_SERVER_USAGE);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (num_workers == 0 || num_model_workers == 0 || max_batch == 0 || server_idle_timeout_sec == 0) {
+        log_error(LIBPOSTAL_SERVER_USAGE);
+        exit(EXIT_FAILURE);
+    }
+
+    request_queue.max_batch = max_batch;
+    request_queue.batch_wait_us = batch_wait_us;
+
+    log_info("Loading models...\n");
+    if (!libpostal_setup_datadir_options(datadir, setup_options)) {
+        exit(EXIT_FAILURE);
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, server_signal_handler);
+    signal(SIGTERM, server_signal_handler);
+
+    struct pollfd listeners[2];
+    bool listener_is_http[2];
+    size_t num_listeners = 0;
+
+    int unix_fd = server_listen_unix(socket_path);
+    if (unix_fd < 0) {
+        log_error("Could not listen on %s\n", socket_path);
+        exit(EXIT_FAILURE);
+    }
+    listeners[num_listeners] = (struct pollfd){.fd = unix_fd, .events = POLLIN};
+    listener_is_http[num_listeners++] = false;
+    log_info("Listening on %s\n", socket_path);
+
+    if (port > 0) {
+        int tcp_fd = server_listen_tcp(host, port);
+        if (tcp_fd < 0) {
+            log_error("Could not listen on %s:%d\n", host, port);
+            exit(EXIT_FAILURE);
+        }
+        listeners[num_listeners] = (struct pollfd){.fd = tcp_fd, .events = POLLIN};
+        listener_is_http[num_listeners++] = true;
+        log_info("Listening on http://%s:%d\n", host, port);
+    }
+
+    pthread_t *model_workers = malloc(num_model_workers * sizeof(pthread_t));
+    pthread_t *workers = malloc(num_workers * sizeof(pthread_t));
+    if (model_workers == NULL || workers == NULL) {
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < num_model_workers; i++) {
+        if (pthread_create(&model_workers[i], NULL, server_model_worker, NULL) != 0) {
+            log_error("Could not start model thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (size_t i = 0; i < num_workers; i++) {
+        if (pthread_create(&workers[i], NULL, server_connection_worker, NULL) != 0) {
+            log_error("Could not start connection worker\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    struct timeval recv_timeout = {.tv_sec = SERVER_RECV_TIMEOUT_SEC, .tv_usec = 0};
+
+    while (server_running) {
+        int ready = poll(listeners, num_listeners, SERVER_POLL_TIMEOUT_MS);
+        if (ready <= 0) continue;
+
+        for (size_t i = 0; i < num_listeners; i++) {
+            if (!(listeners[i].revents & POLLIN)) continue;
+
+            int fd = accept(listeners[i].fd, NULL, NULL);
+            if (fd < 0) continue;
+
+            // Lets idle connections notice shutdown
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &recv_timeout, sizeof(recv_timeout));
+
+            if (!server_connection_push((server_connection_t){.fd = fd, .http = listener_is_http[i]})) {
+                close(fd);
+            }
+        }
+    }
+
+    log_info("Shutting down\n");
+
+    for (size_t i = 0; i < num_listeners; i++) {
+        close(listeners[i].fd);
+    }
+    unlink(socket_path);
+
+    pthread_mutex_lock(&connection_queue.lock);
+    connection_queue.stopped = true;
+    pthread_cond_broadcast(&connection_queue.not_empty);
+    pthread_cond_broadcast(&connection_queue.not_full);
+    pthread_mutex_unlock(&connection_queue.lock);
+
+    for (size_t i = 0; i < num_workers; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+
+    pthread_mutex_lock(&request_queue.lock);
+    request_queue.stopped = true;
+    pthread_cond_broadcast(&request_queue.not_empty);
+    pthread_mutex_unlock(&request_queue.lock);
+
+    for (size_t i = 0; i < num_model_workers; i++) {
+        pthread_join(model_workers[i], NULL);
+    }
+    free(model_workers);
+
+    libpostal_teardown();
+    libpostal_teardown_parser();
+    libpostal_teardown_language_classifier();
+
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,263 @@
+#include <string.h>
+
+#if defined(USE_SSE)
+#include <emmintrin.h>
+#endif
+
+#include "string_set.h"
+#include "feature_hash.h"
+#include "string_utils.h"
+
+#define STRING_SET_DEFAULT_CAPACITY 16
+#define STRING_SET_HASH_SEED 0x5f3759df
+#define STRING_SET_H2_MASK 0x7f
+
+// Max load factor of 7/8
+#define STRING_SET_MAX_SIZE(capacity) ((capacity) - (capacity) / 8)
+
+static inline uint8_t string_set_h2(uint64_t hash) {
+    return (uint8_t)(hash & STRING_SET_H2_MASK);
+}
+
+static inline size_t string_set_h1(uint64_t hash) {
+    return (size_t)(hash >> 7);
+}
+
+// Bit i of the result is set if control byte i of the group equals c
+static inline uint32_t string_set_group_match(const uint8_t *group, uint8_t c) {
+#if defined(USE_SSE)
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)c)));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < STRING_SET_GROUP_SIZE; i++) {
+        mask |= (uint32_t)(group[i] == c) << i;
+    }
+    return mask;
+#endif
+}
+
+static inline uint32_t string_set_ctz(uint32_t mask) {
+    return (uint32_t)__builtin_ctz(mask);
+}
+
+static inline void string_set_set_ctrl(string_set_t *self, size_t i, uint8_t c) {
+    self->ctrl[i] = c;
+    if (i < STRING_SET_GROUP_SIZE) {
+        self->ctrl[self->capacity + i] = c;
+    }
+}
+
+static bool string_set_alloc(string_set_t *self, size_t capacity) {
+    uint8_t *ctrl = malloc(capacity + STRING_SET_GROUP_SIZE);
+    uint64_t *hashes = malloc(capacity * sizeof(uint64_t));
+    size_t *offsets = malloc(capacity * sizeof(size_t));
+
+    if (ctrl == NULL || hashes == NULL || offsets == NULL) {
+        free(ctrl);
+        free(hashes);
+        free(offsets);
+        return false;
+    }
+
+    memset(ctrl, STRING_SET_EMPTY, capacity + STRING_SET_GROUP_SIZE);
+
+    self->ctrl = ctrl;
+    self->hashes = hashes;
+    self->offsets = offsets;
+    self->capacity = capacity;
+    return true;
+}
+
+static size_t string_set_capacity_for_size(size_t size) {
+    size_t capacity = STRING_SET_DEFAULT_CAPACITY;
+    while (STRING_SET_MAX_SIZE(capacity) < size) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+string_set_t *string_set_new_size(size_t size) {
+    string_set_t *self = calloc(1, sizeof(string_set_t));
+    if (self == NULL) return NULL;
+
+    self->arena = char_array_new();
+    if (self->arena == NULL) {
+        free(self);
+        return NULL;
+    }
+
+    if (!string_set_alloc(self, string_set_capacity_for_size(size))) {
+        char_array_destroy(self->arena);
+        free(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+string_set_t *string_set_new(void) {
+    return string_set_new_size(0);
+}
+
+/*
+Probes group by group (triangular steps over groups, which visits every group
+when the number of groups is a power of 2). Returns true and the slot if the
+key is present, otherwise false and the first empty slot in its probe sequence.
+*/
+static bool string_set_find(string_set_t *self, const char *key, size_t len, uint64_t hash, size_t *slot) {
+    size_t mask = self->capacity - 1;
+    size_t pos = string_set_h1(hash) & mask;
+    size_t stride = 0;
+    uint8_t h2 = string_set_h2(hash);
+    char *arena = self->arena->a;
+
+    while (true) {
+        const uint8_t *group = self->ctrl + pos;
+
+        uint32_t matches = string_set_group_match(group, h2);
+        while (matches) {
+            size_t i = (pos + string_set_ctz(matches)) & mask;
+            if (self->hashes[i] == hash) {
+                char *stored = arena + self->offsets[i];
+                if (memcmp(stored, key, len) == 0 && stored[len] == '\0') {
+                    *slot = i;
+                    return true;
+                }
+            }
+            matches &= matches - 1;
+        }
+
+        uint32_t empty = string_set_group_match(group, STRING_SET_EMPTY);
+        if (empty) {
+            *slot = (pos + string_set_ctz(empty)) & mask;
+            return false;
+        }
+
+        stride += STRING_SET_GROUP_SIZE;
+        pos = (pos + stride) & mask;
+    }
+}
+
+// Slot for a key known not to be in the set, used when rehashing
+static size_t string_set_find_empty(string_set_t *self, uint64_t hash) {
+    size_t mask = self->capacity - 1;
+    size_t pos = string_set_h1(hash) & mask;
+    size_t stride = 0;
+
+    while (true) {
+        uint32_t empty = string_set_group_match(self->ctrl + pos, STRING_SET_EMPTY);
+        if (empty) {
+            return (pos + string_set_ctz(empty)) & mask;
+        }
+        stride += STRING_SET_GROUP_SIZE;
+        pos = (pos + stride) & mask;
+    }
+}
+
+static bool string_set_resize(string_set_t *self, size_t capacity) {
+    string_set_t old = *self;
+
+    if (!string_set_alloc(self, capacity)) {
+        return false;
+    }
+
+    // Stored hashes mean keys never need to be rehashed
+    for (size_t i = 0; i < old.capacity; i++) {
+        if (old.ctrl[i] == STRING_SET_EMPTY) continue;
+        uint64_t hash = old.hashes[i];
+        size_t slot = string_set_find_empty(self, hash);
+        string_set_set_ctrl(self, slot, string_set_h2(hash));
+        self->hashes[slot] = hash;
+        self->offsets[slot] = old.offsets[i];
+    }
+
+    free(old.ctrl);
+    free(old.hashes);
+    free(old.offsets);
+    return true;
+}
+
+bool string_set_reserve(string_set_t *self, size_t size) {
+    if (self == NULL) return false;
+    if (size <= STRING_SET_MAX_SIZE(self->capacity)) return true;
+    return string_set_resize(self, string_set_capacity_for_size(size));
+}
+
+static inline uint64_t string_set_hash(const char *key, size_t len) {
+    return feature_hash(key, len, STRING_SET_HASH_SEED);
+}
+
+bool string_set_contains_len(string_set_t *self, const char *key, size_t len) {
+    if (self == NULL || key == NULL || self->size == 0) return false;
+    size_t slot;
+    return string_set_find(self, key, len, string_set_hash(key, len), &slot);
+}
+
+bool string_set_contains(string_set_t *self, const char *key) {
+    if (key == NULL) return false;
+    return string_set_contains_len(self, key, strlen(key));
+}
+
+int string_set_add_len(string_set_t *self, const char *key, size_t len) {
+    if (self == NULL || key == NULL) return -1;
+
+    uint64_t hash = string_set_hash(key, len);
+    size_t slot;
+
+    if (string_set_find(self, key, len, hash, &slot)) {
+        return 0;
+    }
+
+    if (self->size + 1 > STRING_SET_MAX_SIZE(self->capacity)) {
+        if (!string_set_resize(self, self->capacity << 1)) {
+            return -1;
+        }
+        slot = string_set_find_empty(self, hash);
+    }
+
+    size_t offset = self->arena->n;
+    char_array_append_len(self->arena, (char *)key, len);
+    char_array_push(self->arena, '\0');
+
+    string_set_set_ctrl(self, slot, string_set_h2(hash));
+    self->hashes[slot] = hash;
+    self->offsets[slot] = offset;
+    self->size++;
+
+    return 1;
+}
+
+int string_set_add(string_set_t *self, const char *key) {
+    if (key == NULL) return -1;
+    return string_set_add_len(self, key, strlen(key));
+}
+
+void string_set_clear(string_set_t *self) {
+    if (self == NULL) return;
+    memset(self->ctrl, STRING_SET_EMPTY, self->capacity + STRING_SET_GROUP_SIZE);
+    char_array_clear(self->arena);
+    self->size = 0;
+}
+
+void string_set_destroy(string_set_t *self) {
+    if (self == NULL) return;
+
+    if (self->ctrl != NULL) {
+        free(self->ctrl);
+    }
+
+    if (self->hashes != NULL) {
+        free(self->hashes);
+    }
+
+    if (self->offsets != NULL) {
+        free(self->offsets);
+    }
+
+    if (self->arena != NULL) {
+        char_array_destroy(self->arena);
+    }
+
+    free(self);
+}
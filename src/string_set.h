@@ -0,0 +1,64 @@
+/*
+string_set.h
+------------
+
+Flat open-addressing set of strings, used to deduplicate expansions and
+near-dupe hashes.
+
+Layout follows SwissTable: each slot has a control byte which is either
+STRING_SET_EMPTY or the low 7 bits of the key's hash. Lookups scan a
+group of 16 control bytes at a time (one SSE2 compare when USE_SSE is
+defined) and only compare full 64-bit hashes/keys for slots whose control
+byte matches. The control array has the first group mirrored at the end so
+any group can be loaded without wrapping.
+
+Keys are copied into a single arena instead of being strdup'd one by one, so
+adding a key is a memcpy and clearing or destroying the set doesn't free
+individual strings. Pointers into the arena are only valid until the next
+string_set_add. There is no deletion.
+*/
+
+#ifndef STRING_SET_H
+#define STRING_SET_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "collections.h"
+
+#define STRING_SET_GROUP_SIZE 16
+#define STRING_SET_EMPTY 0x80
+
+typedef struct string_set {
+    uint8_t *ctrl;              // capacity + STRING_SET_GROUP_SIZE control bytes
+    uint64_t *hashes;           // Full hash of each occupied slot
+    size_t *offsets;            // Offset of each occupied slot's key in the arena
+    char_array *arena;          // NUL-terminated keys, back to back
+    size_t capacity;            // Power of 2, at least STRING_SET_GROUP_SIZE
+    size_t size;
+} string_set_t;
+
+string_set_t *string_set_new(void);
+string_set_t *string_set_new_size(size_t size);
+
+// Makes room for size keys in total without rehashing
+bool string_set_reserve(string_set_t *self, size_t size);
+
+bool string_set_contains(string_set_t *self, const char *key);
+bool string_set_contains_len(string_set_t *self, const char *key, size_t len);
+
+// Returns 1 if the key was added, 0 if it was already present and -1 on allocation failure
+int string_set_add(string_set_t *self, const char *key);
+int string_set_add_len(string_set_t *self, const char *key, size_t len);
+
+static inline size_t string_set_size(string_set_t *self) {
+    return self->size;
+}
+
+// Empties the set, keeping its memory for reuse
+void string_set_clear(string_set_t *self);
+
+void string_set_destroy(string_set_t *self);
+
+#endif
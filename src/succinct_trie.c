@@ -0,0 +1,619 @@
+#include "succinct_trie.h"
+
+#include <string.h>
+
+#include "klib/ksort.h"
+#include "log/log.h"
+
+#define SUCCINCT_BLOCK_BITS 256
+#define SUCCINCT_WORDS_PER_BLOCK (SUCCINCT_BLOCK_BITS / 64)
+#define SUCCINCT_SELECT_SAMPLE 256
+
+/*
+Bit vector with rank/select
+*/
+
+succinct_bit_vector_t *succinct_bit_vector_new(void) {
+    succinct_bit_vector_t *self = calloc(1, sizeof(succinct_bit_vector_t));
+    if (self == NULL) return NULL;
+
+    self->bits = uint64_array_new();
+    self->ranks = uint32_array_new();
+    self->selects = uint32_array_new();
+
+    if (self->bits == NULL || self->ranks == NULL || self->selects == NULL) {
+        succinct_bit_vector_destroy(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+void succinct_bit_vector_push(succinct_bit_vector_t *self, bool bit) {
+    uint32_t i = self->num_bits;
+    if (i % 64 == 0) {
+        uint64_array_push(self->bits, 0);
+    }
+
+    if (bit) {
+        self->bits->a[i / 64] |= 1ULL << (i % 64);
+    }
+    self->num_bits++;
+}
+
+void succinct_bit_vector_build_index(succinct_bit_vector_t *self) {
+    uint32_array_clear(self->ranks);
+    uint32_array_clear(self->selects);
+
+    uint64_t *words = self->bits->a;
+    size_t num_words = self->bits->n;
+
+    uint32_t num_ones = 0;
+    for (size_t w = 0; w < num_words; w++) {
+        if (w % SUCCINCT_WORDS_PER_BLOCK == 0) {
+            uint32_array_push(self->ranks, num_ones);
+        }
+
+        uint64_t word = words[w];
+        uint32_t word_ones = (uint32_t)__builtin_popcountll(word);
+
+        // Sample the position of every SUCCINCT_SELECT_SAMPLE-th one
+        uint32_t next_sample = (uint32_t)self->selects->n * SUCCINCT_SELECT_SAMPLE;
+        while (next_sample < num_ones + word_ones) {
+            uint64_t remaining = word;
+            for (uint32_t r = next_sample - num_ones; r > 0; r--) {
+                remaining &= remaining - 1;
+            }
+            uint32_array_push(self->selects, (uint32_t)(w * 64 + __builtin_ctzll(remaining)));
+            next_sample += SUCCINCT_SELECT_SAMPLE;
+        }
+
+        num_ones += word_ones;
+    }
+    // Sentinel so ranks[block + 1] is always defined
+    uint32_array_push(self->ranks, num_ones);
+
+    self->num_ones = num_ones;
+}
+
+inline bool succinct_bit_vector_get(succinct_bit_vector_t *self, uint32_t i) {
+    return (self->bits->a[i / 64] >> (i % 64)) & 1;
+}
+
+// Number of ones in [0, i)
+inline uint32_t succinct_bit_vector_rank1(succinct_bit_vector_t *self, uint32_t i) {
+    uint32_t block = i / SUCCINCT_BLOCK_BITS;
+    uint32_t rank = self->ranks->a[block];
+
+    uint64_t *words = self->bits->a;
+    uint32_t word_index = i / 64;
+    for (uint32_t w = block * SUCCINCT_WORDS_PER_BLOCK; w < word_index; w++) {
+        rank += (uint32_t)__builtin_popcountll(words[w]);
+    }
+
+    uint32_t offset = i % 64;
+    if (offset > 0) {
+        rank += (uint32_t)__builtin_popcountll(words[word_index] & ((1ULL << offset) - 1));
+    }
+
+    return rank;
+}
+
+// Position of the k-th one (0-based), k must be < num_ones
+inline uint32_t succinct_bit_vector_select1(succinct_bit_vector_t *self, uint32_t k) {
+    uint32_t sample_pos = self->selects->a[k / SUCCINCT_SELECT_SAMPLE];
+    uint32_t block = sample_pos / SUCCINCT_BLOCK_BITS;
+
+    uint32_t *ranks = self->ranks->a;
+    while (ranks[block + 1] <= k) {
+        block++;
+    }
+
+    uint32_t remaining = k - ranks[block];
+    uint64_t *words = self->bits->a;
+
+    for (uint32_t w = block * SUCCINCT_WORDS_PER_BLOCK; ; w++) {
+        uint64_t word = words[w];
+        uint32_t word_ones = (uint32_t)__builtin_popcountll(word);
+        if (remaining < word_ones) {
+            for (; remaining > 0; remaining--) {
+                word &= word - 1;
+            }
+            return w * 64 + (uint32_t)__builtin_ctzll(word);
+        }
+        remaining -= word_ones;
+    }
+}
+
+void succinct_bit_vector_destroy(succinct_bit_vector_t *self) {
+    if (self == NULL) return;
+
+    if (self->bits != NULL) {
+        uint64_array_destroy(self->bits);
+    }
+
+    if (self->ranks != NULL) {
+        uint32_array_destroy(self->ranks);
+    }
+
+    if (self->selects != NULL) {
+        uint32_array_destroy(self->selects);
+    }
+
+    free(self);
+}
+
+static bool succinct_bit_vector_write(succinct_bit_vector_t *self, FILE *file) {
+    if (!file_write_uint32(file, self->num_bits)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < self->bits->n; i++) {
+        if (!file_write_uint64(file, self->bits->a[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static succinct_bit_vector_t *succinct_bit_vector_read(FILE *file) {
+    uint32_t num_bits;
+    if (!file_read_uint32(file, &num_bits)) {
+        return NULL;
+    }
+
+    succinct_bit_vector_t *self = succinct_bit_vector_new();
+    if (self == NULL) return NULL;
+
+    size_t num_words = (num_bits + 63) / 64;
+    if (num_words > 0) {
+        uint64_array_resize(self->bits, num_words);
+        if (!file_read_uint64_array(file, self->bits->a, num_words)) {
+            succinct_bit_vector_destroy(self);
+            return NULL;
+        }
+    }
+    self->bits->n = num_words;
+    self->num_bits = num_bits;
+
+    succinct_bit_vector_build_index(self);
+
+    return self;
+}
+
+/*
+Tail merging: sort tails by their reversed strings so that a tail which is
+a suffix of another immediately precedes one of the tails it can share
+*/
+
+typedef struct succinct_tail {
+    char *str;
+    size_t len;
+    uint32_t leaf;
+} succinct_tail_t;
+
+static inline int succinct_tail_reversed_cmp(succinct_tail_t a, succinct_tail_t b) {
+    size_t n = a.len < b.len ? a.len : b.len;
+    for (size_t i = 1; i <= n; i++) {
+        unsigned char ca = (unsigned char)a.str[a.len - i];
+        unsigned char cb = (unsigned char)b.str[b.len - i];
+        if (ca != cb) return ca < cb ? -1 : 1;
+    }
+    return a.len < b.len ? -1 : (a.len > b.len ? 1 : 0);
+}
+
+#define succinct_tail_lt(a, b) (succinct_tail_reversed_cmp((a), (b)) < 0)
+
+KSORT_INIT(succinct_tail, succinct_tail_t, succinct_tail_lt)
+
+static bool succinct_trie_build_tails(succinct_trie_t *self, cstring_array *tails) {
+    size_t num_tails = cstring_array_num_strings(tails);
+
+    uint32_array_clear(self->tail_offsets);
+    for (size_t i = 0; i < num_tails; i++) {
+        uint32_array_push(self->tail_offsets, 0);
+    }
+
+    uchar_array_clear(self->tail);
+    if (num_tails == 0) {
+        uchar_array_push(self->tail, '\0');
+        return true;
+    }
+
+    succinct_tail_t *sorted = malloc(num_tails * sizeof(succinct_tail_t));
+    if (sorted == NULL) return false;
+
+    for (size_t i = 0; i < num_tails; i++) {
+        char *str = cstring_array_get_string(tails, i);
+        sorted[i] = (succinct_tail_t){str, strlen(str), (uint32_t)i};
+    }
+
+    ks_introsort(succinct_tail, num_tails, sorted);
+
+    uint32_t *offsets = self->tail_offsets->a;
+
+    for (ssize_t i = (ssize_t)num_tails - 1; i >= 0; i--) {
+        succinct_tail_t t = sorted[i];
+        if (i < (ssize_t)num_tails - 1) {
+            succinct_tail_t next = sorted[i + 1];
+            if (t.len <= next.len && memcmp(t.str, next.str + next.len - t.len, t.len) == 0) {
+                offsets[t.leaf] = offsets[next.leaf] + (uint32_t)(next.len - t.len);
+                continue;
+            }
+        }
+
+        offsets[t.leaf] = (uint32_t)self->tail->n;
+        for (size_t j = 0; j < t.len; j++) {
+            uchar_array_push(self->tail, (unsigned char)t.str[j]);
+        }
+        uchar_array_push(self->tail, '\0');
+    }
+
+    free(sorted);
+    return true;
+}
+
+/*
+Constructors
+*/
+
+static succinct_trie_t *succinct_trie_new_empty(void) {
+    succinct_trie_t *self = calloc(1, sizeof(succinct_trie_t));
+    if (self == NULL) return NULL;
+
+    self->labels = uchar_array_new();
+    if (self->labels == NULL) {
+        goto exit_succinct_trie_created;
+    }
+
+    self->has_child = succinct_bit_vector_new();
+    if (self->has_child == NULL) {
+        goto exit_succinct_trie_created;
+    }
+
+    self->louds = succinct_bit_vector_new();
+    if (self->louds == NULL) {
+        goto exit_succinct_trie_created;
+    }
+
+    self->values = uint32_array_new();
+    if (self->values == NULL) {
+        goto exit_succinct_trie_created;
+    }
+
+    self->tail_offsets = uint32_array_new();
+    if (self->tail_offsets == NULL) {
+        goto exit_succinct_trie_created;
+    }
+
+    self->tail = uchar_array_new();
+    if (self->tail == NULL) {
+        goto exit_succinct_trie_created;
+    }
+
+    return self;
+
+exit_succinct_trie_created:
+    succinct_trie_destroy(self);
+    return NULL;
+}
+
+succinct_trie_t *succinct_trie_new_sorted(cstring_array *keys, uint32_array *values) {
+    if (keys == NULL || values == NULL) return NULL;
+
+    size_t num_keys = cstring_array_num_strings(keys);
+    if (values->n != num_keys) {
+        log_error("Number of keys (%zu) does not match number of values (%zu)\n", num_keys, values->n);
+        return NULL;
+    }
+
+    for (size_t i = 1; i < num_keys; i++) {
+        if (strcmp(cstring_array_get_string(keys, i - 1), cstring_array_get_string(keys, i)) >= 0) {
+            log_error("Keys must be unique and sorted, key %zu is out of order\n", i);
+            return NULL;
+        }
+    }
+
+    succinct_trie_t *self = succinct_trie_new_empty();
+    if (self == NULL) return NULL;
+
+    cstring_array *tails = cstring_array_new();
+    // (start, end, depth) of the keys under each node, in level order
+    uint32_array *queue = uint32_array_new();
+
+    if (tails == NULL || queue == NULL) {
+        goto exit_succinct_trie_building;
+    }
+
+    if (num_keys > 0) {
+        uint32_array_push(queue, 0);
+        uint32_array_push(queue, (uint32_t)num_keys);
+        uint32_array_push(queue, 0);
+    }
+
+    for (size_t q = 0; q < queue->n; q += 3) {
+        uint32_t start = queue->a[q];
+        uint32_t end = queue->a[q + 1];
+        uint32_t depth = queue->a[q + 2];
+
+        bool first_edge = true;
+
+        for (uint32_t i = start; i < end; ) {
+            char *key = cstring_array_get_string(keys, i);
+            unsigned char c = (unsigned char)key[depth];
+
+            uint32_t j = i + 1;
+            if (c != '\0') {
+                while (j < end && (unsigned char)cstring_array_get_string(keys, j)[depth] == c) {
+                    j++;
+                }
+            }
+
+            uchar_array_push(self->labels, c);
+            succinct_bit_vector_push(self->louds, first_edge);
+            first_edge = false;
+
+            if (j - i > 1) {
+                succinct_bit_vector_push(self->has_child, true);
+                uint32_array_push(queue, i);
+                uint32_array_push(queue, j);
+                uint32_array_push(queue, depth + 1);
+            } else {
+                succinct_bit_vector_push(self->has_child, false);
+                uint32_array_push(self->values, values->a[i]);
+                cstring_array_add_string(tails, c != '\0' ? key + depth + 1 : "");
+            }
+
+            i = j;
+        }
+    }
+
+    succinct_bit_vector_build_index(self->has_child);
+    succinct_bit_vector_build_index(self->louds);
+
+    if (!succinct_trie_build_tails(self, tails)) {
+        goto exit_succinct_trie_building;
+    }
+
+    self->num_keys = (uint32_t)num_keys;
+
+    cstring_array_destroy(tails);
+    uint32_array_destroy(queue);
+
+    return self;
+
+exit_succinct_trie_building:
+    if (tails != NULL) cstring_array_destroy(tails);
+    if (queue != NULL) uint32_array_destroy(queue);
+    succinct_trie_destroy(self);
+    return NULL;
+}
+
+/*
+Lookup
+*/
+
+bool succinct_trie_get_data(succinct_trie_t *self, char *key, uint32_t *data) {
+    if (self == NULL || key == NULL || self->labels->n == 0) return false;
+
+    unsigned char *labels = self->labels->a;
+    uint32_t num_labels = (uint32_t)self->labels->n;
+    uint32_t num_nodes = self->louds->num_ones;
+
+    uint32_t node = 0;
+    uint32_t begin = 0;
+
+    for (size_t i = 0; ; i++) {
+        uint32_t end = node + 1 < num_nodes ? succinct_bit_vector_select1(self->louds, node + 1) : num_labels;
+        unsigned char c = (unsigned char)key[i];
+
+        // Labels within a node are sorted
+        uint32_t lo = begin, hi = end;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (labels[mid] < c) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+
+        if (lo == end || labels[lo] != c) {
+            return false;
+        }
+
+        uint32_t edge = lo;
+        uint32_t internal_rank = succinct_bit_vector_rank1(self->has_child, edge);
+
+        if (succinct_bit_vector_get(self->has_child, edge)) {
+            // Internal edges number the nodes below the root in level order
+            node = internal_rank + 1;
+            begin = succinct_bit_vector_select1(self->louds, node);
+            continue;
+        }
+
+        uint32_t leaf = edge - internal_rank;
+        if (c != '\0' && strcmp((char *)self->tail->a + self->tail_offsets->a[leaf], key + i + 1) != 0) {
+            return false;
+        }
+
+        *data = self->values->a[leaf];
+        return true;
+    }
+}
+
+inline uint32_t succinct_trie_num_keys(succinct_trie_t *self) {
+    if (self == NULL) return 0;
+    return self->num_keys;
+}
+
+size_t succinct_trie_memory_size(succinct_trie_t *self) {
+    if (self == NULL) return 0;
+
+    size_t size = sizeof(succinct_trie_t);
+    size += self->labels->n * sizeof(unsigned char);
+
+    succinct_bit_vector_t *bit_vectors[] = {self->has_child, self->louds};
+    for (size_t i = 0; i < sizeof(bit_vectors) / sizeof(bit_vectors[0]); i++) {
+        succinct_bit_vector_t *bv = bit_vectors[i];
+        size += bv->bits->n * sizeof(uint64_t) + (bv->ranks->n + bv->selects->n) * sizeof(uint32_t);
+    }
+
+    size += (self->values->n + self->tail_offsets->n) * sizeof(uint32_t);
+    size += self->tail->n * sizeof(unsigned char);
+
+    return size;
+}
+
+/*
+I/O methods
+*/
+
+static bool succinct_write_uint32_array(FILE *file, uint32_array *array) {
+    if (!file_write_uint32(file, (uint32_t)array->n)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < array->n; i++) {
+        if (!file_write_uint32(file, array->a[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool succinct_read_uint32_array(FILE *file, uint32_array *array) {
+    uint32_t n;
+    if (!file_read_uint32(file, &n)) {
+        return false;
+    }
+
+    uint32_array_resize(array, n);
+    if (n > 0 && !file_read_uint32_array(file, array->a, n)) {
+        return false;
+    }
+    array->n = n;
+    return true;
+}
+
+static bool succinct_write_uchar_array(FILE *file, uchar_array *array) {
+    return file_write_uint32(file, (uint32_t)array->n) &&
+           file_write_chars(file, (const char *)array->a, array->n);
+}
+
+static bool succinct_read_uchar_array(FILE *file, uchar_array *array) {
+    uint32_t n;
+    if (!file_read_uint32(file, &n)) {
+        return false;
+    }
+
+    uchar_array_resize(array, n);
+    if (n > 0 && !file_read_chars(file, (char *)array->a, n)) {
+        return false;
+    }
+    array->n = n;
+    return true;
+}
+
+bool succinct_trie_write(succinct_trie_t *self, FILE *file) {
+    if (self == NULL || file == NULL) return false;
+
+    return file_write_uint32(file, SUCCINCT_TRIE_SIGNATURE) &&
+           file_write_uint32(file, self->num_keys) &&
+           succinct_write_uchar_array(file, self->labels) &&
+           succinct_bit_vector_write(self->has_child, file) &&
+           succinct_bit_vector_write(self->louds, file) &&
+           succinct_write_uint32_array(file, self->values) &&
+           succinct_write_uint32_array(file, self->tail_offsets) &&
+           succinct_write_uchar_array(file, self->tail);
+}
+
+succinct_trie_t *succinct_trie_read(FILE *file) {
+    long save_pos = ftell(file);
+
+    uint32_t signature;
+    if (!file_read_uint32(file, &signature) || signature != SUCCINCT_TRIE_SIGNATURE) {
+        goto exit_file_read;
+    }
+
+    succinct_trie_t *self = succinct_trie_new_empty();
+    if (self == NULL) {
+        goto exit_file_read;
+    }
+
+    succinct_bit_vector_destroy(self->has_child);
+    succinct_bit_vector_destroy(self->louds);
+    self->has_child = NULL;
+    self->louds = NULL;
+
+    if (!file_read_uint32(file, &self->num_keys) ||
+        !succinct_read_uchar_array(file, self->labels)) {
+        goto exit_succinct_trie_created;
+    }
+
+    self->has_child = succinct_bit_vector_read(file);
+    if (self->has_child == NULL) {
+        goto exit_succinct_trie_created;
+    }
+
+    self->louds = succinct_bit_vector_read(file);
+    if (self->louds == NULL) {
+        goto exit_succinct_trie_created;
+    }
+
+    if (!succinct_read_uint32_array(file, self->values) ||
+        !succinct_read_uint32_array(file, self->tail_offsets) ||
+        !succinct_read_uchar_array(file, self->tail)) {
+        goto exit_succinct_trie_created;
+    }
+
+    if (self->has_child->num_bits != self->labels->n ||
+        self->louds->num_bits != self->labels->n ||
+        self->values->n != self->tail_offsets->n) {
+        log_error("Succinct trie is corrupt\n");
+        goto exit_succinct_trie_created;
+    }
+
+    return self;
+
+exit_succinct_trie_created:
+    succinct_trie_destroy(self);
+exit_file_read:
+    fseek(file, save_pos, SEEK_SET);
+    return NULL;
+}
+
+/*
+Destructor
+*/
+
+void succinct_trie_destroy(succinct_trie_t *self) {
+    if (self == NULL) return;
+
+    if (self->labels != NULL) {
+        uchar_array_destroy(self->labels);
+    }
+
+    if (self->has_child != NULL) {
+        succinct_bit_vector_destroy(self->has_child);
+    }
+
+    if (self->louds != NULL) {
+        succinct_bit_vector_destroy(self->louds);
+    }
+
+    if (self->values != NULL) {
+        uint32_array_destroy(self->values);
+    }
+
+    if (self->tail_offsets != NULL) {
+        uint32_array_destroy(self->tail_offsets);
+    }
+
+    if (self->tail != NULL) {
+        uchar_array_destroy(self->tail);
+    }
+
+    free(self);
+}
@@ -0,0 +1,68 @@
+/******************************************************************************
+* Static succinct trie for large read-only dictionaries (vocabularies, model
+* feature names). The tree is stored level-order in the LOUDS-sparse encoding:
+* one label byte per edge plus two bit vectors, has_child (the edge leads to an
+* internal node) and louds (the edge is the first edge of its node). Children
+* and siblings are found with rank/select on those bit vectors, so the
+* structure costs about 10 bits per edge instead of the 8 bytes per
+* double-array node in trie.h. As in trie.h, the suffix of a key below its last
+* branching point is stored as a NUL-terminated tail, and tails which are
+* suffixes of other tails share storage.
+*
+* Succinct tries are built once from sorted keys and only support exact
+* lookups. A double-array trie can be converted with trie_compact (see trie.h).
+******************************************************************************/
+
+#ifndef SUCCINCT_TRIE_H
+#define SUCCINCT_TRIE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "collections.h"
+#include "file_utils.h"
+#include "string_utils.h"
+
+#define SUCCINCT_TRIE_SIGNATURE 0xCDCDCDCD
+
+typedef struct succinct_bit_vector {
+    uint64_array *bits;
+    uint32_array *ranks;    // Number of ones before each block
+    uint32_array *selects;  // Position of every SUCCINCT_SELECT_SAMPLE-th one
+    uint32_t num_bits;
+    uint32_t num_ones;
+} succinct_bit_vector_t;
+
+succinct_bit_vector_t *succinct_bit_vector_new(void);
+void succinct_bit_vector_push(succinct_bit_vector_t *self, bool bit);
+void succinct_bit_vector_build_index(succinct_bit_vector_t *self);
+bool succinct_bit_vector_get(succinct_bit_vector_t *self, uint32_t i);
+uint32_t succinct_bit_vector_rank1(succinct_bit_vector_t *self, uint32_t i);
+uint32_t succinct_bit_vector_select1(succinct_bit_vector_t *self, uint32_t k);
+void succinct_bit_vector_destroy(succinct_bit_vector_t *self);
+
+typedef struct succinct_trie {
+    uchar_array *labels;                // Edge labels in level order, '\0' marks the end of a key
+    succinct_bit_vector_t *has_child;
+    succinct_bit_vector_t *louds;
+    uint32_array *values;               // Data for each leaf edge
+    uint32_array *tail_offsets;         // Offset into tail for each leaf edge
+    uchar_array *tail;
+    uint32_t num_keys;
+} succinct_trie_t;
+
+// keys must be unique and sorted bytewise (strcmp order), values parallel to keys
+succinct_trie_t *succinct_trie_new_sorted(cstring_array *keys, uint32_array *values);
+
+bool succinct_trie_get_data(succinct_trie_t *self, char *key, uint32_t *data);
+uint32_t succinct_trie_num_keys(succinct_trie_t *self);
+size_t succinct_trie_memory_size(succinct_trie_t *self);
+
+bool succinct_trie_write(succinct_trie_t *self, FILE *file);
+succinct_trie_t *succinct_trie_read(FILE *file);
+
+void succinct_trie_destroy(succinct_trie_t *self);
+
+#endif
@@ -0,0 +1,265 @@
+#include <string.h>
+#include <pthread.h>
+
+#include "token_cache.h"
+#include "feature_hash.h"
+#include "string_utils.h"
+
+#define TOKEN_CACHE_HASH_SEED 0x7c4a7c4a
+
+typedef struct token_cache_entry {
+    uint64_t hash;              // 0 for an empty entry
+    uint64_t tag;
+    uint16_t key_len;
+    uint16_t value_len;
+    uint32_t last_used;
+    char data[TOKEN_CACHE_ENTRY_DATA_SIZE];     // Key bytes followed by value bytes
+} token_cache_entry_t;
+
+typedef struct token_cache {
+    token_cache_entry_t *entries;
+    size_t num_entries;
+    size_t num_sets;
+    uint64_t generation;
+    uint32_t clock;
+    token_cache_stats_t stats;  // Not yet added to the global totals
+    uint64_t lookups;
+} token_cache_t;
+
+static bool token_cache_enabled = false;
+static size_t token_cache_num_entries = TOKEN_CACHE_DEFAULT_SIZE;
+static uint64_t token_cache_generation = 1;
+
+static token_cache_stats_t token_cache_global_stats = {0, 0, 0, 0};
+
+static pthread_key_t token_cache_key;
+static pthread_once_t token_cache_key_once = PTHREAD_ONCE_INIT;
+
+static void token_cache_flush_stats(token_cache_t *self) {
+    __atomic_fetch_add(&token_cache_global_stats.hits, self->stats.hits, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&token_cache_global_stats.misses, self->stats.misses, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&token_cache_global_stats.inserts, self->stats.inserts, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&token_cache_global_stats.evictions, self->stats.evictions, __ATOMIC_RELAXED);
+    self->stats = (token_cache_stats_t){0, 0, 0, 0};
+    self->lookups = 0;
+}
+
+static void token_cache_destroy(token_cache_t *self) {
+    if (self == NULL) return;
+
+    token_cache_flush_stats(self);
+
+    if (self->entries != NULL) {
+        free(self->entries);
+    }
+
+    free(self);
+}
+
+static token_cache_t *token_cache_new(size_t num_entries) {
+    token_cache_t *self = calloc(1, sizeof(token_cache_t));
+    if (self == NULL) return NULL;
+
+    self->entries = calloc(num_entries, sizeof(token_cache_entry_t));
+    if (self->entries == NULL) {
+        free(self);
+        return NULL;
+    }
+
+    self->num_entries = num_entries;
+    self->num_sets = num_entries / TOKEN_CACHE_WAYS;
+    self->generation = __atomic_load_n(&token_cache_generation, __ATOMIC_ACQUIRE);
+    return self;
+}
+
+static void token_cache_thread_destroy(void *cache) {
+    token_cache_destroy((token_cache_t *)cache);
+}
+
+static void token_cache_key_create(void) {
+    pthread_key_create(&token_cache_key, token_cache_thread_destroy);
+}
+
+static token_cache_t *token_cache_thread_cache(void) {
+    if (!__atomic_load_n(&token_cache_enabled, __ATOMIC_RELAXED)) return NULL;
+
+    pthread_once(&token_cache_key_once, token_cache_key_create);
+
+    token_cache_t *cache = pthread_getspecific(token_cache_key);
+    size_t num_entries = __atomic_load_n(&token_cache_num_entries, __ATOMIC_RELAXED);
+
+    // Cache may have been sized by a previous token_cache_enable
+    if (cache != NULL && cache->num_entries != num_entries) {
+        token_cache_destroy(cache);
+        cache = NULL;
+        pthread_setspecific(token_cache_key, NULL);
+    }
+
+    if (cache == NULL) {
+        cache = token_cache_new(num_entries);
+        if (cache == NULL) return NULL;
+        pthread_setspecific(token_cache_key, cache);
+        return cache;
+    }
+
+    uint64_t generation = __atomic_load_n(&token_cache_generation, __ATOMIC_ACQUIRE);
+    if (cache->generation != generation) {
+        memset(cache->entries, 0, cache->num_entries * sizeof(token_cache_entry_t));
+        cache->generation = generation;
+    }
+
+    return cache;
+}
+
+bool token_cache_enable(size_t num_entries) {
+    if (num_entries < TOKEN_CACHE_WAYS) num_entries = TOKEN_CACHE_WAYS;
+
+    size_t size = TOKEN_CACHE_WAYS;
+    while (size < num_entries) {
+        size <<= 1;
+    }
+
+    __atomic_store_n(&token_cache_num_entries, size, __ATOMIC_RELAXED);
+    __atomic_store_n(&token_cache_enabled, true, __ATOMIC_RELEASE);
+    return true;
+}
+
+void token_cache_disable(void) {
+    __atomic_store_n(&token_cache_enabled, false, __ATOMIC_RELEASE);
+    token_cache_invalidate();
+
+    // Other threads free their caches on exit
+    pthread_once(&token_cache_key_once, token_cache_key_create);
+    token_cache_t *cache = pthread_getspecific(token_cache_key);
+    if (cache != NULL) {
+        token_cache_destroy(cache);
+        pthread_setspecific(token_cache_key, NULL);
+    }
+}
+
+bool token_cache_is_enabled(void) {
+    return __atomic_load_n(&token_cache_enabled, __ATOMIC_RELAXED);
+}
+
+void token_cache_invalidate(void) {
+    __atomic_fetch_add(&token_cache_generation, 1, __ATOMIC_RELEASE);
+}
+
+static inline uint64_t token_cache_hash(uint64_t tag, const char *key, size_t key_len) {
+    uint64_t hash = feature_hash(key, key_len, TOKEN_CACHE_HASH_SEED) ^ (tag * 0x9e3779b97f4a7c15ULL);
+    hash ^= hash >> 31;
+    return hash != 0 ? hash : 1;
+}
+
+static inline token_cache_entry_t *token_cache_set(token_cache_t *self, uint64_t hash) {
+    return self->entries + (hash & (self->num_sets - 1)) * TOKEN_CACHE_WAYS;
+}
+
+static inline bool token_cache_entry_matches(token_cache_entry_t *entry, uint64_t hash, uint64_t tag, const char *key, size_t key_len) {
+    return entry->hash == hash && entry->tag == tag && entry->key_len == key_len && memcmp(entry->data, key, key_len) == 0;
+}
+
+bool token_cache_get(uint64_t tag, const char *key, size_t key_len, char_array *out) {
+    if (!token_cache_key_cacheable(key_len)) return false;
+
+    token_cache_t *cache = token_cache_thread_cache();
+    if (cache == NULL) return false;
+
+    uint64_t hash = token_cache_hash(tag, key, key_len);
+    token_cache_entry_t *set = token_cache_set(cache, hash);
+
+    bool hit = false;
+
+    for (size_t i = 0; i < TOKEN_CACHE_WAYS; i++) {
+        token_cache_entry_t *entry = set + i;
+        if (token_cache_entry_matches(entry, hash, tag, key, key_len)) {
+            entry->last_used = ++cache->clock;
+            char_array_append_len(out, entry->data + entry->key_len, entry->value_len);
+            hit = true;
+            break;
+        }
+    }
+
+    if (hit) {
+        cache->stats.hits++;
+    } else {
+        cache->stats.misses++;
+    }
+
+    if (++cache->lookups >= TOKEN_CACHE_STATS_FLUSH) {
+        token_cache_flush_stats(cache);
+    }
+
+    return hit;
+}
+
+void token_cache_put(uint64_t tag, const char *key, size_t key_len, const char *value, size_t value_len) {
+    if (!token_cache_key_cacheable(key_len) || key_len + value_len > TOKEN_CACHE_ENTRY_DATA_SIZE) return;
+
+    token_cache_t *cache = token_cache_thread_cache();
+    if (cache == NULL) return;
+
+    uint64_t hash = token_cache_hash(tag, key, key_len);
+    token_cache_entry_t *set = token_cache_set(cache, hash);
+
+    // Reuse a matching or empty way, otherwise evict the least recently used one
+    token_cache_entry_t *entry = NULL;
+    token_cache_entry_t *lru = set;
+
+    for (size_t i = 0; i < TOKEN_CACHE_WAYS; i++) {
+        token_cache_entry_t *way = set + i;
+        if (way->hash == 0 || token_cache_entry_matches(way, hash, tag, key, key_len)) {
+            entry = way;
+            break;
+        }
+        if (way->last_used < lru->last_used) {
+            lru = way;
+        }
+    }
+
+    if (entry == NULL) {
+        entry = lru;
+        cache->stats.evictions++;
+    }
+
+    entry->hash = hash;
+    entry->tag = tag;
+    entry->key_len = (uint16_t)key_len;
+    entry->value_len = (uint16_t)value_len;
+    entry->last_used = ++cache->clock;
+    memcpy(entry->data, key, key_len);
+    memcpy(entry->data + key_len, value, value_len);
+
+    cache->stats.inserts++;
+}
+
+token_cache_stats_t token_cache_get_stats(void) {
+    if (__atomic_load_n(&token_cache_enabled, __ATOMIC_RELAXED)) {
+        pthread_once(&token_cache_key_once, token_cache_key_create);
+        token_cache_t *cache = pthread_getspecific(token_cache_key);
+        if (cache != NULL) {
+            token_cache_flush_stats(cache);
+        }
+    }
+
+    return (token_cache_stats_t){
+        .hits = __atomic_load_n(&token_cache_global_stats.hits, __ATOMIC_RELAXED),
+        .misses = __atomic_load_n(&token_cache_global_stats.misses, __ATOMIC_RELAXED),
+        .inserts = __atomic_load_n(&token_cache_global_stats.inserts, __ATOMIC_RELAXED),
+        .evictions = __atomic_load_n(&token_cache_global_stats.evictions, __ATOMIC_RELAXED)
+    };
+}
+
+void token_cache_reset_stats(void) {
+    pthread_once(&token_cache_key_once, token_cache_key_create);
+    token_cache_t *cache = pthread_getspecific(token_cache_key);
+    if (cache != NULL) {
+        cache->stats = (token_cache_stats_t){0, 0, 0, 0};
+        cache->lookups = 0;
+    }
+
+    __atomic_store_n(&token_cache_global_stats.hits, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&token_cache_global_stats.misses, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&token_cache_global_stats.inserts, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&token_cache_global_stats.evictions, 0, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,74 @@
+/*
+token_cache.h
+-------------
+
+Bounded per-thread memo of normalization results for short strings.
+
+Token frequencies in addresses are heavily skewed ("street", "avenue",
+"москва"), so the same token is normalized and transliterated over and over.
+When enabled, each thread owns a small set-associative cache (4 ways, LRU
+within a set) keyed by the input bytes and a 64-bit tag. The tag encodes what
+was done to the input: the kind of operation plus its options, token type or
+transliterator. Entries store the key and value inline, so lookups and inserts
+never allocate. Inputs or outputs too long to fit in an entry are not cached.
+
+Per-thread caches follow the geodb reader pattern: created on first use and
+destroyed when the thread exits. token_cache_invalidate drops every thread's
+entries lazily (e.g. when the transliteration tables are reloaded).
+
+Hit/miss counts are kept per thread and folded into global totals every
+TOKEN_CACHE_STATS_FLUSH lookups and at thread exit, so token_cache_get_stats
+may lag slightly behind for threads that are still running.
+*/
+
+#ifndef TOKEN_CACHE_H
+#define TOKEN_CACHE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "collections.h"
+
+#define TOKEN_CACHE_DEFAULT_SIZE 4096
+#define TOKEN_CACHE_WAYS 4
+#define TOKEN_CACHE_ENTRY_DATA_SIZE 96
+#define TOKEN_CACHE_MAX_KEY_LEN 48
+#define TOKEN_CACHE_STATS_FLUSH 4096
+
+typedef enum {
+    TOKEN_CACHE_NORMALIZE_TOKEN = 1,
+    TOKEN_CACHE_TRANSLITERATE = 2
+} token_cache_kind_t;
+
+#define TOKEN_CACHE_TAG(kind, value) (((uint64_t)(kind) << 56) | ((uint64_t)(value) & 0x00ffffffffffffffULL))
+
+typedef struct token_cache_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t inserts;
+    uint64_t evictions;
+} token_cache_stats_t;
+
+// Enables caching with num_entries per thread (rounded up to a power of 2)
+bool token_cache_enable(size_t num_entries);
+void token_cache_disable(void);
+bool token_cache_is_enabled(void);
+
+void token_cache_invalidate(void);
+
+/*
+On a hit, appends the cached value to out (not NUL-terminated) and returns
+true. Always returns false when the cache is disabled or the key is too long.
+*/
+bool token_cache_get(uint64_t tag, const char *key, size_t key_len, char_array *out);
+void token_cache_put(uint64_t tag, const char *key, size_t key_len, const char *value, size_t value_len);
+
+static inline bool token_cache_key_cacheable(size_t key_len) {
+    return key_len <= TOKEN_CACHE_MAX_KEY_LEN;
+}
+
+token_cache_stats_t token_cache_get_stats(void);
+void token_cache_reset_stats(void);
+
+#endif
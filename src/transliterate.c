@@ -1,6 +1,9 @@
 #include <math.h>
 #include "transliterate.h"
 #include "file_utils.h"
+#include "feature_hash.h"
+#include "lazy_module.h"
+#include "token_cache.h"
 
 #include "log/log.h"
 #include "strndup.h"
@@ -15,6 +18,8 @@
 
 static transliteration_table_t *trans_table = NULL;
 
+static lazy_module_t transliteration_lazy_module = LAZY_MODULE_INIT("transliteration", transliteration_module_setup);
+
 transliteration_table_t *get_transliteration_table(void) {
     return trans_table;
 }
@@ -44,6 +49,7 @@ void transliterator_destroy(transliterator_t *self) {
 
 
 transliterator_t *get_transliterator(char *name) {
+    lazy_module_ensure(&transliteration_lazy_module);
     if (trans_table == NULL) {
         return NULL;
     }
@@ -666,9 +672,8 @@ static char *replace_groups(trie_t *trie, char *str, char *replacement, group_ca
     return char_array_to_string(ret);
 }
 
-char *transliterate(char *trans_name, char *str, size_t len) {
-    if (trans_name == NULL || str == NULL) return NULL;
-
+static char *transliterate_uncached(char *trans_name, char *str, size_t len) {
+    lazy_module_ensure(&transliteration_lazy_module);
     transliteration_table_t *trans_table = get_transliteration_table();
 
     if (trans_table == NULL) {
@@ -738,7 +743,32 @@ char *transliterate(char *trans_name, char *str, size_t len) {
             return NULL;
         }
 
-        if (step->type == STEP_RULESET) {
+        if (step->type == STEP_RULESET && step->dfa != NULL) {
+            log_debug("compiled ruleset\n");
+            char_array *compiled = char_array_new_size(len + 1);
+            // Consecutive compiled rulesets share their intermediate buffers, so skip ahead to the last of them
+            transliteration_dfa_t *dfas[TRANSLITERATION_DFA_MAX_STEPS];
+            size_t num_dfas = 0;
+            uint32_t steps_end = transliterator->steps_index + transliterator->steps_length;
+
+            while (num_dfas < TRANSLITERATION_DFA_MAX_STEPS && i < steps_end &&
+                   trans_table->steps->a[i]->type == STEP_RULESET && trans_table->steps->a[i]->dfa != NULL) {
+                dfas[num_dfas++] = trans_table->steps->a[i]->dfa;
+                i++;
+            }
+            i--;
+
+            bool compiled_ok = transliteration_dfa_apply_steps(dfas, num_dfas, str, len, compiled);
+            if (!compiled_ok) {
+                log_warn("invalid UTF-8 in transliterating string: %.*s\n", (int)len, str);
+                if (allocated_trans_name) free(trans_name);
+                char_array_destroy(compiled);
+                free(str);
+                return NULL;
+            }
+            free(str);
+            str = char_array_to_string(compiled);
+        } else if (step->type == STEP_RULESET) {
             log_debug("ruleset\n");
             result = trie_get_prefix_from_index(trie, step_name, strlen(step_name), trans_result.node_id, trans_result.tail_pos);
             uint32_t step_node_id = result.node_id;
@@ -790,6 +820,7 @@ char *transliterate(char *trans_name, char *str, size_t len) {
                 if (char_len <= 0) {
                     log_warn("invalid UTF-8 at position %zu in transliterating string: %.*s\n", idx, (int)len, str);
                     if (allocated_trans_name) free(trans_name);
+                    char_array_destroy(new_str);
                     free(str);
                     return NULL;
                 }
@@ -1047,6 +1078,30 @@ char *transliterate(char *trans_name, char *str, size_t len) {
     return str;
 }
 
+char *transliterate(char *trans_name, char *str, size_t len) {
+    if (trans_name == NULL || str == NULL) return NULL;
+
+    if (!token_cache_is_enabled() || !token_cache_key_cacheable(len)) {
+        return transliterate_uncached(trans_name, str, len);
+    }
+
+    uint64_t tag = TOKEN_CACHE_TAG(TOKEN_CACHE_TRANSLITERATE, feature_hash(trans_name, strlen(trans_name), 0));
+
+    char_array *cached = char_array_new_size(len + 1);
+    if (cached != NULL) {
+        if (token_cache_get(tag, str, len, cached)) {
+            return char_array_to_string(cached);
+        }
+        char_array_destroy(cached);
+    }
+
+    char *transliterated = transliterate_uncached(trans_name, str, len);
+    if (transliterated != NULL) {
+        token_cache_put(tag, str, len, transliterated, strlen(transliterated));
+    }
+    return transliterated;
+}
+
 void transliteration_table_destroy(void) {
     transliteration_table_t *trans_table = get_transliteration_table();
     if (trans_table == NULL) return;
@@ -1162,6 +1217,7 @@ transliteration_step_t *transliteration_step_new(char *name, step_type_t type) {
         return NULL;
     }
 
+    self->dfa = NULL;
     self->name = strdup(name);
     if (self->name == NULL) {
         transliteration_step_destroy(self);
@@ -1181,6 +1237,10 @@ void transliteration_step_destroy(transliteration_step_t *self) {
         free(self->name);
     }
 
+    if (self->dfa != NULL) {
+        transliteration_dfa_destroy(self->dfa);
+    }
+
     free(self);
 }
 
@@ -1238,6 +1298,7 @@ bool transliteration_table_add_script_language(script_language_t script_language
 }
 
 transliterator_index_t get_transliterator_index_for_script_language(script_t script, char *language) {
+    lazy_module_ensure(&transliteration_lazy_module);
     if (trans_table == NULL || language == NULL || strlen(language) >= MAX_LANGUAGE_LEN) {
         return NULL_TRANSLITERATOR_INDEX;
     }
@@ -1363,6 +1424,7 @@ transliteration_step_t *transliteration_step_read(FILE *f) {
     if (step == NULL) {
         return NULL;
     }
+    step->dfa = NULL;
 
     if (!file_read_uint32(f, &step->type)) {
         goto exit_step_destroy;
@@ -1780,6 +1842,9 @@ bool transliteration_table_read(FILE *f) {
         goto exit_trans_table_load_error;
     }
 
+    size_t num_compiled = transliteration_table_compile_steps();
+    log_debug("Compiled %zu rulesets\n", num_compiled);
+
     return true;
 
 exit_trans_table_load_error:
@@ -1787,6 +1852,107 @@ exit_trans_table_load_error:
     return false;
 }
 
+static bool transliteration_rule_key_is_plain(char *key) {
+    uint8_t *ptr = (uint8_t *)key;
+    int32_t ch = 0;
+
+    while (*ptr) {
+        ssize_t char_len = utf8proc_iterate(ptr, -1, &ch);
+        // Context markers are not valid UTF-8 on their own
+        if (char_len <= 0) return false;
+        // Control characters mark sets, repeats and empty transitions
+        if (ch < 0x20) return false;
+        ptr += char_len;
+    }
+
+    return true;
+}
+
+static transliteration_dfa_t *transliteration_step_compile(char *trans_name, char *step_name) {
+    transliteration_dfa_t *dfa = NULL;
+
+    char_array *prefix = char_array_from_string(trans_name);
+    char_array_cat(prefix, NAMESPACE_SEPARATOR_CHAR);
+    char_array_cat(prefix, step_name);
+    char_array_cat(prefix, NAMESPACE_SEPARATOR_CHAR);
+
+    cstring_array *keys = cstring_array_new();
+    uint32_array *values = uint32_array_new();
+    cstring_array *outputs = cstring_array_new();
+
+    if (!trie_get_keys_with_prefix(trans_table->trie, char_array_get_string(prefix), keys, values)) {
+        goto exit_step_compile;
+    }
+
+    size_t num_keys = cstring_array_num_strings(keys);
+    // Missing rulesets are reported by the general matcher
+    if (num_keys == 0) {
+        goto exit_step_compile;
+    }
+
+    for (uint32_t i = 0; i < num_keys; i++) {
+        char *key = cstring_array_get_string(keys, i);
+        if (*key == '\0' || !transliteration_rule_key_is_plain(key)) {
+            goto exit_step_compile;
+        }
+
+        uint32_t replacement_index = values->a[i];
+        if (replacement_index >= trans_table->replacements->n) {
+            goto exit_step_compile;
+        }
+
+        transliteration_replacement_t *replacement = trans_table->replacements->a[replacement_index];
+        if (replacement->groups != NULL || replacement->revisit_index != 0) {
+            goto exit_step_compile;
+        }
+
+        char *replacement_string = cstring_array_get_string(trans_table->replacement_strings, replacement->string_index);
+        if (replacement_string == NULL) {
+            goto exit_step_compile;
+        }
+        cstring_array_add_string(outputs, replacement_string);
+    }
+
+    dfa = transliteration_dfa_new(keys, outputs);
+
+exit_step_compile:
+    char_array_destroy(prefix);
+    cstring_array_destroy(keys);
+    uint32_array_destroy(values);
+    cstring_array_destroy(outputs);
+    return dfa;
+}
+
+/*
+Compiles every ruleset step made only of plain string rules (no character
+sets, repeats, empty transitions, contexts, groups or revisits) so it can be
+applied with transliteration_dfa_apply. Returns the number of steps compiled.
+*/
+size_t transliteration_table_compile_steps(void) {
+    if (trans_table == NULL || trans_table->trie == NULL || trans_table->trie->succinct != NULL) return 0;
+
+    size_t num_compiled = 0;
+    transliterator_t *trans;
+
+    kh_foreach_value(trans_table->transliterators, trans, {
+        for (uint32_t i = trans->steps_index; i < trans->steps_index + trans->steps_length && i < trans_table->steps->n; i++) {
+            transliteration_step_t *step = trans_table->steps->a[i];
+            if (step->type != STEP_RULESET) continue;
+
+            if (step->dfa != NULL) {
+                transliteration_dfa_destroy(step->dfa);
+            }
+
+            step->dfa = transliteration_step_compile(trans->name, step->name);
+            if (step->dfa != NULL) {
+                num_compiled++;
+            }
+        }
+    })
+
+    return num_compiled;
+}
+
 bool transliteration_table_write(FILE *f) {
     if (f == NULL) {
         return false;
@@ -1993,9 +2159,19 @@ bool transliteration_module_setup(char *filename) {
     return true;
 }
 
+// Records the path and loads the tables on first use instead
+bool transliteration_module_setup_lazy(char *filename) {
+    if (trans_table != NULL) {
+        return true;
+    }
+    return lazy_module_defer(&transliteration_lazy_module, filename);
+}
 
 void transliteration_module_teardown(void) {
+    lazy_module_cancel(&transliteration_lazy_module);
     transliteration_table_destroy();
     trans_table = NULL;
+    // Cached results came from the old tables
+    token_cache_invalidate();
 }
 
@@ -11,6 +11,7 @@
 #include "string_utils.h"
 #include "trie.h"
 #include "trie_search.h"
+#include "transliteration_dfa.h"
 #include "unicode_scripts.h"
 
 #define LATIN_ASCII "latin-ascii"
@@ -31,6 +32,7 @@ typedef enum {
 typedef struct transliteration_step {
     step_type_t type;
     char *name;
+    transliteration_dfa_t *dfa;     // Compiled at load for rulesets with only plain string rules, otherwise NULL
 } transliteration_step_t;
 
 transliteration_step_t *transliteration_step_new(char *name, step_type_t type);
@@ -166,12 +168,15 @@ transliterator_index_t get_transliterator_index_for_script_language(script_t scr
         }                                                                                                                           \
     } while (0);
 
+size_t transliteration_table_compile_steps(void);
+
 bool transliteration_table_write(FILE *file);
 bool transliteration_table_save(char *filename);
 
 // Module setup/teardown
 bool transliteration_module_init(void);
 bool transliteration_module_setup(char *filename);
+bool transliteration_module_setup_lazy(char *filename);
 void transliteration_module_teardown(void);
 
 #endif
@@ -0,0 +1,361 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "transliteration_dfa.h"
+
+#define NO_DENSE_ROW UINT32_MAX
+
+typedef struct transliteration_dfa_rule {
+    char *key;
+    size_t key_len;
+    uint32_t output_index;
+} transliteration_dfa_rule_t;
+
+static int transliteration_dfa_rule_compare(const void *a, const void *b) {
+    return strcmp(((const transliteration_dfa_rule_t *)a)->key, ((const transliteration_dfa_rule_t *)b)->key);
+}
+
+transliteration_dfa_t *transliteration_dfa_new(cstring_array *keys, cstring_array *outputs) {
+    if (keys == NULL || outputs == NULL) return NULL;
+
+    size_t num_rules = cstring_array_num_strings(keys);
+    if (num_rules != cstring_array_num_strings(outputs) || num_rules >= UINT32_MAX) return NULL;
+
+    transliteration_dfa_t *self = calloc(1, sizeof(transliteration_dfa_t));
+    if (self == NULL) return NULL;
+
+    transliteration_dfa_rule_t *rules = NULL;
+    uint32_array *state_lo = NULL;
+    uint32_array *state_hi = NULL;
+    uint32_array *state_depth = NULL;
+
+    self->dense_rows = uint32_array_new();
+    self->dense = uint32_array_new();
+    self->edges_index = uint32_array_new();
+    self->edge_bytes = uchar_array_new();
+    self->edge_targets = uint32_array_new();
+    self->output_offsets = uint32_array_new();
+    self->output_lengths = uint32_array_new();
+    self->outputs = char_array_new();
+
+    if (self->dense_rows == NULL || self->dense == NULL || self->edges_index == NULL ||
+        self->edge_bytes == NULL || self->edge_targets == NULL || self->output_offsets == NULL ||
+        self->output_lengths == NULL || self->outputs == NULL) {
+        goto exit_dfa_destroy;
+    }
+
+    rules = malloc((num_rules > 0 ? num_rules : 1) * sizeof(transliteration_dfa_rule_t));
+    if (rules == NULL) goto exit_dfa_destroy;
+
+    for (uint32_t i = 0; i < num_rules; i++) {
+        char *key = cstring_array_get_string(keys, i);
+        if (key == NULL || *key == '\0') goto exit_dfa_destroy;
+        rules[i] = (transliteration_dfa_rule_t){key, strlen(key), i};
+        if (rules[i].key_len > self->max_key_len) {
+            self->max_key_len = rules[i].key_len;
+        }
+    }
+
+    // Sorted rules let every state own a contiguous range of them
+    qsort(rules, num_rules, sizeof(transliteration_dfa_rule_t), transliteration_dfa_rule_compare);
+
+    state_lo = uint32_array_new();
+    state_hi = uint32_array_new();
+    state_depth = uint32_array_new();
+    if (state_lo == NULL || state_hi == NULL || state_depth == NULL) goto exit_dfa_destroy;
+
+    uint32_array_push(state_lo, 0);
+    uint32_array_push(state_hi, (uint32_t)num_rules);
+    uint32_array_push(state_depth, 0);
+
+    /*
+    States are numbered breadth-first and processed in that order, so each
+    state's sparse edges are appended contiguously. The depth of a state is
+    the length of its prefix, i.e. the key length of every rule in its range
+    is at least depth.
+    */
+    for (uint32_t s = 0; s < state_lo->n; s++) {
+        uint32_t lo = state_lo->a[s];
+        uint32_t hi = state_hi->a[s];
+        uint32_t depth = state_depth->a[s];
+
+        uint32_t output_offset = TRANSLITERATION_DFA_NO_OUTPUT;
+        uint32_t output_len = 0;
+
+        // The complete key, if any, sorts first in its range
+        if (lo < hi && rules[lo].key_len == depth) {
+            if (lo + 1 < hi && rules[lo + 1].key_len == depth) {
+                goto exit_dfa_destroy;
+            }
+            char *output = cstring_array_get_string(outputs, rules[lo].output_index);
+            if (output == NULL) goto exit_dfa_destroy;
+
+            output_offset = (uint32_t)self->outputs->n;
+            output_len = (uint32_t)strlen(output);
+            char_array_append_len(self->outputs, output, output_len);
+            lo++;
+        }
+
+        uint32_array_push(self->output_offsets, output_offset);
+        uint32_array_push(self->output_lengths, output_len);
+
+        uint32_t edges_start = (uint32_t)self->edge_bytes->n;
+        uint32_array_push(self->edges_index, edges_start);
+
+        while (lo < hi) {
+            unsigned char c = (unsigned char)rules[lo].key[depth];
+            uint32_t end = lo + 1;
+            while (end < hi && (unsigned char)rules[end].key[depth] == c) {
+                end++;
+            }
+
+            uchar_array_push(self->edge_bytes, c);
+            uint32_array_push(self->edge_targets, (uint32_t)state_lo->n);
+
+            uint32_array_push(state_lo, lo);
+            uint32_array_push(state_hi, end);
+            uint32_array_push(state_depth, depth + 1);
+            lo = end;
+        }
+
+        size_t num_edges = self->edge_bytes->n - edges_start;
+
+        if (s == TRANSLITERATION_DFA_START_STATE || num_edges >= TRANSLITERATION_DFA_DENSE_MIN_EDGES) {
+            size_t row = self->dense->n / 256;
+            for (size_t i = 0; i < 256; i++) {
+                uint32_array_push(self->dense, TRANSLITERATION_DFA_NO_STATE);
+            }
+            for (size_t e = edges_start; e < self->edge_bytes->n; e++) {
+                self->dense->a[row * 256 + self->edge_bytes->a[e]] = self->edge_targets->a[e];
+            }
+            self->edge_bytes->n = edges_start;
+            self->edge_targets->n = edges_start;
+            uint32_array_push(self->dense_rows, (uint32_t)row);
+        } else {
+            uint32_array_push(self->dense_rows, NO_DENSE_ROW);
+        }
+    }
+
+    uint32_array_push(self->edges_index, (uint32_t)self->edge_bytes->n);
+    self->num_states = (uint32_t)state_lo->n;
+
+    uint32_array_destroy(state_depth);
+    uint32_array_destroy(state_lo);
+    uint32_array_destroy(state_hi);
+    free(rules);
+
+    return self;
+
+exit_dfa_destroy:
+    if (state_depth != NULL) uint32_array_destroy(state_depth);
+    if (state_lo != NULL) uint32_array_destroy(state_lo);
+    if (state_hi != NULL) uint32_array_destroy(state_hi);
+    if (rules != NULL) free(rules);
+    transliteration_dfa_destroy(self);
+    return NULL;
+}
+
+static inline uint32_t transliteration_dfa_next(transliteration_dfa_t *self, uint32_t state, unsigned char c) {
+    uint32_t row = self->dense_rows->a[state];
+    if (row != NO_DENSE_ROW) {
+        return self->dense->a[(size_t)row * 256 + c];
+    }
+
+    uint32_t end = self->edges_index->a[state + 1];
+    for (uint32_t e = self->edges_index->a[state]; e < end; e++) {
+        unsigned char edge = self->edge_bytes->a[e];
+        if (edge == c) {
+            return self->edge_targets->a[e];
+        } else if (edge > c) {
+            break;
+        }
+    }
+
+    return TRANSLITERATION_DFA_NO_STATE;
+}
+
+/*
+Mirrors the ruleset loop in transliterate.c for rulesets without sets,
+repeats or contexts. The state is the longest prefix of a rule seen so far
+(the start state when there is none). When the next character can't extend
+it, or the input ends inside it, the last complete rule seen is replaced and
+scanning resumes at the current character. If no rule matched, the prefix is
+copied through unchanged.
+*/
+bool transliteration_dfa_apply_to(transliteration_dfa_t *self, char *str, size_t len, char_array *out) {
+    if (self == NULL || str == NULL || out == NULL) return false;
+
+    size_t out_start = out->n;
+
+    uint8_t *ptr = (uint8_t *)str;
+    size_t idx = 0;
+
+    uint32_t state = TRANSLITERATION_DFA_START_STATE;
+    uint32_t match_state = TRANSLITERATION_DFA_NO_STATE;
+    size_t phrase_start = 0;
+    size_t phrase_len = 0;
+
+    int32_t ch = 0;
+
+    while (idx < len) {
+        ssize_t char_len = utf8proc_iterate(ptr, len, &ch);
+        if (char_len <= 0) {
+            out->n = out_start;
+            return false;
+        }
+
+        if (!utf8proc_codepoint_valid(ch)) {
+            idx += char_len;
+            ptr += char_len;
+            continue;
+        }
+
+        if (ch == 0) break;
+
+        uint32_t next = state;
+        for (ssize_t i = 0; i < char_len; i++) {
+            next = transliteration_dfa_next(self, next, ptr[i]);
+            if (next == TRANSLITERATION_DFA_NO_STATE) break;
+        }
+
+        bool partial = next != TRANSLITERATION_DFA_NO_STATE;
+        bool is_last_char = idx + char_len == len;
+
+        if (partial && self->output_offsets->a[next] != TRANSLITERATION_DFA_NO_OUTPUT) {
+            match_state = next;
+        }
+
+        if ((!partial && state != TRANSLITERATION_DFA_START_STATE) || (partial && is_last_char)) {
+            bool advance;
+            if (match_state != TRANSLITERATION_DFA_NO_STATE) {
+                char_array_append_len(out, self->outputs->a + self->output_offsets->a[match_state], self->output_lengths->a[match_state]);
+                match_state = TRANSLITERATION_DFA_NO_STATE;
+                // Characters between the end of the match and here are dropped, as in the general matcher
+                advance = partial;
+            } else {
+                if (phrase_len > 0) {
+                    char_array_append_len(out, str + phrase_start, phrase_len);
+                }
+                if (is_last_char) {
+                    char_array_append_len(out, (char *)ptr, char_len);
+                }
+                advance = is_last_char;
+            }
+
+            state = TRANSLITERATION_DFA_START_STATE;
+            phrase_len = 0;
+
+            if (!advance) continue;
+        } else if (!partial) {
+            char_array_append_len(out, (char *)ptr, char_len);
+        } else {
+            if (state == TRANSLITERATION_DFA_START_STATE) {
+                phrase_start = idx;
+            }
+            phrase_len += char_len;
+            state = next;
+        }
+
+        idx += char_len;
+        ptr += char_len;
+    }
+
+    return true;
+}
+
+char *transliteration_dfa_apply(transliteration_dfa_t *self, char *str, size_t len) {
+    if (self == NULL || str == NULL) return NULL;
+
+    char_array *out = char_array_new_size(len + 1);
+    if (out == NULL) return NULL;
+
+    if (!transliteration_dfa_apply_to(self, str, len, out)) {
+        char_array_destroy(out);
+        return NULL;
+    }
+
+    return char_array_to_string(out);
+}
+
+/*
+Each step only reads the previous step's output, so the steps alternate
+between out and one scratch buffer, starting with whichever has the last
+step write to out. That's a single allocation however many steps there are,
+and none for one step.
+*/
+bool transliteration_dfa_apply_steps(transliteration_dfa_t **dfas, size_t num_dfas, char *str, size_t len, char_array *out) {
+    if (dfas == NULL || num_dfas == 0 || str == NULL || out == NULL) return false;
+
+    size_t out_start = out->n;
+
+    char_array *buffer = NULL;
+    if (num_dfas > 1) {
+        buffer = char_array_new_size(len + 1);
+        if (buffer == NULL) return false;
+    }
+
+    bool ret = true;
+    char *input = str;
+
+    for (size_t i = 0; ret && i < num_dfas; i++) {
+        bool to_out = (num_dfas - 1 - i) % 2 == 0;
+        char_array *output = to_out ? out : buffer;
+        size_t output_start = to_out ? out_start : 0;
+
+        output->n = output_start;
+        ret = transliteration_dfa_apply_to(dfas[i], input, len, output);
+
+        if (i < num_dfas - 1) {
+            char_array_terminate(output);
+            input = output->a + output_start;
+        }
+    }
+
+    if (buffer != NULL) {
+        char_array_destroy(buffer);
+    }
+
+    if (!ret) {
+        out->n = out_start;
+    }
+
+    return ret;
+}
+
+void transliteration_dfa_destroy(transliteration_dfa_t *self) {
+    if (self == NULL) return;
+
+    if (self->dense_rows != NULL) {
+        uint32_array_destroy(self->dense_rows);
+    }
+
+    if (self->dense != NULL) {
+        uint32_array_destroy(self->dense);
+    }
+
+    if (self->edges_index != NULL) {
+        uint32_array_destroy(self->edges_index);
+    }
+
+    if (self->edge_bytes != NULL) {
+        uchar_array_destroy(self->edge_bytes);
+    }
+
+    if (self->edge_targets != NULL) {
+        uint32_array_destroy(self->edge_targets);
+    }
+
+    if (self->output_offsets != NULL) {
+        uint32_array_destroy(self->output_offsets);
+    }
+
+    if (self->output_lengths != NULL) {
+        uint32_array_destroy(self->output_lengths);
+    }
+
+    if (self->outputs != NULL) {
+        char_array_destroy(self->outputs);
+    }
+
+    free(self);
+}
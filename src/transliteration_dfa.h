@@ -0,0 +1,82 @@
+/*
+transliteration_dfa.h
+---------------------
+
+Byte-level state machine for transliteration rulesets made only of plain
+string rules.
+
+The general matcher in transliterate.c walks the shared transliteration trie
+one character at a time and, at every character, also probes for character
+sets, repeats, empty transitions and pre/post contexts. Most steps, e.g.
+latin-ascii or the per-script rulesets, use none of those, so the extra
+lookups are pure overhead. For such a step the rules are compiled into a
+deterministic automaton over UTF-8 bytes: state 0 is the start state, every
+other state is a proper prefix of some rule key, and states for complete keys
+carry their replacement string. Transitions out of the start state and out
+of any state with many edges are stored as dense 256-entry rows, the rest as
+sorted byte lists, so a step is a single forward pass with one table lookup
+per input byte.
+
+transliteration_dfa_apply reproduces the output of the general matcher for
+these rulesets exactly, including its handling of overlapping rules, so
+compiling a step never changes what transliterate returns.
+*/
+
+#ifndef TRANSLITERATION_DFA_H
+#define TRANSLITERATION_DFA_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "collections.h"
+#include "string_utils.h"
+
+#define TRANSLITERATION_DFA_START_STATE 0
+// No transition leads back to the start state, so 0 also means "no edge"
+#define TRANSLITERATION_DFA_NO_STATE 0
+#define TRANSLITERATION_DFA_NO_OUTPUT UINT32_MAX
+
+#define TRANSLITERATION_DFA_DENSE_MIN_EDGES 16
+
+// Longest run of consecutive compiled steps that transliterate hands to transliteration_dfa_apply_steps at once
+#define TRANSLITERATION_DFA_MAX_STEPS 8
+
+typedef struct transliteration_dfa {
+    uint32_t num_states;
+    uint32_array *dense_rows;       // Per state, index of its dense row or UINT32_MAX
+    uint32_array *dense;            // 256 transitions per dense row
+    uint32_array *edges_index;      // Sparse edges of state s are [edges_index[s], edges_index[s + 1])
+    uchar_array *edge_bytes;
+    uint32_array *edge_targets;
+    uint32_array *output_offsets;   // Per state, offset into outputs or TRANSLITERATION_DFA_NO_OUTPUT
+    uint32_array *output_lengths;
+    char_array *outputs;
+    size_t max_key_len;             // Longest input a partial match can hold back
+} transliteration_dfa_t;
+
+/*
+Builds the automaton for the given rules, where outputs[i] replaces keys[i].
+Keys must be non-empty, distinct, valid UTF-8 strings.
+*/
+transliteration_dfa_t *transliteration_dfa_new(cstring_array *keys, cstring_array *outputs);
+
+/*
+Applies the rules to the first len bytes of str and returns a newly allocated
+string, or NULL if str is not valid UTF-8.
+*/
+char *transliteration_dfa_apply(transliteration_dfa_t *self, char *str, size_t len);
+// Same as above but appends to out, which is left unchanged on failure
+bool transliteration_dfa_apply_to(transliteration_dfa_t *self, char *str, size_t len, char_array *out);
+
+/*
+Applies several compiled steps in sequence, each to the first len bytes of the
+previous step's output (as the ruleset loop in transliterate.c does), and
+appends the final result to out. Returns false if any step sees invalid UTF-8.
+Intermediate results share one scratch buffer instead of a new string per step.
+*/
+bool transliteration_dfa_apply_steps(transliteration_dfa_t **dfas, size_t num_dfas, char *str, size_t len, char_array *out);
+
+void transliteration_dfa_destroy(transliteration_dfa_t *self);
+
+#endif
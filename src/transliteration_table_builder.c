@@ -617,6 +617,10 @@ int main(int argc, char **argv) {
 
     }
 
+    // Compiled rulesets aren't stored in the data file, the check only reports which ones qualify
+    size_t num_compiled = transliteration_table_compile_steps();
+    log_info("%zu of %zu steps can be compiled to a DFA\n", num_compiled, trans_table->steps->n);
+
     transliteration_table_write(f);
     fclose(f);
     transliteration_module_teardown();
@@ -620,6 +620,11 @@ bool trie_add_at_index(trie_t *self, uint32_t node_id, char *key, size_t len, ui
         return false;
     }
 
+    if (self->succinct != NULL) {
+        log_error("Cannot add keys to a compacted trie\n");
+        return false;
+    }
+
     unsigned char *ptr = (unsigned char *)key; 
     uint32_t last_node_id = node_id;
     trie_node_t last_node = trie_get_node(self, node_id);
@@ -755,6 +760,10 @@ inline bool trie_get_data_at_index(trie_t *self, uint32_t index,  uint32_t *data
 }
 
 inline bool trie_get_data(trie_t *self, char *key, uint32_t *data) {
+     if (self->succinct != NULL) {
+        return succinct_trie_get_data(self->succinct, key, data);
+     }
+
      uint32_t node_id = trie_get(self, key);
      return trie_get_data_at_index(self, node_id, data);
 }
@@ -806,7 +815,14 @@ trie_prefix_result_t trie_get_prefix_from_index(trie_t *self, char *key, size_t
                 return NULL_PREFIX_RESULT;
             }
 
-            if (node.base < 0) break;
+            if (node.base < 0) {
+                trie_prefetch_data_node(self, node);
+                break;
+            }
+
+            if (i + 1 < len) {
+                trie_prefetch_transition(self, node, ptr[1]);
+            }
         }
     } else {
         next_id = node_id;
@@ -896,6 +912,257 @@ inline uint32_t trie_num_keys(trie_t *self) {
     return self->num_keys;
 }
 
+/*
+Frozen layout
+*/
+
+bool trie_freeze(trie_t *self) {
+    if (self == NULL) return false;
+    if (self->succinct != NULL) return true;
+
+    trie_t *frozen = trie_new_alphabet((uint8_t *)self->alphabet, self->alphabet_size);
+    // (old node id, new node id) pairs in breadth-first order
+    uint32_array *queue = uint32_array_new();
+    if (frozen == NULL || queue == NULL) {
+        goto exit_trie_freeze;
+    }
+
+    uint32_array_push(queue, ROOT_NODE_ID);
+    uint32_array_push(queue, ROOT_NODE_ID);
+
+    unsigned char transitions[NUM_CHARS];
+    uint32_t num_transitions;
+
+    for (size_t q = 0; q < queue->n; q += 2) {
+        uint32_t old_id = queue->a[q];
+        uint32_t new_id = queue->a[q + 1];
+        trie_node_t old_node = trie_get_node(self, old_id);
+
+        if (old_node.base < 0) {
+            // Leaf: its data node and tail go next to those of the leaves visited just before it
+            trie_data_node_t data_node = trie_get_data_node(self, old_node);
+            uint32_t tail_pos = 0;
+            if (data_node.tail != 0) {
+                tail_pos = (uint32_t)frozen->tail->n;
+                trie_add_tail(frozen, self->tail->a + data_node.tail);
+            }
+
+            trie_data_array_push(frozen->data, (trie_data_node_t){tail_pos, data_node.data});
+            trie_set_base(frozen, new_id, -1 * (int32_t)(frozen->data->n - 1));
+            continue;
+        }
+
+        trie_get_transition_chars(self, old_id, transitions, &num_transitions);
+        if (num_transitions == 0) {
+            // No cell names new_id as its parent, so any non-negative base is empty
+            trie_set_base(frozen, new_id, old_node.base);
+            continue;
+        }
+
+        uint32_t new_base = trie_find_new_base(frozen, transitions, num_transitions);
+        if (new_base == TRIE_INDEX_ERROR) {
+            goto exit_trie_freeze;
+        }
+        trie_set_base(frozen, new_id, new_base);
+
+        for (uint32_t i = 0; i < num_transitions; i++) {
+            uint32_t char_index = trie_get_char_index(self, transitions[i]);
+            uint32_t next_id = new_base + char_index;
+
+            trie_make_room_for(frozen, next_id);
+            trie_init_node(frozen, next_id);
+            trie_set_check(frozen, next_id, new_id);
+
+            uint32_array_push(queue, old_node.base + char_index);
+            uint32_array_push(queue, next_id);
+        }
+    }
+
+    frozen->num_keys = self->num_keys;
+
+    // Swap the rebuilt arrays into self so existing pointers to the trie stay valid
+    trie_node_array *nodes = self->nodes;
+    trie_data_array *data = self->data;
+    uchar_array *tail = self->tail;
+
+    self->nodes = frozen->nodes;
+    self->data = frozen->data;
+    self->tail = frozen->tail;
+
+    frozen->nodes = nodes;
+    frozen->data = data;
+    frozen->tail = tail;
+
+    trie_destroy(frozen);
+    uint32_array_destroy(queue);
+
+    return true;
+
+exit_trie_freeze:
+    if (frozen != NULL) trie_destroy(frozen);
+    if (queue != NULL) uint32_array_destroy(queue);
+    return false;
+}
+
+/*
+Compaction
+*/
+
+static void trie_collect_keys(trie_t *self, uint32_t node_id, char_array *prefix, cstring_array *keys, uint32_array *values) {
+    trie_node_t node = trie_get_node(self, node_id);
+    size_t prefix_len = prefix->n;
+
+    // Visit transitions in byte order so keys come out sorted
+    for (int c = 0; c < NUM_CHARS; c++) {
+        uint8_t char_index = self->alpha_map[c];
+        if (char_index >= self->alphabet_size || (unsigned char)self->alphabet[char_index] != c) continue;
+
+        uint32_t next_id = trie_get_transition_index(self, node, (unsigned char)c);
+        trie_node_t next = trie_get_node(self, next_id);
+        if (next.check != (int32_t)node_id) continue;
+
+        char ch = (char)c;
+
+        if (next.base >= 0) {
+            if (c == '\0') continue;
+            char_array_append_len(prefix, &ch, 1);
+            trie_collect_keys(self, next_id, prefix, keys, values);
+            prefix->n = prefix_len;
+            continue;
+        }
+
+        trie_data_node_t data_node = trie_get_data_node(self, next);
+        if (data_node.tail == 0) continue;
+
+        if (c != '\0') {
+            char_array_append_len(prefix, &ch, 1);
+            char_array_append(prefix, (char *)self->tail->a + data_node.tail);
+        }
+        char_array_terminate(prefix);
+
+        cstring_array_add_string(keys, prefix->a);
+        uint32_array_push(values, data_node.data);
+        prefix->n = prefix_len;
+    }
+}
+
+bool trie_get_keys(trie_t *self, cstring_array *keys, uint32_array *values) {
+    if (self == NULL || self->succinct != NULL || keys == NULL || values == NULL) return false;
+
+    char_array *prefix = char_array_new();
+    if (prefix == NULL) return false;
+
+    trie_collect_keys(self, ROOT_NODE_ID, prefix, keys, values);
+
+    char_array_destroy(prefix);
+    return true;
+}
+
+bool trie_get_keys_with_prefix(trie_t *self, char *prefix, cstring_array *keys, uint32_array *values) {
+    if (self == NULL || self->succinct != NULL || prefix == NULL || keys == NULL || values == NULL) return false;
+
+    trie_prefix_result_t result = trie_get_prefix(self, prefix);
+    if (result.node_id == NULL_NODE_ID) return true;
+
+    trie_node_t node = trie_get_node(self, result.node_id);
+
+    // Prefix ends inside a tail, so at most one key remains
+    if (node.base < 0) {
+        trie_data_node_t data_node = trie_get_data_node(self, node);
+        if (data_node.tail != 0) {
+            cstring_array_add_string(keys, (char *)self->tail->a + data_node.tail + result.tail_pos);
+            uint32_array_push(values, data_node.data);
+        }
+        return true;
+    }
+
+    char_array *suffix = char_array_new();
+    if (suffix == NULL) return false;
+
+    trie_collect_keys(self, result.node_id, suffix, keys, values);
+
+    char_array_destroy(suffix);
+    return true;
+}
+
+bool trie_compact(trie_t *self) {
+    if (self == NULL) return false;
+    if (self->succinct != NULL) return true;
+
+    bool ret = false;
+
+    cstring_array *keys = cstring_array_new();
+    uint32_array *values = uint32_array_new();
+    char_array *prefix = char_array_new();
+
+    if (keys == NULL || values == NULL || prefix == NULL) {
+        goto exit_trie_compact;
+    }
+
+    trie_collect_keys(self, ROOT_NODE_ID, prefix, keys, values);
+
+    succinct_trie_t *succinct = succinct_trie_new_sorted(keys, values);
+    if (succinct == NULL) {
+        goto exit_trie_compact;
+    }
+
+    // Replace the double-array with an empty one so the node-level API sees no keys
+    trie_node_array *nodes = trie_node_array_new_size(TRIE_POOL_BEGIN);
+    trie_data_array *data = trie_data_array_new_size(1);
+    uchar_array *tail = uchar_array_new_size(1);
+    if (nodes == NULL || data == NULL || tail == NULL) {
+        if (nodes != NULL) trie_node_array_destroy(nodes);
+        if (data != NULL) trie_data_array_destroy(data);
+        if (tail != NULL) uchar_array_destroy(tail);
+        succinct_trie_destroy(succinct);
+        goto exit_trie_compact;
+    }
+
+    trie_node_array_push(nodes, (trie_node_t){0, 0});
+    trie_node_array_push(nodes, (trie_node_t){-1, -1});
+    trie_node_array_push(nodes, (trie_node_t){TRIE_POOL_BEGIN, 0});
+    trie_data_array_push(data, (trie_data_node_t){0, 0});
+    uchar_array_push(tail, '\0');
+
+    trie_node_array_destroy(self->nodes);
+    trie_data_array_destroy(self->data);
+    uchar_array_destroy(self->tail);
+
+    self->nodes = nodes;
+    self->data = data;
+    self->tail = tail;
+
+    self->succinct = succinct;
+    self->num_keys = succinct_trie_num_keys(succinct);
+
+    ret = true;
+
+exit_trie_compact:
+    if (keys != NULL) cstring_array_destroy(keys);
+    if (values != NULL) uint32_array_destroy(values);
+    if (prefix != NULL) char_array_destroy(prefix);
+    return ret;
+}
+
+inline bool trie_is_compact(trie_t *self) {
+    return self != NULL && self->succinct != NULL;
+}
+
+size_t trie_memory_size(trie_t *self) {
+    if (self == NULL) return 0;
+
+    size_t size = sizeof(trie_t) + self->alphabet_size;
+    size += self->nodes->n * sizeof(trie_node_t);
+    size += self->data->n * sizeof(trie_data_node_t);
+    size += self->tail->n * sizeof(unsigned char);
+
+    if (self->succinct != NULL) {
+        size += succinct_trie_memory_size(self->succinct);
+    }
+
+    return size;
+}
+
 /*
 Destructor
 */
@@ -911,7 +1178,9 @@ void trie_destroy(trie_t *self) {
         uchar_array_destroy(self->tail);
     if (self->data)
         trie_data_array_destroy(self->data);
-    
+    if (self->succinct)
+        succinct_trie_destroy(self->succinct);
+
     free(self);
 }
 
@@ -921,6 +1190,10 @@ I/O methods
 */
 
 bool trie_write(trie_t *self, FILE *file) {
+    if (self->succinct != NULL) {
+        return succinct_trie_write(self->succinct, file);
+    }
+
     if (!file_write_uint32(file, TRIE_SIGNATURE) ||
         !file_write_uint32(file, self->alphabet_size)|| 
         !file_write_chars(file, (char *)self->alphabet, (size_t)self->alphabet_size) ||
@@ -989,6 +1262,23 @@ trie_t *trie_read(FILE *file) {
         goto exit_file_read;
     }
 
+    if (signature == SUCCINCT_TRIE_SIGNATURE) {
+        fseek(file, save_pos, SEEK_SET);
+        succinct_trie_t *succinct = succinct_trie_read(file);
+        if (succinct == NULL) {
+            goto exit_file_read;
+        }
+
+        trie_t *trie = trie_new();
+        if (!trie) {
+            succinct_trie_destroy(succinct);
+            goto exit_file_read;
+        }
+        trie->succinct = succinct;
+        trie->num_keys = succinct_trie_num_keys(succinct);
+        return trie;
+    }
+
     if (signature != TRIE_SIGNATURE) {
         goto exit_file_read;
     }
@@ -15,6 +15,17 @@
 * for effective namespacing e.g. adding the keys "en|blvd" and "fr|blvd"
 * and searching by language. For more information on double-array tries
 * generally, see: http://linux.thai.net/~thep/datrie/datrie.html
+*
+* After a trie is built, trie_freeze rewrites it in breadth-first order so that
+* the hot upper levels are contiguous and each leaf's data node and tail sit
+* next to those of its siblings. Frozen tries are ordinary double-array tries.
+* It's opt-in: no builder calls it, since test/bench_trie shows no measurable
+* lookup gain on the current data.
+*
+* Read-only tries (model features, vocabularies) can be converted in place to
+* the much smaller succinct representation in succinct_trie.h with
+* trie_compact. A compacted trie only supports trie_get_data, trie_num_keys
+* and I/O; trie_read detects either format.
 ******************************************************************************/
 
 #ifndef TRIE_H
@@ -33,6 +44,7 @@
 #include "klib/kvec.h"
 #include "log/log.h"
 #include "string_utils.h"
+#include "succinct_trie.h"
 
 #define TRIE_SIGNATURE 0xABABABAB
 #define NULL_NODE_ID 0
@@ -76,12 +88,35 @@ typedef struct trie {
     uint8_t alpha_map[NUM_CHARS];
     uint32_t alphabet_size;
     uint32_t num_keys;
+    succinct_trie_t *succinct;
 } trie_t;
 
 trie_t *trie_new_alphabet(uint8_t *alphabet, uint32_t alphabet_size);
 trie_t *trie_new(void);
 
 uint32_t trie_get_char_index(trie_t *self, unsigned char c);
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TRIE_PREFETCH(addr) __builtin_prefetch((addr), 0, 3)
+#else
+#define TRIE_PREFETCH(addr)
+#endif
+
+// Start loading the transition from node on c before it is needed
+static inline void trie_prefetch_transition(trie_t *self, trie_node_t node, unsigned char c) {
+    uint32_t index = node.base + self->alpha_map[c] + 1;
+    if (node.base >= 0 && index < self->nodes->n) {
+        TRIE_PREFETCH(self->nodes->a + index);
+    }
+}
+
+// Start loading the data node (and with it the tail offset) of a leaf
+static inline void trie_prefetch_data_node(trie_t *self, trie_node_t node) {
+    uint32_t index = -1 * node.base;
+    if (node.base < 0 && index < self->data->n) {
+        TRIE_PREFETCH(self->data->a + index);
+    }
+}
 uint32_t trie_get_transition_index(trie_t *self, trie_node_t node, unsigned char c);
 trie_node_t trie_get_transition(trie_t *self, trie_node_t node, unsigned char c);
 bool trie_node_is_free(trie_node_t node);
@@ -125,6 +160,15 @@ uint32_t trie_get_len(trie_t *self, char *word, size_t len);
 uint32_t trie_get(trie_t *self, char *word);
 
 uint32_t trie_num_keys(trie_t *self);
+// Appends every key and its data in byte order (double-array tries only)
+bool trie_get_keys(trie_t *self, cstring_array *keys, uint32_array *values);
+// Same for keys starting with prefix, appending only the rest of each key
+bool trie_get_keys_with_prefix(trie_t *self, char *prefix, cstring_array *keys, uint32_array *values);
+
+bool trie_freeze(trie_t *self);
+bool trie_compact(trie_t *self);
+bool trie_is_compact(trie_t *self);
+size_t trie_memory_size(trie_t *self);
 
 typedef struct trie_prefix_result {
     uint32_t node_id;
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "averaged_perceptron.h"
+#include "crf.h"
+#include "language_classifier.h"
+#include "trie.h"
+
+#include "log/log.h"
+
+/*
+Converts the read-only tries in existing model files (address_parser_vocab.trie,
+address_parser_crf.dat, address_parser.dat, language_classifier.dat) to the
+succinct representation. The output is read transparently by the usual loaders.
+CRF and averaged perceptron models which predate the feature filter get one
+built from the trie before it is compacted.
+*/
+
+static bool compact_and_report(trie_t *trie, char *name) {
+    size_t before = trie_memory_size(trie);
+    if (!trie_compact(trie)) {
+        log_error("Error compacting %s\n", name);
+        return false;
+    }
+    size_t after = trie_memory_size(trie);
+
+    log_info("%s: %u keys, %zu bytes -> %zu bytes (%.1fx)\n", name, trie_num_keys(trie), before, after, after > 0 ? (double)before / after : 0.0);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    char *usage = "Usage: ./trie_compactor (trie|crf|averaged_perceptron|language_classifier) input_file output_file\n";
+
+    if (argc < 4) {
+        printf("%s", usage);
+        exit(EXIT_FAILURE);
+    }
+
+    char *type = argv[1];
+    char *input = argv[2];
+    char *output = argv[3];
+
+    bool ok = false;
+
+    if (string_equals(type, "trie")) {
+        trie_t *trie = trie_load(input);
+        if (trie == NULL) {
+            log_error("Could not load trie from %s\n", input);
+            exit(EXIT_FAILURE);
+        }
+        ok = compact_and_report(trie, "trie") && trie_save(trie, output);
+        trie_destroy(trie);
+    } else if (string_equals(type, "crf")) {
+        crf_t *crf = crf_load(input);
+        if (crf == NULL) {
+            log_error("Could not load CRF from %s\n", input);
+            exit(EXIT_FAILURE);
+        }
+        if (crf->hash_bits > 0) {
+            // Models trained with feature hashing have no feature tries
+            log_info("CRF uses feature hashing, nothing to compact\n");
+            ok = crf_save(crf, output);
+        } else {
+            if (crf->state_features_filter == NULL && !crf_build_feature_filter(crf)) {
+                log_error("Error building state feature filter\n");
+                exit(EXIT_FAILURE);
+            }
+            ok = compact_and_report(crf->state_features, "state_features") &&
+                 compact_and_report(crf->state_trans_features, "state_trans_features") &&
+                 crf_save(crf, output);
+        }
+        crf_destroy(crf);
+    } else if (string_equals(type, "averaged_perceptron")) {
+        averaged_perceptron_t *perceptron = averaged_perceptron_load(input);
+        if (perceptron == NULL) {
+            log_error("Could not load averaged perceptron from %s\n", input);
+            exit(EXIT_FAILURE);
+        }
+        if (perceptron->feature_filter == NULL && !averaged_perceptron_build_feature_filter(perceptron)) {
+            log_error("Error building feature filter\n");
+            exit(EXIT_FAILURE);
+        }
+        ok = compact_and_report(perceptron->features, "features") &&
+             averaged_perceptron_save(perceptron, output);
+        averaged_perceptron_destroy(perceptron);
+    } else if (string_equals(type, "language_classifier")) {
+        language_classifier_t *classifier = language_classifier_load(input);
+        if (classifier == NULL) {
+            log_error("Could not load language classifier from %s\n", input);
+            exit(EXIT_FAILURE);
+        }
+        ok = compact_and_report(classifier->features, "features") &&
+             language_classifier_save(classifier, output);
+        language_classifier_destroy(classifier);
+    } else {
+        printf("%s", usage);
+        exit(EXIT_FAILURE);
+    }
+
+    if (!ok) {
+        log_error("Error writing %s\n", output);
+        exit(EXIT_FAILURE);
+    }
+
+    exit(EXIT_SUCCESS);
+}
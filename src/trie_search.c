@@ -270,6 +270,12 @@ bool trie_search_tokens_from_index(trie_t *self, char *str, token_array *tokens,
                     node_id = trie_get_transition_index(self, node, *ptr);
                     node = trie_get_node(self, node_id);
                     log_debug("Doing %c, got node_id=%d\n", *ptr, node_id);
+
+                    if (node.base < 0) {
+                        trie_prefetch_data_node(self, node);
+                    } else if (j + 1 < token_length) {
+                        trie_prefetch_transition(self, node, ptr[1]);
+                    }
                 } else {
                     log_debug("Tail stored on space node, rolling back one character\n");
                     ptr--;
@@ -377,6 +383,11 @@ bool trie_search_tokens_from_index(trie_t *self, char *str, token_array *tokens,
                 phrase_start = i;
             }
 
+            // The terminal and continuation transitions are independent loads
+            if (check_continuation) {
+                trie_prefetch_transition(self, node, ' ');
+            }
+
             trie_node_t terminal_node = trie_get_transition(self, node, '\0');
             if (terminal_node.check == node_id) {
                 log_debug("node match at %d\n", i);
@@ -473,6 +484,257 @@ inline phrase_array *trie_search_tokens(trie_t *self, char *str, token_array *to
     return phrases;
 }
 
+typedef enum {
+    TRIE_TOKEN_CURSOR_ALIVE,
+    TRIE_TOKEN_CURSOR_DONE,
+    TRIE_TOKEN_CURSOR_FELL_OFF,
+    TRIE_TOKEN_CURSOR_NO_CONTINUATION
+} trie_token_cursor_status_t;
+
+static inline bool trie_token_cursor_tail_match(trie_t *self, trie_token_cursor_t *cursor, char *ptr, size_t len, bool *match, uint32_t *data) {
+    unsigned char *tail = self->tail->a + cursor->tail_pos;
+    if (strncmp((char *)tail, ptr, len) != 0) {
+        return false;
+    }
+
+    cursor->tail_pos += len;
+    cursor->state = TRIE_TOKEN_CURSOR_TAIL;
+
+    if (self->tail->a[cursor->tail_pos] == '\0') {
+        *match = true;
+        *data = self->data->a[-1 * trie_get_node(self, cursor->node_id).base].data;
+    }
+    return true;
+}
+
+/*
+Advances a cursor over one token, following the same rules as trie_search_tokens_from_index:
+tokens are joined by a ' ' transition (or directly for ideographic characters and within tails),
+and whitespace tokens are skipped.
+*/
+static trie_token_cursor_status_t trie_token_cursor_advance(trie_t *self, trie_token_cursor_t *cursor, char *str, token_t token, bool *match, uint32_t *data) {
+    *match = false;
+
+    if (cursor->state == TRIE_TOKEN_CURSOR_TAIL) {
+        unsigned char *tail = self->tail->a + cursor->tail_pos;
+        if (token.type == WHITESPACE) {
+            return *tail == ' ' ? TRIE_TOKEN_CURSOR_ALIVE : TRIE_TOKEN_CURSOR_FELL_OFF;
+        }
+        if (*tail == ' ') {
+            cursor->tail_pos++;
+        }
+        if (!trie_token_cursor_tail_match(self, cursor, str + token.offset, token.len, match, data)) {
+            return TRIE_TOKEN_CURSOR_FELL_OFF;
+        }
+        return *match ? TRIE_TOKEN_CURSOR_DONE : TRIE_TOKEN_CURSOR_ALIVE;
+    }
+
+    trie_node_t node = trie_get_node(self, cursor->node_id);
+
+    if (token.type == WHITESPACE) {
+        if (cursor->state == TRIE_TOKEN_CURSOR_NODE) {
+            trie_node_t terminal_node = trie_get_transition(self, node, '\0');
+            if (terminal_node.check == (int32_t)cursor->node_id) {
+                *match = true;
+                *data = self->data->a[-1 * terminal_node.base].data;
+            }
+        }
+        return TRIE_TOKEN_CURSOR_ALIVE;
+    }
+
+    char *ptr = str + token.offset;
+    size_t len = token.len;
+
+    if (cursor->state == TRIE_TOKEN_CURSOR_TAIL_PENDING) {
+        if (!trie_token_cursor_tail_match(self, cursor, ptr, len, match, data)) {
+            return TRIE_TOKEN_CURSOR_FELL_OFF;
+        }
+        return *match ? TRIE_TOKEN_CURSOR_DONE : TRIE_TOKEN_CURSOR_ALIVE;
+    }
+
+    for (size_t j = 0; j < len; j++) {
+        uint32_t next_id = trie_get_transition_index(self, node, (unsigned char)ptr[j]);
+        trie_node_t next = trie_get_node(self, next_id);
+        if (next.check != (int32_t)cursor->node_id) {
+            return TRIE_TOKEN_CURSOR_FELL_OFF;
+        }
+
+        cursor->node_id = next_id;
+        node = next;
+
+        if (node.base < 0) {
+            // The rest of the key is stored in the tail of a single data node
+            cursor->tail_pos = self->data->a[-1 * node.base].tail;
+            if (!trie_token_cursor_tail_match(self, cursor, ptr + j + 1, len - j - 1, match, data)) {
+                return TRIE_TOKEN_CURSOR_FELL_OFF;
+            }
+            return *match ? TRIE_TOKEN_CURSOR_DONE : TRIE_TOKEN_CURSOR_ALIVE;
+        }
+    }
+
+    trie_node_t terminal_node = trie_get_transition(self, node, '\0');
+    if (terminal_node.check == (int32_t)cursor->node_id) {
+        *match = true;
+        *data = self->data->a[-1 * terminal_node.base].data;
+    }
+
+    uint32_t continuation_id = trie_get_transition_index(self, node, ' ');
+    trie_node_t continuation = trie_get_node(self, continuation_id);
+    if (continuation.check == (int32_t)cursor->node_id) {
+        cursor->node_id = continuation_id;
+        if (continuation.base < 0) {
+            cursor->state = TRIE_TOKEN_CURSOR_TAIL_PENDING;
+            cursor->tail_pos = self->data->a[-1 * continuation.base].tail;
+        }
+        return TRIE_TOKEN_CURSOR_ALIVE;
+    } else if (token.type == IDEOGRAPHIC_CHAR) {
+        return TRIE_TOKEN_CURSOR_ALIVE;
+    }
+
+    return TRIE_TOKEN_CURSOR_NO_CONTINUATION;
+}
+
+trie_multi_search_t *trie_multi_search_new(void) {
+    trie_multi_search_t *self = calloc(1, sizeof(trie_multi_search_t));
+    if (self == NULL) return NULL;
+
+    self->cursors = trie_token_cursor_array_new();
+    if (self->cursors == NULL) {
+        goto exit_multi_search_created;
+    }
+
+    self->matches = phrase_array_new();
+    if (self->matches == NULL) {
+        goto exit_multi_search_created;
+    }
+
+    self->resume = uint32_array_new();
+    if (self->resume == NULL) {
+        goto exit_multi_search_created;
+    }
+
+    return self;
+
+exit_multi_search_created:
+    trie_multi_search_destroy(self);
+    return NULL;
+}
+
+void trie_multi_search_destroy(trie_multi_search_t *self) {
+    if (self == NULL) return;
+
+    if (self->cursors != NULL) {
+        trie_token_cursor_array_destroy(self->cursors);
+    }
+
+    if (self->matches != NULL) {
+        phrase_array_destroy(self->matches);
+    }
+
+    if (self->resume != NULL) {
+        uint32_array_destroy(self->resume);
+    }
+
+    free(self);
+}
+
+/*
+Searches several tries over the same sequence of tokens in a single left-to-right pass,
+producing the same phrases as calling trie_search_tokens_from_index on each trie.
+
+Rather than rewinding the string when a partial match falls off the trie, every trie keeps
+a cursor for each token where a phrase may still begin. For each start token we record the
+longest match, or the token where trie_search_tokens_from_index would resume if there's no
+match, and then walk those greedily.
+*/
+bool trie_search_tokens_multi(trie_multi_search_t *self, trie_token_search_t *searches, size_t num_searches) {
+    if (self == NULL || searches == NULL || num_searches == 0) return false;
+
+    size_t num_tokens = 0;
+    for (size_t s = 0; s < num_searches; s++) {
+        token_array *tokens = searches[s].tokens;
+        if (searches[s].str == NULL || tokens == NULL || tokens->n == 0 || searches[s].phrases == NULL) return false;
+        if (s == 0 || tokens->n < num_tokens) {
+            num_tokens = tokens->n;
+        }
+    }
+
+    trie_token_cursor_array *cursors = self->cursors;
+    phrase_array *matches = self->matches;
+    uint32_array *resume = self->resume;
+
+    trie_token_cursor_array_clear(cursors);
+    phrase_array_clear(matches);
+    uint32_array_clear(resume);
+
+    for (size_t s = 0; s < num_searches; s++) {
+        for (uint32_t i = 0; i < num_tokens; i++) {
+            phrase_array_push(matches, NULL_PHRASE);
+            uint32_array_push(resume, i + 1);
+        }
+    }
+
+    for (uint32_t i = 0; i < num_tokens; i++) {
+        for (uint32_t s = 0; s < num_searches; s++) {
+            if (searches[s].tokens->a[i].type == WHITESPACE) continue;
+            trie_token_cursor_t cursor = (trie_token_cursor_t){
+                .search = s,
+                .start = i,
+                .node_id = searches[s].start_node_id,
+                .tail_pos = 0,
+                .state = TRIE_TOKEN_CURSOR_NODE
+            };
+            trie_token_cursor_array_push(cursors, cursor);
+        }
+
+        size_t num_alive = 0;
+        for (size_t c = 0; c < cursors->n; c++) {
+            trie_token_cursor_t cursor = cursors->a[c];
+            trie_token_search_t search = searches[cursor.search];
+            size_t index = cursor.search * num_tokens + cursor.start;
+            bool match = false;
+            uint32_t data = 0;
+
+            trie_token_cursor_status_t status = trie_token_cursor_advance(search.trie, &cursor, search.str, search.tokens->a[i], &match, &data);
+
+            if (match) {
+                matches->a[index] = (phrase_t){cursor.start, i - cursor.start + 1, data};
+            }
+
+            if (status == TRIE_TOKEN_CURSOR_ALIVE) {
+                cursors->a[num_alive++] = cursor;
+            } else if (status == TRIE_TOKEN_CURSOR_NO_CONTINUATION) {
+                // A partial phrase with no continuation skips the tokens it covered
+                resume->a[index] = i + 1;
+            }
+        }
+        cursors->n = num_alive;
+    }
+
+    // A partial phrase still open at the last token ends the search unless it's inside a tail
+    for (size_t c = 0; c < cursors->n; c++) {
+        trie_token_cursor_t cursor = cursors->a[c];
+        if (cursor.state != TRIE_TOKEN_CURSOR_TAIL) {
+            resume->a[cursor.search * num_tokens + cursor.start] = num_tokens;
+        }
+    }
+
+    for (size_t s = 0; s < num_searches; s++) {
+        phrase_t *longest = matches->a + s * num_tokens;
+        uint32_t *next = resume->a + s * num_tokens;
+        for (size_t i = 0; i < num_tokens; ) {
+            if (longest[i].len > 0) {
+                phrase_array_push(searches[s].phrases, longest[i]);
+                i += longest[i].len;
+            } else {
+                i = next[i];
+            }
+        }
+    }
+
+    return true;
+}
+
 phrase_t trie_search_suffixes_from_index(trie_t *self, char *word, size_t len, uint32_t start_node_id) {
     uint32_t last_node_id = start_node_id;
     trie_node_t last_node = trie_get_node(self, last_node_id);
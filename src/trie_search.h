@@ -28,12 +28,49 @@ VECTOR_INIT(phrase_array, phrase_t)
 #define NULL_PHRASE (phrase_t){0, 0, 0}
 #define NULL_PHRASE_MEMBERSHIP -1
 
+// One trie to search in trie_search_tokens_multi. All searches must share token indices
+// (str/tokens may be normalized differently). Matches are appended to phrases.
+typedef struct trie_token_search {
+    trie_t *trie;
+    uint32_t start_node_id;
+    char *str;
+    token_array *tokens;
+    phrase_array *phrases;
+} trie_token_search_t;
+
+typedef enum {
+    TRIE_TOKEN_CURSOR_NODE,
+    TRIE_TOKEN_CURSOR_TAIL_PENDING,
+    TRIE_TOKEN_CURSOR_TAIL
+} trie_token_cursor_state_t;
+
+typedef struct trie_token_cursor {
+    uint32_t search;
+    uint32_t start;
+    uint32_t node_id;
+    uint32_t tail_pos;
+    trie_token_cursor_state_t state;
+} trie_token_cursor_t;
+
+VECTOR_INIT(trie_token_cursor_array, trie_token_cursor_t)
+
+// Reusable scratch space for trie_search_tokens_multi
+typedef struct trie_multi_search {
+    trie_token_cursor_array *cursors;
+    phrase_array *matches;
+    uint32_array *resume;
+} trie_multi_search_t;
+
 phrase_array *trie_search(trie_t *self, char *text);
 bool trie_search_from_index(trie_t *self, char *text, uint32_t start_node_id, phrase_array **phrases);
 bool trie_search_with_phrases(trie_t *self, char *text, phrase_array **phrases);
 phrase_array *trie_search_tokens(trie_t *self, char *str, token_array *tokens);
 bool trie_search_tokens_from_index(trie_t *self, char *str, token_array *tokens, uint32_t start_node_id, phrase_array **phrases);
 bool trie_search_tokens_with_phrases(trie_t *self, char *text, token_array *tokens, phrase_array **phrases);
+
+trie_multi_search_t *trie_multi_search_new(void);
+void trie_multi_search_destroy(trie_multi_search_t *self);
+bool trie_search_tokens_multi(trie_multi_search_t *self, trie_token_search_t *searches, size_t num_searches);
 phrase_t trie_search_suffixes_from_index(trie_t *self, char *word, size_t len, uint32_t start_node_id);
 phrase_t trie_search_suffixes_from_index_get_suffix_char(trie_t *self, char *word, size_t len, uint32_t start_node_id);
 phrase_t trie_search_suffixes(trie_t *self, char *word, size_t len);
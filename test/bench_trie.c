@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_RDTSC
+#endif
+
+#include "../src/scanner.h"
+#include "../src/trie.h"
+#include "../src/trie_search.h"
+
+/*
+Lookup benchmark for the double-array trie, before and after trie_freeze.
+The keys and the search input are the test_trie.c fixtures, padded out with
+generated keys built from the same words so the trie exceeds the CPU caches.
+
+Usage: ./bench_trie [num_keys]
+*/
+
+#define DEFAULT_NUM_KEYS 200000
+#define NUM_SEARCH_LOOPS 20
+
+static char *fixture_keys[] = {"st", "street", "st rt", "st rd", "state route", "maine"};
+static char *fixture_input = "main st r 20";
+
+static char *words[] = {"main", "st", "street", "state", "route", "rt", "rd", "maine", "ave", "north", "n", "blvd"};
+#define NUM_WORDS (sizeof(words) / sizeof(words[0]))
+
+typedef struct bench_result {
+    double ns;
+    double cycles;
+    uint64_t checksum;
+} bench_result_t;
+
+static inline uint64_t bench_cycles(void) {
+#ifdef BENCH_HAVE_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static bench_result_t bench_get_data(trie_t *trie, cstring_array *queries) {
+    size_t n = cstring_array_num_strings(queries);
+    uint64_t checksum = 0;
+
+    clock_t t1 = clock();
+    uint64_t c1 = bench_cycles();
+    for (size_t i = 0; i < n; i++) {
+        uint32_t data;
+        if (trie_get_data(trie, cstring_array_get_string(queries, i), &data)) {
+            checksum += data;
+        }
+    }
+    uint64_t c2 = bench_cycles();
+    clock_t t2 = clock();
+
+    return (bench_result_t){
+        (double)(t2 - t1) / CLOCKS_PER_SEC * 1e9 / n,
+        (double)(c2 - c1) / n,
+        checksum
+    };
+}
+
+static bench_result_t bench_get_prefix(trie_t *trie, cstring_array *queries) {
+    size_t n = cstring_array_num_strings(queries);
+    uint64_t checksum = 0;
+
+    clock_t t1 = clock();
+    uint64_t c1 = bench_cycles();
+    for (size_t i = 0; i < n; i++) {
+        trie_prefix_result_t result = trie_get_prefix(trie, cstring_array_get_string(queries, i));
+        checksum += result.node_id != NULL_NODE_ID;
+    }
+    uint64_t c2 = bench_cycles();
+    clock_t t2 = clock();
+
+    return (bench_result_t){
+        (double)(t2 - t1) / CLOCKS_PER_SEC * 1e9 / n,
+        (double)(c2 - c1) / n,
+        checksum
+    };
+}
+
+static bench_result_t bench_search_tokens(trie_t *trie, cstring_array *sentences, token_array **tokens) {
+    size_t n = cstring_array_num_strings(sentences);
+    uint64_t checksum = 0;
+    size_t num_tokens = 0;
+
+    phrase_array *phrases = phrase_array_new();
+
+    clock_t t1 = clock();
+    uint64_t c1 = bench_cycles();
+    for (int loop = 0; loop < NUM_SEARCH_LOOPS; loop++) {
+        for (size_t i = 0; i < n; i++) {
+            phrase_array_clear(phrases);
+            trie_search_tokens_with_phrases(trie, cstring_array_get_string(sentences, i), tokens[i], &phrases);
+            checksum += phrases->n;
+            num_tokens += tokens[i]->n;
+        }
+    }
+    uint64_t c2 = bench_cycles();
+    clock_t t2 = clock();
+
+    phrase_array_destroy(phrases);
+
+    return (bench_result_t){
+        (double)(t2 - t1) / CLOCKS_PER_SEC * 1e9 / num_tokens,
+        (double)(c2 - c1) / num_tokens,
+        checksum
+    };
+}
+
+static void bench_print(char *name, bench_result_t before, bench_result_t after) {
+    printf("%-20s %10.1f ns %10.1f ns", name, before.ns, after.ns);
+#ifdef BENCH_HAVE_RDTSC
+    printf(" %10.1f cyc %10.1f cyc", before.cycles, after.cycles);
+#endif
+    printf("  speedup %.2fx%s\n", after.ns > 0.0 ? before.ns / after.ns : 0.0, before.checksum == after.checksum ? "" : "  CHECKSUM MISMATCH");
+}
+
+static void shuffle_strings(cstring_array *strings) {
+    size_t n = cstring_array_num_strings(strings);
+    uint32_t *indices = strings->indices->a;
+    for (size_t i = n - 1; i > 0; i--) {
+        size_t j = (size_t)rand() % (i + 1);
+        uint32_t tmp = indices[i];
+        indices[i] = indices[j];
+        indices[j] = tmp;
+    }
+}
+
+int main(int argc, char **argv) {
+    size_t num_keys = DEFAULT_NUM_KEYS;
+    if (argc > 1) {
+        num_keys = (size_t)strtoul(argv[1], NULL, 10);
+    }
+
+    srand(0);
+
+    cstring_array *keys = cstring_array_new();
+    char_array *key = char_array_new();
+
+    for (size_t i = 0; i < sizeof(fixture_keys) / sizeof(fixture_keys[0]); i++) {
+        cstring_array_add_string(keys, fixture_keys[i]);
+    }
+
+    // Generated keys look like "n main st 42" so they share prefixes with the fixtures
+    for (size_t i = 0; i < num_keys; i++) {
+        char_array_clear(key);
+        size_t num_words = 1 + rand() % 3;
+        for (size_t j = 0; j < num_words; j++) {
+            if (j > 0) char_array_cat(key, " ");
+            char_array_cat(key, words[rand() % NUM_WORDS]);
+        }
+        char_array_cat_printf(key, " %d", rand() % (int)(num_keys / 4 + 1));
+        cstring_array_add_string(keys, char_array_get_string(key));
+    }
+
+    // Insert in random order, as the dictionary builders see their input
+    shuffle_strings(keys);
+
+    trie_t *trie = trie_new();
+    size_t n = cstring_array_num_strings(keys);
+    for (size_t i = 0; i < n; i++) {
+        trie_set_data(trie, cstring_array_get_string(keys, i), (uint32_t)i + 1);
+    }
+
+    // Queries: every key plus a miss derived from it, in random order
+    cstring_array *queries = cstring_array_new();
+    for (size_t i = 0; i < n; i++) {
+        char *str = cstring_array_get_string(keys, i);
+        cstring_array_add_string(queries, str);
+        char_array_clear(key);
+        char_array_cat_printf(key, "%s%c", str, 'a' + (int)(i % 26));
+        cstring_array_add_string(queries, char_array_get_string(key));
+    }
+    shuffle_strings(queries);
+
+    size_t num_sentences = n / 10 + 1;
+    cstring_array *sentences = cstring_array_new();
+    cstring_array_add_string(sentences, fixture_input);
+    for (size_t i = 1; i < num_sentences; i++) {
+        char_array_clear(key);
+        char_array_cat_printf(key, "%d ", rand() % 1000);
+        char_array_cat(key, cstring_array_get_string(keys, (size_t)rand() % n));
+        char_array_cat(key, " ");
+        char_array_cat(key, words[rand() % NUM_WORDS]);
+        cstring_array_add_string(sentences, char_array_get_string(key));
+    }
+
+    token_array **tokens = malloc(num_sentences * sizeof(token_array *));
+    for (size_t i = 0; i < num_sentences; i++) {
+        tokens[i] = tokenize_keep_whitespace(cstring_array_get_string(sentences, i));
+    }
+
+    size_t nodes_before = trie->nodes->n;
+    size_t memory_before = trie_memory_size(trie);
+
+    bench_result_t get_before = bench_get_data(trie, queries);
+    bench_result_t prefix_before = bench_get_prefix(trie, queries);
+    bench_result_t search_before = bench_search_tokens(trie, sentences, tokens);
+
+    clock_t t1 = clock();
+    if (!trie_freeze(trie)) {
+        printf("Error freezing trie\n");
+        exit(EXIT_FAILURE);
+    }
+    clock_t t2 = clock();
+
+    bench_result_t get_after = bench_get_data(trie, queries);
+    bench_result_t prefix_after = bench_get_prefix(trie, queries);
+    bench_result_t search_after = bench_search_tokens(trie, sentences, tokens);
+
+    printf("keys=%u, nodes=%zu -> %zu, bytes=%zu -> %zu, freeze time=%.3fs\n\n", trie_num_keys(trie), nodes_before, trie->nodes->n, memory_before, trie_memory_size(trie), (double)(t2 - t1) / CLOCKS_PER_SEC);
+    printf("%-20s %13s %13s\n", "", "built", "frozen");
+    bench_print("trie_get_data", get_before, get_after);
+    bench_print("trie_get_prefix", prefix_before, prefix_after);
+    bench_print("trie_search_tokens", search_before, search_after);
+
+    for (size_t i = 0; i < num_sentences; i++) {
+        token_array_destroy(tokens[i]);
+    }
+    free(tokens);
+
+    cstring_array_destroy(sentences);
+    cstring_array_destroy(queries);
+    cstring_array_destroy(keys);
+    char_array_destroy(key);
+    trie_destroy(trie);
+
+    bool ok = get_before.checksum == get_after.checksum &&
+              prefix_before.checksum == prefix_after.checksum &&
+              search_before.checksum == search_after.checksum;
+
+    exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -7,6 +7,18 @@ SUITE_EXTERN(libpostal_numex_tests);
 SUITE_EXTERN(libpostal_string_utils_tests);
 SUITE_EXTERN(libpostal_trie_tests);
 SUITE_EXTERN(libpostal_crf_context_tests);
+SUITE_EXTERN(libpostal_bloom_tests);
+SUITE_EXTERN(libpostal_feature_hash_tests);
+SUITE_EXTERN(libpostal_double_metaphone_tests);
+SUITE_EXTERN(libpostal_geohash_tests);
+SUITE_EXTERN(libpostal_string_set_tests);
+SUITE_EXTERN(libpostal_token_cache_tests);
+SUITE_EXTERN(libpostal_transliteration_dfa_tests);
+SUITE_EXTERN(libpostal_server_tests);
+#ifdef LIBPOSTAL_TEST_GEODB
+SUITE_EXTERN(libpostal_geodb_builder_tests);
+SUITE_EXTERN(libpostal_geodb_tests);
+#endif
 
 GREATEST_MAIN_DEFS();
 
@@ -21,5 +33,17 @@ int main(int argc, char **argv) {
     RUN_SUITE(libpostal_string_utils_tests);
     RUN_SUITE(libpostal_trie_tests);
     RUN_SUITE(libpostal_crf_context_tests);
+    RUN_SUITE(libpostal_bloom_tests);
+    RUN_SUITE(libpostal_feature_hash_tests);
+    RUN_SUITE(libpostal_double_metaphone_tests);
+    RUN_SUITE(libpostal_geohash_tests);
+    RUN_SUITE(libpostal_string_set_tests);
+    RUN_SUITE(libpostal_token_cache_tests);
+    RUN_SUITE(libpostal_transliteration_dfa_tests);
+    RUN_SUITE(libpostal_server_tests);
+#ifdef LIBPOSTAL_TEST_GEODB
+    RUN_SUITE(libpostal_geodb_builder_tests);
+    RUN_SUITE(libpostal_geodb_tests);
+#endif
     GREATEST_MAIN_END();
 }
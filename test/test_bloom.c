@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdarg.h>
+
+#include "greatest.h"
+#include "../src/bloom.h"
+#include "../src/string_utils.h"
+
+SUITE(libpostal_bloom_tests);
+
+#define TEST_BLOOM_NUM_KEYS 10000
+#define TEST_BLOOM_ERROR_RATE 0.01
+
+static void test_bloom_key(char_array *key, char *prefix, size_t i) {
+    char_array_clear(key);
+    char_array_cat_printf(key, "%s|%zu", prefix, i);
+}
+
+TEST test_blocked_bloom_filter(void) {
+    blocked_bloom_filter_t *bloom = blocked_bloom_filter_new(TEST_BLOOM_NUM_KEYS, TEST_BLOOM_ERROR_RATE);
+    ASSERT(bloom != NULL);
+    ASSERT_EQ((uintptr_t)bloom->blocks % BLOCKED_BLOOM_FILTER_BLOCK_SIZE, 0);
+
+    char_array *key = char_array_new();
+
+    for (size_t i = 0; i < TEST_BLOOM_NUM_KEYS; i++) {
+        test_bloom_key(key, "word", i);
+        blocked_bloom_filter_add(bloom, key->a, key->n);
+    }
+
+    // No false negatives
+    for (size_t i = 0; i < TEST_BLOOM_NUM_KEYS; i++) {
+        test_bloom_key(key, "word", i);
+        ASSERT(blocked_bloom_filter_check(bloom, key->a, key->n));
+    }
+
+    // Blocking costs a little accuracy, allow up to twice the requested rate
+    size_t false_positives = 0;
+    for (size_t i = 0; i < TEST_BLOOM_NUM_KEYS; i++) {
+        test_bloom_key(key, "prev_word", i);
+        if (blocked_bloom_filter_check(bloom, key->a, key->n)) {
+            false_positives++;
+        }
+    }
+    ASSERT(false_positives < 2 * TEST_BLOOM_ERROR_RATE * TEST_BLOOM_NUM_KEYS);
+
+    FILE *f = tmpfile();
+    ASSERT(f != NULL);
+    // Embedded after another section, the blocks still start on a 64-byte boundary of the file
+    ASSERT(file_write_chars(f, "abc", 3));
+    ASSERT(blocked_bloom_filter_write(bloom, f));
+    ASSERT_EQ((size_t)ftell(f) % BLOCKED_BLOOM_FILTER_BLOCK_SIZE, 0);
+    ASSERT_EQ(fseek(f, 3, SEEK_SET), 0);
+
+    blocked_bloom_filter_t *copy = blocked_bloom_filter_read(f);
+    fclose(f);
+    ASSERT(copy != NULL);
+    ASSERT_EQ(copy->num_blocks, bloom->num_blocks);
+    ASSERT_EQ(memcmp(copy->blocks, bloom->blocks, bloom->num_blocks * BLOCKED_BLOOM_FILTER_BLOCK_SIZE), 0);
+
+    for (size_t i = 0; i < TEST_BLOOM_NUM_KEYS; i++) {
+        test_bloom_key(key, "word", i);
+        ASSERT(blocked_bloom_filter_check(copy, key->a, key->n));
+    }
+
+    blocked_bloom_filter_destroy(copy);
+    blocked_bloom_filter_destroy(bloom);
+    char_array_destroy(key);
+
+    PASS();
+}
+
+
+SUITE(libpostal_bloom_tests) {
+
+    RUN_TEST(test_blocked_bloom_filter);
+
+}
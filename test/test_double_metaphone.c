@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "greatest.h"
+#include "../src/double_metaphone.h"
+
+SUITE(libpostal_double_metaphone_tests);
+
+static greatest_test_res test_double_metaphone_codes(char *input, char *primary, char *secondary) {
+    double_metaphone_codes_t *codes = double_metaphone(input);
+    ASSERT(codes != NULL);
+    ASSERT_STR_EQ(primary, codes->primary);
+    ASSERT_STR_EQ(secondary, codes->secondary);
+    double_metaphone_codes_destroy(codes);
+
+    char primary_buffer[DOUBLE_METAPHONE_CODE_SIZE];
+    char secondary_buffer[DOUBLE_METAPHONE_CODE_SIZE];
+    ASSERT(double_metaphone_codes_buffer(input, primary_buffer, secondary_buffer, DOUBLE_METAPHONE_CODE_SIZE));
+    ASSERT_STR_EQ(primary, primary_buffer);
+    ASSERT_STR_EQ(secondary, secondary_buffer);
+
+    PASS();
+}
+
+TEST test_double_metaphone(void) {
+    CHECK_CALL(test_double_metaphone_codes("Schmidt", "XMT", "SMT"));
+    CHECK_CALL(test_double_metaphone_codes("michael", "MKL", "MXL"));
+    CHECK_CALL(test_double_metaphone_codes("caesar", "SSR", "KSR"));
+    CHECK_CALL(test_double_metaphone_codes("bellocchio", "PLK", "PLX"));
+    CHECK_CALL(test_double_metaphone_codes("McClellan", "MKLLN", "MKLLN"));
+    CHECK_CALL(test_double_metaphone_codes("Knight", "NT", "NT"));
+    // Non-ASCII input goes through decomposition, Ç is matched in decomposed form
+    CHECK_CALL(test_double_metaphone_codes("François", "FRNS", "FRNSS"));
+    CHECK_CALL(test_double_metaphone_codes("José", "JS", "HS"));
+    CHECK_CALL(test_double_metaphone_codes("", "", ""));
+
+    PASS();
+}
+
+TEST test_double_metaphone_buffer_too_small(void) {
+    char primary[3];
+    char secondary[3];
+
+    ASSERT_FALSE(double_metaphone_codes_buffer("McClellan", primary, secondary, sizeof(primary)));
+    ASSERT(strlen(primary) < sizeof(primary));
+
+    char long_input[DOUBLE_METAPHONE_MAX_CODEPOINTS + 2];
+    memset(long_input, 'b', sizeof(long_input) - 1);
+    long_input[sizeof(long_input) - 1] = '\0';
+
+    char primary_buffer[DOUBLE_METAPHONE_CODE_SIZE];
+    char secondary_buffer[DOUBLE_METAPHONE_CODE_SIZE];
+    ASSERT_FALSE(double_metaphone_codes_buffer(long_input, primary_buffer, secondary_buffer, DOUBLE_METAPHONE_CODE_SIZE));
+
+    PASS();
+}
+
+SUITE(libpostal_double_metaphone_tests) {
+    RUN_TEST(test_double_metaphone);
+    RUN_TEST(test_double_metaphone_buffer_too_small);
+}
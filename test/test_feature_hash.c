@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdarg.h>
+
+#include "greatest.h"
+#include "../src/crf.h"
+#include "../src/feature_hash.h"
+#include "../src/string_utils.h"
+
+SUITE(libpostal_feature_hash_tests);
+
+#define TEST_FEATURE_HASH_BITS 10
+#define TEST_FEATURE_HASH_NUM_KEYS 5000
+
+TEST test_feature_hash_ids(void) {
+    size_t num_ids = 1 << TEST_FEATURE_HASH_BITS;
+    size_t *counts = calloc(num_ids, sizeof(size_t));
+    ASSERT(counts != NULL);
+
+    char_array *key = char_array_new();
+
+    for (size_t i = 0; i < TEST_FEATURE_HASH_NUM_KEYS; i++) {
+        char_array_clear(key);
+        char_array_cat_printf(key, "word=%zu", i);
+        char *feature = char_array_get_string(key);
+
+        uint32_t id = feature_hash_id(feature, FEATURE_HASH_DEFAULT_SEED, TEST_FEATURE_HASH_BITS);
+        ASSERT(id < num_ids);
+        ASSERT_EQ(id, feature_hash_id(feature, FEATURE_HASH_DEFAULT_SEED, TEST_FEATURE_HASH_BITS));
+        counts[id]++;
+    }
+
+    // Ids should be spread over the whole space, about 5 per id here
+    size_t max_count = 0;
+    for (size_t i = 0; i < num_ids; i++) {
+        if (counts[i] > max_count) max_count = counts[i];
+    }
+    ASSERT(max_count < 25);
+
+    // A different seed gives a different mapping
+    ASSERT(feature_hash("word=1", strlen("word=1"), 1) != feature_hash("word=1", strlen("word=1"), 2));
+
+    char_array_destroy(key);
+    free(counts);
+    PASS();
+}
+
+TEST test_crf_hashed_read_write(void) {
+    crf_t *crf = calloc(1, sizeof(crf_t));
+    ASSERT(crf != NULL);
+
+    crf->num_classes = 2;
+    crf->classes = cstring_array_new();
+    cstring_array_add_string(crf->classes, "house_number");
+    cstring_array_add_string(crf->classes, "road");
+    crf->hash_bits = FEATURE_HASH_MIN_BITS;
+    crf->hash_seed = FEATURE_HASH_DEFAULT_SEED;
+
+    uint32_t feature_id = feature_hash_id("word=main", crf->hash_seed, crf->hash_bits);
+
+    crf->weights = sparse_matrix_new();
+    crf->state_trans_weights = sparse_matrix_new();
+    for (uint32_t i = 0; i < (1U << crf->hash_bits); i++) {
+        if (i == feature_id) {
+            sparse_matrix_append(crf->weights, 1, 2.5);
+        }
+        sparse_matrix_finalize_row(crf->weights);
+        sparse_matrix_finalize_row(crf->state_trans_weights);
+    }
+    crf->trans_weights = double_matrix_new_zeros(2, 2);
+
+    FILE *f = tmpfile();
+    ASSERT(f != NULL);
+    ASSERT(crf_write(crf, f));
+    rewind(f);
+
+    crf_t *copy = crf_read(f);
+    fclose(f);
+    ASSERT(copy != NULL);
+    ASSERT_EQ(copy->hash_bits, crf->hash_bits);
+    ASSERT_EQ(copy->hash_seed, crf->hash_seed);
+    ASSERT(copy->state_features == NULL);
+    ASSERT(copy->state_trans_features == NULL);
+    ASSERT_EQ(copy->weights->m, 1U << crf->hash_bits);
+
+    uint32_t start = copy->weights->indptr->a[feature_id];
+    ASSERT_EQ(copy->weights->indptr->a[feature_id + 1] - start, 1);
+    ASSERT_EQ(copy->weights->indices->a[start], 1);
+
+    crf_destroy(copy);
+    crf_destroy(crf);
+    PASS();
+}
+
+SUITE(libpostal_feature_hash_tests) {
+
+    RUN_TEST(test_feature_hash_ids);
+    RUN_TEST(test_crf_hashed_read_write);
+
+}
@@ -0,0 +1,402 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "greatest.h"
+
+// build_geodb is a program, so include it with its main renamed to get at the import
+#define main build_geodb_main
+#include "../src/geodb_builder.c"
+#undef main
+
+SUITE(libpostal_geodb_builder_tests);
+SUITE(libpostal_geodb_tests);
+
+typedef struct test_geoname {
+    char *name;
+    uint32_t geonames_id;
+    uint32_t admin1_id;
+} test_geoname_t;
+
+static void test_geodb_builder_write_geoname(FILE *f, test_geoname_t g) {
+    fprintf(f, "%s\t%u\t%s\t%d\t0\ten\t0\t1\t0\t0\t0\t1000\t40.0\t-80.0\tPPL\tUS\t6252001\tXX\t%u\t\t0\t\t0\t\t0\n",
+            g.name, g.geonames_id, g.name, GEONAMES_LOCALITY, g.admin1_id);
+}
+
+static void test_geodb_builder_write_postal_code(FILE *f, char *code, char *country_code, uint32_t country_geonames_id) {
+    fprintf(f, "%s\t%s\t%u\t0\t\t\t\t\n", code, country_code, country_geonames_id);
+}
+
+static bool test_geodb_builder_has_edge(geodb_builder_t *builder, uint32_t feature_id, uint32_t geonames_id) {
+    graph_edge_array *edges = builder->feature_graph_builder->edges;
+    for (size_t i = 0; i < edges->n; i++) {
+        if (edges->a[i].v1 == feature_id && edges->a[i].v2 == geonames_id) return true;
+    }
+    return false;
+}
+
+/*
+Several places sharing a name get disambiguation features, and each id must
+only be linked to the features of its own record. The ids are chosen so that
+their order in a hash set differs from the order they appear in the file.
+*/
+TEST test_geodb_builder_shared_name_features(void) {
+    test_geoname_t springfields[] = {
+        {"springfield", 300, 7001},
+        {"springfield", 2, 7002},
+        {"springfield", 17, 7003},
+        {"springfield", 45, 7004}
+    };
+    size_t num_springfields = sizeof(springfields) / sizeof(springfields[0]);
+
+    char tsv_filename[] = "/tmp/test_geodb_builder_tsv_XXXXXX";
+    int fd = mkstemp(tsv_filename);
+    ASSERT(fd >= 0);
+    FILE *f = fdopen(fd, "w");
+    ASSERT(f != NULL);
+
+    for (size_t i = 0; i < num_springfields; i++) {
+        test_geodb_builder_write_geoname(f, springfields[i]);
+    }
+    // A new name flushes the features of the previous one
+    test_geodb_builder_write_geoname(f, (test_geoname_t){"zanesville", 9, 7009});
+    fclose(f);
+
+    char log_filename[] = "/tmp/test_geodb_builder_log_XXXXXX";
+    fd = mkstemp(log_filename);
+    ASSERT(fd >= 0);
+    close(fd);
+
+    geodb_builder_t *builder = geodb_builder_new(log_filename);
+    ASSERT(builder != NULL);
+
+    geodb_builder_import_parallel(builder, tsv_filename, GEODB_BUILDER_GEONAMES, 2);
+
+    cstring_array *features = cstring_array_new();
+
+    for (size_t i = 0; i < num_springfields; i++) {
+        cstring_array_clear(features);
+        ASSERT(geodisambig_add_admin1_feature(features, springfields[i].name, springfields[i].admin1_id));
+
+        uint32_t feature_id;
+        ASSERT(trie_get_data(builder->features, cstring_array_get_string(features, 0), &feature_id));
+
+        for (size_t j = 0; j < num_springfields; j++) {
+            bool has_edge = test_geodb_builder_has_edge(builder, feature_id, springfields[j].geonames_id);
+            if (i == j) {
+                ASSERT(has_edge);
+            } else {
+                ASSERT_FALSE(has_edge);
+            }
+        }
+    }
+
+    // An unambiguous name gets no disambiguation features
+    cstring_array_clear(features);
+    ASSERT(geodisambig_add_admin1_feature(features, "zanesville", 7009));
+    uint32_t feature_id;
+    ASSERT_FALSE(trie_get_data(builder->features, cstring_array_get_string(features, 0), &feature_id));
+
+    cstring_array_destroy(features);
+    geodb_builder_destroy(builder);
+    unlink(tsv_filename);
+    unlink(log_filename);
+    PASS();
+}
+
+SUITE(libpostal_geodb_builder_tests) {
+    RUN_TEST(test_geodb_builder_shared_name_features);
+}
+
+/*
+Sorted by name like geonames.tsv. "10001" is also a postal code, and the
+names are normalized when they're looked up, so "Москва" is found as "москва".
+*/
+static test_geoname_t test_geodb_geonames[] = {
+    {"10001", 5, 7000},
+    {"Springfield", 300, 7001},
+    {"Springfield", 2, 7002},
+    {"Springfield", 17, 7003},
+    {"Springfield", 45, 7004},
+    {"Zanesville", 9, 7009},
+    {"Москва", 524901, 7010}
+};
+
+#define TEST_GEODB_NUM_GEONAMES (sizeof(test_geodb_geonames) / sizeof(test_geodb_geonames[0]))
+
+static char *test_geodb_filenames[] = {
+    GEODB_NAMES_TRIE_FILENAME,
+    GEODB_FEATURES_TRIE_FILENAME,
+    GEODB_FEATURE_GRAPH_FILENAME,
+    GEODB_POSTAL_CODES_FILENAME,
+    GEODB_HASH_FILENAME,
+    GEODB_LOG_FILENAME
+};
+
+#define TEST_GEODB_NUM_FILENAMES (sizeof(test_geodb_filenames) / sizeof(test_geodb_filenames[0]))
+
+static void test_geodb_path(char_array *path, char *dir, char *filename) {
+    char_array_clear(path);
+    char_array_cat_joined(path, PATH_SEPARATOR, true, 2, dir, filename);
+}
+
+static bool test_geodb_build(char *dir) {
+    char_array *path = char_array_new();
+    bool ret = false;
+
+    test_geodb_path(path, dir, "geonames.tsv");
+    FILE *f = fopen(char_array_get_string(path), "w");
+    if (f == NULL) goto exit_test_geodb_build;
+    for (size_t i = 0; i < TEST_GEODB_NUM_GEONAMES; i++) {
+        test_geodb_builder_write_geoname(f, test_geodb_geonames[i]);
+    }
+    fclose(f);
+
+    test_geodb_path(path, dir, "postal_codes.tsv");
+    f = fopen(char_array_get_string(path), "w");
+    if (f == NULL) goto exit_test_geodb_build;
+    test_geodb_builder_write_postal_code(f, "10001", "US", 6252001);
+    test_geodb_builder_write_postal_code(f, "10001", "XX", 999);
+    test_geodb_builder_write_postal_code(f, "SW1A", "GB", 2635167);
+    fclose(f);
+
+    test_geodb_path(path, dir, GEODB_LOG_FILENAME);
+    geodb_builder_t *builder = geodb_builder_new(char_array_get_string(path));
+    if (builder == NULL) goto exit_test_geodb_build;
+
+    test_geodb_path(path, dir, "geonames.tsv");
+    import_geonames(builder, char_array_get_string(path), 2);
+    test_geodb_path(path, dir, "postal_codes.tsv");
+    import_geonames_postal_codes(builder, char_array_get_string(path), 2);
+
+    ret = geodb_builder_finalize(builder, dir);
+    geodb_builder_destroy(builder);
+
+exit_test_geodb_build:
+    char_array_destroy(path);
+    return ret;
+}
+
+static void test_geodb_remove(char *dir) {
+    char_array *path = char_array_new();
+
+    test_geodb_path(path, dir, "geonames.tsv");
+    unlink(char_array_get_string(path));
+    test_geodb_path(path, dir, "postal_codes.tsv");
+    unlink(char_array_get_string(path));
+
+    for (size_t i = 0; i < TEST_GEODB_NUM_FILENAMES; i++) {
+        test_geodb_path(path, dir, test_geodb_filenames[i]);
+        unlink(char_array_get_string(path));
+    }
+
+    char_array_destroy(path);
+    rmdir(dir);
+}
+
+static bool test_geodb_ids_equal(uint32_array *ids, geodb_name_lookup_result_t result, uint32_t *expected, size_t num_expected) {
+    if (!result.found || result.count != num_expected) return false;
+
+    // Any order
+    for (size_t i = 0; i < num_expected; i++) {
+        bool found = false;
+        for (size_t j = result.index; j < result.index + result.count; j++) {
+            if (ids->a[j] == expected[i]) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) return false;
+    }
+    return true;
+}
+
+TEST test_geodb_lookup_batch(void) {
+    char dir[] = "/tmp/test_geodb_XXXXXX";
+    ASSERT(mkdtemp(dir) != NULL);
+    ASSERT(test_geodb_build(dir));
+    ASSERT(geodb_module_setup(dir));
+
+    geodb_reader_t *reader = geodb_reader_new(get_geodb());
+    ASSERT(reader != NULL);
+
+    geonames_generic_t *generic = geodb_reader_get(reader, "300");
+    ASSERT(generic != NULL);
+    ASSERT_EQ(GEONAMES_PLACE, generic->type);
+    ASSERT_EQ(300, generic->geoname->geonames_id);
+
+    // Raw keys
+    char *keys[] = {"300", "US|10001", "GB|sw1a", "12345", NULL};
+    size_t num_keys = sizeof(keys) / sizeof(keys[0]);
+    geodb_lookup_result_t key_results[num_keys];
+
+    ASSERT_EQ(3, geodb_reader_lookup_batch(reader, num_keys, keys, key_results));
+    ASSERT(key_results[0].found && key_results[0].type == GEONAMES_PLACE && key_results[0].geonames_id == 300);
+    ASSERT(key_results[1].found && key_results[1].type == GEONAMES_POSTAL_CODE && key_results[1].geonames_id == 6252001);
+    ASSERT(key_results[2].found && key_results[2].geonames_id == 2635167);
+    ASSERT_FALSE(key_results[3].found);
+    ASSERT_FALSE(key_results[4].found);
+
+    uint32_array *ids = uint32_array_new();
+
+    // Place names
+    char *places[] = {"springfield", "  МОСКВА ", "Zanesville", "10001", "Nowhere", NULL};
+    size_t num_places = sizeof(places) / sizeof(places[0]);
+    geodb_name_lookup_result_t place_results[num_places];
+
+    ASSERT_EQ(4, geodb_reader_lookup_names_batch(reader, num_places, places, GEONAMES_PLACE, ids, place_results));
+    ASSERT(test_geodb_ids_equal(ids, place_results[0], (uint32_t []){300, 2, 17, 45}, 4));
+    // Last name in the file
+    ASSERT(test_geodb_ids_equal(ids, place_results[1], (uint32_t []){524901}, 1));
+    ASSERT(test_geodb_ids_equal(ids, place_results[2], (uint32_t []){9}, 1));
+    // Only the place, not the postal codes of the same name
+    ASSERT(test_geodb_ids_equal(ids, place_results[3], (uint32_t []){5}, 1));
+    ASSERT_FALSE(place_results[4].found);
+    ASSERT_FALSE(place_results[5].found);
+
+    // Postal codes resolve to their country when they have no containing place
+    uint32_array_clear(ids);
+    char *postal_codes[] = {"10001", "SW1A", "springfield"};
+    size_t num_postal_codes = sizeof(postal_codes) / sizeof(postal_codes[0]);
+    geodb_name_lookup_result_t postal_code_results[num_postal_codes];
+
+    ASSERT_EQ(2, geodb_reader_lookup_names_batch(reader, num_postal_codes, postal_codes, GEONAMES_POSTAL_CODE, ids, postal_code_results));
+    ASSERT(test_geodb_ids_equal(ids, postal_code_results[0], (uint32_t []){6252001, 999}, 2));
+    ASSERT(test_geodb_ids_equal(ids, postal_code_results[1], (uint32_t []){2635167}, 1));
+    ASSERT_FALSE(postal_code_results[2].found);
+
+    uint32_array_destroy(ids);
+    geodb_reader_destroy(reader);
+    geodb_module_teardown();
+    test_geodb_remove(dir);
+    PASS();
+}
+
+#define TEST_GEODB_NUM_THREADS 4
+
+typedef struct test_geodb_thread {
+    pthread_t thread;
+    char *key;
+    uint32_t geonames_id;
+    // Record owned by the thread's reader
+    geoname_t *geoname;
+    bool found;
+    bool found_after_teardown;
+    bool found_after_reload;
+} test_geodb_thread_t;
+
+static pthread_mutex_t test_geodb_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t test_geodb_cond = PTHREAD_COND_INITIALIZER;
+static int test_geodb_phase = 0;
+static size_t test_geodb_num_done = 0;
+
+// Threads stay alive between phases so that teardown runs while they still hold their readers
+static void test_geodb_thread_finish_phase(int phase) {
+    pthread_mutex_lock(&test_geodb_lock);
+    test_geodb_num_done++;
+    pthread_cond_broadcast(&test_geodb_cond);
+    while (test_geodb_phase < phase) {
+        pthread_cond_wait(&test_geodb_cond, &test_geodb_lock);
+    }
+    pthread_mutex_unlock(&test_geodb_lock);
+}
+
+static void test_geodb_wait_done(size_t num_done) {
+    pthread_mutex_lock(&test_geodb_lock);
+    while (test_geodb_num_done < num_done) {
+        pthread_cond_wait(&test_geodb_cond, &test_geodb_lock);
+    }
+    pthread_mutex_unlock(&test_geodb_lock);
+}
+
+static void test_geodb_start_phase(int phase) {
+    pthread_mutex_lock(&test_geodb_lock);
+    test_geodb_phase = phase;
+    pthread_cond_broadcast(&test_geodb_cond);
+    pthread_mutex_unlock(&test_geodb_lock);
+}
+
+static bool test_geodb_thread_lookup(test_geodb_thread_t *self, geoname_t **geoname) {
+    geonames_generic_t *generic = geodb_get(self->key);
+    if (generic == NULL) return false;
+
+    bool found = generic->type == GEONAMES_PLACE && generic->geoname->geonames_id == self->geonames_id;
+    if (geoname != NULL) {
+        *geoname = generic->geoname;
+    }
+    free(generic);
+    return found;
+}
+
+static void *test_geodb_thread_run(void *arg) {
+    test_geodb_thread_t *self = arg;
+
+    self->found = test_geodb_thread_lookup(self, &self->geoname);
+    test_geodb_thread_finish_phase(1);
+
+    self->found_after_teardown = test_geodb_thread_lookup(self, NULL);
+    test_geodb_thread_finish_phase(2);
+
+    self->found_after_reload = test_geodb_thread_lookup(self, NULL);
+    return NULL;
+}
+
+TEST test_geodb_thread_readers(void) {
+    char dir[] = "/tmp/test_geodb_XXXXXX";
+    ASSERT(mkdtemp(dir) != NULL);
+    ASSERT(test_geodb_build(dir));
+    ASSERT(geodb_module_setup(dir));
+
+    char *keys[TEST_GEODB_NUM_THREADS] = {"300", "2", "17", "45"};
+    uint32_t ids[TEST_GEODB_NUM_THREADS] = {300, 2, 17, 45};
+    test_geodb_thread_t threads[TEST_GEODB_NUM_THREADS];
+
+    test_geodb_phase = 0;
+    test_geodb_num_done = 0;
+
+    for (size_t i = 0; i < TEST_GEODB_NUM_THREADS; i++) {
+        threads[i] = (test_geodb_thread_t){.key = keys[i], .geonames_id = ids[i]};
+        ASSERT_EQ(0, pthread_create(&threads[i].thread, NULL, test_geodb_thread_run, &threads[i]));
+    }
+
+    test_geodb_wait_done(TEST_GEODB_NUM_THREADS);
+
+    // Each thread looked up its id with a reader of its own
+    ASSERT_EQ(TEST_GEODB_NUM_THREADS, geodb_num_thread_readers());
+    for (size_t i = 0; i < TEST_GEODB_NUM_THREADS; i++) {
+        ASSERT(threads[i].found);
+        for (size_t j = 0; j < i; j++) {
+            ASSERT(threads[i].geoname != threads[j].geoname);
+        }
+    }
+
+    // Destroys every thread's reader, not just this one's
+    geodb_module_teardown();
+    ASSERT_EQ(0, geodb_num_thread_readers());
+    test_geodb_start_phase(1);
+    test_geodb_wait_done(2 * TEST_GEODB_NUM_THREADS);
+
+    // The same threads get new readers once the geodb is loaded again
+    ASSERT(geodb_module_setup(dir));
+    test_geodb_start_phase(2);
+
+    for (size_t i = 0; i < TEST_GEODB_NUM_THREADS; i++) {
+        pthread_join(threads[i].thread, NULL);
+        ASSERT_FALSE(threads[i].found_after_teardown);
+        ASSERT(threads[i].found_after_reload);
+    }
+    // Exited threads free their own readers
+    ASSERT_EQ(0, geodb_num_thread_readers());
+
+    geodb_module_teardown();
+    test_geodb_remove(dir);
+    PASS();
+}
+
+SUITE(libpostal_geodb_tests) {
+    RUN_TEST(test_geodb_lookup_batch);
+    RUN_TEST(test_geodb_thread_readers);
+}
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "greatest.h"
+#include "../src/geohash/geohash.h"
+
+SUITE(libpostal_geohash_tests);
+
+static greatest_test_res check_geohash_uint64(double latitude, double longitude, size_t precision) {
+    char geohash[GEOHASH_UINT64_MAX_PRECISION + 1];
+    char geohash_uint64_str[GEOHASH_UINT64_MAX_PRECISION + 1];
+    size_t geohash_len = precision + 1;
+
+    ASSERT_EQ(GEOHASH_OK, geohash_encode(latitude, longitude, geohash, geohash_len));
+
+    uint64_t hash;
+    ASSERT_EQ(GEOHASH_OK, geohash_encode_uint64(latitude, longitude, precision, &hash));
+    ASSERT_EQ(GEOHASH_OK, geohash_uint64_to_string(hash, precision, geohash_uint64_str, geohash_len));
+    ASSERT_STR_EQ(geohash, geohash_uint64_str);
+
+    char neighbors[(GEOHASH_UINT64_MAX_PRECISION + 1) * 8];
+    int num_neighbors = 0;
+    ASSERT_EQ(GEOHASH_OK, geohash_neighbors(geohash, neighbors, geohash_len * 8, &num_neighbors));
+
+    uint64_t neighbors_uint64[8];
+    size_t num_neighbors_uint64 = 0;
+    ASSERT_EQ(GEOHASH_OK, geohash_neighbors_uint64(hash, precision, neighbors_uint64, &num_neighbors_uint64));
+    ASSERT_EQ((size_t)num_neighbors, num_neighbors_uint64);
+
+    for (size_t i = 0; i < num_neighbors_uint64; i++) {
+        ASSERT_EQ(GEOHASH_OK, geohash_uint64_to_string(neighbors_uint64[i], precision, geohash_uint64_str, geohash_len));
+        ASSERT_STR_EQ(neighbors + i * geohash_len, geohash_uint64_str);
+    }
+
+    PASS();
+}
+
+TEST test_geohash_uint64(void) {
+    double points[][2] = {
+        {40.6892, -74.0445},
+        {-33.8568, 151.2153},
+        {0.0, 0.0},
+        {-1e-9, 179.9999999},
+        {89.9999999, -180.0},
+        {-90.0, 12.5}
+    };
+
+    for (size_t i = 0; i < sizeof(points) / sizeof(points[0]); i++) {
+        for (size_t precision = 1; precision <= GEOHASH_UINT64_MAX_PRECISION; precision++) {
+            CHECK_CALL(check_geohash_uint64(points[i][0], points[i][1], precision));
+        }
+    }
+
+    uint64_t hash;
+    ASSERT_EQ(GEOHASH_OK, geohash_encode_uint64(57.64911, 10.40744, 11, &hash));
+    char str[12];
+    ASSERT_EQ(GEOHASH_OK, geohash_uint64_to_string(hash, 11, str, sizeof(str)));
+    ASSERT_STR_EQ("u4pruydqqvj", str);
+
+    PASS();
+}
+
+TEST test_geohash_encode_batch(void) {
+    double latitudes[] = {40.6892, 91.0, -33.8568};
+    double longitudes[] = {-74.0445, 0.0, 151.2153};
+    uint64_t hashes[3];
+
+    ASSERT_EQ(2, geohash_encode_batch(latitudes, longitudes, 3, 7, hashes));
+    ASSERT_EQ(GEOHASH_UINT64_INVALID, hashes[1]);
+
+    for (size_t i = 0; i < 3; i += 2) {
+        uint64_t hash;
+        ASSERT_EQ(GEOHASH_OK, geohash_encode_uint64(latitudes[i], longitudes[i], 7, &hash));
+        ASSERT_EQ(hash, hashes[i]);
+    }
+
+    PASS();
+}
+
+SUITE(libpostal_geohash_tests) {
+    RUN_TEST(test_geohash_uint64);
+    RUN_TEST(test_geohash_encode_batch);
+}
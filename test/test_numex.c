@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <pthread.h>
 
 #include "greatest.h"
 #include "../src/numex.h"
@@ -75,6 +76,57 @@ TEST test_numeric_expressions(void) {
     PASS();
 }
 
+static greatest_test_res test_numex_may_match(char *input, char *lang, bool expected) {
+    numex_language_t *language = get_numex_language(lang);
+    ASSERT(language != NULL);
+    ASSERT_EQ(expected, numex_language_may_match(language, input, strlen(input)));
+    PASS();
+}
+
+TEST test_numex_prefilter(void) {
+    CHECK_CALL(test_numex_may_match("123 45-6", "en", false));
+    CHECK_CALL(test_numex_may_match("five hundred ninety-three", "en", true));
+    CHECK_CALL(test_numex_may_match("123 fifth ave", "en", true));
+    CHECK_CALL(test_numex_may_match("1234", "de", false));
+    CHECK_CALL(test_numex_may_match("dreiundzwanzigste strasse", "de", true));
+    CHECK_CALL(test_numex_may_match("百二十", "ja", true));
+
+    // Inputs the prefilter rejects must be left unchanged
+    CHECK_CALL(test_numex("123 45-6", "123 45-6", "en"));
+
+    PASS();
+}
+
+#define TEST_NUMEX_LAZY_THREADS 4
+
+static void *test_numex_lazy_worker(void *arg) {
+    char *normalized = replace_numeric_expressions("twenty-sixth street", "en");
+    bool *ok = arg;
+    *ok = normalized != NULL && strcmp(normalized, "26th street") == 0;
+    free(normalized);
+    return NULL;
+}
+
+TEST test_numex_lazy_setup(void) {
+    numex_module_teardown();
+    ASSERT(numex_module_setup_lazy(DEFAULT_NUMEX_PATH));
+    ASSERT(get_numex_table() == NULL);
+
+    // The first callers race to load the table, all of them must see it complete
+    pthread_t threads[TEST_NUMEX_LAZY_THREADS];
+    bool ok[TEST_NUMEX_LAZY_THREADS] = {false};
+    for (size_t i = 0; i < TEST_NUMEX_LAZY_THREADS; i++) {
+        ASSERT_EQ(pthread_create(&threads[i], NULL, test_numex_lazy_worker, &ok[i]), 0);
+    }
+    for (size_t i = 0; i < TEST_NUMEX_LAZY_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        ASSERT(ok[i]);
+    }
+
+    ASSERT(get_numex_table() != NULL);
+    PASS();
+}
+
 GREATEST_SUITE(libpostal_numex_tests) {
     if (!numex_module_setup(DEFAULT_NUMEX_PATH)) {
         printf("Could not load numex module\n");
@@ -82,6 +134,8 @@ GREATEST_SUITE(libpostal_numex_tests) {
     }
 
     RUN_TEST(test_numeric_expressions);
+    RUN_TEST(test_numex_prefilter);
+    RUN_TEST(test_numex_lazy_setup);
 
     numex_module_teardown();
 }
@@ -1876,6 +1876,51 @@ TEST test_ru_parses(void) {
     PASS();
 }
 
+static void test_async_parse_callback(libpostal_address_parser_response_t *response, void *userdata) {
+    *(libpostal_address_parser_response_t **)userdata = response;
+}
+
+TEST test_async_parses(void) {
+    char *addresses[] = {
+        "781 Franklin Ave Crown Heights Brooklyn NYC NY 11216 USA",
+        "Barboncino 781 Franklin Ave, Crown Heights, Brooklyn, NY 11216 USA",
+        "188541, г. Сосновый Бор Ленинградской области",
+        "Rue du Médecin-Colonel Calbairac Toulouse France",
+        "Quatre vingt douze Ave des Champs-Élysées"
+    };
+    size_t num_addresses = sizeof(addresses) / sizeof(char *);
+    libpostal_address_parser_response_t *responses[sizeof(addresses) / sizeof(char *)] = {NULL};
+
+    libpostal_async_options_t async_options = libpostal_get_async_default_options();
+    async_options.num_workers = 3;
+    ASSERT(libpostal_setup_async(async_options));
+
+    libpostal_address_parser_options_t options = libpostal_get_address_parser_default_options();
+
+    for (size_t i = 0; i < num_addresses; i++) {
+        ASSERT(libpostal_submit_parse(addresses[i], options, test_async_parse_callback, &responses[i]));
+    }
+
+    libpostal_async_wait();
+    libpostal_teardown_async();
+
+    // Each worker parses with its own context, results must match the synchronous parser
+    for (size_t i = 0; i < num_addresses; i++) {
+        libpostal_address_parser_response_t *expected = libpostal_parse_address(addresses[i], options);
+        ASSERT(expected != NULL);
+        ASSERT(responses[i] != NULL);
+        ASSERT_EQ(expected->num_components, responses[i]->num_components);
+        for (size_t j = 0; j < expected->num_components; j++) {
+            ASSERT_STR_EQ(expected->labels[j], responses[i]->labels[j]);
+            ASSERT_STR_EQ(expected->components[j], responses[i]->components[j]);
+        }
+        libpostal_address_parser_response_destroy(expected);
+        libpostal_address_parser_response_destroy(responses[i]);
+    }
+
+    PASS();
+}
+
 SUITE(libpostal_parser_tests) {
     if (!libpostal_setup() || !libpostal_setup_parser()) {
         printf("Could not setup libpostal\n");
@@ -1907,6 +1952,7 @@ SUITE(libpostal_parser_tests) {
     RUN_TEST(test_hu_parses);
     RUN_TEST(test_ro_parses);
     RUN_TEST(test_ru_parses);
+    RUN_TEST(test_async_parses);
 
     libpostal_teardown();
     libpostal_teardown_parser();
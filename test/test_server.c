@@ -0,0 +1,259 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "greatest.h"
+
+// libpostal_server is a program, so include it with its main renamed to get at the connection handlers
+#define main libpostal_server_main
+#include "../src/server.c"
+#undef main
+
+SUITE(libpostal_server_tests);
+
+typedef struct test_server_connection {
+    int fd;
+    bool http;
+} test_server_connection_t;
+
+// Mirrors server_connection_worker: handle one connection, then close it
+static void *test_server_connection_thread(void *arg) {
+    test_server_connection_t *connection = arg;
+    if (connection->http) {
+        server_handle_http_connection(connection->fd);
+    } else {
+        server_handle_unix_connection(connection->fd);
+    }
+    close(connection->fd);
+    return NULL;
+}
+
+/*
+Sends each chunk in its own write over a socketpair, closes the client's
+write side and collects everything the server sends back until it closes
+the connection.
+*/
+static bool test_server_exchange(bool http, char **chunks, size_t num_chunks, char_array *response) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) return false;
+
+    test_server_connection_t connection = {.fd = fds[1], .http = http};
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, test_server_connection_thread, &connection) != 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+
+    for (size_t i = 0; i < num_chunks; i++) {
+        // The server may hang up early, e.g. on an overlong line
+        if (!server_write_all(fds[0], chunks[i], strlen(chunks[i]))) break;
+        // Give the server a chance to read a partial line before the rest arrives
+        usleep(1000);
+    }
+    shutdown(fds[0], SHUT_WR);
+
+    char_array_clear(response);
+    char buf[1024];
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof(buf))) > 0) {
+        char_array_append_len(response, buf, (size_t)n);
+    }
+    char_array_terminate(response);
+
+    pthread_join(thread, NULL);
+    close(fds[0]);
+    return n == 0;
+}
+
+static uint64_t test_server_stats_requests(char *line) {
+    char *prefix = "{\"requests\": ";
+    if (strncmp(line, prefix, strlen(prefix)) != 0) return UINT64_MAX;
+    return strtoull(line + strlen(prefix), NULL, 10);
+}
+
+/*
+One JSON line per request, in order, however the requests are split across
+reads. Blank lines are skipped and unknown commands get an error line
+without going through the model threads.
+*/
+TEST test_server_unix_framing(void) {
+    char *chunks[] = {
+        "/st",
+        "ats\r\n\n/bogus?x=1\n",
+        "/stats\n"
+    };
+
+    char_array *response = char_array_new();
+    ASSERT(test_server_exchange(false, chunks, sizeof(chunks) / sizeof(chunks[0]), response));
+
+    size_t num_lines = 0;
+    cstring_array *lines = cstring_array_split(char_array_get_string(response), "\n", 1, &num_lines);
+    ASSERT(lines != NULL);
+    // Every response ends in a newline, so the last split is empty
+    ASSERT_EQ(4, num_lines);
+    ASSERT_STR_EQ("", cstring_array_get_string(lines, 3));
+
+    uint64_t requests_before = test_server_stats_requests(cstring_array_get_string(lines, 0));
+    ASSERT(requests_before != UINT64_MAX);
+    ASSERT_STR_EQ("{\"error\": \"unknown command\"}", cstring_array_get_string(lines, 1));
+    // Only the first /stats went through a model thread in between
+    ASSERT_EQ(requests_before + 1, test_server_stats_requests(cstring_array_get_string(lines, 2)));
+
+    cstring_array_destroy(lines);
+    char_array_destroy(response);
+    PASS();
+}
+
+// An overlong line closes the connection without answering anything after it
+TEST test_server_unix_line_too_long(void) {
+    char *long_line = malloc(SERVER_MAX_LINE_LEN + 2);
+    ASSERT(long_line != NULL);
+    memset(long_line, 'x', SERVER_MAX_LINE_LEN + 1);
+    long_line[SERVER_MAX_LINE_LEN + 1] = '\0';
+
+    char *chunks[] = {long_line, "\n/stats\n"};
+
+    char_array *response = char_array_new();
+    ASSERT(test_server_exchange(false, chunks, sizeof(chunks) / sizeof(chunks[0]), response));
+    ASSERT_EQ(0, char_array_len(response));
+
+    char_array_destroy(response);
+    free(long_line);
+    PASS();
+}
+
+static greatest_test_res check_server_http(char *request, int status, char *body) {
+    char *chunks[] = {request};
+    char_array *response = char_array_new();
+    ASSERT(test_server_exchange(true, chunks, 1, response));
+
+    char *str = char_array_get_string(response);
+    char status_line[64];
+    snprintf(status_line, sizeof(status_line), "HTTP/1.0 %d %s\r\n", status, server_http_reason(status));
+    ASSERT(strncmp(status_line, str, strlen(status_line)) == 0);
+
+    char *header_end = strstr(str, "\r\n\r\n");
+    ASSERT(header_end != NULL);
+    char *response_body = header_end + strlen("\r\n\r\n");
+
+    char *content_length = strstr(str, "Content-Length: ");
+    ASSERT(content_length != NULL && content_length < header_end);
+    ASSERT_EQ(strlen(response_body), (size_t)strtoul(content_length + strlen("Content-Length: "), NULL, 10));
+
+    if (body != NULL) {
+        ASSERT_STR_EQ(body, response_body);
+    } else {
+        ASSERT(test_server_stats_requests(response_body) != UINT64_MAX);
+    }
+
+    char_array_destroy(response);
+    PASS();
+}
+
+TEST test_server_http_framing(void) {
+    // Headers are read and ignored, the status line carries the status
+    CHECK_CALL(check_server_http("GET /stats HTTP/1.1\r\nHost: localhost\r\nAccept: */*\r\n\r\n", HTTP_OK, NULL));
+    CHECK_CALL(check_server_http("GET /stats HTTP/1.0\n\n", HTTP_OK, NULL));
+    CHECK_CALL(check_server_http("GET /bogus HTTP/1.0\r\n\r\n", HTTP_NOT_FOUND, "{\"error\": \"unknown command\"}"));
+    CHECK_CALL(check_server_http("POST /stats HTTP/1.0\r\n\r\n", HTTP_METHOD_NOT_ALLOWED, "{\"error\": \"only GET is supported\"}"));
+    CHECK_CALL(check_server_http("garbage\r\n\r\n", HTTP_BAD_REQUEST, "{\"error\": \"malformed request line\"}"));
+    PASS();
+}
+
+// A client that connects and sends nothing is dropped after the idle timeout
+TEST test_server_idle_timeout(void) {
+    int fds[2];
+    ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    struct timeval recv_timeout = {.tv_sec = SERVER_RECV_TIMEOUT_SEC, .tv_usec = 0};
+    ASSERT(setsockopt(fds[1], SOL_SOCKET, SO_RCVTIMEO, &recv_timeout, sizeof(recv_timeout)) == 0);
+
+    uint64_t prev_idle_timeout_sec = server_idle_timeout_sec;
+    server_idle_timeout_sec = 2 * SERVER_RECV_TIMEOUT_SEC;
+
+    test_server_connection_t connection = {.fd = fds[1], .http = false};
+    pthread_t thread;
+    ASSERT(pthread_create(&thread, NULL, test_server_connection_thread, &connection) == 0);
+
+    // Blocks until the server closes its end, which it only does on timeout
+    char c;
+    ASSERT_EQ(0, read(fds[0], &c, 1));
+
+    pthread_join(thread, NULL);
+    close(fds[0]);
+    server_idle_timeout_sec = prev_idle_timeout_sec;
+    PASS();
+}
+
+// A stale socket is replaced, any other file at the socket path is left alone
+TEST test_server_listen_unix(void) {
+    char dir[] = "/tmp/test_server_XXXXXX";
+    ASSERT(mkdtemp(dir) != NULL);
+
+    char file_path[64];
+    char socket_path[64];
+    snprintf(file_path, sizeof(file_path), "%s/file", dir);
+    snprintf(socket_path, sizeof(socket_path), "%s/sock", dir);
+
+    FILE *f = fopen(file_path, "w");
+    ASSERT(f != NULL);
+    fputs("keep me\n", f);
+    fclose(f);
+
+    ASSERT_EQ(-1, server_listen_unix(file_path));
+    struct stat st;
+    ASSERT(lstat(file_path, &st) == 0);
+    ASSERT(S_ISREG(st.st_mode));
+    ASSERT_EQ(strlen("keep me\n"), (size_t)st.st_size);
+
+    int fd = server_listen_unix(socket_path);
+    ASSERT(fd >= 0);
+    close(fd);
+
+    // Closing the listener leaves the socket file behind
+    ASSERT(lstat(socket_path, &st) == 0);
+    ASSERT(S_ISSOCK(st.st_mode));
+
+    fd = server_listen_unix(socket_path);
+    ASSERT(fd >= 0);
+    close(fd);
+
+    unlink(socket_path);
+    unlink(file_path);
+    rmdir(dir);
+    PASS();
+}
+
+SUITE(libpostal_server_tests) {
+    // As in main, a client hanging up shouldn't kill the process
+    signal(SIGPIPE, SIG_IGN);
+
+    // /stats and unknown commands don't need any models loaded
+    request_queue.max_batch = DEFAULT_SERVER_MAX_BATCH;
+
+    pthread_t model_worker;
+    if (pthread_create(&model_worker, NULL, server_model_worker, NULL) != 0) {
+        log_error("Could not start model thread\n");
+        return;
+    }
+
+    RUN_TEST(test_server_unix_framing);
+    RUN_TEST(test_server_unix_line_too_long);
+    RUN_TEST(test_server_http_framing);
+    RUN_TEST(test_server_idle_timeout);
+    RUN_TEST(test_server_listen_unix);
+
+    pthread_mutex_lock(&request_queue.lock);
+    request_queue.stopped = true;
+    pthread_cond_broadcast(&request_queue.not_empty);
+    pthread_mutex_unlock(&request_queue.lock);
+
+    pthread_join(model_worker, NULL);
+}
@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "greatest.h"
+#include "../src/string_set.h"
+
+SUITE(libpostal_string_set_tests);
+
+TEST test_string_set_add_contains(void) {
+    string_set_t *set = string_set_new();
+    ASSERT(set != NULL);
+
+    ASSERT_EQ(1, string_set_add(set, "main st"));
+    ASSERT_EQ(0, string_set_add(set, "main st"));
+    ASSERT_EQ(1, string_set_add(set, ""));
+    ASSERT_EQ(0, string_set_add(set, ""));
+    ASSERT_EQ(2, string_set_size(set));
+
+    // Prefixes and extensions of a key are distinct keys
+    ASSERT_FALSE(string_set_contains(set, "main"));
+    ASSERT_FALSE(string_set_contains(set, "main street"));
+    ASSERT(string_set_contains_len(set, "main street", strlen("main st")));
+    ASSERT_EQ(1, string_set_add_len(set, "main street", strlen("main")));
+    ASSERT(string_set_contains(set, "main"));
+
+    string_set_clear(set);
+    ASSERT_EQ(0, string_set_size(set));
+    ASSERT_FALSE(string_set_contains(set, "main st"));
+    ASSERT_EQ(1, string_set_add(set, "main st"));
+
+    string_set_destroy(set);
+    PASS();
+}
+
+TEST test_string_set_grow(void) {
+    string_set_t *set = string_set_new();
+    ASSERT(set != NULL);
+
+    char key[32];
+    size_t num_keys = 10000;
+
+    for (size_t i = 0; i < num_keys; i++) {
+        sprintf(key, "key%zu", i);
+        ASSERT_EQ(1, string_set_add(set, key));
+    }
+    ASSERT_EQ(num_keys, string_set_size(set));
+
+    for (size_t i = 0; i < num_keys; i++) {
+        sprintf(key, "key%zu", i);
+        ASSERT(string_set_contains(set, key));
+        ASSERT_EQ(0, string_set_add(set, key));
+    }
+
+    ASSERT_FALSE(string_set_contains(set, "key10000"));
+
+    string_set_destroy(set);
+    PASS();
+}
+
+SUITE(libpostal_string_set_tests) {
+    RUN_TEST(test_string_set_add_contains);
+    RUN_TEST(test_string_set_grow);
+}
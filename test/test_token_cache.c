@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "greatest.h"
+#include "../src/token_cache.h"
+#include "../src/string_utils.h"
+
+SUITE(libpostal_token_cache_tests);
+
+static greatest_test_res check_token_cache_get(uint64_t tag, char *key, char *expected) {
+    char_array *out = char_array_new();
+    bool hit = token_cache_get(tag, key, strlen(key), out);
+    if (expected == NULL) {
+        ASSERT_FALSE(hit);
+    } else {
+        ASSERT(hit);
+        char_array_terminate(out);
+        ASSERT_STR_EQ(expected, char_array_get_string(out));
+    }
+    char_array_destroy(out);
+    PASS();
+}
+
+TEST test_token_cache_get_put(void) {
+    uint64_t tag1 = TOKEN_CACHE_TAG(TOKEN_CACHE_NORMALIZE_TOKEN, 1);
+    uint64_t tag2 = TOKEN_CACHE_TAG(TOKEN_CACHE_NORMALIZE_TOKEN, 2);
+
+    // Disabled cache never stores anything
+    token_cache_put(tag1, "st.", 3, "st", 2);
+    CHECK_CALL(check_token_cache_get(tag1, "st.", NULL));
+
+    ASSERT(token_cache_enable(64));
+    token_cache_reset_stats();
+
+    CHECK_CALL(check_token_cache_get(tag1, "st.", NULL));
+    token_cache_put(tag1, "st.", 3, "st", 2);
+    token_cache_put(tag1, "", 0, "", 0);
+    CHECK_CALL(check_token_cache_get(tag1, "st.", "st"));
+    CHECK_CALL(check_token_cache_get(tag1, "", ""));
+    // Same key with different options is a different entry
+    CHECK_CALL(check_token_cache_get(tag2, "st.", NULL));
+    CHECK_CALL(check_token_cache_get(tag1, "st", NULL));
+
+    token_cache_stats_t stats = token_cache_get_stats();
+    ASSERT_EQ(2, stats.hits);
+    ASSERT_EQ(3, stats.misses);
+    ASSERT_EQ(2, stats.inserts);
+
+    // Keys and values that don't fit in an entry are skipped
+    char long_key[TOKEN_CACHE_MAX_KEY_LEN + 2];
+    memset(long_key, 'a', sizeof(long_key) - 1);
+    long_key[sizeof(long_key) - 1] = '\0';
+    token_cache_put(tag1, long_key, strlen(long_key), "a", 1);
+    CHECK_CALL(check_token_cache_get(tag1, long_key, NULL));
+
+    token_cache_invalidate();
+    CHECK_CALL(check_token_cache_get(tag1, "st.", NULL));
+
+    token_cache_disable();
+    PASS();
+}
+
+TEST test_token_cache_eviction(void) {
+    uint64_t tag = TOKEN_CACHE_TAG(TOKEN_CACHE_TRANSLITERATE, 1);
+    size_t num_entries = 16;
+    ASSERT(token_cache_enable(num_entries));
+    token_cache_reset_stats();
+
+    char key[32];
+    char value[32];
+    size_t num_keys = num_entries * 8;
+
+    for (size_t i = 0; i < num_keys; i++) {
+        sprintf(key, "key%zu", i);
+        sprintf(value, "value%zu", i);
+        token_cache_put(tag, key, strlen(key), value, strlen(value));
+    }
+
+    // Whatever survived must still map to the right value
+    size_t num_found = 0;
+    char_array *out = char_array_new();
+    for (size_t i = 0; i < num_keys; i++) {
+        sprintf(key, "key%zu", i);
+        sprintf(value, "value%zu", i);
+        char_array_clear(out);
+        if (token_cache_get(tag, key, strlen(key), out)) {
+            char_array_terminate(out);
+            ASSERT_STR_EQ(value, char_array_get_string(out));
+            num_found++;
+        }
+    }
+    char_array_destroy(out);
+
+    ASSERT(num_found <= num_entries);
+    token_cache_stats_t stats = token_cache_get_stats();
+    ASSERT_EQ(num_keys, stats.inserts);
+    ASSERT(stats.evictions >= num_keys - num_entries);
+
+    token_cache_disable();
+    PASS();
+}
+
+SUITE(libpostal_token_cache_tests) {
+    RUN_TEST(test_token_cache_get_put);
+    RUN_TEST(test_token_cache_eviction);
+}
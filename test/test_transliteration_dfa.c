@@ -0,0 +1,387 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "greatest.h"
+#include "../src/transliterate.h"
+#include "../src/transliteration_dfa.h"
+
+SUITE(libpostal_transliteration_dfa_tests);
+
+static greatest_test_res check_transliteration_dfa_apply(transliteration_dfa_t *dfa, char *input, char *expected) {
+    char *output = transliteration_dfa_apply(dfa, input, strlen(input));
+    if (expected == NULL) {
+        ASSERT(output == NULL);
+    } else {
+        ASSERT(output != NULL);
+        ASSERT_STR_EQ(expected, output);
+        free(output);
+    }
+    PASS();
+}
+
+TEST test_transliteration_dfa(void) {
+    cstring_array *keys = cstring_array_new();
+    cstring_array *outputs = cstring_array_new();
+
+    char *rules[][2] = {
+        {"a", "b"},
+        {"ab", "x"},
+        {"ц", "ts"},
+        {"щ", "shch"},
+        {"ё", ""}
+    };
+
+    for (size_t i = 0; i < sizeof(rules) / sizeof(rules[0]); i++) {
+        cstring_array_add_string(keys, rules[i][0]);
+        cstring_array_add_string(outputs, rules[i][1]);
+    }
+
+    transliteration_dfa_t *dfa = transliteration_dfa_new(keys, outputs);
+    ASSERT(dfa != NULL);
+
+    CHECK_CALL(check_transliteration_dfa_apply(dfa, "", ""));
+    CHECK_CALL(check_transliteration_dfa_apply(dfa, "q", "q"));
+    CHECK_CALL(check_transliteration_dfa_apply(dfa, "ac", "bc"));
+    // Longest rule wins
+    CHECK_CALL(check_transliteration_dfa_apply(dfa, "abc", "xc"));
+    CHECK_CALL(check_transliteration_dfa_apply(dfa, "щёцa", "shchtsb"));
+    CHECK_CALL(check_transliteration_dfa_apply(dfa, "улица", "улиtsа"));
+    CHECK_CALL(check_transliteration_dfa_apply(dfa, "a\xff", NULL));
+
+    transliteration_dfa_destroy(dfa);
+
+    // Duplicate keys are rejected
+    cstring_array_add_string(keys, "a");
+    cstring_array_add_string(outputs, "c");
+    ASSERT(transliteration_dfa_new(keys, outputs) == NULL);
+
+    cstring_array_destroy(keys);
+    cstring_array_destroy(outputs);
+    PASS();
+}
+
+static transliteration_dfa_t *transliteration_dfa_from_rules(char *rules[][2], size_t num_rules) {
+    cstring_array *keys = cstring_array_new();
+    cstring_array *outputs = cstring_array_new();
+
+    for (size_t i = 0; i < num_rules; i++) {
+        cstring_array_add_string(keys, rules[i][0]);
+        cstring_array_add_string(outputs, rules[i][1]);
+    }
+
+    transliteration_dfa_t *dfa = transliteration_dfa_new(keys, outputs);
+    cstring_array_destroy(keys);
+    cstring_array_destroy(outputs);
+    return dfa;
+}
+
+static greatest_test_res check_transliteration_dfa_apply_steps(transliteration_dfa_t **dfas, size_t num_dfas, char *input, char *expected) {
+    size_t len = strlen(input);
+
+    // Applying the steps one at a time
+    char *sequential = strdup(input);
+    for (size_t i = 0; i < num_dfas && sequential != NULL; i++) {
+        char *next = transliteration_dfa_apply(dfas[i], sequential, len);
+        free(sequential);
+        sequential = next;
+    }
+
+    char_array *out = char_array_new();
+    char_array_append(out, "|");
+    bool ok = transliteration_dfa_apply_steps(dfas, num_dfas, input, len, out);
+
+    if (expected == NULL) {
+        ASSERT(sequential == NULL);
+        ASSERT_FALSE(ok);
+        ASSERT_STR_EQ("|", char_array_get_string(out));
+    } else {
+        ASSERT(ok);
+        ASSERT(sequential != NULL);
+        ASSERT_STR_EQ(expected, sequential);
+        ASSERT_STR_EQ(expected, char_array_get_string(out) + 1);
+        free(sequential);
+    }
+
+    char_array_destroy(out);
+    PASS();
+}
+
+TEST test_transliteration_dfa_apply_steps(void) {
+    char *first_rules[][2] = {
+        {"щ", "shch"},
+        {"ц", "ts"},
+        {"а", "a"},
+        {"ё", "\xd1"}
+    };
+    char *second_rules[][2] = {
+        {"sh", "S"},
+        {"a", "A"},
+        {"t", ""}
+    };
+
+    transliteration_dfa_t *dfas[2];
+    dfas[0] = transliteration_dfa_from_rules(first_rules, sizeof(first_rules) / sizeof(first_rules[0]));
+    dfas[1] = transliteration_dfa_from_rules(second_rules, sizeof(second_rules) / sizeof(second_rules[0]));
+    ASSERT(dfas[0] != NULL && dfas[1] != NULL);
+
+    CHECK_CALL(check_transliteration_dfa_apply_steps(dfas, 2, "", ""));
+    CHECK_CALL(check_transliteration_dfa_apply_steps(dfas, 2, "цa", "sa"));
+    // Later steps only see as many bytes as the original input had
+    CHECK_CALL(check_transliteration_dfa_apply_steps(dfas, 2, "щ", "S"));
+    // A rule output splitting a character is invalid UTF-8 for the next step
+    CHECK_CALL(check_transliteration_dfa_apply_steps(dfas, 2, "ёё", NULL));
+    CHECK_CALL(check_transliteration_dfa_apply_steps(dfas, 2, "a\xff", NULL));
+
+    transliteration_dfa_destroy(dfas[0]);
+    transliteration_dfa_destroy(dfas[1]);
+    PASS();
+}
+
+#define TRANSLITERATION_DFA_RANDOM_NUM_TABLES 50
+#define TRANSLITERATION_DFA_RANDOM_NUM_RULES 100
+#define TRANSLITERATION_DFA_RANDOM_NUM_INPUTS 100
+#define TRANSLITERATION_DFA_RANDOM_MAX_STEPS 5
+#define TRANSLITERATION_DFA_RANDOM_TRANSLITERATOR "random"
+
+// Overlapping one-, two- and three-byte characters
+static char *transliteration_dfa_random_chars[] = {
+    "a", "b", "c", " ", "ц", "ч", "é", "ё", "中", "р", "с", "т"
+};
+
+#define TRANSLITERATION_DFA_RANDOM_NUM_CHARS (sizeof(transliteration_dfa_random_chars) / sizeof(transliteration_dfa_random_chars[0]))
+
+// Returns the number of characters
+static size_t transliteration_dfa_random_string(char_array *str, size_t max_chars, size_t num_chars) {
+    char_array_clear(str);
+    size_t len = rand() % (max_chars + 1);
+    for (size_t i = 0; i < len; i++) {
+        char_array_append(str, transliteration_dfa_random_chars[rand() % num_chars]);
+    }
+    char_array_terminate(str);
+    return len;
+}
+
+// Adds a random ruleset step of plain string rules to the table
+static bool transliteration_dfa_random_step(transliteration_table_t *trans_table, char *step_name, size_t num_chars) {
+    transliteration_step_t *step = transliteration_step_new(step_name, STEP_RULESET);
+    if (step == NULL) return false;
+    step_array_push(trans_table->steps, step);
+
+    char_array *key = char_array_new();
+    char_array *rule = char_array_new();
+    char_array *replacement = char_array_new();
+    size_t num_rules = 1 + rand() % TRANSLITERATION_DFA_RANDOM_NUM_RULES;
+
+    for (size_t i = 0; i < num_rules; i++) {
+        // The first rule is never empty, so every step has at least one
+        if (transliteration_dfa_random_string(rule, 3, num_chars) == 0) {
+            if (i > 0) continue;
+            char_array_cat(rule, transliteration_dfa_random_chars[rand() % num_chars]);
+        }
+
+        char_array_clear(key);
+        char_array_cat_printf(key, "%s|%s|%s", TRANSLITERATION_DFA_RANDOM_TRANSLITERATOR, step_name, char_array_get_string(rule));
+        // Re-adding a key corrupts the trie
+        if (trie_get(trans_table->trie, char_array_get_string(key)) != NULL_NODE_ID) continue;
+
+        transliteration_dfa_random_string(replacement, 2, num_chars);
+        // Outputs that split a character
+        if (rand() % 50 == 0) char_array_cat(replacement, "\xd1");
+
+        uint32_t string_index = cstring_array_num_strings(trans_table->replacement_strings);
+        cstring_array_add_string(trans_table->replacement_strings, char_array_get_string(replacement));
+
+        uint32_t replacement_index = trans_table->replacements->n;
+        transliteration_replacement_array_push(trans_table->replacements, transliteration_replacement_new(string_index, 0, NULL));
+
+        trie_add(trans_table->trie, char_array_get_string(key), replacement_index);
+    }
+
+    char_array_destroy(key);
+    char_array_destroy(rule);
+    char_array_destroy(replacement);
+    return true;
+}
+
+static transliteration_dfa_t *transliteration_dfa_random(size_t num_chars) {
+    cstring_array *keys = cstring_array_new();
+    cstring_array *outputs = cstring_array_new();
+    char_array *key = char_array_new();
+    char_array *output = char_array_new();
+
+    size_t num_rules = 1 + rand() % TRANSLITERATION_DFA_RANDOM_NUM_RULES;
+
+    for (size_t i = 0; i < num_rules; i++) {
+        if (transliteration_dfa_random_string(key, 3, num_chars) == 0) {
+            if (i > 0) continue;
+            char_array_cat(key, transliteration_dfa_random_chars[rand() % num_chars]);
+        }
+
+        bool exists = false;
+        for (size_t j = 0; j < cstring_array_num_strings(keys) && !exists; j++) {
+            exists = strcmp(cstring_array_get_string(keys, j), char_array_get_string(key)) == 0;
+        }
+        if (exists) continue;
+
+        transliteration_dfa_random_string(output, 2, num_chars);
+        if (rand() % 50 == 0) char_array_cat(output, "\xd1");
+
+        cstring_array_add_string(keys, char_array_get_string(key));
+        cstring_array_add_string(outputs, char_array_get_string(output));
+    }
+
+    transliteration_dfa_t *dfa = transliteration_dfa_new(keys, outputs);
+
+    cstring_array_destroy(keys);
+    cstring_array_destroy(outputs);
+    char_array_destroy(key);
+    char_array_destroy(output);
+    return dfa;
+}
+
+/*
+Checks transliteration_dfa_apply_steps against applying the same 1-5 random
+steps one at a time with transliteration_dfa_apply, including invalid UTF-8,
+NUL bytes and rule outputs that split a character.
+*/
+TEST test_transliteration_dfa_apply_steps_random(void) {
+    srand(0);
+
+    char_array *str = char_array_new();
+    char_array *rest = char_array_new();
+    char_array *out = char_array_new();
+
+    for (size_t t = 0; t < TRANSLITERATION_DFA_RANDOM_NUM_TABLES; t++) {
+        transliteration_dfa_t *dfas[TRANSLITERATION_DFA_RANDOM_MAX_STEPS];
+        size_t num_dfas = 1 + rand() % TRANSLITERATION_DFA_RANDOM_MAX_STEPS;
+        size_t num_chars = 2 + rand() % (TRANSLITERATION_DFA_RANDOM_NUM_CHARS - 1);
+
+        for (size_t i = 0; i < num_dfas; i++) {
+            dfas[i] = transliteration_dfa_random(num_chars);
+            ASSERT(dfas[i] != NULL);
+        }
+
+        for (size_t i = 0; i < TRANSLITERATION_DFA_RANDOM_NUM_INPUTS; i++) {
+            transliteration_dfa_random_string(str, 12, num_chars);
+            if (rand() % 20 == 0) char_array_cat(str, "\xff" "a");
+            if (rand() % 20 == 0) char_array_cat(str, "\xd1");
+            // Bytes after a NUL are within len but never read
+            if (rand() % 20 == 0) {
+                char_array_cat_len(str, "\0", 1);
+                transliteration_dfa_random_string(rest, 4, num_chars);
+                char_array_cat(str, char_array_get_string(rest));
+            }
+
+            char *input = char_array_get_string(str);
+            size_t len = str->n - 1;
+
+            char *sequential = strndup(input, len);
+            for (size_t j = 0; j < num_dfas && sequential != NULL; j++) {
+                char *next = transliteration_dfa_apply(dfas[j], sequential, len);
+                free(sequential);
+                sequential = next;
+            }
+
+            char_array_clear(out);
+            char_array_append(out, "|");
+            bool ok = transliteration_dfa_apply_steps(dfas, num_dfas, input, len, out);
+
+            if (sequential == NULL) {
+                ASSERT_FALSE(ok);
+                ASSERT_EQ(1, out->n);
+            } else {
+                ASSERT(ok);
+                char_array_terminate(out);
+                ASSERT_STR_EQ(sequential, char_array_get_string(out) + 1);
+                free(sequential);
+            }
+        }
+
+        for (size_t i = 0; i < num_dfas; i++) {
+            transliteration_dfa_destroy(dfas[i]);
+        }
+    }
+
+    char_array_destroy(str);
+    char_array_destroy(rest);
+    char_array_destroy(out);
+    PASS();
+}
+
+/*
+Builds synthetic tables of plain string rules and checks that transliterate
+returns the same thing with the steps compiled as it does with the general
+matcher, i.e. with every step's DFA set to NULL.
+*/
+TEST test_transliteration_dfa_transliterate_random(void) {
+    srand(0);
+
+    char_array *str = char_array_new();
+
+    for (size_t t = 0; t < TRANSLITERATION_DFA_RANDOM_NUM_TABLES; t++) {
+        ASSERT(transliteration_module_init());
+        transliteration_table_t *trans_table = get_transliteration_table();
+
+        size_t num_steps = 1 + rand() % TRANSLITERATION_DFA_RANDOM_MAX_STEPS;
+        size_t num_chars = 2 + rand() % (TRANSLITERATION_DFA_RANDOM_NUM_CHARS - 1);
+
+        transliterator_t *trans = transliterator_new(strdup(TRANSLITERATION_DFA_RANDOM_TRANSLITERATOR), 0, trans_table->steps->n, num_steps);
+        ASSERT(trans != NULL);
+        ASSERT(transliteration_table_add_transliterator(trans));
+
+        for (size_t i = 0; i < num_steps; i++) {
+            char step_name[32];
+            snprintf(step_name, sizeof(step_name), "s%zu", i);
+            ASSERT(transliteration_dfa_random_step(trans_table, step_name, num_chars));
+        }
+
+        cstring_array *inputs = cstring_array_new();
+        cstring_array *expected = cstring_array_new();
+        uchar_array *valid = uchar_array_new();
+
+        for (size_t i = 0; i < TRANSLITERATION_DFA_RANDOM_NUM_INPUTS; i++) {
+            transliteration_dfa_random_string(str, 12, num_chars);
+            // Invalid UTF-8 and truncated characters
+            if (rand() % 20 == 0) char_array_cat(str, "\xff" "a");
+            if (rand() % 30 == 0) char_array_cat(str, "\xd1");
+            cstring_array_add_string(inputs, char_array_get_string(str));
+
+            char *input = cstring_array_get_string(inputs, i);
+            char *output = transliterate(TRANSLITERATION_DFA_RANDOM_TRANSLITERATOR, input, strlen(input));
+            cstring_array_add_string(expected, output != NULL ? output : "");
+            uchar_array_push(valid, output != NULL);
+            free(output);
+        }
+
+        ASSERT_EQ(num_steps, transliteration_table_compile_steps());
+
+        for (size_t i = 0; i < TRANSLITERATION_DFA_RANDOM_NUM_INPUTS; i++) {
+            char *input = cstring_array_get_string(inputs, i);
+            char *output = transliterate(TRANSLITERATION_DFA_RANDOM_TRANSLITERATOR, input, strlen(input));
+            if (!valid->a[i]) {
+                ASSERT(output == NULL);
+            } else {
+                ASSERT(output != NULL);
+                ASSERT_STR_EQ(cstring_array_get_string(expected, i), output);
+                free(output);
+            }
+        }
+
+        cstring_array_destroy(inputs);
+        cstring_array_destroy(expected);
+        uchar_array_destroy(valid);
+        transliteration_module_teardown();
+    }
+
+    char_array_destroy(str);
+    PASS();
+}
+
+SUITE(libpostal_transliteration_dfa_tests) {
+    RUN_TEST(test_transliteration_dfa);
+    RUN_TEST(test_transliteration_dfa_apply_steps);
+    RUN_TEST(test_transliteration_dfa_apply_steps_random);
+    RUN_TEST(test_transliteration_dfa_transliterate_random);
+}
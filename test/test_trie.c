@@ -56,6 +56,211 @@ TEST test_trie(void) {
     PASS();
 }
 
+static greatest_test_res test_trie_search_tokens_multi_matches_single(trie_multi_search_t *search, trie_t **tries, size_t num_tries, char *input) {
+    token_array *tokens = tokenize_keep_whitespace(input);
+    ASSERT(tokens != NULL);
+
+    trie_token_search_t searches[num_tries];
+    for (size_t i = 0; i < num_tries; i++) {
+        searches[i] = (trie_token_search_t){tries[i], ROOT_NODE_ID, input, tokens, phrase_array_new()};
+    }
+
+    ASSERT(trie_search_tokens_multi(search, searches, num_tries));
+
+    for (size_t i = 0; i < num_tries; i++) {
+        phrase_array *expected = trie_search_tokens(tries[i], input, tokens);
+        size_t num_expected = expected != NULL ? expected->n : 0;
+        phrase_array *phrases = searches[i].phrases;
+
+        ASSERT_EQ(num_expected, phrases->n);
+        for (size_t j = 0; j < num_expected; j++) {
+            ASSERT_EQ(expected->a[j].start, phrases->a[j].start);
+            ASSERT_EQ(expected->a[j].len, phrases->a[j].len);
+            ASSERT_EQ(expected->a[j].data, phrases->a[j].data);
+        }
+
+        if (expected != NULL) {
+            phrase_array_destroy(expected);
+        }
+        phrase_array_destroy(phrases);
+    }
+
+    token_array_destroy(tokens);
+    PASS();
+}
+
+TEST test_trie_search_tokens_multi(void) {
+    trie_t *trie = trie_new();
+    ASSERT(trie != NULL);
+    CHECK_CALL(test_trie_setup(trie));
+
+    trie_t *other = trie_new();
+    ASSERT(other != NULL);
+    CHECK_CALL(test_trie_add_get(other, "main", 1));
+    CHECK_CALL(test_trie_add_get(other, "main st", 2));
+    CHECK_CALL(test_trie_add_get(other, "st r", 3));
+    CHECK_CALL(test_trie_add_get(other, "20", 4));
+
+    trie_t *tries[] = {trie, other};
+    size_t num_tries = sizeof(tries) / sizeof(tries[0]);
+
+    trie_multi_search_t *search = trie_multi_search_new();
+    ASSERT(search != NULL);
+
+    CHECK_CALL(test_trie_search_tokens_multi_matches_single(search, tries, num_tries, "main st r 20"));
+    CHECK_CALL(test_trie_search_tokens_multi_matches_single(search, tries, num_tries, "state route 20 maine"));
+    CHECK_CALL(test_trie_search_tokens_multi_matches_single(search, tries, num_tries, "st rt st rd street"));
+    CHECK_CALL(test_trie_search_tokens_multi_matches_single(search, tries, num_tries, "st state st"));
+
+    trie_multi_search_destroy(search);
+    trie_destroy(other);
+    trie_destroy(trie);
+
+    PASS();
+}
+
+#define TRIE_SEARCH_RANDOM_NUM_DICTIONARIES 100
+#define TRIE_SEARCH_RANDOM_NUM_INPUTS 50
+
+TEST test_trie_search_tokens_multi_random(void) {
+    // Few words with shared prefixes, so phrases overlap and partial matches abound
+    char *words[] = {"st", "street", "s", "saint", "state", "main", "maine", "rt", "route", "rd", "20", "n", "ул", "улица"};
+    size_t num_words = sizeof(words) / sizeof(words[0]);
+    char *separators[] = {" ", " ", " ", ", ", "-"};
+    size_t num_separators = sizeof(separators) / sizeof(separators[0]);
+
+    srand(0);
+
+    trie_multi_search_t *search = trie_multi_search_new();
+    ASSERT(search != NULL);
+
+    char_array *str = char_array_new();
+
+    for (size_t d = 0; d < TRIE_SEARCH_RANDOM_NUM_DICTIONARIES; d++) {
+        size_t num_tries = 1 + rand() % 3;
+        trie_t *tries[3];
+
+        for (size_t i = 0; i < num_tries; i++) {
+            tries[i] = trie_new();
+            ASSERT(tries[i] != NULL);
+
+            size_t num_keys = 1 + rand() % 12;
+            for (size_t k = 0; k < num_keys; k++) {
+                char_array_clear(str);
+                size_t key_words = 1 + rand() % 3;
+                for (size_t w = 0; w < key_words; w++) {
+                    if (w > 0) char_array_cat(str, " ");
+                    char_array_cat(str, words[rand() % num_words]);
+                }
+                // Re-adding a key isn't supported, so check first like the builders do
+                char *key = char_array_get_string(str);
+                if (trie_get(tries[i], key) == NULL_NODE_ID) {
+                    ASSERT(trie_add(tries[i], key, (uint32_t)k + 1));
+                }
+            }
+        }
+
+        for (size_t n = 0; n < TRIE_SEARCH_RANDOM_NUM_INPUTS; n++) {
+            char_array_clear(str);
+            size_t input_words = 1 + rand() % 10;
+            for (size_t w = 0; w < input_words; w++) {
+                if (w > 0) char_array_cat(str, separators[rand() % num_separators]);
+                char_array_cat(str, words[rand() % num_words]);
+            }
+
+            CHECK_CALL(test_trie_search_tokens_multi_matches_single(search, tries, num_tries, char_array_get_string(str)));
+        }
+
+        for (size_t i = 0; i < num_tries; i++) {
+            trie_destroy(tries[i]);
+        }
+    }
+
+    char_array_destroy(str);
+    trie_multi_search_destroy(search);
+
+    PASS();
+}
+
+static greatest_test_res test_trie_fixture_get(trie_t *trie) {
+    char *keys[] = {"st", "street", "st rt", "st rd", "state route", "maine"};
+    uint32_t values[] = {1, 2, 3, 3, 4, 5};
+
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        uint32_t data;
+        ASSERT(trie_get_data(trie, keys[i], &data));
+        ASSERT_EQ(values[i], data);
+    }
+
+    char *missing[] = {"s", "str", "streets", "st r", "main", ""};
+    for (size_t i = 0; i < sizeof(missing) / sizeof(missing[0]); i++) {
+        uint32_t data;
+        ASSERT_FALSE(trie_get_data(trie, missing[i], &data));
+    }
+
+    ASSERT_EQ(6, trie_num_keys(trie));
+
+    PASS();
+}
+
+TEST test_trie_freeze(void) {
+    trie_t *trie = trie_new();
+    ASSERT(trie != NULL);
+    CHECK_CALL(test_trie_setup(trie));
+
+    ASSERT(trie_freeze(trie));
+    CHECK_CALL(test_trie_fixture_get(trie));
+
+    char *input = "main st r 20";
+    token_array *tokens = tokenize_keep_whitespace(input);
+    phrase_array *phrases = trie_search_tokens(trie, input, tokens);
+
+    ASSERT(phrases != NULL);
+    ASSERT_EQ(1, phrases->n);
+    ASSERT_EQ(2, phrases->a[0].start);
+    ASSERT_EQ(1, phrases->a[0].len);
+    phrase_array_destroy(phrases);
+    token_array_destroy(tokens);
+
+    // A frozen trie is still an ordinary double-array trie
+    CHECK_CALL(test_trie_add_get(trie, "road", 6));
+
+    trie_destroy(trie);
+
+    PASS();
+}
+
+TEST test_trie_compact(void) {
+    trie_t *trie = trie_new();
+    ASSERT(trie != NULL);
+    CHECK_CALL(test_trie_setup(trie));
+
+    ASSERT(trie_compact(trie));
+    ASSERT(trie_is_compact(trie));
+    CHECK_CALL(test_trie_fixture_get(trie));
+    ASSERT_FALSE(trie_add(trie, "road", 6));
+
+    FILE *f = tmpfile();
+    ASSERT(f != NULL);
+    ASSERT(trie_write(trie, f));
+    rewind(f);
+
+    trie_t *read_trie = trie_read(f);
+    fclose(f);
+    ASSERT(read_trie != NULL);
+    ASSERT(trie_is_compact(read_trie));
+    CHECK_CALL(test_trie_fixture_get(read_trie));
+
+    trie_destroy(read_trie);
+    trie_destroy(trie);
+
+    PASS();
+}
+
 GREATEST_SUITE(libpostal_trie_tests) {
     RUN_TEST(test_trie);
+    RUN_TEST(test_trie_search_tokens_multi);
+    RUN_TEST(test_trie_search_tokens_multi_random);
+    RUN_TEST(test_trie_freeze);
+    RUN_TEST(test_trie_compact);
 }